@@ -0,0 +1,214 @@
+/*
+A library to communicate a menu object set accross DBus and
+track updates and maintain consistency.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it 
+under the terms of either or both of the following licenses:
+
+1) the GNU Lesser General Public License version 3, as published by the 
+Free Software Foundation; and/or
+2) the GNU Lesser General Public License version 2.1, as published by 
+the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but 
+WITHOUT ANY WARRANTY; without even the implied warranties of 
+MERCHANTABILITY, SATISFACTORY QUALITY or FITNESS FOR A PARTICULAR 
+PURPOSE.  See the applicable version of the GNU Lesser General Public 
+License for more details.
+
+You should have received a copy of both the GNU Lesser General Public 
+License version 3 and version 2.1 along with this program.  If not, see 
+<http://www.gnu.org/licenses/>
+*/
+
+/* Every client watching menus on a connection used to get its own
+   signal subscription, and thus its own match rule on the bus.  The
+   hub makes one subscription per connection for the whole dbusmenu
+   interface and hands the signals out to the clients based on who
+   sent them and which object they're for. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "client-hub.h"
+
+#define DBUSMENU_INTERFACE  "com.canonical.dbusmenu"
+
+typedef struct _hub_t hub_t;
+struct _hub_t {
+	GDBusConnection * connection;
+	guint subscription;
+	GHashTable * routes; /* "sender\nobject" -> GList of route_t */
+};
+
+typedef struct _route_t route_t;
+struct _route_t {
+	guint id;
+	gchar * key;
+	hub_t * hub;
+	DbusmenuClientHubFunc func;
+	gpointer user_data;
+};
+
+static GHashTable * hubs = NULL;   /* GDBusConnection -> hub_t */
+static GHashTable * routes = NULL; /* ID -> route_t */
+static guint next_id = 1;
+
+static gchar *
+route_key (const gchar * sender, const gchar * object)
+{
+	return g_strconcat(sender, "\n", object, NULL);
+}
+
+/* Figure out which clients want the signal and pass it along */
+static void
+hub_signal_cb (GDBusConnection * connection, const gchar * sender, const gchar * object, const gchar * interface, const gchar * signal, GVariant * params, gpointer user_data)
+{
+	hub_t * hub = (hub_t *)user_data;
+
+	if (sender == NULL || object == NULL) {
+		return;
+	}
+
+	gchar * key = route_key(sender, object);
+	GList * list = g_hash_table_lookup(hub->routes, key);
+	g_free(key);
+
+	if (list == NULL) {
+		return;
+	}
+
+	/* Clients can go away while handling the signal, so take a
+	   copy of who we're calling and check they're still here */
+	guint count = g_list_length(list);
+	guint * ids = g_new(guint, count);
+	guint i;
+
+	for (i = 0; list != NULL; list = g_list_next(list), i++) {
+		ids[i] = ((route_t *)list->data)->id;
+	}
+
+	for (i = 0; i < count; i++) {
+		route_t * route = g_hash_table_lookup(routes, GUINT_TO_POINTER(ids[i]));
+		if (route != NULL) {
+			route->func(sender, signal, params, route->user_data);
+		}
+	}
+
+	g_free(ids);
+
+	return;
+}
+
+/* Get the hub for @connection, building it if we need to */
+static hub_t *
+hub_get (GDBusConnection * connection)
+{
+	if (hubs == NULL) {
+		hubs = g_hash_table_new(g_direct_hash, g_direct_equal);
+		routes = g_hash_table_new(g_direct_hash, g_direct_equal);
+	}
+
+	hub_t * hub = g_hash_table_lookup(hubs, connection);
+	if (hub != NULL) {
+		return hub;
+	}
+
+	hub = g_new0(hub_t, 1);
+	hub->connection = g_object_ref(connection);
+	hub->routes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	hub->subscription = g_dbus_connection_signal_subscribe(connection,
+	                                                       NULL, /* sender */
+	                                                       DBUSMENU_INTERFACE,
+	                                                       NULL, /* member */
+	                                                       NULL, /* object path */
+	                                                       NULL, /* arg0 */
+	                                                       G_DBUS_SIGNAL_FLAGS_NONE,
+	                                                       hub_signal_cb,
+	                                                       hub,
+	                                                       NULL);
+
+	g_hash_table_insert(hubs, connection, hub);
+
+	return hub;
+}
+
+/* Drop the hub once nobody is using it anymore */
+static void
+hub_free (hub_t * hub)
+{
+	g_hash_table_remove(hubs, hub->connection);
+
+	g_dbus_connection_signal_unsubscribe(hub->connection, hub->subscription);
+	g_hash_table_destroy(hub->routes);
+	g_object_unref(hub->connection);
+	g_free(hub);
+
+	return;
+}
+
+/* Start passing the dbusmenu signals from @sender for @object
+   on @connection to @func.  @sender needs to be the unique name
+   as that's what the signals come from.  Returns an ID to pass
+   to _dbusmenu_client_hub_unregister() */
+guint
+_dbusmenu_client_hub_register (GDBusConnection * connection, const gchar * sender, const gchar * object, DbusmenuClientHubFunc func, gpointer user_data)
+{
+	g_return_val_if_fail(G_IS_DBUS_CONNECTION(connection), 0);
+	g_return_val_if_fail(sender != NULL, 0);
+	g_return_val_if_fail(object != NULL, 0);
+	g_return_val_if_fail(func != NULL, 0);
+
+	hub_t * hub = hub_get(connection);
+
+	route_t * route = g_new0(route_t, 1);
+	route->id = next_id++;
+	route->key = route_key(sender, object);
+	route->hub = hub;
+	route->func = func;
+	route->user_data = user_data;
+
+	GList * list = g_hash_table_lookup(hub->routes, route->key);
+	list = g_list_prepend(list, route);
+	g_hash_table_insert(hub->routes, g_strdup(route->key), list);
+
+	g_hash_table_insert(routes, GUINT_TO_POINTER(route->id), route);
+
+	return route->id;
+}
+
+/* Stop passing signals for a registration */
+void
+_dbusmenu_client_hub_unregister (guint id)
+{
+	if (routes == NULL) {
+		return;
+	}
+
+	route_t * route = g_hash_table_lookup(routes, GUINT_TO_POINTER(id));
+	g_return_if_fail(route != NULL);
+
+	g_hash_table_remove(routes, GUINT_TO_POINTER(id));
+
+	hub_t * hub = route->hub;
+	GList * list = g_hash_table_lookup(hub->routes, route->key);
+	list = g_list_remove(list, route);
+
+	if (list == NULL) {
+		g_hash_table_remove(hub->routes, route->key);
+	} else {
+		g_hash_table_insert(hub->routes, g_strdup(route->key), list);
+	}
+
+	if (g_hash_table_size(hub->routes) == 0) {
+		hub_free(hub);
+	}
+
+	g_free(route->key);
+	g_free(route);
+
+	return;
+}
@@ -0,0 +1,49 @@
+/*
+A library to communicate a menu object set accross DBus and
+track updates and maintain consistency.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it 
+under the terms of either or both of the following licenses:
+
+1) the GNU Lesser General Public License version 3, as published by the 
+Free Software Foundation; and/or
+2) the GNU Lesser General Public License version 2.1, as published by 
+the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but 
+WITHOUT ANY WARRANTY; without even the implied warranties of 
+MERCHANTABILITY, SATISFACTORY QUALITY or FITNESS FOR A PARTICULAR 
+PURPOSE.  See the applicable version of the GNU Lesser General Public 
+License for more details.
+
+You should have received a copy of both the GNU Lesser General Public 
+License version 3 and version 2.1 along with this program.  If not, see 
+<http://www.gnu.org/licenses/>
+*/
+
+#ifndef __DBUSMENU_CLIENT_HUB_H__
+#define __DBUSMENU_CLIENT_HUB_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* Called for each dbusmenu signal from the sender and object
+   that it was registered for */
+typedef void (*DbusmenuClientHubFunc) (const gchar * sender,
+                                       const gchar * signal,
+                                       GVariant * params,
+                                       gpointer user_data);
+
+guint                _dbusmenu_client_hub_register   (GDBusConnection * connection,
+                                                      const gchar * sender,
+                                                      const gchar * object,
+                                                      DbusmenuClientHubFunc func,
+                                                      gpointer user_data);
+void                 _dbusmenu_client_hub_unregister (guint id);
+
+G_END_DECLS
+
+#endif
@@ -30,21 +30,50 @@ License version 3 and version 2.1 along with this program.  If not, see
 #include "config.h"
 #endif
 
+#include <string.h>
+
 #include <gio/gio.h>
+#include <glib/gstdio.h>
 
 #include "client.h"
 #include "client-private.h"
 #include "menuitem.h"
 #include "menuitem-private.h"
 #include "client-menuitem.h"
+#include "client-hub.h"
 #include "server-marshal.h"
 #include "client-marshal.h"
 #include "dbus-menu-clean.xml.h"
 #include "enum-types.h"
 
 /* How many property requests should we queue before
-   sending the message on dbus */
-#define MAX_PROPERTIES_TO_QUEUE  100
+   sending the message on dbus.  We start in the middle and
+   then adjust based on how big and slow the replies are. */
+#define MIN_PROPERTIES_TO_QUEUE    25
+#define START_PROPERTIES_TO_QUEUE  100
+#define MAX_PROPERTIES_TO_QUEUE    1000
+
+/* What we'd like a properties reply to stay under, in bytes
+   and in microseconds */
+#define PROPERTIES_REPLY_SIZE      (256 * 1024)
+#define PROPERTIES_REPLY_TIME      (100 * 1000)
+
+/* How deep we get the layout at a time with lazy layouts: the
+   items themselves and their submenus */
+#define LAZY_LAYOUT_DEPTH  2
+
+/* How many distinct property values we share between all the
+   clients before starting the table over */
+#define INTERN_MAX_VALUES  4096
+
+/* How much of a shared value goes into its hash, the equal
+   function looks at the rest */
+#define INTERN_HASH_PREFIX  64
+
+/* The version of the layout cache file format, and how long
+   to wait after a change before writing it out */
+#define LAYOUT_CACHE_VERSION  1
+#define LAYOUT_CACHE_DELAY    2
 
 /* Properties */
 enum {
@@ -53,7 +82,16 @@ enum {
 	PROP_DBUSNAME,
 	PROP_STATUS,
 	PROP_TEXT_DIRECTION,
-	PROP_GROUP_EVENTS
+	PROP_GROUP_EVENTS,
+	PROP_LAZY_LAYOUT,
+	PROP_CACHE_LAYOUT,
+	PROP_LAYOUT_DEBOUNCE,
+	PROP_LAYOUT_MAX_STALENESS,
+	PROP_LAYOUT_FETCHES_SAVED,
+	PROP_SHARED_CONNECTION,
+	PROP_LEAN_TRANSPORT,
+	PROP_RECONNECT_GRACE,
+	PROP_FLAT_LAYOUT
 };
 
 /* Signals */
@@ -64,6 +102,7 @@ enum {
 	ITEM_ACTIVATE,
 	EVENT_RESULT,
 	ICON_THEME_DIRS,
+	ITEMS_PROPERTIES_CHANGED,
 	LAST_SIGNAL
 };
 
@@ -75,6 +114,23 @@ enum {
 
 typedef void (*properties_func) (GVariant * properties, GError * error, gpointer user_data);
 
+/* The whole layout kept as arrays instead of menuitems.  Items are
+   in breadth first order so that the children of an item are all
+   next to each other.  Each item's properties are a run in the
+   property arrays, runs that grow move to the end. */
+typedef struct _flat_mirror_t flat_mirror_t;
+struct _flat_mirror_t {
+	GArray * ids;         /* gint */
+	GArray * parents;     /* gint, index of the parent or -1 */
+	GArray * child_start; /* guint, index of the first child */
+	GArray * child_count; /* guint */
+	GArray * prop_start;  /* guint, into prop_names and prop_values */
+	GArray * prop_count;  /* guint */
+	GArray * prop_names;  /* GQuark */
+	GPtrArray * prop_values; /* GVariant *, interned */
+	GHashTable * id_index; /* ID -> index + 1 */
+};
+
 static guint signals[LAST_SIGNAL] = { 0 };
 
 struct _DbusmenuClientPrivate
@@ -92,9 +148,44 @@ struct _DbusmenuClientPrivate
 
 	GCancellable * layoutcall;
 	GVariant * layout_props;
+	GStrv property_filter; /* NULL means all properties */
 
 	gint current_revision;
 	gint my_revision;
+	gboolean layout_delta; /* server supports GetLayoutDelta */
+	gint dirty_parent; /* -1 when no update is pending */
+
+	gboolean lazy_layout;
+	GHashTable * lazy_items; /* IDs of items whose children we haven't gotten */
+	GHashTable * lazy_calls; /* ID -> GCancellable of a fetch in progress */
+
+	GHashTable * item_index; /* ID -> DbusmenuMenuitem in our tree */
+
+	gboolean cache_layout;
+	guint cache_load_idle;
+	guint cache_save_timeout;
+
+	guint layout_debounce; /* ms to wait for the server to settle, 0 for none */
+	guint layout_max_staleness; /* ms we can wait in total, 0 for no limit */
+	guint layout_debounce_timeout;
+	gint64 layout_stale_since; /* when we started waiting, 0 if we aren't */
+	guint layout_fetches_saved;
+	guint layout_absorbed; /* updates while a call was out */
+
+	gboolean shared_connection;
+	guint hub_registration;
+
+	gboolean lean_transport;
+	gchar * lean_owner; /* unique name of the server, NULL when it's gone */
+	guint lean_watch;
+	guint lean_signals;
+	guint lean_properties;
+	GCancellable * lean_cancel; /* GetAll in progress */
+
+	guint reconnect_grace; /* ms to keep the tree after the server leaves */
+	guint reconnect_timeout;
+
+	flat_mirror_t * flat; /* NULL unless we're keeping a flat layout */
 
 	guint dbusproxy;
 
@@ -102,8 +193,13 @@ struct _DbusmenuClientPrivate
 
 	GArray * delayed_property_list;
 	GArray * delayed_property_listeners;
+	GHashTable * delayed_property_index; /* ID -> position in listeners + 1 */
+	guint delayed_property_max;
 	gint delayed_idle;
 
+	guint realize_idle;
+	GQueue * realize_queue; /* type: newItemPropData * */
+
 	DbusmenuTextDirection text_direction;
 	DbusmenuStatus status;
 	GStrv icon_dirs;
@@ -155,6 +251,8 @@ typedef struct _properties_callback_t properties_callback_t;
 struct _properties_callback_t {
 	DbusmenuClient * client;
 	GArray * listeners;
+	GHashTable * index;
+	gint64 sent;
 };
 
 
@@ -170,13 +268,17 @@ static void set_property (GObject * obj, guint id, const GValue * value, GParamS
 static void get_property (GObject * obj, guint id, GValue * value, GParamSpec * pspec);
 /* Private Funcs */
 static void layout_update (GDBusProxy * proxy, guint revision, gint parent, DbusmenuClient * client);
-static void id_prop_update (GDBusProxy * proxy, gint id, gchar * property, GVariant * value, DbusmenuClient * client);
+static DbusmenuMenuitem * id_prop_update (GDBusProxy * proxy, gint id, gchar * property, GVariant * value, DbusmenuClient * client);
 static void id_update (GDBusProxy * proxy, gint id, DbusmenuClient * client);
 static void build_proxies (DbusmenuClient * client);
-static DbusmenuMenuitem * parse_layout_xml(DbusmenuClient * client, GVariant * layout, DbusmenuMenuitem * item, DbusmenuMenuitem * parent, GDBusProxy * proxy);
-static gint parse_layout (DbusmenuClient * client, GVariant * layout);
+static DbusmenuMenuitem * parse_layout_xml(DbusmenuClient * client, GVariant * layout, DbusmenuMenuitem * item, DbusmenuMenuitem * parent, GDBusProxy * proxy, gint depth);
+static gint parse_layout (DbusmenuClient * client, GVariant * layout, gint depth);
+static gint layout_apply (DbusmenuClient * client, GVariant * layout, gint depth);
 static void update_layout_cb (GObject * proxy, GAsyncResult * res, gpointer data);
 static void update_layout (DbusmenuClient * client);
+static void update_layout_debounced (DbusmenuClient * client);
+static void update_layout_full (DbusmenuClient * client);
+static void update_layout_subtree (DbusmenuClient * client, DbusmenuMenuitem * parent);
 static void menuitem_get_properties_cb (GVariant * properties, GError * error, gpointer data);
 static void get_properties_globber (DbusmenuClient * client, gint id, const gchar ** properties, properties_func callback, gpointer user_data);
 static GQuark error_domain (void);
@@ -185,13 +287,51 @@ static void menuproxy_build_cb (GObject * object, GAsyncResult * res, gpointer u
 static void menuproxy_prop_changed_cb (GDBusProxy * proxy, GVariant * properties, GStrv invalidated, gpointer user_data);
 static void menuproxy_name_changed_cb (GObject * object, GParamSpec * pspec, gpointer user_data);
 static void menuproxy_signal_cb (GDBusProxy * proxy, gchar * sender, gchar * signal, GVariant * params, gpointer user_data);
+static void menu_signal (DbusmenuClient * client, const gchar * signal, GVariant * params);
+static void server_properties_update (DbusmenuClient * client, GVariant * properties, const gchar * const * invalidated);
+static void client_call (DbusmenuClient * client, const gchar * method, GVariant * params, GDBusCallFlags flags, gint timeout, GCancellable * cancellable, GAsyncReadyCallback callback, gpointer user_data);
+static GVariant * client_call_finish (GObject * source, GAsyncResult * res, GError ** error);
+static gchar * client_name_owner (DbusmenuClientPrivate * priv);
+static void lean_build (DbusmenuClient * client);
+static void hub_register (DbusmenuClient * client);
 static void type_handler_destroy (gpointer user_data);
 static void event_data_end (event_data_t * eventd, GError * error);
 static void about_to_show_finish_pntr (gpointer data, gpointer user_data);
+static gboolean property_wanted (DbusmenuClientPrivate * priv, const gchar * property);
+static void build_layout_props (DbusmenuClientPrivate * priv);
+static gboolean layout_cache_load_idle (gpointer user_data);
+static void layout_cache_queue (DbusmenuClient * client);
+static void layout_cache_save (DbusmenuClient * client);
+static DbusmenuMenuitem * item_index_lookup (DbusmenuClientPrivate * priv, gint id);
+static GVariant * intern_value (GVariant * value);
+static void flat_free (flat_mirror_t * flat);
+static void flat_clear (flat_mirror_t * flat);
+static gboolean flat_rebuild (flat_mirror_t * flat, GVariant * layout);
+static void flat_property_set (flat_mirror_t * flat, gint id, const gchar * property, GVariant * value);
+static GVariant * flat_build_layout (flat_mirror_t * flat, guint index);
+static gboolean flat_apply_delta (flat_mirror_t * flat, GVariant * updates);
+static void flat_signal (DbusmenuClient * client, GQuark signal_quark, GVariant * params);
 
 /* Globals */
 static GDBusNodeInfo *            dbusmenu_node_info = NULL;
 static GDBusInterfaceInfo *       dbusmenu_interface_info = NULL;
+static GHashTable *               dbusmenu_reply_types = NULL; /* method -> GVariantType */
+static GHashTable *               dbusmenu_signal_types = NULL; /* signal -> GVariantType */
+
+/* The signals we get from the server, looked up once so that
+   dispatching them is just comparing integers */
+static GQuark signal_layout_updated = 0;
+static GQuark signal_items_properties_updated = 0;
+static GQuark signal_item_property_updated = 0;
+static GQuark signal_item_updated = 0;
+static GQuark signal_item_activation_requested = 0;
+
+/* Property values shared between all the items of all the clients,
+   the same value from the server is only kept once */
+G_LOCK_DEFINE_STATIC(interned);
+static GHashTable *               interned_values = NULL;
+static guint                      interned_hits = 0;
+static gsize                      interned_bytes_saved = 0;
 
 /* Build a type */
 G_DEFINE_TYPE (DbusmenuClient, dbusmenu_client, G_TYPE_OBJECT);
@@ -305,6 +445,26 @@ dbusmenu_client_class_init (DbusmenuClientClass *klass)
 	                                        NULL, NULL,
 	                                        _dbusmenu_client_marshal_VOID__POINTER,
 	                                        G_TYPE_NONE, 1, G_TYPE_POINTER);
+	/**
+		DbusmenuClient::items-properties-changed:
+		@arg0: The #DbusmenuClient object
+		@arg1: (element-type DbusmenuMenuitem GStrv): A #GHashTable of the
+			#DbusmenuMenuitem objects that changed to a #GStrv of the
+			names of the properties that changed on each.
+
+		Signaled once all of the property changes that the server sent
+		together have been applied.  Each item has also signaled
+		#DbusmenuMenuitem::property-changed for every change, but
+		this lets those who'd rather update once per item wait
+		for the whole batch.
+	*/
+	signals[ITEMS_PROPERTIES_CHANGED] = g_signal_new(DBUSMENU_CLIENT_SIGNAL_ITEMS_PROPERTIES_CHANGED,
+	                                        G_TYPE_FROM_CLASS (klass),
+	                                        G_SIGNAL_RUN_LAST,
+	                                        G_STRUCT_OFFSET (DbusmenuClientClass, items_properties_changed),
+	                                        NULL, NULL,
+	                                        g_cclosure_marshal_VOID__BOXED,
+	                                        G_TYPE_NONE, 1, G_TYPE_HASH_TABLE);
 
 	g_object_class_install_property (object_class, PROP_DBUSOBJECT,
 	                                 g_param_spec_string(DBUSMENU_CLIENT_PROP_DBUS_OBJECT, "DBus Object we represent",
@@ -330,6 +490,46 @@ dbusmenu_client_class_init (DbusmenuClientClass *klass)
 	                                 g_param_spec_boolean(DBUSMENU_CLIENT_PROP_GROUP_EVENTS, "Whether or not multiple events should be grouped",
 	                                              "Event grouping lowers the number of messages on DBus and will be set automatically based on the version to optimize traffic.  It can be disabled for testing or other purposes.",
 	                                              FALSE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property (object_class, PROP_LAZY_LAYOUT,
+	                                 g_param_spec_boolean(DBUSMENU_CLIENT_PROP_LAZY_LAYOUT, "Only get submenus when they're needed",
+	                                              "Gets the top levels of the layout at first and the rest of the submenus as they're about to be shown.  This makes large menus much cheaper if most of them are never opened.",
+	                                              FALSE, G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property (object_class, PROP_CACHE_LAYOUT,
+	                                 g_param_spec_boolean(DBUSMENU_CLIENT_PROP_CACHE_LAYOUT, "Keep a copy of the layout on disk",
+	                                              "Saves the layout in the user's cache directory and builds the menus from it on startup, before the server has answered.  The layout from the server then replaces it as usual.  Servers that are only known by a unique bus name aren't cached.",
+	                                              FALSE, G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property (object_class, PROP_LAYOUT_DEBOUNCE,
+	                                 g_param_spec_uint(DBUSMENU_CLIENT_PROP_LAYOUT_DEBOUNCE, "Time to wait for layout changes to settle",
+	                                              "How many milliseconds to wait after the server says the layout changed before getting it, starting over each time it changes again.  Zero gets it right away.",
+	                                              0, G_MAXUINT, 0,
+	                                              G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property (object_class, PROP_LAYOUT_MAX_STALENESS,
+	                                 g_param_spec_uint(DBUSMENU_CLIENT_PROP_LAYOUT_MAX_STALENESS, "Longest time to wait for layout changes",
+	                                              "The most milliseconds that waiting for the layout to settle can add up to before it is gotten anyway.  Zero means there is no limit.",
+	                                              0, G_MAXUINT, 0,
+	                                              G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property (object_class, PROP_LAYOUT_FETCHES_SAVED,
+	                                 g_param_spec_uint(DBUSMENU_CLIENT_PROP_LAYOUT_FETCHES_SAVED, "Layout fetches saved",
+	                                              "How many times getting the layout was folded into a later one, either by waiting for changes to settle or because a call for it was already on its way.",
+	                                              0, G_MAXUINT, 0,
+	                                              G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property (object_class, PROP_SHARED_CONNECTION,
+	                                 g_param_spec_boolean(DBUSMENU_CLIENT_PROP_SHARED_CONNECTION, "Share signal handling with other clients",
+	                                              "Gets the menu signals through one subscription shared by all the clients on the connection instead of each client adding its own.  Useful when there are a lot of clients in one process.",
+	                                              FALSE, G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property (object_class, PROP_LEAN_TRANSPORT,
+	                                 g_param_spec_boolean(DBUSMENU_CLIENT_PROP_LEAN_TRANSPORT, "Talk to the server without a GDBusProxy",
+	                                              "Makes the calls and watches the signals directly on the connection instead of through a GDBusProxy.  The server's properties come in one GetAll and the layout is asked for alongside it, so starting up takes one round trip once the server is found.",
+	                                              FALSE, G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property (object_class, PROP_RECONNECT_GRACE,
+	                                 g_param_spec_uint(DBUSMENU_CLIENT_PROP_RECONNECT_GRACE, "Time to wait for the server to come back",
+	                                              "How many milliseconds to keep the menus after the server leaves the bus.  If it comes back in that time its layout is matched up with the menus we kept, so the items that didn't change stay as they are.  Zero drops the menus right away.",
+	                                              0, G_MAXUINT, 0,
+	                                              G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property (object_class, PROP_FLAT_LAYOUT,
+	                                 g_param_spec_boolean(DBUSMENU_CLIENT_PROP_FLAT_LAYOUT, "Keep the layout as flat arrays",
+	                                              "Keeps the layout in compact arrays that can be read with the dbusmenu_client_flat functions instead of building a menuitem for every entry.  The menuitems are only built if dbusmenu_client_get_root() is called.",
+	                                              FALSE, G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
 
 	if (dbusmenu_node_info == NULL) {
 		GError * error = NULL;
@@ -349,11 +549,54 @@ dbusmenu_client_class_init (DbusmenuClientClass *klass)
 		}
 	}
 
+	/* Without a proxy nobody checks the replies for us, so
+	   keep what each method should return handy */
+	if (dbusmenu_reply_types == NULL) {
+		dbusmenu_reply_types = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify)g_variant_type_free);
+
+		gint i, j;
+		for (i = 0; dbusmenu_interface_info->methods != NULL && dbusmenu_interface_info->methods[i] != NULL; i++) {
+			GDBusMethodInfo * method = dbusmenu_interface_info->methods[i];
+			GString * type = g_string_new("(");
+
+			for (j = 0; method->out_args != NULL && method->out_args[j] != NULL; j++) {
+				g_string_append(type, method->out_args[j]->signature);
+			}
+			g_string_append_c(type, ')');
+
+			g_hash_table_insert(dbusmenu_reply_types, method->name, g_variant_type_new(type->str));
+			g_string_free(type, TRUE);
+		}
+	}
+
+	/* And the same for the signals */
+	if (dbusmenu_signal_types == NULL) {
+		dbusmenu_signal_types = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify)g_variant_type_free);
+
+		gint i, j;
+		for (i = 0; dbusmenu_interface_info->signals != NULL && dbusmenu_interface_info->signals[i] != NULL; i++) {
+			GDBusSignalInfo * signal = dbusmenu_interface_info->signals[i];
+			GString * type = g_string_new("(");
+
+			for (j = 0; signal->args != NULL && signal->args[j] != NULL; j++) {
+				g_string_append(type, signal->args[j]->signature);
+			}
+			g_string_append_c(type, ')');
+
+			g_hash_table_insert(dbusmenu_signal_types, signal->name, g_variant_type_new(type->str));
+			g_string_free(type, TRUE);
+		}
+	}
+
+	signal_layout_updated = g_quark_from_static_string("LayoutUpdated");
+	signal_items_properties_updated = g_quark_from_static_string("ItemsPropertiesUpdated");
+	signal_item_property_updated = g_quark_from_static_string("ItemPropertyUpdated");
+	signal_item_updated = g_quark_from_static_string("ItemUpdated");
+	signal_item_activation_requested = g_quark_from_static_string("ItemActivationRequested");
+
 	return;
 }
 
-#define LAYOUT_PROPS_COUNT  6
-
 static void
 dbusmenu_client_init (DbusmenuClient *self)
 {
@@ -374,19 +617,46 @@ dbusmenu_client_init (DbusmenuClient *self)
 
 	priv->layoutcall = NULL;
 
-	gchar * layout_props[LAYOUT_PROPS_COUNT + 1];
-	layout_props[0] = DBUSMENU_MENUITEM_PROP_TYPE;
-	layout_props[1] = DBUSMENU_MENUITEM_PROP_LABEL;
-	layout_props[2] = DBUSMENU_MENUITEM_PROP_VISIBLE;
-	layout_props[3] = DBUSMENU_MENUITEM_PROP_ENABLED;
-	layout_props[4] = DBUSMENU_MENUITEM_PROP_CHILD_DISPLAY;
-	layout_props[5] = DBUSMENU_MENUITEM_PROP_ACCESSIBLE_DESC;
-	layout_props[LAYOUT_PROPS_COUNT] = NULL;
-	priv->layout_props = g_variant_new_strv((const gchar * const *)layout_props, LAYOUT_PROPS_COUNT);
-	g_variant_ref_sink(priv->layout_props);
+	priv->layout_props = NULL;
+	priv->property_filter = NULL;
+	build_layout_props(priv);
 
 	priv->current_revision = 0;
 	priv->my_revision = 0;
+	priv->layout_delta = FALSE;
+	priv->dirty_parent = -1;
+
+	priv->lazy_layout = FALSE;
+
+	priv->cache_layout = FALSE;
+	priv->cache_load_idle = 0;
+	priv->cache_save_timeout = 0;
+
+	priv->layout_debounce = 0;
+	priv->layout_max_staleness = 0;
+	priv->layout_debounce_timeout = 0;
+	priv->layout_stale_since = 0;
+	priv->layout_fetches_saved = 0;
+	priv->layout_absorbed = 0;
+
+	priv->shared_connection = FALSE;
+	priv->hub_registration = 0;
+
+	priv->lean_transport = FALSE;
+	priv->lean_owner = NULL;
+	priv->lean_watch = 0;
+	priv->lean_signals = 0;
+	priv->lean_properties = 0;
+	priv->lean_cancel = NULL;
+
+	priv->reconnect_grace = 0;
+	priv->reconnect_timeout = 0;
+
+	priv->flat = NULL;
+	priv->lazy_items = g_hash_table_new(g_direct_hash, g_direct_equal);
+	priv->lazy_calls = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_object_unref);
+
+	priv->item_index = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_object_unref);
 
 	priv->dbusproxy = 0;
 
@@ -395,7 +665,12 @@ dbusmenu_client_init (DbusmenuClient *self)
 
 	priv->delayed_idle = 0;
 	priv->delayed_property_list = g_array_new(TRUE, FALSE, sizeof(gchar *));
+
+	priv->realize_idle = 0;
+	priv->realize_queue = g_queue_new();
 	priv->delayed_property_listeners = g_array_new(FALSE, FALSE, sizeof(properties_listener_t));
+	priv->delayed_property_index = g_hash_table_new(g_direct_hash, g_direct_equal);
+	priv->delayed_property_max = START_PROPERTIES_TO_QUEUE;
 
 	priv->text_direction = DBUSMENU_TEXT_DIRECTION_NONE;
 	priv->status = DBUSMENU_STATUS_NORMAL;
@@ -421,6 +696,22 @@ dbusmenu_client_dispose (GObject *object)
 		priv->delayed_idle = 0;
 	}
 
+	if (priv->realize_idle != 0) {
+		g_source_remove(priv->realize_idle);
+		priv->realize_idle = 0;
+	}
+
+	/* No one is going to see these now */
+	if (priv->realize_queue != NULL) {
+		newItemPropData * propdata;
+		while ((propdata = g_queue_pop_head(priv->realize_queue)) != NULL) {
+			g_object_unref(propdata->item);
+			g_free(propdata);
+		}
+		g_queue_free(priv->realize_queue);
+		priv->realize_queue = NULL;
+	}
+
 	if (priv->event_idle != 0) {
 		g_source_remove(priv->event_idle);
 		priv->event_idle = 0;
@@ -480,6 +771,11 @@ dbusmenu_client_dispose (GObject *object)
 		priv->delayed_property_listeners = NULL;
 	}
 
+	if (priv->delayed_property_index != NULL) {
+		g_hash_table_destroy(priv->delayed_property_index);
+		priv->delayed_property_index = NULL;
+	}
+
 	if (priv->layoutcall != NULL) {
 		g_cancellable_cancel(priv->layoutcall);
 		g_object_unref(priv->layoutcall);
@@ -491,6 +787,27 @@ dbusmenu_client_dispose (GObject *object)
 		priv->layout_props = NULL;
 	}
 
+	if (priv->lazy_calls != NULL) {
+		GHashTableIter iter;
+		gpointer cancel;
+		g_hash_table_iter_init(&iter, priv->lazy_calls);
+		while (g_hash_table_iter_next(&iter, NULL, &cancel)) {
+			g_cancellable_cancel(G_CANCELLABLE(cancel));
+		}
+		g_hash_table_destroy(priv->lazy_calls);
+		priv->lazy_calls = NULL;
+	}
+
+	if (priv->lazy_items != NULL) {
+		g_hash_table_destroy(priv->lazy_items);
+		priv->lazy_items = NULL;
+	}
+
+	if (priv->property_filter != NULL) {
+		g_strfreev(priv->property_filter);
+		priv->property_filter = NULL;
+	}
+
 	/* Bring down the menu proxy, ensure we're not
 	   looking for one at the same time. */
 	if (priv->menuproxy_cancel != NULL) {
@@ -498,6 +815,10 @@ dbusmenu_client_dispose (GObject *object)
 		g_object_unref(priv->menuproxy_cancel);
 		priv->menuproxy_cancel = NULL;
 	}
+	if (priv->hub_registration != 0) {
+		_dbusmenu_client_hub_unregister(priv->hub_registration);
+		priv->hub_registration = 0;
+	}
 	if (priv->menuproxy != NULL) {
 		g_signal_handlers_disconnect_matched(priv->menuproxy,
 		                                     G_SIGNAL_MATCH_DATA,
@@ -511,6 +832,27 @@ dbusmenu_client_dispose (GObject *object)
 		priv->dbusproxy = 0;
 	}
 
+	/* And the same without the proxy */
+	if (priv->lean_cancel != NULL) {
+		g_cancellable_cancel(priv->lean_cancel);
+		g_object_unref(priv->lean_cancel);
+		priv->lean_cancel = NULL;
+	}
+	if (priv->lean_watch != 0) {
+		g_bus_unwatch_name(priv->lean_watch);
+		priv->lean_watch = 0;
+	}
+	if (priv->lean_signals != 0) {
+		g_dbus_connection_signal_unsubscribe(priv->session_bus, priv->lean_signals);
+		priv->lean_signals = 0;
+	}
+	if (priv->lean_properties != 0) {
+		g_dbus_connection_signal_unsubscribe(priv->session_bus, priv->lean_properties);
+		priv->lean_properties = 0;
+	}
+	g_free(priv->lean_owner);
+	priv->lean_owner = NULL;
+
 	/* Bring down the session bus, ensure we're not
 	   looking for one at the same time. */
 	if (priv->session_bus_cancel != NULL) {
@@ -523,11 +865,43 @@ dbusmenu_client_dispose (GObject *object)
 		priv->session_bus = NULL;
 	}
 
+	if (priv->cache_load_idle != 0) {
+		g_source_remove(priv->cache_load_idle);
+		priv->cache_load_idle = 0;
+	}
+
+	if (priv->layout_debounce_timeout != 0) {
+		g_source_remove(priv->layout_debounce_timeout);
+		priv->layout_debounce_timeout = 0;
+	}
+
+	if (priv->reconnect_timeout != 0) {
+		g_source_remove(priv->reconnect_timeout);
+		priv->reconnect_timeout = 0;
+	}
+
+	/* Don't lose the last changes if we were waiting to write them */
+	if (priv->cache_save_timeout != 0) {
+		g_source_remove(priv->cache_save_timeout);
+		priv->cache_save_timeout = 0;
+		layout_cache_save(DBUSMENU_CLIENT(object));
+	}
+
+	if (priv->item_index != NULL) {
+		g_hash_table_destroy(priv->item_index);
+		priv->item_index = NULL;
+	}
+
 	if (priv->root != NULL) {
 		g_object_unref(G_OBJECT(priv->root));
 		priv->root = NULL;
 	}
 
+	if (priv->flat != NULL) {
+		flat_free(priv->flat);
+		priv->flat = NULL;
+	}
+
 	G_OBJECT_CLASS (dbusmenu_client_parent_class)->dispose (object);
 	return;
 }
@@ -578,6 +952,45 @@ set_property (GObject * obj, guint id, const GValue * value, GParamSpec * pspec)
 	case PROP_GROUP_EVENTS:
 		priv->group_events = g_value_get_boolean(value);
 		break;
+	case PROP_LAZY_LAYOUT:
+		priv->lazy_layout = g_value_get_boolean(value);
+		break;
+	case PROP_CACHE_LAYOUT:
+		priv->cache_layout = g_value_get_boolean(value);
+		/* Wait until we're built and someone can hear about it */
+		if (priv->cache_layout && priv->cache_load_idle == 0) {
+			priv->cache_load_idle = g_idle_add(layout_cache_load_idle, obj);
+		}
+		break;
+	case PROP_LAYOUT_DEBOUNCE:
+		priv->layout_debounce = g_value_get_uint(value);
+		break;
+	case PROP_LAYOUT_MAX_STALENESS:
+		priv->layout_max_staleness = g_value_get_uint(value);
+		break;
+	case PROP_SHARED_CONNECTION:
+		priv->shared_connection = g_value_get_boolean(value);
+		break;
+	case PROP_LEAN_TRANSPORT:
+		priv->lean_transport = g_value_get_boolean(value);
+		break;
+	case PROP_RECONNECT_GRACE:
+		priv->reconnect_grace = g_value_get_uint(value);
+		break;
+	case PROP_FLAT_LAYOUT:
+		if (g_value_get_boolean(value) && priv->flat == NULL) {
+			priv->flat = g_new0(flat_mirror_t, 1);
+			priv->flat->ids = g_array_new(FALSE, FALSE, sizeof(gint));
+			priv->flat->parents = g_array_new(FALSE, FALSE, sizeof(gint));
+			priv->flat->child_start = g_array_new(FALSE, FALSE, sizeof(guint));
+			priv->flat->child_count = g_array_new(FALSE, FALSE, sizeof(guint));
+			priv->flat->prop_start = g_array_new(FALSE, FALSE, sizeof(guint));
+			priv->flat->prop_count = g_array_new(FALSE, FALSE, sizeof(guint));
+			priv->flat->prop_names = g_array_new(FALSE, FALSE, sizeof(GQuark));
+			priv->flat->prop_values = g_ptr_array_new();
+			priv->flat->id_index = g_hash_table_new(g_direct_hash, g_direct_equal);
+		}
+		break;
 	default:
 		g_warning("Unknown property %d.", id);
 		return;
@@ -607,6 +1020,33 @@ get_property (GObject * obj, guint id, GValue * value, GParamSpec * pspec)
 	case PROP_GROUP_EVENTS:
 		g_value_set_boolean(value, priv->group_events);
 		break;
+	case PROP_LAZY_LAYOUT:
+		g_value_set_boolean(value, priv->lazy_layout);
+		break;
+	case PROP_CACHE_LAYOUT:
+		g_value_set_boolean(value, priv->cache_layout);
+		break;
+	case PROP_LAYOUT_DEBOUNCE:
+		g_value_set_uint(value, priv->layout_debounce);
+		break;
+	case PROP_LAYOUT_MAX_STALENESS:
+		g_value_set_uint(value, priv->layout_max_staleness);
+		break;
+	case PROP_LAYOUT_FETCHES_SAVED:
+		g_value_set_uint(value, priv->layout_fetches_saved);
+		break;
+	case PROP_SHARED_CONNECTION:
+		g_value_set_boolean(value, priv->shared_connection);
+		break;
+	case PROP_LEAN_TRANSPORT:
+		g_value_set_boolean(value, priv->lean_transport);
+		break;
+	case PROP_RECONNECT_GRACE:
+		g_value_set_uint(value, priv->reconnect_grace);
+		break;
+	case PROP_FLAT_LAYOUT:
+		g_value_set_boolean(value, priv->flat != NULL);
+		break;
 	default:
 		g_warning("Unknown property %d.", id);
 		return;
@@ -627,21 +1067,46 @@ error_domain (void)
 	return error;
 }
 
-/* Quick little function to search through the listeners and find
-   one that matches an ID */
+/* Quick little function to find the listener that matches an ID
+   using the index of where they are in the array */
 static properties_listener_t *
-find_listener (GArray * listeners, guint index, gint id)
+find_listener (GArray * listeners, GHashTable * index, gint id)
 {
-	if (index >= listeners->len) {
+	guint position = GPOINTER_TO_UINT(g_hash_table_lookup(index, GINT_TO_POINTER(id)));
+	if (position == 0 || position > listeners->len) {
 		return NULL;
 	}
 
-	properties_listener_t * retval = &g_array_index(listeners, properties_listener_t, index);
-	if (retval->id == id) {
-		return retval;
+	return &g_array_index(listeners, properties_listener_t, position - 1);
+}
+
+/* Look at how the last properties request went and figure out
+   how many to put in the next one.  Fast, small replies mean we
+   can ask for more at once, slow or big ones mean we should ask
+   for less. */
+static void
+properties_adapt_queue (DbusmenuClientPrivate * priv, guint requested, gsize size, gint64 elapsed)
+{
+	guint max = priv->delayed_property_max;
+
+	if (elapsed > PROPERTIES_REPLY_TIME || size > PROPERTIES_REPLY_SIZE) {
+		max = max / 2;
+	} else if (requested >= max) {
+		/* Only grow if we filled up the last one, otherwise
+		   it doesn't tell us much */
+		max = max * 2;
 	}
 
-	return find_listener(listeners, index + 1, id);
+	/* Don't let the reply get bigger than we'd like based
+	   on how big each item was in this one */
+	if (requested > 0 && size > 0) {
+		gsize peritem = MAX(size / requested, 1);
+		max = MIN(max, PROPERTIES_REPLY_SIZE / peritem);
+	}
+
+	priv->delayed_property_max = CLAMP(max, MIN_PROPERTIES_TO_QUEUE, MAX_PROPERTIES_TO_QUEUE);
+
+	return;
 }
 
 /* Call back from getting the group properties, now we need
@@ -655,7 +1120,11 @@ get_properties_callback (GObject *obj, GAsyncResult * res, gpointer user_data)
 	GError * error = NULL;
 	GVariant * params = NULL;
 
-	params = g_dbus_proxy_call_finish(G_DBUS_PROXY(obj), res, &error);
+	params = client_call_finish(obj, res, &error);
+
+	if (error == NULL) {
+		properties_adapt_queue(DBUSMENU_CLIENT_GET_PRIVATE(cbdata->client), listeners->len, g_variant_get_size(params), g_get_monotonic_time() - cbdata->sent);
+	}
 
 	if (error != NULL) {
 		/* If we get an error, all our callbacks need to hear about it. */
@@ -686,7 +1155,7 @@ get_properties_callback (GObject *obj, GAsyncResult * res, gpointer user_data)
 
 			GVariant * properties = g_variant_get_child_value(child, 1);
 
-			properties_listener_t * listener = find_listener(listeners, 0, id);
+			properties_listener_t * listener = find_listener(listeners, cbdata->index, id);
 			if (listener == NULL) {
 				g_warning("Unable to find listener for ID %d", id);
 				g_variant_unref(properties);
@@ -727,6 +1196,7 @@ get_properties_callback (GObject *obj, GAsyncResult * res, gpointer user_data)
 
 	/* Clean up */
 	g_array_free(listeners, TRUE);
+	g_hash_table_destroy(cbdata->index);
 	g_object_unref(cbdata->client);
 	g_free(user_data);
 
@@ -740,7 +1210,7 @@ get_properties_idle (gpointer user_data)
 {
 	properties_callback_t * cbdata = NULL;
 	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(user_data);
-	g_return_val_if_fail(priv->menuproxy != NULL, TRUE);
+	g_return_val_if_fail(priv->menuproxy != NULL || priv->lean_owner != NULL, TRUE);
 
 	if (priv->delayed_property_listeners->len == 0) {
 		g_warning("Odd, idle func got no listeners.");
@@ -762,7 +1232,12 @@ get_properties_idle (gpointer user_data)
 	GVariantType * type = g_variant_type_new("as");
 	g_variant_builder_init(&builder, type);
 	g_variant_type_free(type);
-	/* TODO: need to use delayed property list here */
+	/* An empty list gets everything, otherwise only what we want */
+	if (priv->property_filter != NULL) {
+		for (i = 0; priv->property_filter[i] != NULL; i++) {
+			g_variant_builder_add(&builder, "s", priv->property_filter[i]);
+		}
+	}
 	GVariant * variant_props = g_variant_builder_end(&builder);
 
 	/* Combine them into a value for the parameter */
@@ -773,17 +1248,19 @@ get_properties_idle (gpointer user_data)
 
 	cbdata = g_new(properties_callback_t, 1);
 	cbdata->listeners = priv->delayed_property_listeners;
+	cbdata->index = priv->delayed_property_index;
 	cbdata->client = DBUSMENU_CLIENT(user_data);
+	cbdata->sent = g_get_monotonic_time();
 	g_object_ref(G_OBJECT(user_data));
 
-	g_dbus_proxy_call(priv->menuproxy,
-	                  "GetGroupProperties",
-	                  variant_params,
-	                  G_DBUS_CALL_FLAGS_NONE,
-	                  -1,   /* timeout */
-	                  NULL, /* cancellable */
-	                  get_properties_callback,
-	                  cbdata);
+	client_call(DBUSMENU_CLIENT(user_data),
+	            "GetGroupProperties",
+	            variant_params,
+	            G_DBUS_CALL_FLAGS_NONE,
+	            -1,   /* timeout */
+	            NULL, /* cancellable */
+	            get_properties_callback,
+	            cbdata);
 
 	/* Free properties */
 	gchar ** dataregion = (gchar **)g_array_free(priv->delayed_property_list, FALSE);
@@ -794,6 +1271,7 @@ get_properties_idle (gpointer user_data)
 
 	/* Rebuild the listeners */
 	priv->delayed_property_listeners = g_array_new(FALSE, FALSE, sizeof(properties_listener_t));
+	priv->delayed_property_index = g_hash_table_new(g_direct_hash, g_direct_equal);
 
 	/* Make sure we set for a new idle */
 	priv->delayed_idle = 0;
@@ -826,7 +1304,7 @@ static void
 get_properties_globber (DbusmenuClient * client, gint id, const gchar ** properties, properties_func callback, gpointer user_data)
 {
 	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
-	if (find_listener(priv->delayed_property_listeners, 0, id) != NULL) {
+	if (g_hash_table_contains(priv->delayed_property_index, GINT_TO_POINTER(id))) {
 		g_warning("Asking for properties from same ID twice: %d", id);
 		GError * localerror = NULL;
 		g_set_error_literal(&localerror, error_domain(), 0, "ID already queued");
@@ -859,6 +1337,7 @@ get_properties_globber (DbusmenuClient * client, gint id, const gchar ** propert
 	listener.replied = FALSE;
 
 	g_array_append_val(priv->delayed_property_listeners, listener);
+	g_hash_table_insert(priv->delayed_property_index, GINT_TO_POINTER(id), GUINT_TO_POINTER(priv->delayed_property_listeners->len));
 
 	if (priv->delayed_idle == 0) {
 		priv->delayed_idle = g_idle_add(get_properties_idle, client);
@@ -867,7 +1346,7 @@ get_properties_globber (DbusmenuClient * client, gint id, const gchar ** propert
 	/* Look at how many proprites we have queued up and
 	   make it so that we don't leave too many in one
 	   request. */
-	if (priv->delayed_property_listeners->len == MAX_PROPERTIES_TO_QUEUE) {
+	if (priv->delayed_property_listeners->len >= priv->delayed_property_max) {
 		get_properties_flush(client);
 	}
 
@@ -887,7 +1366,7 @@ item_activated (GDBusProxy * proxy, gint id, guint timestamp, DbusmenuClient * c
 		return;
 	}
 
-	DbusmenuMenuitem * menuitem = dbusmenu_menuitem_find_id(priv->root, id);
+	DbusmenuMenuitem * menuitem = item_index_lookup(priv, id);
 	if (menuitem == NULL) {
 		g_warning("Unable to find menu item %d to activate.", id);
 		return;
@@ -898,670 +1377,2178 @@ item_activated (GDBusProxy * proxy, gint id, guint timestamp, DbusmenuClient * c
 	return;
 }
 
-/* Annoying little wrapper to make the right function update */
-static void
-layout_update (GDBusProxy * proxy, guint revision, gint parent, DbusmenuClient * client)
+/* Checks to see if the property is one that we're asking
+   the server for */
+static gboolean
+property_wanted (DbusmenuClientPrivate * priv, const gchar * property)
 {
-	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
-	priv->current_revision = revision;
-	if (priv->current_revision > priv->my_revision) {
-		update_layout(client);
+	if (priv->property_filter == NULL) {
+		return TRUE;
 	}
-	return;
+
+	gint i;
+	for (i = 0; priv->property_filter[i] != NULL; i++) {
+		if (g_strcmp0(priv->property_filter[i], property) == 0) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
 }
 
-/* Signal from the server that a property has changed
-   on one of our menuitems */
-static void
-id_prop_update (GDBusProxy * proxy, gint id, gchar * property, GVariant * value, DbusmenuClient * client)
+/* Finds the item in our tree with @id without having to walk
+   the tree to get there */
+static DbusmenuMenuitem *
+item_index_lookup (DbusmenuClientPrivate * priv, gint id)
 {
-	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+	if (priv->root == NULL || priv->item_index == NULL) {
+		return NULL;
+	}
 
-	g_return_if_fail(priv->root != NULL);
+	return g_hash_table_lookup(priv->item_index, GINT_TO_POINTER(id));
+}
 
-	DbusmenuMenuitem * menuitem = dbusmenu_menuitem_find_id(priv->root, id);
-	if (menuitem == NULL) {
-		#ifdef MASSIVEDEBUGGING
-		g_debug("Property update '%s' on id %d which couldn't be found", property, id);
-		#endif
-		return;
-	}
+/* Drops an item from the index, as long as the index has that
+   item and not a newer one with the same ID */
+static void
+item_index_remove (DbusmenuMenuitem * item, gpointer user_data)
+{
+	DbusmenuClientPrivate * priv = (DbusmenuClientPrivate *)user_data;
+	gpointer id = GINT_TO_POINTER(dbusmenu_menuitem_get_id(item));
 
-	dbusmenu_menuitem_property_set_variant(menuitem, property, value);
+	if (g_hash_table_lookup(priv->item_index, id) == item) {
+		g_hash_table_remove(priv->item_index, id);
+	}
 
 	return;
 }
 
-/* Oh, lots of updates now.  That silly server, they want
-   to change all kinds of stuff! */
+/* Builds the list of properties that we ask for with the layout.
+   It's all of the ones that we want so that the layout has all
+   the information needed to realize the items. */
 static void
-id_update (GDBusProxy * proxy, gint id, DbusmenuClient * client)
+build_layout_props (DbusmenuClientPrivate * priv)
 {
-	#ifdef MASSIVEDEBUGGING
-	g_debug("Client side ID update: %d", id);
-	#endif 
-
-	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
-	g_return_if_fail(priv->root != NULL);
+	if (priv->layout_props != NULL) {
+		g_variant_unref(priv->layout_props);
+	}
 
-	DbusmenuMenuitem * menuitem = dbusmenu_menuitem_find_id(priv->root, id);
-	g_return_if_fail(menuitem != NULL);
+	/* An empty list gets all of them */
+	if (priv->property_filter != NULL) {
+		priv->layout_props = g_variant_new_strv((const gchar * const *)priv->property_filter, -1);
+	} else {
+		priv->layout_props = g_variant_new_strv(NULL, 0);
+	}
+	g_variant_ref_sink(priv->layout_props);
 
-	g_debug("Getting properties");
-	g_object_ref(menuitem);
-	get_properties_globber(client, id, NULL, menuitem_get_properties_cb, menuitem);
 	return;
 }
 
-/* Watches to see if our DBus savior comes onto the bus */
-static void
-dbus_owner_change (GDBusConnection * connection, const gchar * name, const gchar * owner, gpointer user_data)
+/* How many parents there are above @mi */
+static guint
+dirty_parent_depth (DbusmenuMenuitem * mi)
 {
-	g_return_if_fail(DBUSMENU_IS_CLIENT(user_data));
+	guint depth = 0;
 
-	DbusmenuClient * client = DBUSMENU_CLIENT(user_data);
+	for (mi = dbusmenu_menuitem_get_parent(mi); mi != NULL; mi = dbusmenu_menuitem_get_parent(mi)) {
+		depth++;
+	}
 
-	/* Woot!  A service for us to love and to hold for ever
-	   and ever and ever! */
-	return build_proxies(client);
+	return depth;
 }
 
-/* This function builds the DBus proxy which will look out for
-   the service coming up. */
-static void
-build_dbus_proxy (DbusmenuClient * client)
+/* Find the item that has both @a and @b under it so that
+   we can update both with one request.  Zero is the root. */
+static gint
+dirty_parent_merge (DbusmenuClientPrivate * priv, gint a, gint b)
 {
-	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
-
-	if (priv->dbusproxy != 0) {
-		return;
+	if (a == b) {
+		return a;
 	}
 
-	priv->dbusproxy = g_bus_watch_name_on_connection(priv->session_bus,
-	                                                 priv->dbus_name,
-	                                                 G_BUS_NAME_WATCHER_FLAGS_NONE,
-	                                                 dbus_owner_change,
-	                                                 NULL,
-	                                                 client,
-	                                                 NULL);
+	if (a == 0 || b == 0 || priv->root == NULL) {
+		return 0;
+	}
 
-	/* Now let's check to make sure we're not in some race
-	   condition case. */
-	/* TODO: Not sure how to check for names in GDBus */
+	DbusmenuMenuitem * ami = item_index_lookup(priv, a);
+	DbusmenuMenuitem * bmi = item_index_lookup(priv, b);
 
-	return;
-}
+	if (ami == NULL || bmi == NULL) {
+		return 0;
+	}
 
-/* A signal handler that gets called when a proxy is destoryed a
-   so it needs to clean up a little.  Make sure we don't think we
-   have a layout and setup the dbus watcher. */
-static void
-proxy_destroyed (GObject * gobj_proxy, gpointer userdata)
-{
-	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(userdata);
+	/* Bring them up to the same depth, then walk up together
+	   until they meet */
+	guint adepth = dirty_parent_depth(ami);
+	guint bdepth = dirty_parent_depth(bmi);
 
-	if (priv->root != NULL) {
-		g_object_unref(G_OBJECT(priv->root));
-		priv->root = NULL;
-		#ifdef MASSIVEDEBUGGING
-		g_debug("Proxies destroyed, signaling a root change and a layout update.");
-		#endif
-		g_signal_emit(G_OBJECT(userdata), signals[ROOT_CHANGED], 0, NULL, TRUE);
-		g_signal_emit(G_OBJECT(userdata), signals[LAYOUT_UPDATED], 0, TRUE);
+	for (; adepth > bdepth; adepth--) {
+		ami = dbusmenu_menuitem_get_parent(ami);
+	}
+	for (; bdepth > adepth; bdepth--) {
+		bmi = dbusmenu_menuitem_get_parent(bmi);
 	}
 
-	if ((gpointer)priv->menuproxy == (gpointer)gobj_proxy) {
-		if (priv->layoutcall != NULL) {
-			g_cancellable_cancel(priv->layoutcall);
-			g_object_unref(priv->layoutcall);
-			priv->layoutcall = NULL;
-		}
+	while (ami != bmi) {
+		ami = dbusmenu_menuitem_get_parent(ami);
+		bmi = dbusmenu_menuitem_get_parent(bmi);
 	}
 
-	priv->current_revision = 0;
-	priv->my_revision = 0;
+	if (ami == NULL || ami == priv->root) {
+		return 0;
+	}
 
-	build_dbus_proxy(DBUSMENU_CLIENT(userdata));
-	return;
+	return dbusmenu_menuitem_get_id(ami);
 }
 
-/* Respond to us getting the session bus (hopefully) or handle
-   the error if not */
+/* Annoying little wrapper to make the right function update */
 static void
-session_bus_cb (GObject * object, GAsyncResult * res, gpointer user_data)
+layout_update (GDBusProxy * proxy, guint revision, gint parent, DbusmenuClient * client)
 {
-	GError * error = NULL;
-
-	/* NOTE: We're not using any other variables before checking
-	   the result because they could be destroyed and thus invalid */
-	GDBusConnection * bus = g_bus_get_finish(res, &error);
-	if (error != NULL) {
-		g_warning("Unable to get session bus: %s", error->message);
-		g_error_free(error);
-		return;
-	}
-
-	/* If this wasn't cancelled, we should be good */
-	DbusmenuClient * client = DBUSMENU_CLIENT(user_data);
 	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
-	priv->session_bus = bus;
+	priv->current_revision = revision;
+	if (priv->current_revision > priv->my_revision) {
+		/* Keep track of the part of the tree that we need to
+		   get to cover all the updates */
+		if (priv->dirty_parent < 0) {
+			priv->dirty_parent = parent;
+		} else {
+			priv->dirty_parent = dirty_parent_merge(priv, priv->dirty_parent, parent);
+		}
 
-	if (priv->session_bus_cancel != NULL) {
-		g_object_unref(priv->session_bus_cancel);
-		priv->session_bus_cancel = NULL;
+		update_layout_debounced(client);
 	}
-
-	/* Retry to build the proxies now that we have a bus */
-	build_proxies(DBUSMENU_CLIENT(user_data));
-
 	return;
 }
 
-/* When we have a name and an object, build the two proxies and get the
-   first version of the layout */
-static void
-build_proxies (DbusmenuClient * client)
+/* Hash the type, the size and the start of the data of a value,
+   g_variant_hash() only works on the basic types and we get plenty
+   of arrays.  Icons can be several kB, so rather than going through
+   all of them here we leave it to intern_equal() to look at the
+   whole thing when the hashes match. */
+static guint
+intern_hash (gconstpointer key)
 {
-	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+	GVariant * value = (GVariant *)key;
+	guint hash = g_str_hash(g_variant_get_type_string(value));
+	const guchar * data = g_variant_get_data(value);
+	gsize size = g_variant_get_size(value);
+	gsize i;
 
-	g_return_if_fail(priv->dbus_object != NULL);
-	g_return_if_fail(priv->dbus_name != NULL);
+	hash = (hash << 5) + hash + (guint)size;
 
-	if (priv->session_bus == NULL) {
-		/* We don't have the session bus yet, that's okay, but
-		   we need to handle that. */
+	for (i = 0; i < MIN(size, INTERN_HASH_PREFIX); i++) {
+		hash = (hash << 5) + hash + data[i];
+	}
 
-		/* If we're already running we don't need to look again. */
-		if (priv->session_bus_cancel == NULL) {
-			priv->session_bus_cancel = g_cancellable_new();
+	return hash;
+}
 
-			/* Async get the session bus */
-			g_bus_get(G_BUS_TYPE_SESSION, priv->session_bus_cancel, session_bus_cb, client);
+static gboolean
+intern_equal (gconstpointer a, gconstpointer b)
+{
+	return g_variant_equal(a, b);
+}
+
+/* Find the shared copy of a value, or make it if this is the first
+   time we've seen it.  Values from the bus point into the message
+   they came in, so the shared copy gets its own data to let that go.
+   Returns a reference that the caller needs to unref. */
+static GVariant *
+intern_value (GVariant * value)
+{
+	if (value == NULL) {
+		return NULL;
+	}
+
+	G_LOCK(interned);
+
+	if (interned_values == NULL) {
+		interned_values = g_hash_table_new_full(intern_hash, intern_equal, (GDestroyNotify)g_variant_unref, NULL);
+	}
+
+	GVariant * shared = g_hash_table_lookup(interned_values, value);
+
+	if (shared != NULL) {
+		interned_hits++;
+		interned_bytes_saved += g_variant_get_size(value);
+	} else {
+		/* Nothing is lost by starting over, the items still have
+		   their values, they just won't be shared with new ones */
+		if (g_hash_table_size(interned_values) >= INTERN_MAX_VALUES) {
+			g_hash_table_remove_all(interned_values);
 		}
 
-		/* This function exists, it'll be called again when we get
-		   the session bus so this condition will be ignored */
-		return;
+		/* Some of these come from the layout cache file, so the
+		   copy isn't trusted to be in normal form */
+		gsize size = g_variant_get_size(value);
+		gpointer data = g_malloc(size);
+		if (size > 0) {
+			memcpy(data, g_variant_get_data(value), size);
+		}
+		shared = g_variant_ref_sink(g_variant_new_from_data(g_variant_get_type(value), data, size, FALSE, g_free, data));
+
+		g_hash_table_add(interned_values, shared);
 	}
 
-	/* Build us a menu proxy */
-	if (priv->menuproxy == NULL) {
+	g_variant_ref(shared);
 
-		/* Check to see if we're already building one */
-		if (priv->menuproxy_cancel == NULL) {
-			priv->menuproxy_cancel = g_cancellable_new();
+	G_UNLOCK(interned);
 
-			g_dbus_proxy_new(priv->session_bus,
-			                 G_DBUS_PROXY_FLAGS_DO_NOT_AUTO_START,
-			                 dbusmenu_interface_info,
-			                 priv->dbus_name,
-			                 priv->dbus_object,
-			                 DBUSMENU_INTERFACE,
-			                 priv->menuproxy_cancel,
-			                 menuproxy_build_cb,
-			                 client);
+	return shared;
+}
+
+/* Set a property on one of our items with the shared copy of
+   the value */
+static void
+property_set_interned (DbusmenuMenuitem * item, const gchar * property, GVariant * value)
+{
+	GVariant * shared = intern_value(value);
+
+	dbusmenu_menuitem_property_set_variant(item, property, shared);
+
+	if (shared != NULL) {
+		g_variant_unref(shared);
+	}
+
+	return;
+}
+
+/* Empty out the flat layout, keeping the arrays to fill again */
+static void
+flat_clear (flat_mirror_t * flat)
+{
+	guint i;
+	for (i = 0; i < flat->prop_values->len; i++) {
+		GVariant * value = g_ptr_array_index(flat->prop_values, i);
+		if (value != NULL) {
+			g_variant_unref(value);
 		}
 	}
 
+	g_array_set_size(flat->ids, 0);
+	g_array_set_size(flat->parents, 0);
+	g_array_set_size(flat->child_start, 0);
+	g_array_set_size(flat->child_count, 0);
+	g_array_set_size(flat->prop_start, 0);
+	g_array_set_size(flat->prop_count, 0);
+	g_array_set_size(flat->prop_names, 0);
+	g_ptr_array_set_size(flat->prop_values, 0);
+	g_hash_table_remove_all(flat->id_index);
+
 	return;
 }
 
-/* Callback when we know if the menu proxy can be created or
-   not and do something with it! */
 static void
-menuproxy_build_cb (GObject * object, GAsyncResult * res, gpointer user_data)
+flat_free (flat_mirror_t * flat)
 {
-	GError * error = NULL;
+	flat_clear(flat);
+
+	g_array_free(flat->ids, TRUE);
+	g_array_free(flat->parents, TRUE);
+	g_array_free(flat->child_start, TRUE);
+	g_array_free(flat->child_count, TRUE);
+	g_array_free(flat->prop_start, TRUE);
+	g_array_free(flat->prop_count, TRUE);
+	g_array_free(flat->prop_names, TRUE);
+	g_ptr_array_free(flat->prop_values, TRUE);
+	g_hash_table_destroy(flat->id_index);
+	g_free(flat);
 
-	/* NOTE: We're not using any other variables before checking
-	   the result because they could be destroyed and thus invalid */
-	GDBusProxy * proxy = g_dbus_proxy_new_finish(res, &error);
-	if (error != NULL) {
-		g_warning("Unable to get menu proxy: %s", error->message);
-		g_error_free(error);
-		return;
-	}
+	return;
+}
 
-	/* If this wasn't cancelled, we should be good */
-	DbusmenuClient * client = DBUSMENU_CLIENT(user_data);
-	/* But let's check */
-	g_return_if_fail(client != NULL);
-	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
-	g_return_if_fail(priv != NULL);
+/* Replace the flat layout with a new one from the server.  Walks
+   the layout breadth first, each item's children are given the
+   next free indexes when we get to it so they end up together. */
+static gboolean
+flat_rebuild (flat_mirror_t * flat, GVariant * layout)
+{
+	g_return_val_if_fail(g_variant_is_of_type(layout, G_VARIANT_TYPE("(ia{sv}av)")), FALSE);
 
+	flat_clear(flat);
 
-	priv->menuproxy = proxy;
+	GQueue queue = G_QUEUE_INIT;
+	g_queue_push_tail(&queue, g_variant_ref(layout));
 
-	if (priv->menuproxy_cancel != NULL) {
-		g_object_unref(priv->menuproxy_cancel);
-		priv->menuproxy_cancel = NULL;
-	}
+	gint parent = -1;
+	g_array_append_val(flat->parents, parent);
 
-	/* Check the text direction if available */
-	GVariant * textdir = g_dbus_proxy_get_cached_property(priv->menuproxy, "TextDirection");
-	if (textdir != NULL) {
-		if (g_variant_is_of_type(textdir, G_VARIANT_TYPE_VARIANT)) {
-			GVariant * tmp =  g_variant_get_variant(textdir);
-			g_variant_unref(textdir);
-			textdir = tmp;
-		}
+	GVariant * node;
+	for (parent = 0; (node = g_queue_pop_head(&queue)) != NULL; parent++) {
+		gint id;
+		GVariant * props = NULL;
+		GVariant * children = NULL;
+		g_variant_get(node, "(i@a{sv}@av)", &id, &props, &children);
 
-		priv->text_direction = dbusmenu_text_direction_get_value_from_nick(g_variant_get_string(textdir, NULL));
-		g_object_notify(G_OBJECT(user_data), DBUSMENU_CLIENT_PROP_TEXT_DIRECTION);
+		g_array_append_val(flat->ids, id);
+		g_hash_table_insert(flat->id_index, GINT_TO_POINTER(id), GINT_TO_POINTER(parent + 1));
 
-		g_variant_unref(textdir);
-		textdir = NULL;
-	}
+		/* Properties */
+		guint start = flat->prop_names->len;
+		g_array_append_val(flat->prop_start, start);
 
-	/* Check the status if available */
-	GVariant * status = g_dbus_proxy_get_cached_property(priv->menuproxy, "Status");
-	if (status != NULL) {
-		if (g_variant_is_of_type(status, G_VARIANT_TYPE_VARIANT)) {
-			GVariant * tmp = g_variant_get_variant(status);
-			g_variant_unref(status);
-			status = tmp;
+		GVariantIter iter;
+		gchar * name;
+		GVariant * value;
+		g_variant_iter_init(&iter, props);
+		while (g_variant_iter_loop(&iter, "{sv}", &name, &value)) {
+			GQuark quark = g_quark_from_string(name);
+			g_array_append_val(flat->prop_names, quark);
+			g_ptr_array_add(flat->prop_values, intern_value(value));
 		}
 
-		priv->status = dbusmenu_status_get_value_from_nick(g_variant_get_string(status, NULL));
-		g_object_notify(G_OBJECT(user_data), DBUSMENU_CLIENT_PROP_STATUS);
+		guint count = flat->prop_names->len - start;
+		g_array_append_val(flat->prop_count, count);
 
-		g_variant_unref(status);
-		status = NULL;
-	}
+		/* Children, they get their indexes now */
+		start = flat->parents->len;
+		g_array_append_val(flat->child_start, start);
 
-	/* Get the icon theme directories if available */
-	GVariant * icon_dirs = g_dbus_proxy_get_cached_property(priv->menuproxy, "IconThemePath");
-	if (icon_dirs != NULL) {
-		if (priv->icon_dirs != NULL) {
-			g_strfreev(priv->icon_dirs);
-			priv->icon_dirs = NULL;
+		GVariant * child;
+		g_variant_iter_init(&iter, children);
+		while ((child = g_variant_iter_next_value(&iter)) != NULL) {
+			GVariant * childlayout = g_variant_get_variant(child);
+			g_variant_unref(child);
+
+			if (!g_variant_is_of_type(childlayout, G_VARIANT_TYPE("(ia{sv}av)"))) {
+				g_warning("Child layout is of type '%s' instead of '%s'", g_variant_get_type_string(childlayout), "(ia{sv}av)");
+				g_variant_unref(childlayout);
+				continue;
+			}
+
+			g_array_append_val(flat->parents, parent);
+			g_queue_push_tail(&queue, childlayout);
 		}
 
-		priv->icon_dirs = g_variant_dup_strv(icon_dirs, NULL);
-		g_signal_emit(G_OBJECT(client), signals[ICON_THEME_DIRS], 0, priv->icon_dirs, TRUE);
+		count = flat->parents->len - start;
+		g_array_append_val(flat->child_count, count);
 
-		g_variant_unref(icon_dirs);
-		icon_dirs = NULL;
+		g_variant_unref(props);
+		g_variant_unref(children);
+		g_variant_unref(node);
 	}
 
-	/* Get the dbusmenu protocol version if available */
-	GVariant * version = g_dbus_proxy_get_cached_property(priv->menuproxy, "Version");
-	if (version != NULL) {
-		guint32 remote_version = 0;
+	return TRUE;
+}
+
+/* Change, add or remove (@value is NULL) a property on the item
+   with @id in the flat layout */
+static void
+flat_property_set (flat_mirror_t * flat, gint id, const gchar * property, GVariant * value)
+{
+	gint index = GPOINTER_TO_INT(g_hash_table_lookup(flat->id_index, GINT_TO_POINTER(id))) - 1;
+	if (index < 0) {
+		return;
+	}
+
+	GQuark quark = g_quark_from_string(property);
+	guint start = g_array_index(flat->prop_start, guint, index);
+	guint count = g_array_index(flat->prop_count, guint, index);
+	guint i;
 
-		if (g_variant_is_of_type(version, G_VARIANT_TYPE_UINT32)) {
-			remote_version = g_variant_get_uint32(version);
+	for (i = start; i < start + count; i++) {
+		if (g_array_index(flat->prop_names, GQuark, i) != quark) {
+			continue;
 		}
 
-		gboolean old_group = priv->group_events;
-		/* Figure out if we can group the events or not */
-		if (remote_version >= 3) {
-			priv->group_events = TRUE;
+		GVariant * oldvalue = g_ptr_array_index(flat->prop_values, i);
+
+		if (value != NULL) {
+			g_ptr_array_index(flat->prop_values, i) = intern_value(value);
 		} else {
-			priv->group_events = FALSE;
+			/* The last one in the run fills the hole */
+			guint last = start + count - 1;
+			g_array_index(flat->prop_names, GQuark, i) = g_array_index(flat->prop_names, GQuark, last);
+			g_ptr_array_index(flat->prop_values, i) = g_ptr_array_index(flat->prop_values, last);
+			g_ptr_array_index(flat->prop_values, last) = NULL;
+			g_array_index(flat->prop_count, guint, index) = count - 1;
 		}
 
-		/* Notify listeners if we changed the value */
-		if (old_group != priv->group_events) {
-			g_object_notify(G_OBJECT(client), DBUSMENU_CLIENT_PROP_GROUP_EVENTS);
+		g_variant_unref(oldvalue);
+		return;
+	}
+
+	if (value == NULL) {
+		return;
+	}
+
+	/* A new one, if there's something after our run we move it to
+	   the end so that there's room.  The old spot is wasted until
+	   the next layout. */
+	if (start + count != flat->prop_names->len) {
+		guint newstart = flat->prop_names->len;
+
+		for (i = start; i < start + count; i++) {
+			GQuark name = g_array_index(flat->prop_names, GQuark, i);
+			g_array_append_val(flat->prop_names, name);
+			g_ptr_array_add(flat->prop_values, g_ptr_array_index(flat->prop_values, i));
+			g_ptr_array_index(flat->prop_values, i) = NULL;
 		}
 
-		g_variant_unref(version);
-		version = NULL;
+		g_array_index(flat->prop_start, guint, index) = newstart;
 	}
 
-	/* If we get here, we don't need the DBus proxy */
-	if (priv->dbusproxy != 0) {
-		g_bus_unwatch_name(priv->dbusproxy);
-		priv->dbusproxy = 0;
+	g_array_append_val(flat->prop_names, quark);
+	g_ptr_array_add(flat->prop_values, intern_value(value));
+	g_array_index(flat->prop_count, guint, index) = count + 1;
+
+	return;
+}
+
+/* Turn the item at @index and everything under it back into a
+   layout like the server would send */
+static GVariant *
+flat_build_layout (flat_mirror_t * flat, guint index)
+{
+	GVariantBuilder props;
+	g_variant_builder_init(&props, G_VARIANT_TYPE("a{sv}"));
+
+	guint start = g_array_index(flat->prop_start, guint, index);
+	guint count = g_array_index(flat->prop_count, guint, index);
+	guint i;
+	for (i = start; i < start + count; i++) {
+		g_variant_builder_add(&props, "{sv}",
+		                      g_quark_to_string(g_array_index(flat->prop_names, GQuark, i)),
+		                      g_ptr_array_index(flat->prop_values, i));
 	}
 
-	g_signal_connect(priv->menuproxy, "g-signal",             G_CALLBACK(menuproxy_signal_cb),       client);
-	g_signal_connect(priv->menuproxy, "notify::g-name-owner", G_CALLBACK(menuproxy_name_changed_cb), client);
-	g_signal_connect(priv->menuproxy, "g-properties-changed", G_CALLBACK(menuproxy_prop_changed_cb), client);
+	GVariantBuilder children;
+	g_variant_builder_init(&children, G_VARIANT_TYPE("av"));
 
-	gchar * name_owner = g_dbus_proxy_get_name_owner(priv->menuproxy);
-	if (name_owner != NULL) {
-		update_layout(client);
-		g_free(name_owner);
+	start = g_array_index(flat->child_start, guint, index);
+	count = g_array_index(flat->child_count, guint, index);
+	for (i = start; i < start + count; i++) {
+		g_variant_builder_add(&children, "v", flat_build_layout(flat, i));
 	}
 
-	return;
+	return g_variant_new("(i@a{sv}@av)",
+	                     g_array_index(flat->ids, gint, index),
+	                     g_variant_builder_end(&props),
+	                     g_variant_builder_end(&children));
 }
 
-/* Handle the properites changing */
-static void
-menuproxy_prop_changed_cb (GDBusProxy * proxy, GVariant * properties, GStrv invalidated, gpointer user_data)
+/* Builds the layout for @id with the changes from a delta spliced
+   in.  Parents in @children get that list of children, and items
+   in @layouts are new and come just as the server sent them.
+   @visited has the items that are already in the layout, as the
+   delta could have an item under two parents, or under itself.
+   Returns a full reference, or NULL if the delta doesn't make
+   a tree out of the items that we have. */
+static GVariant *
+flat_delta_layout (flat_mirror_t * flat, GHashTable * children, GHashTable * layouts, GHashTable * visited, gint id)
 {
-	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(user_data);
-	DbusmenuTextDirection olddir = priv->text_direction;
-	DbusmenuStatus oldstatus = priv->status;
-	gboolean dirs_changed = FALSE;
+	if (g_hash_table_contains(visited, GINT_TO_POINTER(id))) {
+		g_warning("Layout delta has item %d in more than one place", id);
+		return NULL;
+	}
+	g_hash_table_add(visited, GINT_TO_POINTER(id));
 
-	/* Invalidate first */
-	gchar * invalid;
-	gint i = 0;
-	for (invalid = invalidated[i]; invalid != NULL; invalid = invalidated[++i]) {
-		if (g_strcmp0(invalid, "TextDirection") == 0) {
-			priv->text_direction = DBUSMENU_TEXT_DIRECTION_NONE;
-		}
-		if (g_strcmp0(invalid, "Status") == 0) {
-			priv->status = DBUSMENU_STATUS_NORMAL;
-		}
-		if (g_strcmp0(invalid, "IconThemePath") == 0) {
-			if (priv->icon_dirs != NULL) {
-				dirs_changed = TRUE;
-				g_strfreev(priv->icon_dirs);
-				priv->icon_dirs = NULL;
-			}
+	GVariant * layout = g_hash_table_lookup(layouts, GINT_TO_POINTER(id));
+	if (layout != NULL) {
+		return g_variant_ref(layout);
+	}
+
+	gint index = GPOINTER_TO_INT(g_hash_table_lookup(flat->id_index, GINT_TO_POINTER(id))) - 1;
+	if (index < 0) {
+		g_warning("Layout delta needs item %d that we don't have", id);
+		return NULL;
+	}
+
+	GVariantBuilder props;
+	g_variant_builder_init(&props, G_VARIANT_TYPE("a{sv}"));
+
+	guint start = g_array_index(flat->prop_start, guint, index);
+	guint count = g_array_index(flat->prop_count, guint, index);
+	guint i;
+	for (i = start; i < start + count; i++) {
+		g_variant_builder_add(&props, "{sv}",
+		                      g_quark_to_string(g_array_index(flat->prop_names, GQuark, i)),
+		                      g_ptr_array_index(flat->prop_values, i));
+	}
+
+	GVariantBuilder childrenbuilder;
+	g_variant_builder_init(&childrenbuilder, G_VARIANT_TYPE("av"));
+
+	/* The new list of children if the delta has one, otherwise
+	   the ones that we had */
+	GArray * childids = g_hash_table_lookup(children, GINT_TO_POINTER(id));
+	start = g_array_index(flat->child_start, guint, index);
+	count = (childids != NULL) ? childids->len : g_array_index(flat->child_count, guint, index);
+
+	for (i = 0; i < count; i++) {
+		gint childid = (childids != NULL) ? g_array_index(childids, gint, i) : g_array_index(flat->ids, gint, start + i);
+		GVariant * child = flat_delta_layout(flat, children, layouts, visited, childid);
+
+		if (child == NULL) {
+			g_variant_builder_clear(&props);
+			g_variant_builder_clear(&childrenbuilder);
+			return NULL;
 		}
+
+		g_variant_builder_add_value(&childrenbuilder, g_variant_new_variant(child));
+		g_variant_unref(child);
 	}
 
-	/* Check updates */
-	GVariantIter iters;
-	gchar * key; GVariant * value;
-	g_variant_iter_init(&iters, properties);
-	while (g_variant_iter_loop(&iters, "{sv}", &key, &value)) {
-		if (g_strcmp0(key, "TextDirection") == 0) {
-			if (g_variant_is_of_type(value, G_VARIANT_TYPE_VARIANT)) {
-				GVariant * tmp = g_variant_get_variant(value);
-				g_variant_unref(value);
-				value = tmp;
-			}
+	return g_variant_ref_sink(g_variant_new("(i@a{sv}@av)",
+	                                        id,
+	                                        g_variant_builder_end(&props),
+	                                        g_variant_builder_end(&childrenbuilder)));
+}
 
-			priv->text_direction = dbusmenu_text_direction_get_value_from_nick(g_variant_get_string(value, NULL));
+/* Take the changed parents from GetLayoutDelta and bring the flat
+   layout up to date.  The arrays are rebuilt, but only the new
+   items have to come over the bus.  Returns FALSE, with the flat
+   layout emptied, if the delta doesn't fit with what we have. */
+static gboolean
+flat_apply_delta (flat_mirror_t * flat, GVariant * updates)
+{
+	if (flat->ids->len == 0) {
+		return FALSE;
+	}
+
+	GHashTable * children = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)g_array_unref);
+	GHashTable * layouts = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)g_variant_unref);
+	gboolean synced = TRUE;
+
+	GVariantIter iter;
+	gint parentid;
+	GVariant * ids;
+	GVariant * newlayouts;
+
+	g_variant_iter_init(&iter, updates);
+	while (synced && g_variant_iter_next(&iter, "(i@ai@av)", &parentid, &ids, &newlayouts)) {
+		/* Same as with the menuitems, if we don't have the parent
+		   it's gone or inside something that's new */
+		if (parentid == 0) {
+			parentid = g_array_index(flat->ids, gint, 0);
 		}
-		if (g_strcmp0(key, "Status") == 0) {
-			if (g_variant_is_of_type(value, G_VARIANT_TYPE_VARIANT)) {
-				GVariant * tmp = g_variant_get_variant(value);
-				g_variant_unref(value);
-				value = tmp;
-			}
 
-			priv->status = dbusmenu_status_get_value_from_nick(g_variant_get_string(value, NULL));
+		if (g_hash_table_lookup(flat->id_index, GINT_TO_POINTER(parentid)) == NULL ||
+				g_hash_table_contains(layouts, GINT_TO_POINTER(parentid))) {
+			g_variant_unref(ids);
+			g_variant_unref(newlayouts);
+			continue;
 		}
-		if (g_strcmp0(key, "IconThemePath") == 0) {
-			if (priv->icon_dirs != NULL) {
-				g_strfreev(priv->icon_dirs);
-				priv->icon_dirs = NULL;
+
+		GVariantIter childiter;
+		GVariant * childv;
+		g_variant_iter_init(&childiter, newlayouts);
+		while ((childv = g_variant_iter_next_value(&childiter)) != NULL) {
+			GVariant * layout = g_variant_get_variant(childv);
+			g_variant_unref(childv);
+
+			if (!g_variant_is_of_type(layout, G_VARIANT_TYPE("(ia{sv}av)"))) {
+				g_warning("Child layout is of type '%s' instead of '%s'", g_variant_get_type_string(layout), "(ia{sv}av)");
+				g_variant_unref(layout);
+				synced = FALSE;
+				break;
 			}
 
-			priv->icon_dirs = g_variant_dup_strv(value, NULL);
-			dirs_changed = TRUE;
+			GVariant * idv = g_variant_get_child_value(layout, 0);
+			g_hash_table_insert(layouts, GINT_TO_POINTER(g_variant_get_int32(idv)), layout);
+			g_variant_unref(idv);
 		}
-		if (g_strcmp0(key, "Version") == 0) {
-			guint32 remote_version = 0;
 
-			if (g_variant_is_of_type(value, G_VARIANT_TYPE_UINT32)) {
-				remote_version = g_variant_get_uint32(value);
-			}
+		GArray * childids = g_array_new(FALSE, FALSE, sizeof(gint));
+		gint childid;
 
-			if (remote_version >= 3) {
-				priv->group_events = TRUE;
-			} else {
-				priv->group_events = FALSE;
+		g_variant_iter_init(&childiter, ids);
+		while (synced && g_variant_iter_next(&childiter, "i", &childid)) {
+			if (g_hash_table_lookup(flat->id_index, GINT_TO_POINTER(childid)) == NULL &&
+					!g_hash_table_contains(layouts, GINT_TO_POINTER(childid))) {
+				g_warning("Layout delta has item %d that we don't know about", childid);
+				synced = FALSE;
+				break;
 			}
+
+			g_array_append_val(childids, childid);
 		}
+
+		g_hash_table_insert(children, GINT_TO_POINTER(parentid), childids);
+
+		g_variant_unref(ids);
+		g_variant_unref(newlayouts);
 	}
 
-	if (olddir != priv->text_direction) {
-		g_object_notify(G_OBJECT(user_data), DBUSMENU_CLIENT_PROP_TEXT_DIRECTION);
+	if (synced) {
+		GHashTable * visited = g_hash_table_new(g_direct_hash, g_direct_equal);
+		GVariant * layout = flat_delta_layout(flat, children, layouts, visited, g_array_index(flat->ids, gint, 0));
+		g_hash_table_destroy(visited);
+
+		if (layout != NULL) {
+			synced = flat_rebuild(flat, layout);
+			g_variant_unref(layout);
+		} else {
+			synced = FALSE;
+		}
 	}
 
-	if (oldstatus != priv->status) {
-		g_object_notify(G_OBJECT(user_data), DBUSMENU_CLIENT_PROP_STATUS);
+	g_hash_table_destroy(children);
+	g_hash_table_destroy(layouts);
+
+	/* We can't trust what we have anymore, it all comes
+	   again with the full layout */
+	if (!synced) {
+		flat_clear(flat);
 	}
 
-	if (dirs_changed) {
-		g_signal_emit(G_OBJECT(user_data), signals[ICON_THEME_DIRS], 0, priv->icon_dirs, TRUE);
+	return synced;
+}
+
+/* Signal from the server that a property has changed
+   on one of our menuitems.  Returns the menuitem if the
+   value on it actually changed. */
+static DbusmenuMenuitem *
+id_prop_update (GDBusProxy * proxy, gint id, gchar * property, GVariant * value, DbusmenuClient * client)
+{
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+
+	g_return_val_if_fail(priv->root != NULL, NULL);
+
+	/* The server tells everyone about everything, we only
+	   care about the ones we asked for. */
+	if (!property_wanted(priv, property)) {
+		return NULL;
 	}
 
-	return;
+	DbusmenuMenuitem * menuitem = item_index_lookup(priv, id);
+	if (menuitem == NULL) {
+		#ifdef MASSIVEDEBUGGING
+		g_debug("Property update '%s' on id %d which couldn't be found", property, id);
+		#endif
+		return NULL;
+	}
+
+	GVariant * oldvalue = dbusmenu_menuitem_property_get_variant(menuitem, property);
+	gboolean changed = oldvalue == NULL || value == NULL || !g_variant_equal(oldvalue, value);
+
+	property_set_interned(menuitem, property, value);
+
+	return changed ? menuitem : NULL;
 }
 
-/* Handle the case where we change owners */
+/* Adds @property to the list of keys that changed on @item
+   in this batch of updates */
 static void
-menuproxy_name_changed_cb (GObject * object, GParamSpec * pspec, gpointer user_data)
+properties_batch_add (GHashTable * batch, DbusmenuMenuitem * item, const gchar * property)
 {
-	GDBusProxy * proxy = G_DBUS_PROXY(object);
+	gchar ** keys = g_hash_table_lookup(batch, item);
+	guint len = 0;
 
-	gchar * owner = g_dbus_proxy_get_name_owner(proxy);
+	if (keys != NULL) {
+		len = g_strv_length(keys);
 
-	if (owner == NULL) {
-		/* Oh, no!  We lost our owner! */
-		proxy_destroyed(G_OBJECT(proxy), user_data);
+		guint i;
+		for (i = 0; i < len; i++) {
+			if (g_strcmp0(keys[i], property) == 0) {
+				return;
+			}
+		}
+
+		/* Keep our reference on the item while we grow the list */
+		g_hash_table_steal(batch, item);
 	} else {
-		g_free(owner);
-		update_layout(DBUSMENU_CLIENT(user_data));
+		g_object_ref(item);
 	}
 
+	keys = g_renew(gchar *, keys, len + 2);
+	keys[len] = g_strdup(property);
+	keys[len + 1] = NULL;
+
+	g_hash_table_insert(batch, item, keys);
+
 	return;
 }
 
-/* Handle the signals out of the proxy */
+/* Oh, lots of updates now.  That silly server, they want
+   to change all kinds of stuff! */
 static void
-menuproxy_signal_cb (GDBusProxy * proxy, gchar * sender, gchar * signal, GVariant * params, gpointer user_data)
+id_update (GDBusProxy * proxy, gint id, DbusmenuClient * client)
 {
-	g_return_if_fail(DBUSMENU_IS_CLIENT(user_data));
-	DbusmenuClient * client = DBUSMENU_CLIENT(user_data);
-	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
-
-	if (g_strcmp0(signal, "LayoutUpdated") == 0) {
-		guint revision; gint parent;
-		g_variant_get(params, "(ui)", &revision, &parent);
-		layout_update(proxy, revision, parent, client);
-	} else if (priv->root == NULL) {
-		/* Drop out here, all the rest of these really need to have a root
-		   node so we can just ignore them if there isn't one. */
-	} else if (g_strcmp0(signal, "ItemsPropertiesUpdated") == 0) {
-		/* Remove before adding just incase there is a duplicate, against the
-		   rules, but we can handle it so let's do it. */
-		GVariantIter ritems;
-		GVariant * ritemsv = g_variant_get_child_value(params, 1);
-		g_variant_iter_init(&ritems, ritemsv);
+	#ifdef MASSIVEDEBUGGING
+	g_debug("Client side ID update: %d", id);
+	#endif 
 
-		GVariant * ritem;
-		while ((ritem = g_variant_iter_next_value(&ritems)) != NULL) {
-			GVariant * idv = g_variant_get_child_value(ritem, 0);
-			gint id = g_variant_get_int32(idv);
-			g_variant_unref(idv);
-			DbusmenuMenuitem * menuitem = dbusmenu_menuitem_find_id(priv->root, id);
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+	g_return_if_fail(priv->root != NULL);
 
-			if (menuitem == NULL) {
-				continue;
-			}
+	DbusmenuMenuitem * menuitem = item_index_lookup(priv, id);
+	g_return_if_fail(menuitem != NULL);
 
-			GVariantIter properties;
-			GVariant * propv = g_variant_get_child_value(ritem, 1);
-			g_variant_iter_init(&properties, propv);
-			gchar * property;
+	g_debug("Getting properties");
+	g_object_ref(menuitem);
+	get_properties_globber(client, id, NULL, menuitem_get_properties_cb, menuitem);
+	return;
+}
 
-			while (g_variant_iter_loop(&properties, "s", &property)) {
-				/* g_debug("Removing property '%s' on %d", property, id); */
-				dbusmenu_menuitem_property_remove(menuitem, property);
-			}
-			g_variant_unref(ritem);
-			g_variant_unref(propv);
-		}
-		g_variant_unref(ritemsv);
+/* Watches to see if our DBus savior comes onto the bus */
+static void
+dbus_owner_change (GDBusConnection * connection, const gchar * name, const gchar * owner, gpointer user_data)
+{
+	g_return_if_fail(DBUSMENU_IS_CLIENT(user_data));
 
-		GVariantIter items;
-		GVariant * itemsv = g_variant_get_child_value(params, 0);
-		g_variant_iter_init(&items, itemsv);
+	DbusmenuClient * client = DBUSMENU_CLIENT(user_data);
 
-		GVariant * item;
-		while ((item = g_variant_iter_next_value(&items)) != NULL) {
-			GVariant * idv = g_variant_get_child_value(item, 0);
-			gint id = g_variant_get_int32(idv);
-			g_variant_unref(idv);
+	/* Woot!  A service for us to love and to hold for ever
+	   and ever and ever! */
+	return build_proxies(client);
+}
 
-			GVariantIter properties;
-			GVariant * propv = g_variant_get_child_value(item, 1);
-			g_variant_iter_init(&properties, propv);
-			gchar * property;
-			GVariant * value;
+/* This function builds the DBus proxy which will look out for
+   the service coming up. */
+static void
+build_dbus_proxy (DbusmenuClient * client)
+{
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
 
-			while (g_variant_iter_loop(&properties, "{sv}", &property, &value)) {
-				GVariant * internalvalue = value;
-				if (G_LIKELY(g_variant_is_of_type(value, G_VARIANT_TYPE_VARIANT))) {
-					/* Unboxing if needed */
-					internalvalue = g_variant_get_variant(value);
-				}
+	if (priv->dbusproxy != 0) {
+		return;
+	}
 
-				id_prop_update(proxy, id, property, internalvalue, client);
+	priv->dbusproxy = g_bus_watch_name_on_connection(priv->session_bus,
+	                                                 priv->dbus_name,
+	                                                 G_BUS_NAME_WATCHER_FLAGS_NONE,
+	                                                 dbus_owner_change,
+	                                                 NULL,
+	                                                 client,
+	                                                 NULL);
 
-				if (internalvalue != value) {
-					/* If we unboxed, we need to drop it, otherwise the
-					   iter_loop function will unref for us */
-					g_variant_unref(internalvalue);
-				}
-			}
-			g_variant_unref(propv);
-			g_variant_unref(item);
-		}
-		g_variant_unref(itemsv);
-	} else if (g_strcmp0(signal, "ItemPropertyUpdated") == 0) {
-		gint id; gchar * property; GVariant * value;
-		g_variant_get(params, "(isv)", &id, &property, &value);
-		id_prop_update(proxy, id, property, value, client);
-		g_free(property);
-		g_variant_unref(value);
-	} else if (g_strcmp0(signal, "ItemUpdated") == 0) {
-		gint id;
-		g_variant_get(params, "(i)", &id);
-		id_update(proxy, id, client);
-	} else if (g_strcmp0(signal, "ItemActivationRequested") == 0) {
-		gint id; guint timestamp;
-		g_variant_get(params, "(iu)", &id, &timestamp);
-		item_activated(proxy, id, timestamp, client);
-	} else {
-		g_warning("Received signal '%s' from menu proxy that is unknown", signal);
-	}
+	/* Now let's check to make sure we're not in some race
+	   condition case. */
+	/* TODO: Not sure how to check for names in GDBus */
 
 	return;
 }
 
-/* This is the callback for the properties on a menu item.  There
-   should be all of them in the Hash, and they we use foreach to
-   copy them into the menuitem.
-   This isn't the most efficient way.  We can optimize this by
-   somehow removing the foreach.  But that is for later.  */
+/* Throw away the tree we've got, the server isn't there to
+   tell us about it anymore */
 static void
-menuitem_get_properties_cb (GVariant * properties, GError * error, gpointer data)
+drop_root (DbusmenuClient * client)
 {
-	g_return_if_fail(DBUSMENU_IS_MENUITEM(data));
-	DbusmenuMenuitem * item = DBUSMENU_MENUITEM(data);
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
 
-	if (error != NULL) {
-		g_warning("Error getting properties on a menuitem: %s", error->message);
-		goto out;
+	if (priv->reconnect_timeout != 0) {
+		g_source_remove(priv->reconnect_timeout);
+		priv->reconnect_timeout = 0;
 	}
 
-	if (properties == NULL) {
-		goto out;
+	if (priv->flat != NULL && priv->flat->ids->len > 0) {
+		flat_clear(priv->flat);
+
+		if (priv->root == NULL) {
+			g_signal_emit(G_OBJECT(client), signals[LAYOUT_UPDATED], 0, TRUE);
+			return;
+		}
 	}
 
-	if (!g_variant_is_of_type(properties, G_VARIANT_TYPE("a{sv}"))) {
-		g_warning("Properties are of type '%s' instead of type '%s'", g_variant_get_type_string(properties), "a{sv}");
-		goto out;
+	if (priv->root == NULL) {
+		return;
 	}
 
-	GVariantIter iter;
-	gchar * key;
-	GVariant * value;
+	g_hash_table_remove_all(priv->item_index);
+	g_object_unref(G_OBJECT(priv->root));
+	priv->root = NULL;
+	#ifdef MASSIVEDEBUGGING
+	g_debug("Proxies destroyed, signaling a root change and a layout update.");
+	#endif
+	g_signal_emit(G_OBJECT(client), signals[ROOT_CHANGED], 0, NULL, TRUE);
+	g_signal_emit(G_OBJECT(client), signals[LAYOUT_UPDATED], 0, TRUE);
 
-	g_variant_iter_init(&iter, properties);
+	return;
+}
 
-	while (g_variant_iter_loop(&iter, "{sv}", &key, &value)) {
-		dbusmenu_menuitem_property_set_variant(item, key, value);
-	}
+/* The server didn't come back in time */
+static gboolean
+reconnect_grace_cb (gpointer user_data)
+{
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(user_data);
 
-out:
-	g_object_unref(data);
+	priv->reconnect_timeout = 0;
+	drop_root(DBUSMENU_CLIENT(user_data));
 
-	return;
+	return FALSE;
 }
 
-/* This function is called to refresh the properites on an item that
-   is getting recycled with the update, but we think might have prop
-   changes. */
+/* A signal handler that gets called when a proxy is destoryed a
+   so it needs to clean up a little.  Make sure we don't think we
+   have a layout and setup the dbus watcher. */
 static void
-menuitem_get_properties_replace_cb (GVariant * properties, GError * error, gpointer data)
+proxy_destroyed (GObject * gobj_proxy, gpointer userdata)
 {
-	g_return_if_fail(DBUSMENU_IS_MENUITEM(data));
-	gboolean have_error = FALSE;
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(userdata);
 
-	if (error != NULL) {
-		g_warning("Unable to replace properties on %d: %s", dbusmenu_menuitem_get_id(DBUSMENU_MENUITEM(data)), error->message);
-		have_error = TRUE;
-	}
-	
-	if (properties == NULL) {
-		have_error = TRUE;
+	/* If we're allowed to, hang onto the tree for a bit.  When the
+	   server comes back its layout gets matched up against it like
+	   any other update, so only what changed gets rebuilt. */
+	gboolean have_layout = priv->root != NULL || (priv->flat != NULL && priv->flat->ids->len > 0);
+
+	if (have_layout && priv->reconnect_grace > 0) {
+		if (priv->reconnect_timeout == 0) {
+			priv->reconnect_timeout = g_timeout_add(priv->reconnect_grace, reconnect_grace_cb, userdata);
+		}
+	} else {
+		drop_root(DBUSMENU_CLIENT(userdata));
 	}
 
-	/* Get the list of the current properties */
-	GList * current_props = dbusmenu_menuitem_properties_list(DBUSMENU_MENUITEM(data));
-	GList * tmp = NULL;
+	if ((gpointer)priv->menuproxy == (gpointer)gobj_proxy) {
+		if (priv->layoutcall != NULL) {
+			g_cancellable_cancel(priv->layoutcall);
+			g_object_unref(priv->layoutcall);
+			priv->layoutcall = NULL;
+		}
+	}
 
-	if (!have_error && g_variant_is_of_type(properties, G_VARIANT_TYPE("a{sv}"))) {
-		GVariantIter iter;
-		g_variant_iter_init(&iter, properties);
-		gchar * name; GVariant * value;
+	priv->current_revision = 0;
+	priv->my_revision = 0;
+	priv->dirty_parent = -1;
+	g_hash_table_remove_all(priv->lazy_items);
 
-		/* Remove the entries from the current list that we have new
-		   values for.  This way we don't create signals of them being
-		   removed with the duplication of the value being changed. */
-		while (g_variant_iter_loop(&iter, "{sv}", &name, &value)) {
-			for (tmp = current_props; tmp != NULL; tmp = g_list_next(tmp)) {
-				if (g_strcmp0((gchar *)tmp->data, name) == 0) {
-					current_props = g_list_delete_link(current_props, tmp);
-					break;
-				}
-			}
-		}
+	/* Without a proxy we never stopped watching the name */
+	if (!priv->lean_transport) {
+		build_dbus_proxy(DBUSMENU_CLIENT(userdata));
 	}
+	return;
+}
 
-	/* Remove all entries that we're not getting values for, we can
-	   assume that they no longer exist */
-	for (tmp = current_props; tmp != NULL && have_error == FALSE; tmp = g_list_next(tmp)) {
-		dbusmenu_menuitem_property_remove(DBUSMENU_MENUITEM(data), (const gchar *)tmp->data);
+/* Respond to us getting the session bus (hopefully) or handle
+   the error if not */
+static void
+session_bus_cb (GObject * object, GAsyncResult * res, gpointer user_data)
+{
+	GError * error = NULL;
+
+	/* NOTE: We're not using any other variables before checking
+	   the result because they could be destroyed and thus invalid */
+	GDBusConnection * bus = g_bus_get_finish(res, &error);
+	if (error != NULL) {
+		g_warning("Unable to get session bus: %s", error->message);
+		g_error_free(error);
+		return;
 	}
-	g_list_free(current_props);
 
-	if (!have_error) {
-		menuitem_get_properties_cb(properties, error, data);
-	} else {
-		g_object_unref(data);
+	/* If this wasn't cancelled, we should be good */
+	DbusmenuClient * client = DBUSMENU_CLIENT(user_data);
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+	priv->session_bus = bus;
+
+	if (priv->session_bus_cancel != NULL) {
+		g_object_unref(priv->session_bus_cancel);
+		priv->session_bus_cancel = NULL;
 	}
 
+	/* Retry to build the proxies now that we have a bus */
+	build_proxies(DBUSMENU_CLIENT(user_data));
+
 	return;
 }
 
-/* This is a different get properites call back that also sends
-   new signals.  It basically is a small wrapper around the original. */
+/* When we have a name and an object, build the two proxies and get the
+   first version of the layout */
 static void
-menuitem_get_properties_new_cb (GVariant * properties, GError * error, gpointer data)
+build_proxies (DbusmenuClient * client)
 {
-	g_return_if_fail(data != NULL);
-	newItemPropData * propdata = (newItemPropData *)data;
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
 
-	if (error != NULL) {
-		g_debug("Error getting properties on a new menuitem: %s", error->message);
-		goto out;
+	g_return_if_fail(priv->dbus_object != NULL);
+	g_return_if_fail(priv->dbus_name != NULL);
+
+	if (priv->session_bus == NULL) {
+		/* We don't have the session bus yet, that's okay, but
+		   we need to handle that. */
+
+		/* If we're already running we don't need to look again. */
+		if (priv->session_bus_cancel == NULL) {
+			priv->session_bus_cancel = g_cancellable_new();
+
+			/* Async get the session bus */
+			g_bus_get(G_BUS_TYPE_SESSION, priv->session_bus_cancel, session_bus_cb, client);
+		}
+
+		/* This function exists, it'll be called again when we get
+		   the session bus so this condition will be ignored */
+		return;
 	}
 
-	if (properties == NULL) {
-		g_warning("Not realizing new item as properties for it were unavailable");
-		goto out;
+	if (priv->lean_transport) {
+		lean_build(client);
+		return;
 	}
 
+	/* Build us a menu proxy */
+	if (priv->menuproxy == NULL) {
+
+		/* Check to see if we're already building one */
+		if (priv->menuproxy_cancel == NULL) {
+			priv->menuproxy_cancel = g_cancellable_new();
+
+			/* With a shared connection the hub gets the signals
+			   for us, so the proxy doesn't need to ask for them */
+			GDBusProxyFlags flags = G_DBUS_PROXY_FLAGS_DO_NOT_AUTO_START;
+			if (priv->shared_connection) {
+				flags |= G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS;
+			}
+
+			g_dbus_proxy_new(priv->session_bus,
+			                 flags,
+			                 dbusmenu_interface_info,
+			                 priv->dbus_name,
+			                 priv->dbus_object,
+			                 DBUSMENU_INTERFACE,
+			                 priv->menuproxy_cancel,
+			                 menuproxy_build_cb,
+			                 client);
+		}
+	}
+
+	return;
+}
+
+/* Callback when we know if the menu proxy can be created or
+   not and do something with it! */
+static void
+menuproxy_build_cb (GObject * object, GAsyncResult * res, gpointer user_data)
+{
+	GError * error = NULL;
+
+	/* NOTE: We're not using any other variables before checking
+	   the result because they could be destroyed and thus invalid */
+	GDBusProxy * proxy = g_dbus_proxy_new_finish(res, &error);
+	if (error != NULL) {
+		g_warning("Unable to get menu proxy: %s", error->message);
+		g_error_free(error);
+		return;
+	}
+
+	/* If this wasn't cancelled, we should be good */
+	DbusmenuClient * client = DBUSMENU_CLIENT(user_data);
+	/* But let's check */
+	g_return_if_fail(client != NULL);
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+	g_return_if_fail(priv != NULL);
+
+
+	priv->menuproxy = proxy;
+
+	if (priv->menuproxy_cancel != NULL) {
+		g_object_unref(priv->menuproxy_cancel);
+		priv->menuproxy_cancel = NULL;
+	}
+
+	/* Take everything the proxy got for us as it was built */
+	GVariantBuilder builder;
+	g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
+
+	gchar ** names = g_dbus_proxy_get_cached_property_names(priv->menuproxy);
+	gint i;
+	for (i = 0; names != NULL && names[i] != NULL; i++) {
+		GVariant * value = g_dbus_proxy_get_cached_property(priv->menuproxy, names[i]);
+		if (value != NULL) {
+			g_variant_builder_add(&builder, "{sv}", names[i], value);
+			g_variant_unref(value);
+		}
+	}
+	g_strfreev(names);
+
+	GVariant * properties = g_variant_ref_sink(g_variant_builder_end(&builder));
+	server_properties_update(client, properties, NULL);
+	g_variant_unref(properties);
+
+	/* If we get here, we don't need the DBus proxy */
+	if (priv->dbusproxy != 0) {
+		g_bus_unwatch_name(priv->dbusproxy);
+		priv->dbusproxy = 0;
+	}
+
+	if (priv->shared_connection) {
+		hub_register(client);
+	} else {
+		g_signal_connect(priv->menuproxy, "g-signal",             G_CALLBACK(menuproxy_signal_cb),       client);
+	}
+	g_signal_connect(priv->menuproxy, "notify::g-name-owner", G_CALLBACK(menuproxy_name_changed_cb), client);
+	g_signal_connect(priv->menuproxy, "g-properties-changed", G_CALLBACK(menuproxy_prop_changed_cb), client);
+
+	gchar * name_owner = g_dbus_proxy_get_name_owner(priv->menuproxy);
+	if (name_owner != NULL) {
+		update_layout(client);
+		g_free(name_owner);
+	}
+
+	return;
+}
+
+/* Take in the properties of the menu as a whole, from when we
+   start up or when they change.  Anything invalidated goes back to
+   its default. */
+static void
+server_properties_update (DbusmenuClient * client, GVariant * properties, const gchar * const * invalidated)
+{
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+	DbusmenuTextDirection olddir = priv->text_direction;
+	DbusmenuStatus oldstatus = priv->status;
+	gboolean oldgroup = priv->group_events;
+	gboolean dirs_changed = FALSE;
+
+	/* Invalidate first */
+	gint i;
+	for (i = 0; invalidated != NULL && invalidated[i] != NULL; i++) {
+		const gchar * invalid = invalidated[i];
+
+		if (g_strcmp0(invalid, "TextDirection") == 0) {
+			priv->text_direction = DBUSMENU_TEXT_DIRECTION_NONE;
+		}
+		if (g_strcmp0(invalid, "Status") == 0) {
+			priv->status = DBUSMENU_STATUS_NORMAL;
+		}
+		if (g_strcmp0(invalid, "IconThemePath") == 0) {
+			if (priv->icon_dirs != NULL) {
+				dirs_changed = TRUE;
+				g_strfreev(priv->icon_dirs);
+				priv->icon_dirs = NULL;
+			}
+		}
+	}
+
+	/* Check updates */
+	GVariantIter iters;
+	gchar * key; GVariant * value;
+	g_variant_iter_init(&iters, properties);
+	while (g_variant_iter_loop(&iters, "{sv}", &key, &value)) {
+		if (g_strcmp0(key, "TextDirection") == 0) {
+			if (g_variant_is_of_type(value, G_VARIANT_TYPE_VARIANT)) {
+				GVariant * tmp = g_variant_get_variant(value);
+				g_variant_unref(value);
+				value = tmp;
+			}
+
+			priv->text_direction = dbusmenu_text_direction_get_value_from_nick(g_variant_get_string(value, NULL));
+		}
+		if (g_strcmp0(key, "Status") == 0) {
+			if (g_variant_is_of_type(value, G_VARIANT_TYPE_VARIANT)) {
+				GVariant * tmp = g_variant_get_variant(value);
+				g_variant_unref(value);
+				value = tmp;
+			}
+
+			priv->status = dbusmenu_status_get_value_from_nick(g_variant_get_string(value, NULL));
+		}
+		if (g_strcmp0(key, "IconThemePath") == 0) {
+			if (priv->icon_dirs != NULL) {
+				g_strfreev(priv->icon_dirs);
+				priv->icon_dirs = NULL;
+			}
+
+			priv->icon_dirs = g_variant_dup_strv(value, NULL);
+			dirs_changed = TRUE;
+		}
+		if (g_strcmp0(key, "Version") == 0) {
+			guint32 remote_version = 0;
+
+			if (g_variant_is_of_type(value, G_VARIANT_TYPE_UINT32)) {
+				remote_version = g_variant_get_uint32(value);
+			}
+
+			/* Figure out if we can group the events or not */
+			if (remote_version >= 3) {
+				priv->group_events = TRUE;
+			} else {
+				priv->group_events = FALSE;
+			}
+
+			/* Newer servers can tell us just what changed in the layout */
+			priv->layout_delta = (remote_version >= 4);
+		}
+	}
+
+	if (olddir != priv->text_direction) {
+		g_object_notify(G_OBJECT(client), DBUSMENU_CLIENT_PROP_TEXT_DIRECTION);
+	}
+
+	if (oldstatus != priv->status) {
+		g_object_notify(G_OBJECT(client), DBUSMENU_CLIENT_PROP_STATUS);
+	}
+
+	if (oldgroup != priv->group_events) {
+		g_object_notify(G_OBJECT(client), DBUSMENU_CLIENT_PROP_GROUP_EVENTS);
+	}
+
+	if (dirs_changed) {
+		g_signal_emit(G_OBJECT(client), signals[ICON_THEME_DIRS], 0, priv->icon_dirs, TRUE);
+	}
+
+	return;
+}
+
+/* Handle the properites changing */
+static void
+menuproxy_prop_changed_cb (GDBusProxy * proxy, GVariant * properties, GStrv invalidated, gpointer user_data)
+{
+	server_properties_update(DBUSMENU_CLIENT(user_data), properties, (const gchar * const *)invalidated);
+	return;
+}
+
+/* Handle the case where we change owners */
+static void
+menuproxy_name_changed_cb (GObject * object, GParamSpec * pspec, gpointer user_data)
+{
+	GDBusProxy * proxy = G_DBUS_PROXY(object);
+
+	gchar * owner = g_dbus_proxy_get_name_owner(proxy);
+
+	/* The signals come from the owner, so follow it */
+	hub_register(DBUSMENU_CLIENT(user_data));
+
+	if (owner == NULL) {
+		/* Oh, no!  We lost our owner! */
+		proxy_destroyed(G_OBJECT(proxy), user_data);
+	} else {
+		g_free(owner);
+		update_layout(DBUSMENU_CLIENT(user_data));
+	}
+
+	return;
+}
+
+/* Signals for us that came through the shared hub */
+static void
+hub_signal_cb (const gchar * sender, const gchar * signal, GVariant * params, gpointer user_data)
+{
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(user_data);
+
+	if (priv->menuproxy == NULL && priv->lean_owner == NULL) {
+		return;
+	}
+
+	menu_signal(DBUSMENU_CLIENT(user_data), signal, params);
+
+	return;
+}
+
+/* Register with the hub for the signals from whoever currently
+   owns the name we're looking at, dropping the old registration */
+static void
+hub_register (DbusmenuClient * client)
+{
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+
+	if (!priv->shared_connection) {
+		return;
+	}
+
+	if (priv->hub_registration != 0) {
+		_dbusmenu_client_hub_unregister(priv->hub_registration);
+		priv->hub_registration = 0;
+	}
+
+	gchar * owner = client_name_owner(priv);
+	if (owner == NULL) {
+		return;
+	}
+
+	priv->hub_registration = _dbusmenu_client_hub_register(priv->session_bus, owner, priv->dbus_object, hub_signal_cb, client);
+	g_free(owner);
+
+	return;
+}
+
+/* Who owns the name we're looking at, if anyone.  Comes from the
+   proxy if we have one, or from our own watch if we don't. */
+static gchar *
+client_name_owner (DbusmenuClientPrivate * priv)
+{
+	if (priv->lean_transport) {
+		return g_strdup(priv->lean_owner);
+	}
+
+	if (priv->menuproxy == NULL) {
+		return NULL;
+	}
+
+	return g_dbus_proxy_get_name_owner(priv->menuproxy);
+}
+
+/* Call a method on the menu, through the proxy or right on the
+   connection depending on how we're talking to the server */
+static void
+client_call (DbusmenuClient * client, const gchar * method, GVariant * params, GDBusCallFlags flags, gint timeout, GCancellable * cancellable, GAsyncReadyCallback callback, gpointer user_data)
+{
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+
+	if (!priv->lean_transport) {
+		g_dbus_proxy_call(priv->menuproxy, method, params, flags, timeout, cancellable, callback, user_data);
+		return;
+	}
+
+	/* If the owner has gone we still need an answer, even if
+	   it's an error, so ask the name like the proxy would */
+	g_dbus_connection_call(priv->session_bus,
+	                       priv->lean_owner != NULL ? priv->lean_owner : priv->dbus_name,
+	                       priv->dbus_object,
+	                       DBUSMENU_INTERFACE,
+	                       method,
+	                       params,
+	                       g_hash_table_lookup(dbusmenu_reply_types, method),
+	                       flags | G_DBUS_CALL_FLAGS_NO_AUTO_START,
+	                       timeout,
+	                       cancellable,
+	                       callback,
+	                       user_data);
+
+	return;
+}
+
+/* Get the reply from client_call(), whichever way it went */
+static GVariant *
+client_call_finish (GObject * source, GAsyncResult * res, GError ** error)
+{
+	if (G_IS_DBUS_PROXY(source)) {
+		return g_dbus_proxy_call_finish(G_DBUS_PROXY(source), res, error);
+	}
+
+	return g_dbus_connection_call_finish(G_DBUS_CONNECTION(source), res, error);
+}
+
+/* Signals straight off the connection */
+static void
+lean_signal_cb (GDBusConnection * connection, const gchar * sender, const gchar * path, const gchar * interface, const gchar * signal, GVariant * params, gpointer user_data)
+{
+	menu_signal(DBUSMENU_CLIENT(user_data), signal, params);
+	return;
+}
+
+/* The server's properties changing, straight off the connection */
+static void
+lean_properties_cb (GDBusConnection * connection, const gchar * sender, const gchar * path, const gchar * interface, const gchar * signal, GVariant * params, gpointer user_data)
+{
+	if (!g_variant_is_of_type(params, G_VARIANT_TYPE("(sa{sv}as)"))) {
+		return;
+	}
+
+	GVariant * properties = NULL;
+	const gchar ** invalidated = NULL;
+	g_variant_get(params, "(&s@a{sv}^a&s)", NULL, &properties, &invalidated);
+
+	server_properties_update(DBUSMENU_CLIENT(user_data), properties, invalidated);
+
+	g_variant_unref(properties);
+	g_free(invalidated);
+
+	return;
+}
+
+/* Listen for the signals from whoever owns the name now, dropping
+   anything we had for the last owner */
+static void
+lean_subscribe (DbusmenuClient * client)
+{
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+
+	if (priv->lean_signals != 0) {
+		g_dbus_connection_signal_unsubscribe(priv->session_bus, priv->lean_signals);
+		priv->lean_signals = 0;
+	}
+
+	if (priv->lean_properties != 0) {
+		g_dbus_connection_signal_unsubscribe(priv->session_bus, priv->lean_properties);
+		priv->lean_properties = 0;
+	}
+
+	/* Only does anything if we're sharing */
+	hub_register(client);
+
+	if (priv->lean_owner == NULL) {
+		return;
+	}
+
+	if (!priv->shared_connection) {
+		priv->lean_signals = g_dbus_connection_signal_subscribe(priv->session_bus,
+		                                                        priv->lean_owner,
+		                                                        DBUSMENU_INTERFACE,
+		                                                        NULL, /* all signals */
+		                                                        priv->dbus_object,
+		                                                        NULL, /* arg0 */
+		                                                        G_DBUS_SIGNAL_FLAGS_NONE,
+		                                                        lean_signal_cb,
+		                                                        client,
+		                                                        NULL);
+	}
+
+	priv->lean_properties = g_dbus_connection_signal_subscribe(priv->session_bus,
+	                                                           priv->lean_owner,
+	                                                           "org.freedesktop.DBus.Properties",
+	                                                           "PropertiesChanged",
+	                                                           priv->dbus_object,
+	                                                           DBUSMENU_INTERFACE,
+	                                                           G_DBUS_SIGNAL_FLAGS_NONE,
+	                                                           lean_properties_cb,
+	                                                           client,
+	                                                           NULL);
+
+	return;
+}
+
+/* All the server's properties in one go */
+static void
+lean_get_all_cb (GObject * object, GAsyncResult * res, gpointer user_data)
+{
+	GError * error = NULL;
+
+	/* NOTE: We're not using any other variables before checking
+	   the result because they could be destroyed and thus invalid */
+	GVariant * reply = g_dbus_connection_call_finish(G_DBUS_CONNECTION(object), res, &error);
+	if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		g_error_free(error);
+		return;
+	}
+
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(user_data);
+
+	if (priv->lean_cancel != NULL) {
+		g_object_unref(priv->lean_cancel);
+		priv->lean_cancel = NULL;
+	}
+
+	if (error != NULL) {
+		g_warning("Unable to get the menu's properties: %s", error->message);
+		g_error_free(error);
+		return;
+	}
+
+	GVariant * properties = g_variant_get_child_value(reply, 0);
+	server_properties_update(DBUSMENU_CLIENT(user_data), properties, NULL);
+	g_variant_unref(properties);
+	g_variant_unref(reply);
+
+	return;
+}
+
+/* The server has left the bus, drop everything that was about it */
+static void
+lean_name_vanished (GDBusConnection * connection, const gchar * name, gpointer user_data)
+{
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(user_data);
+
+	/* It was never there to begin with */
+	if (priv->lean_owner == NULL) {
+		return;
+	}
+
+	if (priv->lean_cancel != NULL) {
+		g_cancellable_cancel(priv->lean_cancel);
+		g_object_unref(priv->lean_cancel);
+		priv->lean_cancel = NULL;
+	}
+
+	g_free(priv->lean_owner);
+	priv->lean_owner = NULL;
+	lean_subscribe(DBUSMENU_CLIENT(user_data));
+
+	/* Same as losing the proxy, there isn't one to lose */
+	proxy_destroyed(NULL, user_data);
+
+	return;
+}
+
+/* Somebody has the name, ask them about themselves and for the
+   layout at the same time.  The layout doesn't need anything the
+   properties tell us, so there's no reason to wait for them. */
+static void
+lean_name_appeared (GDBusConnection * connection, const gchar * name, const gchar * owner, gpointer user_data)
+{
+	DbusmenuClient * client = DBUSMENU_CLIENT(user_data);
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+
+	if (g_strcmp0(priv->lean_owner, owner) == 0) {
+		return;
+	}
+
+	/* A new owner is a new server, start over with it */
+	lean_name_vanished(connection, name, user_data);
+
+	priv->lean_owner = g_strdup(owner);
+	lean_subscribe(client);
+
+	priv->lean_cancel = g_cancellable_new();
+	g_dbus_connection_call(priv->session_bus,
+	                       priv->lean_owner,
+	                       priv->dbus_object,
+	                       "org.freedesktop.DBus.Properties",
+	                       "GetAll",
+	                       g_variant_new("(s)", DBUSMENU_INTERFACE),
+	                       G_VARIANT_TYPE("(a{sv})"),
+	                       G_DBUS_CALL_FLAGS_NO_AUTO_START,
+	                       -1,   /* timeout */
+	                       priv->lean_cancel,
+	                       lean_get_all_cb,
+	                       client);
+
+	update_layout(client);
+
+	return;
+}
+
+/* Without a proxy we keep watching the name for as long as we're
+   around, it tells us who to talk to and when they've gone */
+static void
+lean_build (DbusmenuClient * client)
+{
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+
+	if (priv->lean_watch != 0) {
+		return;
+	}
+
+	priv->lean_watch = g_bus_watch_name_on_connection(priv->session_bus,
+	                                                  priv->dbus_name,
+	                                                  G_BUS_NAME_WATCHER_FLAGS_NONE,
+	                                                  lean_name_appeared,
+	                                                  lean_name_vanished,
+	                                                  client,
+	                                                  NULL);
+
+	return;
+}
+
+/* Handle the signals out of the proxy */
+static void
+menuproxy_signal_cb (GDBusProxy * proxy, gchar * sender, gchar * signal, GVariant * params, gpointer user_data)
+{
+	g_return_if_fail(DBUSMENU_IS_CLIENT(user_data));
+	menu_signal(DBUSMENU_CLIENT(user_data), signal, params);
+	return;
+}
+
+/* Keep the flat layout up to date with the properties the
+   server tells us about.  The layout itself is refetched. */
+static void
+flat_signal (DbusmenuClient * client, GQuark signal_quark, GVariant * params)
+{
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+	GVariantIter iter;
+	gint id;
+	const gchar * property;
+	GVariant * value;
+
+	if (signal_quark == signal_items_properties_updated) {
+		/* Removals first, like with the menuitems */
+		GVariant * removed = g_variant_get_child_value(params, 1);
+		GVariant * names;
+		g_variant_iter_init(&iter, removed);
+		while (g_variant_iter_loop(&iter, "(i@as)", &id, &names)) {
+			GVariantIter nameiter;
+			g_variant_iter_init(&nameiter, names);
+			while (g_variant_iter_loop(&nameiter, "&s", &property)) {
+				flat_property_set(priv->flat, id, property, NULL);
+			}
+		}
+		g_variant_unref(removed);
+
+		GVariant * updated = g_variant_get_child_value(params, 0);
+		GVariant * props;
+		g_variant_iter_init(&iter, updated);
+		while (g_variant_iter_loop(&iter, "(i@a{sv})", &id, &props)) {
+			GVariantIter propiter;
+			g_variant_iter_init(&propiter, props);
+			while (g_variant_iter_loop(&propiter, "{&sv}", &property, &value)) {
+				if (!property_wanted(priv, property)) {
+					continue;
+				}
+
+				if (g_variant_is_of_type(value, G_VARIANT_TYPE_VARIANT)) {
+					GVariant * inner = g_variant_get_variant(value);
+					flat_property_set(priv->flat, id, property, inner);
+					g_variant_unref(inner);
+				} else {
+					flat_property_set(priv->flat, id, property, value);
+				}
+			}
+		}
+		g_variant_unref(updated);
+	} else if (signal_quark == signal_item_property_updated) {
+		g_variant_get(params, "(i&sv)", &id, &property, &value);
+		if (property_wanted(priv, property)) {
+			flat_property_set(priv->flat, id, property, value);
+		}
+		g_variant_unref(value);
+	} else if (signal_quark == signal_item_updated && priv->root == NULL) {
+		/* Without menuitems there's nobody to get the properties
+		   for, so get them all with the layout */
+		update_layout_debounced(client);
+	}
+
+	return;
+}
+
+/* Handle the signals from the server, however they got here */
+static void
+menu_signal (DbusmenuClient * client, const gchar * signal, GVariant * params)
+{
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+	/* The handlers don't use it, and without a proxy it's NULL */
+	GDBusProxy * proxy = priv->menuproxy;
+	GQuark signal_quark = g_quark_try_string(signal);
+
+	/* The proxy checks these, but the hub and the connection
+	   don't, so make sure we can unpack it */
+	const GVariantType * expected = g_hash_table_lookup(dbusmenu_signal_types, signal);
+	if (expected != NULL && !g_variant_is_of_type(params, expected)) {
+		g_warning("Received signal '%s' of type '%s' instead of '%s'", signal, g_variant_get_type_string(params), g_variant_type_peek_string(expected));
+		return;
+	}
+
+	if (priv->flat != NULL) {
+		flat_signal(client, signal_quark, params);
+	}
+
+	if (signal_quark == signal_layout_updated) {
+		guint revision; gint parent;
+		g_variant_get(params, "(ui)", &revision, &parent);
+		layout_update(proxy, revision, parent, client);
+	} else if (priv->root == NULL) {
+		/* Drop out here, all the rest of these really need to have a root
+		   node so we can just ignore them if there isn't one. */
+	} else if (signal_quark == signal_items_properties_updated) {
+		/* Everything that changes gets collected up so that we can
+		   tell about it all at once after it's been applied */
+		GHashTable * batch = g_hash_table_new_full(g_direct_hash, g_direct_equal, g_object_unref, (GDestroyNotify)g_strfreev);
+
+		/* Remove before adding just incase there is a duplicate, against the
+		   rules, but we can handle it so let's do it. */
+		GVariantIter ritems;
+		GVariant * ritemsv = g_variant_get_child_value(params, 1);
+		g_variant_iter_init(&ritems, ritemsv);
+
+		GVariant * ritem;
+		while ((ritem = g_variant_iter_next_value(&ritems)) != NULL) {
+			GVariant * idv = g_variant_get_child_value(ritem, 0);
+			gint id = g_variant_get_int32(idv);
+			g_variant_unref(idv);
+			DbusmenuMenuitem * menuitem = item_index_lookup(priv, id);
+
+			if (menuitem == NULL) {
+				continue;
+			}
+
+			GVariantIter properties;
+			GVariant * propv = g_variant_get_child_value(ritem, 1);
+			g_variant_iter_init(&properties, propv);
+			gchar * property;
+
+			while (g_variant_iter_loop(&properties, "s", &property)) {
+				/* g_debug("Removing property '%s' on %d", property, id); */
+				if (dbusmenu_menuitem_property_exist(menuitem, property)) {
+					dbusmenu_menuitem_property_remove(menuitem, property);
+					properties_batch_add(batch, menuitem, property);
+				}
+			}
+			g_variant_unref(ritem);
+			g_variant_unref(propv);
+		}
+		g_variant_unref(ritemsv);
+
+		GVariantIter items;
+		GVariant * itemsv = g_variant_get_child_value(params, 0);
+		g_variant_iter_init(&items, itemsv);
+
+		GVariant * item;
+		while ((item = g_variant_iter_next_value(&items)) != NULL) {
+			GVariant * idv = g_variant_get_child_value(item, 0);
+			gint id = g_variant_get_int32(idv);
+			g_variant_unref(idv);
+
+			GVariantIter properties;
+			GVariant * propv = g_variant_get_child_value(item, 1);
+			g_variant_iter_init(&properties, propv);
+			gchar * property;
+			GVariant * value;
+
+			while (g_variant_iter_loop(&properties, "{sv}", &property, &value)) {
+				GVariant * internalvalue = value;
+				if (G_LIKELY(g_variant_is_of_type(value, G_VARIANT_TYPE_VARIANT))) {
+					/* Unboxing if needed */
+					internalvalue = g_variant_get_variant(value);
+				}
+
+				DbusmenuMenuitem * menuitem = id_prop_update(proxy, id, property, internalvalue, client);
+				if (menuitem != NULL) {
+					properties_batch_add(batch, menuitem, property);
+				}
+
+				if (internalvalue != value) {
+					/* If we unboxed, we need to drop it, otherwise the
+					   iter_loop function will unref for us */
+					g_variant_unref(internalvalue);
+				}
+			}
+			g_variant_unref(propv);
+			g_variant_unref(item);
+		}
+		g_variant_unref(itemsv);
+
+		if (g_hash_table_size(batch) > 0) {
+			g_signal_emit(G_OBJECT(client), signals[ITEMS_PROPERTIES_CHANGED], 0, batch);
+			layout_cache_queue(client);
+		}
+		g_hash_table_unref(batch);
+	} else if (signal_quark == signal_item_property_updated) {
+		gint id; gchar * property; GVariant * value;
+		g_variant_get(params, "(isv)", &id, &property, &value);
+		id_prop_update(proxy, id, property, value, client);
+		g_free(property);
+		g_variant_unref(value);
+	} else if (signal_quark == signal_item_updated) {
+		gint id;
+		g_variant_get(params, "(i)", &id);
+		id_update(proxy, id, client);
+	} else if (signal_quark == signal_item_activation_requested) {
+		gint id; guint timestamp;
+		g_variant_get(params, "(iu)", &id, &timestamp);
+		item_activated(proxy, id, timestamp, client);
+	} else {
+		g_warning("Received signal '%s' from menu proxy that is unknown", signal);
+	}
+
+	return;
+}
+
+/* This is the callback for the properties on a menu item.  There
+   should be all of them in the Hash, and they we use foreach to
+   copy them into the menuitem.
+   This isn't the most efficient way.  We can optimize this by
+   somehow removing the foreach.  But that is for later.  */
+static void
+menuitem_get_properties_cb (GVariant * properties, GError * error, gpointer data)
+{
+	g_return_if_fail(DBUSMENU_IS_MENUITEM(data));
+	DbusmenuMenuitem * item = DBUSMENU_MENUITEM(data);
+
+	if (error != NULL) {
+		g_warning("Error getting properties on a menuitem: %s", error->message);
+		goto out;
+	}
+
+	if (properties == NULL) {
+		goto out;
+	}
+
+	if (!g_variant_is_of_type(properties, G_VARIANT_TYPE("a{sv}"))) {
+		g_warning("Properties are of type '%s' instead of type '%s'", g_variant_get_type_string(properties), "a{sv}");
+		goto out;
+	}
+
+	GVariantIter iter;
+	gchar * key;
+	GVariant * value;
+
+	g_variant_iter_init(&iter, properties);
+
+	while (g_variant_iter_loop(&iter, "{sv}", &key, &value)) {
+		property_set_interned(item, key, value);
+	}
+
+out:
+	g_object_unref(data);
+
+	return;
+}
+
+/* A function to work with an event_data_t and make sure it gets
+   free'd and in a terminal state. */
+static void
+event_data_end (event_data_t * edata, GError * error)
+{
+	g_signal_emit(edata->client, signals[EVENT_RESULT], 0, edata->menuitem, edata->event, edata->variant, edata->timestamp, error, TRUE);
+
+	g_variant_unref(edata->variant);
+	g_free(edata->event);
+	g_object_unref(edata->menuitem);
+	g_object_unref(edata->client);
+	g_free(edata);
+
+	return;
+}
+
+/* Respond to the call function to make sure that the other side
+   got it, or print a warning. */
+static void
+menuitem_call_cb (GObject * proxy, GAsyncResult * res, gpointer userdata)
+{
+	GError * error = NULL;
+	event_data_t * edata = (event_data_t *)userdata;
+	GVariant * params;
+
+	params = client_call_finish(proxy, res, &error);
+
+	if (error != NULL) {
+		g_warning("Unable to call event '%s' on menu item %d: %s", edata->event, dbusmenu_menuitem_get_id(edata->menuitem), error->message);
+	}
+
+	event_data_end(edata, error);
+
+	if (G_UNLIKELY(error != NULL)) {
+		g_error_free(error);
+	}
+	if (G_LIKELY(params != NULL)) {
+		g_variant_unref(params);
+	}
+
+	return;
+}
+
+/* Looks at event_data_t structs to match an ID */
+static gint
+event_data_find (gconstpointer data, gconstpointer user_data)
+{
+	event_data_t * edata = (event_data_t *)data;
+	gint id = GPOINTER_TO_INT(user_data);
+
+	if (edata->id == id) {
+		return 0;
+	} else {
+		return -1;
+	}
+}
+
+/* The callback from the dbus message to pass events to the
+   to the server en masse */
+static void
+event_group_cb (GObject * proxy, GAsyncResult * res, gpointer user_data)
+{
+	GQueue * events = (GQueue *)user_data;
+
+	GError * error = NULL;
+	GVariant * params;
+	params = client_call_finish(proxy, res, &error);
+
+	if (error != NULL) {
+		/* If we got an actual DBus error, we should just pass that
+		   along and finish up */
+		g_queue_foreach(events, (GFunc)event_data_end, error);
+		g_queue_free(events);
+		events = NULL;
+		return;
+	}
+
+	gint id = 0;
+	GVariant * array = g_variant_get_child_value(params, 0);
+	GVariantIter iter;
+	g_variant_iter_init(&iter, array);
+
+	while (g_variant_iter_loop(&iter, "i", &id)) {
+		GList * item = g_queue_find_custom(events, GINT_TO_POINTER(id), event_data_find);
+
+		if (item != NULL) {
+			GError * iderror = g_error_new(error_domain(), ERROR_ID_NOT_FOUND, "Unable to find ID: %d", id);
+			event_data_end((event_data_t *)item->data, iderror);
+			g_queue_delete_link(events, item);
+			g_error_free(iderror);
+		}
+	}
+
+	g_variant_unref(array);
+	g_variant_unref(params);
+
+	/* If we have any left send non-error responses */
+	g_queue_foreach(events, (GFunc)event_data_end, NULL);
+	g_queue_free(events);
+	return;
+}
+
+/* Turn an event structure into the variant builder form */
+static void
+events_to_builder (gpointer data, gpointer user_data)
+{
+	event_data_t * edata = (event_data_t *)data;
+	GVariantBuilder * builder = (GVariantBuilder *)user_data;
+
+	GVariantBuilder tuple;
+	g_variant_builder_init(&tuple, G_VARIANT_TYPE_TUPLE);
+
+	g_variant_builder_add_value(&tuple, g_variant_new_int32(edata->id));
+	g_variant_builder_add_value(&tuple, g_variant_new_string(edata->event));
+	g_variant_builder_add_value(&tuple, g_variant_new_variant(edata->variant));
+	g_variant_builder_add_value(&tuple, g_variant_new_uint32(edata->timestamp));
+
+	GVariant * vtuple = g_variant_builder_end(&tuple);
+	g_variant_builder_add_value(builder, vtuple);
+	return;
+}
+
+/* Group all the events into a single Dbus message and send
+   that out */
+static gboolean
+event_idle_cb (gpointer user_data)
+{
+	g_return_val_if_fail(DBUSMENU_IS_CLIENT(user_data), FALSE);
+	DbusmenuClient * client = DBUSMENU_CLIENT(user_data);
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(user_data);
+
+	/* We use prepend for speed, but now we want to have them
+	   in the order they were called incase that matters. */
+	GQueue * levents = priv->events_to_go;
+	priv->events_to_go = NULL;
+	priv->event_idle = 0;
+
+	GVariantBuilder array;
+	g_variant_builder_init(&array, G_VARIANT_TYPE("a(isvu)"));
+	g_queue_foreach(levents, events_to_builder, &array);
+	GVariant * vevents = g_variant_builder_end(&array);
+
+	if (g_signal_has_handler_pending (client, signals[EVENT_RESULT], 0, TRUE)) {
+		client_call(client,
+		            "EventGroup",
+		            g_variant_new_tuple(&vevents, 1),
+		            G_DBUS_CALL_FLAGS_NONE,
+		            1000,   /* timeout */
+		            NULL, /* cancellable */
+		            event_group_cb, levents);
+	} else {
+		client_call(client,
+		            "EventGroup",
+		            g_variant_new_tuple(&vevents, 1),
+		            G_DBUS_CALL_FLAGS_NONE,
+		            1000,   /* timeout */
+		            NULL, /* cancellable */
+		            NULL, NULL);
+		g_queue_foreach(levents, (GFunc)event_data_end, NULL);
+		g_queue_free(levents);
+	}
+
+	return FALSE;
+}
+
+/* Sends the event over DBus to the server on the other side
+   of the bus. */
+void
+dbusmenu_client_send_event (DbusmenuClient * client, gint id, const gchar * name, GVariant * variant, guint timestamp, DbusmenuMenuitem * mi)
+{
+	g_return_if_fail(DBUSMENU_IS_CLIENT(client));
+	g_return_if_fail(id >= 0);
+	g_return_if_fail(name != NULL);
+
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+	if (mi == NULL) {
+		g_warning("Asked to activate a menuitem %d that we don't know about", id);
+		return;
+	}
+
+	if (variant == NULL) {
+		variant = g_variant_new_int32(0);
+	}
+
+	/* Don't bother with the reply handling if nobody is watching... */
+	if (!priv->group_events && !g_signal_has_handler_pending (client, signals[EVENT_RESULT], 0, TRUE)) {
+		client_call(client,
+		            "Event",
+		            g_variant_new("(isvu)", id, name, variant, timestamp),
+		            G_DBUS_CALL_FLAGS_NONE,
+		            1000,   /* timeout */
+		            NULL, /* cancellable */
+		            NULL, NULL);
+		return;
+	}
+
+	event_data_t * edata = g_new0(event_data_t, 1);
+	edata->id = id;
+	edata->client = client;
+	g_object_ref(client);
+	edata->menuitem = mi;
+	g_object_ref(edata->menuitem);
+	edata->event = g_strdup(name);
+	edata->timestamp = timestamp;
+	edata->variant = variant;
+	g_variant_ref_sink(variant);
+
+	if (!priv->group_events) {
+		client_call(client,
+		            "Event",
+		            g_variant_new("(isvu)", id, name, variant, timestamp),
+		            G_DBUS_CALL_FLAGS_NONE,
+		            1000,   /* timeout */
+		            NULL, /* cancellable */
+		            menuitem_call_cb,
+		            edata);
+	} else {
+		if (priv->events_to_go == NULL) {
+			priv->events_to_go = g_queue_new();
+		}
+
+		g_queue_push_tail(priv->events_to_go, edata);
+
+		if (priv->event_idle == 0) {
+			priv->event_idle = g_idle_add(event_idle_cb, client);
+		}
+	}
+
+	return;
+}
+
+typedef struct _about_to_show_t about_to_show_t;
+struct _about_to_show_t {
+	gint id;
+	DbusmenuClient * client;
+	void (*cb) (gpointer data);
+	gpointer cb_data;
+};
+
+/* Takes an about_to_show_t structure and calls the callback correctly
+   and updates the layout if needed. */
+static void
+about_to_show_finish (about_to_show_t * data, gboolean need_update)
+{
+	g_return_if_fail(data != NULL);
+
+	/* If we need to update, do that first. */
+	if (need_update) {
+		update_layout(data->client);
+	}
+
+	if (data->cb != NULL) {
+		data->cb(data->cb_data);
+	}
+
+	g_object_unref(data->client);
+	g_free(data);
+
+	return;
+}
+
+/* A little function to match prototypes and make sure to convert from
+   a pointer to an int correctly */
+static void
+about_to_show_finish_pntr (gpointer data, gpointer user_data)
+{
+	return about_to_show_finish((about_to_show_t *)data, GPOINTER_TO_INT(user_data));
+}
+
+/* Respond to the DBus message from sending a bunch of about-to-show events
+   to the server */
+static void
+about_to_show_group_cb (GObject * proxy, GAsyncResult * res, gpointer userdata)
+{
+	GError * error = NULL;
+	GQueue * showers = (GQueue *)userdata;
+	GVariant * params = NULL;
+
+	params = client_call_finish(proxy, res, &error);
+
+	if (error != NULL) {
+		g_warning("Unable to send about_to_show_group: %s", error->message);
+		/* Note: we're just ensuring only the callback gets called */
+		g_error_free(error);
+		error = NULL;
+	} else {
+		GVariant * updates = g_variant_get_child_value(params, 0);
+		GVariantIter iter;
+
+		/* Okay, so this is kinda interesting.  We actually don't care which
+		   entries asked us to update the structure, as it's quite simply a
+		   single structure.  So if we have any ask, we get the update once to
+		   avoid itterating through all the structures. */
+		if (g_variant_iter_init(&iter, updates) > 0) {
+			about_to_show_t * first = (about_to_show_t *)g_queue_peek_head(showers);
+			update_layout(first->client);
+		}
+
+		g_variant_unref(updates);
+		g_variant_unref(params);
+		params = NULL;
+	}
+
+	g_queue_foreach(showers, about_to_show_finish_pntr, GINT_TO_POINTER(FALSE));
+	g_queue_free(showers);
+
+	return;
+}
+
+/* Check to see if this about to show entry has a callback associated
+   with it */
+static void
+about_to_show_idle_callbacks (gpointer data, gpointer user_data)
+{
+	about_to_show_t * abts = (about_to_show_t *)data;
+	gboolean * got_callbacks = (gboolean *)user_data;
+
+	if (abts->cb != NULL) {
+		*got_callbacks = TRUE;
+	}
+
+	return;
+}
+
+/* Take the ID out of the about to show structure and put it into the 
+   variant builder */
+static void
+about_to_show_idle_ids (gpointer data, gpointer user_data)
+{
+	about_to_show_t * abts = (about_to_show_t *)data;
+	GVariantBuilder * builder = (GVariantBuilder *)user_data;
+
+	g_variant_builder_add_value(builder, g_variant_new_int32(abts->id));
+
+	return;
+}
+
+/* Function that gets called with all the queued about_to_show messages, let's
+   get these guys on the bus! */
+static gboolean
+about_to_show_idle (gpointer user_data)
+{
+	DbusmenuClient * client = DBUSMENU_CLIENT(user_data);
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+
+	/* Reset our object global props and take ownership of these entries */
+	priv->about_to_show_idle = 0;
+	GQueue * showers = priv->about_to_show_to_go;
+	priv->about_to_show_to_go = NULL;
+
+	g_return_val_if_fail(showers != NULL, FALSE);
+
+	/* Figure out if we've got any callbacks */
+	gboolean got_callbacks = FALSE;
+	g_queue_foreach(showers, about_to_show_idle_callbacks, &got_callbacks);
+
+	/* Build a list of the IDs */
+	GVariantBuilder idarray;
+	g_variant_builder_init(&idarray, G_VARIANT_TYPE("ai"));
+	g_queue_foreach(showers, about_to_show_idle_ids, &idarray);
+	GVariant * ids = g_variant_builder_end(&idarray);
+
+	/* Setup our callbacks */
+	GAsyncReadyCallback cb = NULL;
+	gpointer cb_data = NULL;
+	if (got_callbacks) {
+		cb = about_to_show_group_cb;
+		cb_data = showers;
+	} else {
+		g_queue_foreach(showers, about_to_show_finish_pntr, GINT_TO_POINTER(FALSE));
+		g_queue_free(showers);
+	}
+
+	/* Let's call it! */
+	client_call(client,
+	            "AboutToShowGroup",
+	            g_variant_new_tuple(&ids, 1),
+	            G_DBUS_CALL_FLAGS_NONE,
+	            -1,   /* timeout */
+	            NULL, /* cancellable */
+	            cb,
+	            cb_data);
+
+	return FALSE;
+}
+
+/* Reports errors and responds to update request that were a result
+   of sending the about to show signal. */
+static void
+about_to_show_cb (GObject * proxy, GAsyncResult * res, gpointer userdata)
+{
+	gboolean need_update = FALSE;
+	GError * error = NULL;
+	about_to_show_t * data = (about_to_show_t *)userdata;
+	GVariant * params = NULL;
+
+	params = client_call_finish(proxy, res, &error);
+
+	if (error != NULL) {
+		g_warning("Unable to send about_to_show: %s", error->message);
+		/* Note: we're just ensuring only the callback gets called */
+		need_update = FALSE;
+		g_error_free(error);
+		error = NULL;
+	} else {
+		g_variant_get(params, "(b)", &need_update);
+		g_variant_unref(params);
+	}
+
+	if (data != NULL) {
+		about_to_show_finish(data, need_update);
+	}
+
+	return;
+}
+
+/* Sends the about to show signal for a given id to the
+   server on the other side of DBus */
+void
+dbusmenu_client_send_about_to_show(DbusmenuClient * client, gint id, void (*cb)(gpointer data), gpointer cb_data)
+{
+	g_return_if_fail(DBUSMENU_CLIENT(client));
+	g_return_if_fail(id >= 0);
+
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+	g_return_if_fail(priv != NULL);
+
+	/* If we haven't gotten this submenu yet, now's the time.  It's
+	   asked for first so it'll be back before the about to show. */
+	if (priv->root != NULL && g_hash_table_contains(priv->lazy_items, GINT_TO_POINTER(id))) {
+		DbusmenuMenuitem * item = item_index_lookup(priv, id);
+		if (item != NULL) {
+			dbusmenu_client_fetch_submenu(client, item);
+		}
+	}
+
+	about_to_show_t * data = g_new0(about_to_show_t, 1);
+	data->id = id;
+	data->client = client;
+	data->cb = cb;
+	data->cb_data = cb_data;
+	g_object_ref(client);
+
+	if (priv->group_events) {
+		if (priv->about_to_show_to_go == NULL) {
+			priv->about_to_show_to_go = g_queue_new();
+		}
+
+		g_queue_push_tail(priv->about_to_show_to_go, data);
+
+		if (priv->about_to_show_idle == 0) {
+			priv->about_to_show_idle = g_idle_add(about_to_show_idle, client);
+		}
+	} else {
+		GAsyncReadyCallback dbuscb = NULL;
+
+		/* If there's no callback we don't need this data, let's
+		   clean it up in a consistent way */
+		if (cb == NULL) {
+			about_to_show_finish(data, FALSE);
+			data = NULL;
+		} else {
+			dbuscb = about_to_show_cb;
+		}
+
+		client_call(client,
+		            "AboutToShow",
+		            g_variant_new("(i)", id),
+		            G_DBUS_CALL_FLAGS_NONE,
+		            -1,   /* timeout */
+		            NULL, /* cancellable */
+		            dbuscb,
+		            data);
+	}
+
+	return;
+}
+
+/* How far down the tree we ask for when getting the layout */
+static gint
+layout_depth (DbusmenuClientPrivate * priv)
+{
+	/* The flat layout always has all of it */
+	if (priv->lazy_layout && priv->flat == NULL) {
+		return LAZY_LAYOUT_DEPTH;
+	}
+
+	return -1;
+}
+
+/* Hand a new item, which has all of its properties now, to the
+   type handlers and tell everyone about it. */
+static void
+realize_new_item (newItemPropData * propdata)
+{
 	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(propdata->client);
 
-	/* Extra ref as get_properties will unref once itself */
-	g_object_ref(propdata->item);
-	menuitem_get_properties_cb (properties, error, propdata->item);
-
 	gboolean handled = FALSE;
 
 	const gchar * type;
@@ -1587,766 +3574,763 @@ menuitem_get_properties_new_cb (GVariant * properties, GError * error, gpointer
 		g_signal_emit(G_OBJECT(propdata->client), signals[NEW_MENUITEM], 0, propdata->item, TRUE);
 	}
 
-out:
-	g_object_unref(propdata->item);
-	g_free(propdata);
-
 	return;
 }
 
-/* A function to work with an event_data_t and make sure it gets
-   free'd and in a terminal state. */
-static void
-event_data_end (event_data_t * edata, GError * error)
+/* Realize all the items that were built in the last layout
+   update.  This is done in the idle so that everyone sees the
+   new items after the layout and root changes, like they'd see
+   them after getting their properties. */
+static gboolean
+realize_items_idle (gpointer user_data)
 {
-	g_signal_emit(edata->client, signals[EVENT_RESULT], 0, edata->menuitem, edata->event, edata->variant, edata->timestamp, error, TRUE);
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(user_data);
+	priv->realize_idle = 0;
 
-	g_variant_unref(edata->variant);
-	g_free(edata->event);
-	g_object_unref(edata->menuitem);
-	g_object_unref(edata->client);
-	g_free(edata);
+	newItemPropData * propdata;
+	while ((propdata = g_queue_pop_head(priv->realize_queue)) != NULL) {
+		realize_new_item(propdata);
+		g_object_unref(propdata->item);
+		g_free(propdata);
+	}
 
-	return;
+	return FALSE;
 }
 
-/* Respond to the call function to make sure that the other side
-   got it, or print a warning. */
-static void
-menuitem_call_cb (GObject * proxy, GAsyncResult * res, gpointer userdata)
+/* Builds a new child and queues it up to be realized.  The
+   properties in the layout are all of them, so they just need
+   to be applied before the item is realized. */
+static DbusmenuMenuitem *
+parse_layout_new_child (gint id, DbusmenuClient * client, DbusmenuMenuitem * parent)
 {
-	GError * error = NULL;
-	event_data_t * edata = (event_data_t *)userdata;
-	GVariant * params;
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+	DbusmenuMenuitem * item = NULL;
+
+	/* Build a new item */
+	item = DBUSMENU_MENUITEM(dbusmenu_client_menuitem_new(id, client));
+	if (parent == NULL) {
+		dbusmenu_menuitem_set_root(item, TRUE);
+	}
 
-	params = g_dbus_proxy_call_finish(G_DBUS_PROXY(proxy), res, &error);
+	g_hash_table_insert(priv->item_index, GINT_TO_POINTER(id), g_object_ref(item));
 
-	if (error != NULL) {
-		g_warning("Unable to call event '%s' on menu item %d: %s", edata->event, dbusmenu_menuitem_get_id(edata->menuitem), error->message);
+	newItemPropData * propdata = g_new0(newItemPropData, 1);
+	propdata->client  = client;
+	propdata->item    = item;
+	propdata->parent  = parent;
+	g_object_ref(item);
+
+	g_queue_push_tail(priv->realize_queue, propdata);
+	if (priv->realize_idle == 0) {
+		priv->realize_idle = g_idle_add(realize_items_idle, client);
 	}
 
-	event_data_end(edata, error);
+	return item;
+}
 
-	if (G_UNLIKELY(error != NULL)) {
-		g_error_free(error);
+/* Apply the properties that are sent along with the layout
+   of an item to the menu item.  They're all the properties that
+   we want so anything not in there has been removed. */
+static void
+parse_layout_apply_props (DbusmenuMenuitem * item, GVariant * layout)
+{
+	GVariantIter iter;
+	gchar * prop;
+	GVariant * value;
+	GVariant * props;
+
+	props = g_variant_get_child_value(layout, 1);
+
+	/* Remove all entries that we're not getting values for, we can
+	   assume that they no longer exist */
+	GList * current_props = dbusmenu_menuitem_properties_list(item);
+	GList * tmp = NULL;
+	for (tmp = current_props; tmp != NULL; tmp = g_list_next(tmp)) {
+		GVariant * newvalue = g_variant_lookup_value(props, (const gchar *)tmp->data, NULL);
+		if (newvalue == NULL) {
+			dbusmenu_menuitem_property_remove(item, (const gchar *)tmp->data);
+		} else {
+			g_variant_unref(newvalue);
+		}
 	}
-	if (G_LIKELY(params != NULL)) {
-		g_variant_unref(params);
+	g_list_free(current_props);
+
+	/* Set the type first as it can manage the behavior of
+	   all other properties. */
+	g_variant_iter_init(&iter, props);
+	while (g_variant_iter_loop(&iter, "{sv}", &prop, &value)) {
+		if (g_strcmp0(prop, DBUSMENU_MENUITEM_PROP_TYPE) == 0) {
+			property_set_interned(item, prop, value);
+		}
+	}
+
+	/* Now go through and do all the properties. */
+	g_variant_iter_init(&iter, props);
+	while (g_variant_iter_loop(&iter, "{sv}", &prop, &value)) {
+		property_set_interned(item, prop, value);
 	}
+	g_variant_unref(props);
 
 	return;
 }
 
-/* Looks at event_data_t structs to match an ID */
-static gint
-event_data_find (gconstpointer data, gconstpointer user_data)
+/* Index the children of @parent by their IDs */
+static GHashTable *
+children_index (DbusmenuMenuitem * parent)
 {
-	event_data_t * edata = (event_data_t *)data;
-	gint id = GPOINTER_TO_INT(user_data);
+	GHashTable * index = g_hash_table_new(g_direct_hash, g_direct_equal);
+	GList * child;
 
-	if (edata->id == id) {
-		return 0;
-	} else {
-		return -1;
+	for (child = dbusmenu_menuitem_get_children(parent); child != NULL; child = g_list_next(child)) {
+		g_hash_table_insert(index, GINT_TO_POINTER(dbusmenu_menuitem_get_id(DBUSMENU_MENUITEM(child->data))), child->data);
 	}
+
+	return index;
 }
 
-/* The callback from the dbus message to pass events to the
-   to the server en masse */
+/* Find the longest increasing subsequence of @seq and mark the
+   entries that are in it in @keep.  Those are the children that
+   are already in the right order and don't need to move. */
 static void
-event_group_cb (GObject * proxy, GAsyncResult * res, gpointer user_data)
+children_lis (const gint * seq, guint len, gboolean * keep)
 {
-	GQueue * events = (GQueue *)user_data;
-
-	GError * error = NULL;
-	GVariant * params;
-	params = g_dbus_proxy_call_finish(G_DBUS_PROXY(proxy), res, &error);
-
-	if (error != NULL) {
-		/* If we got an actual DBus error, we should just pass that
-		   along and finish up */
-		g_queue_foreach(events, (GFunc)event_data_end, error);
-		g_queue_free(events);
-		events = NULL;
+	if (len == 0) {
 		return;
 	}
 
-	gint id = 0;
-	GVariant * array = g_variant_get_child_value(params, 0);
-	GVariantIter iter;
-	g_variant_iter_init(&iter, array);
-
-	while (g_variant_iter_loop(&iter, "i", &id)) {
-		GList * item = g_queue_find_custom(events, GINT_TO_POINTER(id), event_data_find);
+	/* tails[n] is the index of the smallest value that ends an
+	   increasing run of length n + 1 */
+	guint * tails = g_new(guint, len);
+	gint * prev = g_new(gint, len);
+	guint runs = 0;
+	guint i;
+
+	for (i = 0; i < len; i++) {
+		guint low = 0;
+		guint high = runs;
+
+		while (low < high) {
+			guint mid = (low + high) / 2;
+			if (seq[tails[mid]] < seq[i]) {
+				low = mid + 1;
+			} else {
+				high = mid;
+			}
+		}
 
-		if (item != NULL) {
-			GError * iderror = g_error_new(error_domain(), ERROR_ID_NOT_FOUND, "Unable to find ID: %d", id);
-			event_data_end((event_data_t *)item->data, iderror);
-			g_queue_delete_link(events, item);
-			g_error_free(iderror);
+		prev[i] = low > 0 ? (gint)tails[low - 1] : -1;
+		tails[low] = i;
+		if (low == runs) {
+			runs++;
 		}
+
+		keep[i] = FALSE;
 	}
 
-	g_variant_unref(array);
-	g_variant_unref(params);
+	gint entry;
+	for (entry = tails[runs - 1]; entry >= 0; entry = prev[entry]) {
+		keep[entry] = TRUE;
+	}
+
+	g_free(tails);
+	g_free(prev);
 
-	/* If we have any left send non-error responses */
-	g_queue_foreach(events, (GFunc)event_data_end, NULL);
-	g_queue_free(events);
 	return;
 }
 
-/* Turn an event structure into the variant builder form */
+/* Make the children of @parent match @ids.  For each ID @items has
+   either the current child to recycle for it or NULL to build a new
+   one, and it gets filled in with the new children.  Everything that
+   isn't recycled is removed first, then the recycled children that
+   are already in order stay put while the others move around them,
+   and last the new children are added in their places. */
 static void
-events_to_builder (gpointer data, gpointer user_data)
+children_reconcile (DbusmenuClient * client, DbusmenuMenuitem * parent, const gint * ids, DbusmenuMenuitem ** items, guint len)
 {
-	event_data_t * edata = (event_data_t *)data;
-	GVariantBuilder * builder = (GVariantBuilder *)user_data;
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+	GHashTable * recycled = g_hash_table_new(g_direct_hash, g_direct_equal);
+	guint i;
 
-	GVariantBuilder tuple;
-	g_variant_builder_init(&tuple, G_VARIANT_TYPE_TUPLE);
+	for (i = 0; i < len; i++) {
+		if (items[i] != NULL) {
+			g_hash_table_insert(recycled, items[i], GINT_TO_POINTER(-1));
+		}
+	}
 
-	g_variant_builder_add_value(&tuple, g_variant_new_int32(edata->id));
-	g_variant_builder_add_value(&tuple, g_variant_new_string(edata->event));
-	g_variant_builder_add_value(&tuple, g_variant_new_variant(edata->variant));
-	g_variant_builder_add_value(&tuple, g_variant_new_uint32(edata->timestamp));
+	/* Remove the children we're not keeping and number the ones
+	   that we are in the order they're in now */
+	GList * oldchildren = g_list_copy(dbusmenu_menuitem_get_children(parent));
+	GList * oldchild;
+	gint oldpos = 0;
 
-	GVariant * vtuple = g_variant_builder_end(&tuple);
-	g_variant_builder_add_value(builder, vtuple);
-	return;
-}
+	for (oldchild = oldchildren; oldchild != NULL; oldchild = g_list_next(oldchild)) {
+		if (g_hash_table_contains(recycled, oldchild->data)) {
+			g_hash_table_insert(recycled, oldchild->data, GINT_TO_POINTER(oldpos++));
+		} else {
+			#ifdef MASSIVEDEBUGGING
+			g_debug("Unref'ing menu item with layout update. ID: %d", dbusmenu_menuitem_get_id(DBUSMENU_MENUITEM(oldchild->data)));
+			#endif
+			dbusmenu_menuitem_foreach(DBUSMENU_MENUITEM(oldchild->data), item_index_remove, priv);
+			dbusmenu_menuitem_child_delete(parent, DBUSMENU_MENUITEM(oldchild->data));
+		}
+	}
+	g_list_free(oldchildren);
 
-/* Group all the events into a single Dbus message and send
-   that out */
-static gboolean
-event_idle_cb (gpointer user_data)
-{
-	g_return_val_if_fail(DBUSMENU_IS_CLIENT(user_data), FALSE);
-	DbusmenuClient * client = DBUSMENU_CLIENT(user_data);
-	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(user_data);
+	/* Line up the old positions of the recycled children in their
+	   new order and find the ones that can stay where they are */
+	guint * newpos = g_new(guint, len);
+	gint * seq = g_new(gint, len);
+	gboolean * keep = g_new(gboolean, len);
+	guint count = 0;
 
-	/* We use prepend for speed, but now we want to have them
-	   in the order they were called incase that matters. */
-	GQueue * levents = priv->events_to_go;
-	priv->events_to_go = NULL;
-	priv->event_idle = 0;
+	for (i = 0; i < len; i++) {
+		if (items[i] == NULL) {
+			continue;
+		}
 
-	GVariantBuilder array;
-	g_variant_builder_init(&array, G_VARIANT_TYPE("a(isvu)"));
-	g_queue_foreach(levents, events_to_builder, &array);
-	GVariant * vevents = g_variant_builder_end(&array);
+		gint pos = GPOINTER_TO_INT(g_hash_table_lookup(recycled, items[i]));
+		if (pos < 0) {
+			g_warning("Trying to recycle item %d that isn't a child of %d", ids[i], dbusmenu_menuitem_get_id(parent));
+			items[i] = NULL;
+			continue;
+		}
 
-	if (g_signal_has_handler_pending (client, signals[EVENT_RESULT], 0, TRUE)) {
-		g_dbus_proxy_call(priv->menuproxy,
-		                  "EventGroup",
-		                  g_variant_new_tuple(&vevents, 1),
-		                  G_DBUS_CALL_FLAGS_NONE,
-		                  1000,   /* timeout */
-		                  NULL, /* cancellable */
-		                  event_group_cb, levents);
-	} else {
-		g_dbus_proxy_call(priv->menuproxy,
-		                  "EventGroup",
-		                  g_variant_new_tuple(&vevents, 1),
-		                  G_DBUS_CALL_FLAGS_NONE,
-		                  1000,   /* timeout */
-		                  NULL, /* cancellable */
-		                  NULL, NULL);
-		g_queue_foreach(levents, (GFunc)event_data_end, NULL);
-		g_queue_free(levents);
+		newpos[count] = i;
+		seq[count] = pos;
+		count++;
 	}
+	g_hash_table_destroy(recycled);
 
-	return FALSE;
+	children_lis(seq, count, keep);
+
+	/* Move the rest, working back from the end so that the child
+	   we're putting them in front of is already in its place */
+	gint entry;
+	for (entry = (gint)count - 1; entry >= 0; entry--) {
+		if (keep[entry]) {
+			continue;
+		}
+
+		DbusmenuMenuitem * childmi = items[newpos[entry]];
+		guint position = count - 1;
+
+		if ((guint)entry != count - 1) {
+			guint curpos = dbusmenu_menuitem_get_position(childmi, parent);
+			guint nextpos = dbusmenu_menuitem_get_position(items[newpos[entry + 1]], parent);
+			position = curpos < nextpos ? nextpos - 1 : nextpos;
+		}
+
+		#ifdef MASSIVEDEBUGGING
+		g_debug("Recycling menu item %d at position %d", dbusmenu_menuitem_get_id(childmi), newpos[entry]);
+		#endif
+		dbusmenu_menuitem_child_reorder(parent, childmi, position);
+	}
+
+	g_free(newpos);
+	g_free(seq);
+	g_free(keep);
+
+	/* Everything before each new child is in its final place now,
+	   so they can go right where they belong */
+	for (i = 0; i < len; i++) {
+		if (items[i] != NULL) {
+			continue;
+		}
+
+		#ifdef MASSIVEDEBUGGING
+		g_debug("Building new menu item %d at position %d", ids[i], i);
+		#endif
+		items[i] = parse_layout_new_child(ids[i], client, parent);
+		dbusmenu_menuitem_child_add_position(parent, items[i], i);
+		g_object_unref(items[i]);
+	}
+
+	return;
 }
 
-/* Sends the event over DBus to the server on the other side
-   of the bus. */
-void
-dbusmenu_client_send_event (DbusmenuClient * client, gint id, const gchar * name, GVariant * variant, guint timestamp, DbusmenuMenuitem * mi)
+/* Parse recursively through the XML and make it into
+   objects as need be */
+static DbusmenuMenuitem *
+parse_layout_xml(DbusmenuClient * client, GVariant * layout, DbusmenuMenuitem * item, DbusmenuMenuitem * parent, GDBusProxy * proxy, gint depth)
 {
-	g_return_if_fail(DBUSMENU_IS_CLIENT(client));
-	g_return_if_fail(id >= 0);
-	g_return_if_fail(name != NULL);
-
-	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
-	if (mi == NULL) {
-		g_warning("Asked to activate a menuitem %d that we don't know about", id);
-		return;
+	if (layout == NULL) {
+		return NULL;
 	}
 
-	if (variant == NULL) {
-		variant = g_variant_new_int32(0);
+	/* First verify and figure out what we've got */
+	GVariant * idv = g_variant_get_child_value(layout, 0);
+	gint id = g_variant_get_int32(idv);
+	g_variant_unref(idv);
+	if (id < 0) {
+		return NULL;
 	}
+	#ifdef MASSIVEDEBUGGING
+	g_debug("Client looking at node with id: %d", id);
+	#endif
 
-	/* Don't bother with the reply handling if nobody is watching... */
-	if (!priv->group_events && !g_signal_has_handler_pending (client, signals[EVENT_RESULT], 0, TRUE)) {
-		g_dbus_proxy_call(priv->menuproxy,
-		                  "Event",
-		                  g_variant_new("(isvu)", id, name, variant, timestamp),
-		                  G_DBUS_CALL_FLAGS_NONE,
-		                  1000,   /* timeout */
-		                  NULL, /* cancellable */
-		                  NULL, NULL);
-		return;
+	g_return_val_if_fail(item != NULL, NULL);
+	g_return_val_if_fail(id == dbusmenu_menuitem_get_id(item), NULL);
+
+	/* If we didn't ask for the layout this far down we can't say
+	   anything about the children, leave them until they're needed */
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+	if (depth == 0) {
+		g_hash_table_add(priv->lazy_items, GINT_TO_POINTER(id));
+		return item;
 	}
+	g_hash_table_remove(priv->lazy_items, GINT_TO_POINTER(id));
 
-	event_data_t * edata = g_new0(event_data_t, 1);
-	edata->id = id;
-	edata->client = client;
-	g_object_ref(client);
-	edata->menuitem = mi;
-	g_object_ref(edata->menuitem);
-	edata->event = g_strdup(name);
-	edata->timestamp = timestamp;
-	edata->variant = variant;
-	g_variant_ref_sink(variant);
+	/* Some variables */
+	GVariantIter children;
+	GVariant * childrenv;
 
-	if (!priv->group_events) {
-		g_dbus_proxy_call(priv->menuproxy,
-		                  "Event",
-		                  g_variant_new("(isvu)", id, name, variant, timestamp),
-		                  G_DBUS_CALL_FLAGS_NONE,
-		                  1000,   /* timeout */
-		                  NULL, /* cancellable */
-		                  menuitem_call_cb,
-		                  edata);
-	} else {
-		if (priv->events_to_go == NULL) {
-			priv->events_to_go = g_queue_new();
+	childrenv = g_variant_get_child_value(layout, 2);
+	g_variant_iter_init(&children, childrenv);
+
+	/* Go through all the XML Nodes and see which of our current
+	   children can be recycled to cover them */
+	GHashTable * oldchildren = children_index(item);
+	GPtrArray * layouts = g_ptr_array_new_with_free_func((GDestroyNotify)g_variant_unref);
+	GPtrArray * items = g_ptr_array_new();
+	GArray * ids = g_array_new(FALSE, FALSE, sizeof(gint));
+
+	GVariant * child;
+	while ((child = g_variant_iter_next_value(&children)) != NULL) {
+		if (g_variant_is_of_type(child, G_VARIANT_TYPE_VARIANT)) {
+			GVariant * tmp = g_variant_get_variant(child);
+			g_variant_unref(child);
+			child = tmp;
+		}
+
+		GVariant * childidv = g_variant_get_child_value(child, 0);
+		gint childid = g_variant_get_int32(childidv);
+		g_variant_unref(childidv);
+		if (childid < 0) {
+			/* Don't increment the position when there isn't a valid
+			   node in the XML tree.  It's probably a comment. */
+			g_variant_unref(child);
+			continue;
 		}
 
-		g_queue_push_tail(priv->events_to_go, edata);
+		DbusmenuMenuitem * childmi = g_hash_table_lookup(oldchildren, GINT_TO_POINTER(childid));
+		if (childmi != NULL) {
+			g_hash_table_remove(oldchildren, GINT_TO_POINTER(childid));
+
+			GVariant * child_props = g_variant_get_child_value(child, 1);
+			GVariant * new_type = g_variant_lookup_value(child_props, DBUSMENU_MENUITEM_PROP_TYPE, NULL);
+			GVariant * old_type = dbusmenu_menuitem_property_get_variant(childmi, DBUSMENU_MENUITEM_PROP_TYPE);
+
+			// Only recycle the menu item if it's of the same type
+			if (!((old_type == NULL && new_type == NULL) || (old_type != NULL && new_type != NULL && g_variant_compare(old_type, new_type) == 0))) {
+				childmi = NULL;
+			}
 
-		if (priv->event_idle == 0) {
-			priv->event_idle = g_idle_add(event_idle_cb, client);
+			if (new_type != NULL) {
+				g_variant_unref(new_type);
+			}
+			g_variant_unref(child_props);
 		}
+
+		g_ptr_array_add(layouts, child);
+		g_ptr_array_add(items, childmi);
+		g_array_append_val(ids, childid);
 	}
+	g_hash_table_destroy(oldchildren);
 
-	return;
-}
+	children_reconcile(client, item, (gint *)ids->data, (DbusmenuMenuitem **)items->pdata, ids->len);
 
-typedef struct _about_to_show_t about_to_show_t;
-struct _about_to_show_t {
-	gint id;
-	DbusmenuClient * client;
-	void (*cb) (gpointer data);
-	gpointer cb_data;
-};
+	/* Apply known properties sent in the structure to the
+	   menu item.  Sometimes they may just be copies */
+	guint i;
+	for (i = 0; i < items->len; i++) {
+		parse_layout_apply_props(DBUSMENU_MENUITEM(g_ptr_array_index(items, i)), g_ptr_array_index(layouts, i));
+	}
 
-/* Takes an about_to_show_t structure and calls the callback correctly
-   and updates the layout if needed. */
-static void
-about_to_show_finish (about_to_show_t * data, gboolean need_update)
-{
-	g_return_if_fail(data != NULL);
+	/* We've got everything built up at this node and reconcilled */
 
-	/* If we need to update, do that first. */
-	if (need_update) {
-		update_layout(data->client);
+	/* Flush the properties requests if this is the first level */
+	if (parent != NULL && dbusmenu_menuitem_get_id(parent) == 0) {
+		get_properties_flush(client);
 	}
 
-	if (data->cb != NULL) {
-		data->cb(data->cb_data);
+	/* now it's time to recurse down the tree. */
+	for (i = 0; i < items->len; i++) {
+		#ifdef MASSIVEDEBUGGING
+		g_debug("Recursing parse_layout_xml.  ID: %d", g_array_index(ids, gint, i));
+		#endif
+
+		parse_layout_xml(client, g_ptr_array_index(layouts, i), DBUSMENU_MENUITEM(g_ptr_array_index(items, i)), item, proxy, depth < 0 ? depth : depth - 1);
 	}
 
-	g_object_unref(data->client);
-	g_free(data);
+	g_ptr_array_free(layouts, TRUE);
+	g_ptr_array_free(items, TRUE);
+	g_array_free(ids, TRUE);
+	g_variant_unref(childrenv);
 
-	return;
+	return item;
 }
 
-/* A little function to match prototypes and make sure to convert from
-   a pointer to an int correctly */
-static void
-about_to_show_finish_pntr (gpointer data, gpointer user_data)
+/* Take the layout passed to us over DBus and turn it into
+   a set of beautiful objects */
+static gint
+parse_layout (DbusmenuClient * client, GVariant * layout, gint depth)
 {
-	return about_to_show_finish((about_to_show_t *)data, GPOINTER_TO_INT(user_data));
-}
+	#ifdef MASSIVEDEBUGGING
+	g_debug("Client Parsing a new layout");
+	#endif 
 
-/* Respond to the DBus message from sending a bunch of about-to-show events
-   to the server */
-static void
-about_to_show_group_cb (GObject * proxy, GAsyncResult * res, gpointer userdata)
-{
-	GError * error = NULL;
-	GQueue * showers = (GQueue *)userdata;
-	GVariant * params = NULL;
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
 
-	params = g_dbus_proxy_call_finish(G_DBUS_PROXY(proxy), res, &error);
+	DbusmenuMenuitem * oldroot = priv->root;
 
-	if (error != NULL) {
-		g_warning("Unable to send about_to_show_group: %s", error->message);
-		/* Note: we're just ensuring only the callback gets called */
-		g_error_free(error);
-		error = NULL;
-	} else {
-		GVariant * updates = g_variant_get_child_value(params, 0);
-		GVariantIter iter;
+	if (priv->root == NULL) {
+		priv->root = parse_layout_new_child(0, client, NULL);
+	}
+	parse_layout_apply_props(priv->root, layout);
 
-		/* Okay, so this is kinda interesting.  We actually don't care which
-		   entries asked us to update the structure, as it's quite simply a
-		   single structure.  So if we have any ask, we get the update once to
-		   avoid itterating through all the structures. */
-		if (g_variant_iter_init(&iter, updates) > 0) {
-			about_to_show_t * first = (about_to_show_t *)g_queue_peek_head(showers);
-			update_layout(first->client);
-		}
+	priv->root = parse_layout_xml(client, layout, priv->root, NULL, priv->menuproxy, depth);
 
-		g_variant_unref(updates);
-		g_variant_unref(params);
-		params = NULL;
+	if (priv->root == NULL) {
+		g_warning("Unable to parse layout on client %s object %s: %s", priv->dbus_name, priv->dbus_object, g_variant_print(layout, TRUE));
 	}
 
-	g_queue_foreach(showers, about_to_show_finish_pntr, GINT_TO_POINTER(FALSE));
-	g_queue_free(showers);
+	if (priv->root != oldroot) {
+		#ifdef MASSIVEDEBUGGING
+		g_debug("Client signaling root changed.");
+		#endif 
 
-	return;
+		/* If they are different, and there was an old root we must
+		   clean up that old root */
+		if (oldroot != NULL) {
+			g_hash_table_remove_all(priv->item_index);
+			dbusmenu_menuitem_set_root(oldroot, FALSE);
+			g_object_unref(oldroot);
+			oldroot = NULL;
+		}
+
+		/* If the root changed we can signal that */
+		g_signal_emit(G_OBJECT(client), signals[ROOT_CHANGED], 0, priv->root, TRUE);
+	}
+
+	return 1;
 }
 
-/* Check to see if this about to show entry has a callback associated
-   with it */
-static void
-about_to_show_idle_callbacks (gpointer data, gpointer user_data)
+/* A whole layout has come in, from the server or the cache.  If
+   we're keeping a flat layout the menuitems are only built once
+   somebody has asked for them. */
+static gint
+layout_apply (DbusmenuClient * client, GVariant * layout, gint depth)
 {
-	about_to_show_t * abts = (about_to_show_t *)data;
-	gboolean * got_callbacks = (gboolean *)user_data;
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
 
-	if (abts->cb != NULL) {
-		*got_callbacks = TRUE;
+	if (priv->flat == NULL) {
+		return parse_layout(client, layout, depth);
 	}
 
-	return;
+	if (!flat_rebuild(priv->flat, layout)) {
+		return 0;
+	}
+
+	if (priv->root == NULL) {
+		return 1;
+	}
+
+	return parse_layout(client, layout, depth);
 }
 
-/* Take the ID out of the about to show structure and put it into the 
-   variant builder */
-static void
-about_to_show_idle_ids (gpointer data, gpointer user_data)
+/* Where we keep the cached layout for the server and object
+   that this client is looking at.  Servers that are only known by
+   their unique name won't ever have that name again, so there's
+   no point in keeping a file that would never be read; NULL then. */
+static gchar *
+layout_cache_file (DbusmenuClientPrivate * priv)
 {
-	about_to_show_t * abts = (about_to_show_t *)data;
-	GVariantBuilder * builder = (GVariantBuilder *)user_data;
+	if (g_dbus_is_unique_name(priv->dbus_name)) {
+		return NULL;
+	}
 
-	g_variant_builder_add_value(builder, g_variant_new_int32(abts->id));
+	gchar * key = g_strdup_printf("%s\n%s", priv->dbus_name, priv->dbus_object);
+	gchar * hash = g_compute_checksum_for_string(G_CHECKSUM_SHA1, key, -1);
+	gchar * basename = g_strconcat(hash, ".layout", NULL);
+	gchar * filename = g_build_filename(g_get_user_cache_dir(), "libdbusmenu", basename, NULL);
 
-	return;
+	g_free(basename);
+	g_free(hash);
+	g_free(key);
+
+	return filename;
 }
 
-/* Function that gets called with all the queued about_to_show messages, let's
-   get these guys on the bus! */
-static gboolean
-about_to_show_idle (gpointer user_data)
+/* Write out the layout that we have now, with all the properties
+   we know, so that the next client can start from it. */
+static void
+layout_cache_save (DbusmenuClient * client)
 {
-	DbusmenuClient * client = DBUSMENU_CLIENT(user_data);
 	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
 
-	/* Reset our object global props and take ownership of these entries */
-	priv->about_to_show_idle = 0;
-	GQueue * showers = priv->about_to_show_to_go;
-	priv->about_to_show_to_go = NULL;
-
-	g_return_val_if_fail(showers != NULL, FALSE);
-
-	/* Figure out if we've got any callbacks */
-	gboolean got_callbacks = FALSE;
-	g_queue_foreach(showers, about_to_show_idle_callbacks, &got_callbacks);
-
-	/* Build a list of the IDs */
-	GVariantBuilder idarray;
-	g_variant_builder_init(&idarray, G_VARIANT_TYPE("ai"));
-	g_queue_foreach(showers, about_to_show_idle_ids, &idarray);
-	GVariant * ids = g_variant_builder_end(&idarray);
+	if (priv->dbus_name == NULL || priv->dbus_object == NULL) {
+		return;
+	}
 
-	/* Setup our callbacks */
-	GAsyncReadyCallback cb = NULL;
-	gpointer cb_data = NULL;
-	if (got_callbacks) {
-		cb = about_to_show_group_cb;
-		cb_data = showers;
+	GVariant * layout = NULL;
+	if (priv->root != NULL) {
+		layout = dbusmenu_menuitem_build_variant(priv->root, NULL, -1);
+	} else if (priv->flat != NULL && priv->flat->ids->len > 0) {
+		layout = g_variant_ref_sink(flat_build_layout(priv->flat, 0));
 	} else {
-		g_queue_foreach(showers, about_to_show_finish_pntr, GINT_TO_POINTER(FALSE));
-		g_queue_free(showers);
+		return;
 	}
 
-	/* Let's call it! */
-	g_dbus_proxy_call(priv->menuproxy,
-	                  "AboutToShowGroup",
-	                  g_variant_new_tuple(&ids, 1),
-	                  G_DBUS_CALL_FLAGS_NONE,
-	                  -1,   /* timeout */
-	                  NULL, /* cancellable */
-	                  cb,
-	                  cb_data);
+	GVariant * cache = g_variant_ref_sink(g_variant_new("(uv)", LAYOUT_CACHE_VERSION, layout));
+	g_variant_unref(layout);
 
-	return FALSE;
-}
+	gchar * filename = layout_cache_file(priv);
+	if (filename == NULL) {
+		g_variant_unref(cache);
+		return;
+	}
 
-/* Reports errors and responds to update request that were a result
-   of sending the about to show signal. */
-static void
-about_to_show_cb (GObject * proxy, GAsyncResult * res, gpointer userdata)
-{
-	gboolean need_update = FALSE;
+	gchar * dirname = g_path_get_dirname(filename);
 	GError * error = NULL;
-	about_to_show_t * data = (about_to_show_t *)userdata;
-	GVariant * params = NULL;
-
-	params = g_dbus_proxy_call_finish(G_DBUS_PROXY(proxy), res, &error);
 
-	if (error != NULL) {
-		g_warning("Unable to send about_to_show: %s", error->message);
-		/* Note: we're just ensuring only the callback gets called */
-		need_update = FALSE;
+	if (g_mkdir_with_parents(dirname, 0700) != 0) {
+		g_warning("Unable to create layout cache directory '%s'", dirname);
+	} else if (!g_file_set_contents(filename, g_variant_get_data(cache), g_variant_get_size(cache), &error)) {
+		g_warning("Unable to write layout cache '%s': %s", filename, error->message);
 		g_error_free(error);
-		error = NULL;
-	} else {
-		g_variant_get(params, "(b)", &need_update);
-		g_variant_unref(params);
 	}
 
-	if (data != NULL) {
-		about_to_show_finish(data, need_update);
-	}
+	g_free(dirname);
+	g_free(filename);
+	g_variant_unref(cache);
 
 	return;
 }
 
-/* Sends the about to show signal for a given id to the
-   server on the other side of DBus */
-void
-dbusmenu_client_send_about_to_show(DbusmenuClient * client, gint id, void (*cb)(gpointer data), gpointer cb_data)
+/* Timeout to write the cache once things have settled down */
+static gboolean
+layout_cache_save_timeout (gpointer user_data)
 {
-	g_return_if_fail(DBUSMENU_CLIENT(client));
-	g_return_if_fail(id >= 0);
-
-	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
-	g_return_if_fail(priv != NULL);
-
-	about_to_show_t * data = g_new0(about_to_show_t, 1);
-	data->id = id;
-	data->client = client;
-	data->cb = cb;
-	data->cb_data = cb_data;
-	g_object_ref(client);
-
-	if (priv->group_events) {
-		if (priv->about_to_show_to_go == NULL) {
-			priv->about_to_show_to_go = g_queue_new();
-		}
-
-		g_queue_push_tail(priv->about_to_show_to_go, data);
-
-		if (priv->about_to_show_idle == 0) {
-			priv->about_to_show_idle = g_idle_add(about_to_show_idle, client);
-		}
-	} else {
-		GAsyncReadyCallback dbuscb = NULL;
-
-		/* If there's no callback we don't need this data, let's
-		   clean it up in a consistent way */
-		if (cb == NULL) {
-			about_to_show_finish(data, FALSE);
-			data = NULL;
-		} else {
-			dbuscb = about_to_show_cb;
-		}
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(user_data);
+	priv->cache_save_timeout = 0;
 
-		g_dbus_proxy_call(priv->menuproxy,
-		                  "AboutToShow",
-		                  g_variant_new("(i)", id),
-		                  G_DBUS_CALL_FLAGS_NONE,
-		                  -1,   /* timeout */
-		                  NULL, /* cancellable */
-		                  dbuscb,
-		                  data);
-	}
+	layout_cache_save(DBUSMENU_CLIENT(user_data));
 
-	return;
+	return FALSE;
 }
 
-/* Builds a new child with property requests and everything
-   else to clean up the code a bit */
-static DbusmenuMenuitem *
-parse_layout_new_child (gint id, DbusmenuClient * client, DbusmenuMenuitem * parent)
+/* Our copy of the layout changed, write it out in a bit if
+   we're keeping a cache */
+static void
+layout_cache_queue (DbusmenuClient * client)
 {
-	DbusmenuMenuitem * item = NULL;
-
-	/* Build a new item */
-	item = DBUSMENU_MENUITEM(dbusmenu_client_menuitem_new(id, client));
-	if (parent == NULL) {
-		dbusmenu_menuitem_set_root(item, TRUE);
-	}
-
-	/* Get the properties queued up for this item */
-	/* Not happy allocating about this, but I need these :( */
-	newItemPropData * propdata = g_new0(newItemPropData, 1);
-	if (propdata != NULL) {
-		propdata->client  = client;
-		propdata->item    = item;
-		propdata->parent  = parent;
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
 
-		g_object_ref(item);
-		get_properties_globber(client, id, NULL, menuitem_get_properties_new_cb, propdata);
-	} else {
-		g_warning("Unable to allocate memory to get properties for menuitem.  This menuitem will never be realized.");
+	if (!priv->cache_layout || priv->cache_save_timeout != 0) {
+		return;
 	}
 
-	return item;
-}
+	priv->cache_save_timeout = g_timeout_add_seconds(LAYOUT_CACHE_DELAY, layout_cache_save_timeout, client);
 
-/* Refresh the properties on this item */
-static void
-parse_layout_update (DbusmenuMenuitem * item, DbusmenuClient * client)
-{
-	g_object_ref(item);
-	get_properties_globber(client, dbusmenu_menuitem_get_id(item), NULL, menuitem_get_properties_replace_cb, item);
 	return;
 }
 
-/* Parse recursively through the XML and make it into
-   objects as need be */
-static DbusmenuMenuitem *
-parse_layout_xml(DbusmenuClient * client, GVariant * layout, DbusmenuMenuitem * item, DbusmenuMenuitem * parent, GDBusProxy * proxy)
+/* Build up our menus from the cached layout so that there is
+   something to show while we wait on the server.  The server's
+   layout gets reconciled over it when it comes in. */
+static gboolean
+layout_cache_load_idle (gpointer user_data)
 {
-	if (layout == NULL) {
-		return NULL;
+	DbusmenuClient * client = DBUSMENU_CLIENT(user_data);
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+	priv->cache_load_idle = 0;
+
+	/* If the server beat us, there's nothing to do */
+	if (priv->root != NULL || priv->my_revision > 0 || (priv->flat != NULL && priv->flat->ids->len > 0)) {
+		return FALSE;
 	}
 
-	/* First verify and figure out what we've got */
-	GVariant * idv = g_variant_get_child_value(layout, 0);
-	gint id = g_variant_get_int32(idv);
-	g_variant_unref(idv);
-	if (id < 0) {
-		return NULL;
+	if (priv->dbus_name == NULL || priv->dbus_object == NULL) {
+		return FALSE;
 	}
-	#ifdef MASSIVEDEBUGGING
-	g_debug("Client looking at node with id: %d", id);
-	#endif
 
-	g_return_val_if_fail(item != NULL, NULL);
-	g_return_val_if_fail(id == dbusmenu_menuitem_get_id(item), NULL);
+	gchar * filename = layout_cache_file(priv);
+	gchar * data = NULL;
+	gsize length = 0;
 
-	/* Some variables */
-	GVariantIter children;
-	GVariant * childrenv;
+	if (filename == NULL) {
+		return FALSE;
+	}
 
-	childrenv = g_variant_get_child_value(layout, 2);
-	g_variant_iter_init(&children, childrenv);
+	if (!g_file_get_contents(filename, &data, &length, NULL)) {
+		g_free(filename);
+		return FALSE;
+	}
 
-	guint position = 0;
-	GList * oldchildren = g_list_copy(dbusmenu_menuitem_get_children(item));
-	/* g_debug("Starting old children: %d", g_list_length(oldchildren)); */
+	GVariant * cache = g_variant_ref_sink(g_variant_new_from_data(G_VARIANT_TYPE("(uv)"), data, length, FALSE, g_free, data));
+	guint version = 0;
+	GVariant * layout = NULL;
 
-	/* Go through all the XML Nodes and make sure that we have menuitems
-	   to cover those XML nodes. */
-	GVariant * child;
-	while ((child = g_variant_iter_next_value(&children)) != NULL) {
-		/* g_debug("Looking at child: %d", position); */
-		if (g_variant_is_of_type(child, G_VARIANT_TYPE_VARIANT)) {
-			GVariant * tmp = g_variant_get_variant(child);
-			g_variant_unref(child);
-			child = tmp;
-		}
+	g_variant_get(cache, "(uv)", &version, &layout);
 
-		GVariant * childidv = g_variant_get_child_value(child, 0);
-		gint childid = g_variant_get_int32(childidv);
-		g_variant_unref(childidv);
-		if (childid < 0) {
-			/* Don't increment the position when there isn't a valid
-			   node in the XML tree.  It's probably a comment. */
-			g_variant_unref(child);
-			continue;
-		}
-		DbusmenuMenuitem * childmi = NULL;
-
-		/* First see if we can recycle a node that we've already built
-		   on this menu item */
-		GList * childsearch = NULL;
-		for (childsearch = oldchildren; childsearch != NULL; childsearch = g_list_next(childsearch)) {
-			DbusmenuMenuitem * cs_mi = DBUSMENU_MENUITEM(childsearch->data);
-			if (childid == dbusmenu_menuitem_get_id(cs_mi)) {
-				GVariantIter iter;
-				gchar * prop;
-				GVariant * value;
-				GVariant * child_props;
-				GVariant * new_type = NULL;
-				GVariant * old_type = NULL;
-
-				child_props = g_variant_get_child_value(child, 1);
-				g_variant_iter_init(&iter, child_props);
-				while (g_variant_iter_loop(&iter, "{sv}", &prop, &value)) {
-					if (g_strcmp0(prop, DBUSMENU_MENUITEM_PROP_TYPE) == 0) {
-						new_type = value;
-						break;
-					}
-				}
-				g_variant_unref(child_props);
-				
-				old_type = dbusmenu_menuitem_property_get_variant(cs_mi, DBUSMENU_MENUITEM_PROP_TYPE);
-				if ((old_type == NULL && new_type == NULL) || (old_type != NULL && new_type != NULL && g_variant_compare(old_type, new_type) == 0)) {
-					// Only recycle the menu item if it's of the same type
-					oldchildren = g_list_remove(oldchildren, cs_mi);
-					childmi = cs_mi;
-				}
-				break;
-			}
-		}
+	if (version == LAYOUT_CACHE_VERSION && g_variant_is_of_type(layout, G_VARIANT_TYPE("(ia{sv}av)"))) {
+		#ifdef MASSIVEDEBUGGING
+		g_debug("Client building layout from cache '%s'", filename);
+		#endif
+		layout_apply(client, layout, -1);
 
-		if (childmi == NULL) {
-			#ifdef MASSIVEDEBUGGING
-			g_debug("Building new menu item %d at position %d", childid, position);
-			#endif
-			/* If we can't recycle, then we build a new one */
-			childmi = parse_layout_new_child(childid, client, item);
-			dbusmenu_menuitem_child_add_position(item, childmi, position);
-			g_object_unref(childmi);
-		} else {
-			#ifdef MASSIVEDEBUGGING
-			g_debug("Recycling menu item %d at position %d", childid, position);
-			#endif
-			/* If we can recycle, make sure it's in the right place */
-			dbusmenu_menuitem_child_reorder(item, childmi, position);
-			parse_layout_update(childmi, client);
+		if (priv->root != NULL || (priv->flat != NULL && priv->flat->ids->len > 0)) {
+			g_signal_emit(G_OBJECT(client), signals[LAYOUT_UPDATED], 0, TRUE);
 		}
+	} else {
+		g_debug("Ignoring layout cache '%s' in an unknown format", filename);
+	}
 
-		/* Apply known properties sent in the structure to the
-		   menu item.  Sometimes they may just be copies */
-		if (childmi != NULL) {
-			GVariantIter iter;
-			gchar * prop;
-			GVariant * value;
-			GVariant * child_props;
-
-			/* Set the type first as it can manage the behavior of
-			   all other properties. */
-			child_props = g_variant_get_child_value(child, 1);
-			g_variant_iter_init(&iter, child_props);
-			while (g_variant_iter_loop(&iter, "{sv}", &prop, &value)) {
-				if (g_strcmp0(prop, DBUSMENU_MENUITEM_PROP_TYPE) == 0) {
-					dbusmenu_menuitem_property_set_variant(childmi, prop, value);
-				}
-			}
+	g_variant_unref(layout);
+	g_variant_unref(cache);
+	g_free(filename);
 
-			/* Now go through and do all the properties. */
-			g_variant_iter_init(&iter, child_props);
-			while (g_variant_iter_loop(&iter, "{sv}", &prop, &value)) {
-				dbusmenu_menuitem_property_set_variant(childmi, prop, value);
-			}
-			g_variant_unref(child_props);
+	return FALSE;
+}
+
+/* Reconcile the children of @parent with the list of IDs that
+   the server has sent us.  Anything that isn't in our list should
+   have its layout in @layouts, otherwise we're out of sync. */
+static gboolean
+parse_layout_delta_children (DbusmenuClient * client, DbusmenuMenuitem * parent, GVariant * ids, GVariant * layouts)
+{
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+	gboolean synced = TRUE;
+
+	/* Index the layouts of the new children */
+	GHashTable * newlayouts = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)g_variant_unref);
+	GVariantIter iter;
+	GVariant * layoutv;
+
+	g_variant_iter_init(&iter, layouts);
+	while ((layoutv = g_variant_iter_next_value(&iter)) != NULL) {
+		GVariant * layout = g_variant_get_variant(layoutv);
+		g_variant_unref(layoutv);
+
+		/* The variants could be anything, and we're going to take
+		   them apart assuming they're layouts */
+		if (!g_variant_is_of_type(layout, G_VARIANT_TYPE("(ia{sv}av)"))) {
+			g_warning("Layout delta has a child of type '%s' instead of a layout", g_variant_get_type_string(layout));
+			g_variant_unref(layout);
+			synced = FALSE;
+			break;
 		}
 
-		position++;
-		g_variant_unref(child);
+		GVariant * idv = g_variant_get_child_value(layout, 0);
+		g_hash_table_insert(newlayouts, GINT_TO_POINTER(g_variant_get_int32(idv)), layout);
+		g_variant_unref(idv);
 	}
 
-	/* Remove any children that are no longer used by this version of
-	   the layout. */
-	GList * oldchildleft = NULL;
-	for (oldchildleft = oldchildren; oldchildleft != NULL; oldchildleft = g_list_next(oldchildleft)) {
-		DbusmenuMenuitem * oldmi = DBUSMENU_MENUITEM(oldchildleft->data);
-		#ifdef MASSIVEDEBUGGING
-		g_debug("Unref'ing menu item with layout update. ID: %d", dbusmenu_menuitem_get_id(oldmi));
-		#endif
-		dbusmenu_menuitem_child_delete(item, oldmi);
+	if (!synced) {
+		g_hash_table_destroy(newlayouts);
+		return FALSE;
 	}
-	g_list_free(oldchildren);
 
-	/* We've got everything built up at this node and reconcilled */
+	/* Everything should either be one of our children already or
+	   have a layout, check before we start changing things */
+	GHashTable * oldchildren = children_index(parent);
+	GPtrArray * items = g_ptr_array_new();
+	GArray * childids = g_array_new(FALSE, FALSE, sizeof(gint));
+	gint childid;
+
+	g_variant_iter_init(&iter, ids);
+	while (g_variant_iter_next(&iter, "i", &childid)) {
+		DbusmenuMenuitem * childmi = g_hash_table_lookup(oldchildren, GINT_TO_POINTER(childid));
+		g_hash_table_remove(oldchildren, GINT_TO_POINTER(childid));
+
+		if (childmi == NULL && !g_hash_table_contains(newlayouts, GINT_TO_POINTER(childid))) {
+			g_warning("Layout delta has item %d that we don't know about", childid);
+			synced = FALSE;
+			break;
+		}
 
-	/* Flush the properties requests if this is the first level */
-	if (parent != NULL && dbusmenu_menuitem_get_id(parent) == 0) {
-		get_properties_flush(client);
+		g_ptr_array_add(items, childmi);
+		g_array_append_val(childids, childid);
 	}
+	g_hash_table_destroy(oldchildren);
 
-	/* now it's time to recurse down the tree. */
-	g_variant_iter_init(&children, childrenv);
+	if (synced) {
+		children_reconcile(client, parent, (gint *)childids->data, (DbusmenuMenuitem **)items->pdata, childids->len);
 
-	child = g_variant_iter_next_value(&children);
-	GList * childmis = dbusmenu_menuitem_get_children(item);
-	while (child != NULL && childmis != NULL) {
-		if (g_variant_is_of_type(child, G_VARIANT_TYPE_VARIANT)) {
-			GVariant * tmp = g_variant_get_variant(child);
-			g_variant_unref(child);
-			child = tmp;
-		}
+		/* New children, or ones removed and added back, get their
+		   layouts applied so that we're current */
+		guint i;
+		for (i = 0; i < items->len; i++) {
+			GVariant * layout = g_hash_table_lookup(newlayouts, GINT_TO_POINTER(g_array_index(childids, gint, i)));
+			if (layout == NULL) {
+				continue;
+			}
 
-		GVariant * xmlidv = g_variant_get_child_value(child, 0);
-		gint xmlid = g_variant_get_int32(xmlidv);
-		g_variant_unref(xmlidv);
-		/* If this isn't a valid menu item we need to move on
-		   until we have one.  This avoids things like comments. */
-		if (xmlid < 0) {
-			g_variant_unref(child);
-			child = g_variant_iter_next_value(&children);
-			continue;
+			DbusmenuMenuitem * childmi = DBUSMENU_MENUITEM(g_ptr_array_index(items, i));
+			parse_layout_apply_props(childmi, layout);
+			parse_layout_xml(client, layout, childmi, parent, priv->menuproxy, -1);
 		}
-
-		#ifdef MASSIVEDEBUGGING
-		gint miid = dbusmenu_menuitem_get_id(DBUSMENU_MENUITEM(childmis->data));
-		g_debug("Recursing parse_layout_xml.  XML ID: %d  MI ID: %d", xmlid, miid);
-		#endif
-		
-		parse_layout_xml(client, child, DBUSMENU_MENUITEM(childmis->data), item, proxy);
-
-		g_variant_unref(child);
-		child = g_variant_iter_next_value(&children);
-		childmis = g_list_next(childmis);
 	}
 
-	g_variant_unref(childrenv);
-
-	if (child != NULL) {
-		g_warning("Sync failed, now we've got extra layout nodes.");
-	}
-	if (childmis != NULL) {
-		g_warning("Sync failed, now we've got extra menu items.");
-	}
+	g_ptr_array_free(items, TRUE);
+	g_array_free(childids, TRUE);
+	g_hash_table_destroy(newlayouts);
 
-	return item;
+	return synced;
 }
 
-/* Take the layout passed to us over DBus and turn it into
-   a set of beautiful objects */
-static gint
-parse_layout (DbusmenuClient * client, GVariant * layout)
+/* Take the list of changed parents from GetLayoutDelta and bring
+   our copy of the layout up to date. */
+static gboolean
+parse_layout_delta (DbusmenuClient * client, GVariant * updates)
 {
-	#ifdef MASSIVEDEBUGGING
-	g_debug("Client Parsing a new layout");
-	#endif 
-
 	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+	g_return_val_if_fail(priv->root != NULL, FALSE);
 
-	DbusmenuMenuitem * oldroot = priv->root;
+	GVariantIter iter;
+	gint parentid;
+	GVariant * ids;
+	GVariant * layouts;
+	gboolean synced = TRUE;
 
-	if (priv->root == NULL) {
-		priv->root = parse_layout_new_child(0, client, NULL);
-	} else {
-		parse_layout_update(priv->root, client);
-	}
+	g_variant_iter_init(&iter, updates);
+	while (synced && g_variant_iter_next(&iter, "(i@ai@av)", &parentid, &ids, &layouts)) {
+		DbusmenuMenuitem * parent = NULL;
 
-	priv->root = parse_layout_xml(client, layout, priv->root, NULL, priv->menuproxy);
+		if (parentid == 0) {
+			parent = priv->root;
+		} else {
+			parent = item_index_lookup(priv, parentid);
+		}
 
-	if (priv->root == NULL) {
-		g_warning("Unable to parse layout on client %s object %s: %s", priv->dbus_name, priv->dbus_object, g_variant_print(layout, TRUE));
-	}
+		/* If we don't have the parent it's been removed, or it's
+		   inside a new item that we got the full layout for.  If
+		   we haven't gotten its children yet, we'll get them new. */
+		if (parent != NULL && !g_hash_table_contains(priv->lazy_items, GINT_TO_POINTER(parentid))) {
+			synced = parse_layout_delta_children(client, parent, ids, layouts);
+		}
 
-	if (priv->root != oldroot) {
-		#ifdef MASSIVEDEBUGGING
-		g_debug("Client signaling root changed.");
-		#endif 
+		g_variant_unref(ids);
+		g_variant_unref(layouts);
+	}
 
-		/* If they are different, and there was an old root we must
-		   clean up that old root */
-		if (oldroot != NULL) {
-			dbusmenu_menuitem_set_root(oldroot, FALSE);
-			g_object_unref(oldroot);
-			oldroot = NULL;
-		}
+	return synced;
+}
 
-		/* If the root changed we can signal that */
-		g_signal_emit(G_OBJECT(client), signals[ROOT_CHANGED], 0, priv->root, TRUE);
+/* A layout call has come back.  The updates that came in while
+   it was out were either covered by it, or will all be covered by
+   the one @followup fetch, so all but that one were saved. */
+static void
+layout_absorbed_settle (DbusmenuClientPrivate * priv, gboolean followup)
+{
+	if (priv->layout_absorbed == 0) {
+		return;
 	}
 
-	return 1;
+	priv->layout_fetches_saved += priv->layout_absorbed - (followup ? 1 : 0);
+	priv->layout_absorbed = 0;
+
+	return;
 }
 
 /* When the layout property returns, here's where we take care of that. */
@@ -2359,8 +4343,9 @@ update_layout_cb (GObject * proxy, GAsyncResult * res, gpointer data)
 	GError * error = NULL;
 	GVariant * params = NULL;
 	GVariant * layout = NULL;
+	gboolean updated = FALSE;
 
-	params = g_dbus_proxy_call_finish(G_DBUS_PROXY(proxy), res, &error);
+	params = client_call_finish(proxy, res, &error);
 
 	if (error != NULL) {
 		g_warning("Getting layout failed: %s", error->message);
@@ -2374,41 +4359,268 @@ update_layout_cb (GObject * proxy, GAsyncResult * res, gpointer data)
 
 	layout = g_variant_get_child_value(params, 1);
 
-	guint parseable = parse_layout(client, layout);
+	guint parseable = layout_apply(client, layout, layout_depth(priv));
 
 	if (parseable == 0) {
 		g_warning("Unable to parse layout!");
 		goto out;
 	}
 
+	/* If we were keeping a tree around for the server, it's
+	   been caught up now */
+	if (priv->reconnect_timeout != 0) {
+		g_source_remove(priv->reconnect_timeout);
+		priv->reconnect_timeout = 0;
+	}
+
 	priv->my_revision = rev;
+	if (priv->my_revision >= priv->current_revision) {
+		/* Anything we were told about while waiting is in here */
+		priv->dirty_parent = -1;
+	}
 	/* g_debug("Root is now: 0x%X", (unsigned int)priv->root); */
 	#ifdef MASSIVEDEBUGGING
 	g_debug("Client signaling layout has changed.");
 	#endif 
 	g_signal_emit(G_OBJECT(client), signals[LAYOUT_UPDATED], 0, TRUE);
+	layout_cache_queue(client);
+	updated = TRUE;
+
+out:
+	if (priv->layoutcall != NULL) {
+		g_object_unref(priv->layoutcall);
+		priv->layoutcall = NULL;
+	}
+
+	if (layout != NULL) {
+		g_variant_unref(layout);
+	}
+
+	if (params != NULL) {
+		g_variant_unref(params);
+	}
 
 	/* Check to see if we got another update in the time this
-	   one was issued. */
-	if (priv->my_revision < priv->current_revision) {
-		update_layout(client);
+	   one was issued.  The call has to be cleared first or we'd
+	   think it was still running. */
+	gboolean followup = updated && priv->my_revision < priv->current_revision;
+	layout_absorbed_settle(priv, followup);
+	if (followup) {
+		update_layout_debounced(client);
+	}
+
+	g_object_unref(G_OBJECT(client));
+	return;
+}
+
+/* Handles the response to GetLayoutDelta.  If the server couldn't
+   give us the changes, or we couldn't apply them, we fall back to
+   getting the whole layout. */
+static void
+update_layout_delta_cb (GObject * proxy, GAsyncResult * res, gpointer data)
+{
+	DbusmenuClient * client = DBUSMENU_CLIENT(data);
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+
+	GError * error = NULL;
+	GVariant * params = NULL;
+	gboolean need_full = FALSE;
+
+	params = client_call_finish(proxy, res, &error);
+
+	if (error != NULL) {
+		/* Being cancelled means we've lost the proxy, no reason to
+		   go looking for the full layout then. */
+		if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			need_full = TRUE;
+		}
+		g_error_free(error);
+		goto out;
+	}
+
+	guint rev;
+	GVariant * updates = NULL;
+	g_variant_get(params, "(u@a(iaiav))", &rev, &updates);
+
+	gboolean synced = priv->root != NULL || priv->flat != NULL;
+	if (synced && priv->flat != NULL) {
+		synced = flat_apply_delta(priv->flat, updates);
+	}
+	if (synced && priv->root != NULL) {
+		synced = parse_layout_delta(client, updates);
 	}
 
+	if (!synced) {
+		need_full = TRUE;
+	} else {
+		priv->my_revision = rev;
+		if (priv->my_revision >= priv->current_revision) {
+			priv->dirty_parent = -1;
+		}
+		#ifdef MASSIVEDEBUGGING
+		g_debug("Client signaling layout has changed.");
+		#endif 
+		g_signal_emit(G_OBJECT(client), signals[LAYOUT_UPDATED], 0, TRUE);
+		layout_cache_queue(client);
+	}
+
+	g_variant_unref(updates);
+
 out:
 	if (priv->layoutcall != NULL) {
 		g_object_unref(priv->layoutcall);
 		priv->layoutcall = NULL;
 	}
 
-	if (layout != NULL) {
-		g_variant_unref(layout);
+	if (params != NULL) {
+		g_variant_unref(params);
+	}
+
+	layout_absorbed_settle(priv, need_full || priv->my_revision < priv->current_revision);
+
+	if (need_full) {
+		update_layout_full(client);
+	} else if (priv->my_revision < priv->current_revision) {
+		/* Check to see if we got another update in the time this
+		   one was issued. */
+		update_layout_debounced(client);
+	}
+
+	g_object_unref(G_OBJECT(client));
+	return;
+}
+
+/* Ask the server for only the changes since the revision of the
+   layout that we have */
+static void
+update_layout_delta (DbusmenuClient * client)
+{
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+
+	priv->layoutcall = g_cancellable_new();
+	/* This covers everything */
+	priv->dirty_parent = -1;
+
+	g_object_ref(G_OBJECT(client));
+	client_call(client,
+	            "GetLayoutDelta",
+	            g_variant_new("(u@as)", priv->my_revision, priv->layout_props),
+	            G_DBUS_CALL_FLAGS_NONE,
+	            -1,   /* timeout */
+	            priv->layoutcall, /* cancellable */
+	            update_layout_delta_cb,
+	            client);
+
+	return;
+}
+
+typedef struct _subtree_call_t subtree_call_t;
+struct _subtree_call_t {
+	DbusmenuClient * client;
+	gint parent;
+	gint revision;
+};
+
+/* Handles the layout of a single subtree coming back and
+   reconciles it with the items that we have. */
+static void
+update_layout_subtree_cb (GObject * proxy, GAsyncResult * res, gpointer data)
+{
+	subtree_call_t * call = (subtree_call_t *)data;
+	DbusmenuClient * client = call->client;
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+
+	GError * error = NULL;
+	GVariant * params = NULL;
+	gboolean need_full = FALSE;
+
+	params = client_call_finish(proxy, res, &error);
+
+	if (error != NULL) {
+		if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			g_debug("Unable to get layout for %d: %s", call->parent, error->message);
+			need_full = TRUE;
+		}
+		g_error_free(error);
+		goto out;
+	}
+
+	DbusmenuMenuitem * item = NULL;
+	if (priv->root != NULL) {
+		item = item_index_lookup(priv, call->parent);
+	}
+
+	if (item == NULL) {
+		need_full = TRUE;
+		goto out;
+	}
+
+	GVariant * layout = g_variant_get_child_value(params, 1);
+	parse_layout_apply_props(item, layout);
+	if (parse_layout_xml(client, layout, item, dbusmenu_menuitem_get_parent(item), priv->menuproxy, layout_depth(priv)) == NULL) {
+		need_full = TRUE;
+	}
+	g_variant_unref(layout);
+
+	if (!need_full) {
+		/* The revision in the reply can include changes elsewhere
+		   in the tree that we haven't been told about yet, so we
+		   can only claim the revision that asked for this part. */
+		priv->my_revision = call->revision;
+		#ifdef MASSIVEDEBUGGING
+		g_debug("Client signaling layout has changed.");
+		#endif 
+		g_signal_emit(G_OBJECT(client), signals[LAYOUT_UPDATED], 0, TRUE);
+		layout_cache_queue(client);
+	}
+
+out:
+	if (priv->layoutcall != NULL) {
+		g_object_unref(priv->layoutcall);
+		priv->layoutcall = NULL;
 	}
 
 	if (params != NULL) {
 		g_variant_unref(params);
 	}
 
+	layout_absorbed_settle(priv, need_full || priv->my_revision < priv->current_revision);
+
+	if (need_full) {
+		update_layout_full(client);
+	} else if (priv->my_revision < priv->current_revision) {
+		update_layout_debounced(client);
+	}
+
 	g_object_unref(G_OBJECT(client));
+	g_free(call);
+	return;
+}
+
+/* Get the layout of only the items under @parent */
+static void
+update_layout_subtree (DbusmenuClient * client, DbusmenuMenuitem * parent)
+{
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+
+	subtree_call_t * call = g_new0(subtree_call_t, 1);
+	call->client = client;
+	call->parent = dbusmenu_menuitem_get_id(parent);
+	call->revision = priv->current_revision;
+
+	priv->layoutcall = g_cancellable_new();
+	priv->dirty_parent = -1;
+
+	g_object_ref(G_OBJECT(client));
+	client_call(client,
+	            "GetLayout",
+	            g_variant_new("(ii@as)", call->parent, layout_depth(priv), priv->layout_props),
+	            G_DBUS_CALL_FLAGS_NONE,
+	            -1,   /* timeout */
+	            priv->layoutcall, /* cancellable */
+	            update_layout_subtree_cb,
+	            call);
+
 	return;
 }
 
@@ -2420,42 +4632,190 @@ update_layout (DbusmenuClient * client)
 	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
 	g_return_if_fail(priv->layout_props != NULL);
 
-	if (priv->menuproxy == NULL) {
-		return;
+	/* Whatever we were waiting on, we're getting it now */
+	if (priv->layout_debounce_timeout != 0) {
+		g_source_remove(priv->layout_debounce_timeout);
+		priv->layout_debounce_timeout = 0;
 	}
+	priv->layout_stale_since = 0;
 
-	gchar * name_owner = g_dbus_proxy_get_name_owner(priv->menuproxy);
+	gchar * name_owner = client_name_owner(priv);
 	if (name_owner == NULL) {
 		return;
 	}
 	g_free(name_owner);
 
+	/* It'll get looked at when the call that's out comes back */
 	if (priv->layoutcall != NULL) {
+		priv->layout_absorbed++;
+		return;
+	}
+
+	/* If we've already got a layout, we only need what's changed.
+	   That works for the flat layout and the menuitems alike. */
+	if (priv->layout_delta && (priv->root != NULL || priv->flat != NULL) && priv->my_revision > 0) {
+		update_layout_delta(client);
+		return;
+	}
+
+	/* The flat layout can't take just a subtree, so it's rebuilt
+	   from the whole thing and the menuitems are caught up from that */
+	if (priv->flat != NULL) {
+		update_layout_full(client);
+		return;
+	}
+
+	/* Or if the server told us which part changed, just that part */
+	if (priv->dirty_parent > 0 && priv->root != NULL && priv->my_revision > 0) {
+		DbusmenuMenuitem * parent = item_index_lookup(priv, priv->dirty_parent);
+		if (parent != NULL) {
+			update_layout_subtree(client, parent);
+			return;
+		}
+	}
+
+	update_layout_full(client);
+	return;
+}
+
+/* Timeout for when the server has been quiet long enough, or
+   we've waited as long as we're allowed to */
+static gboolean
+update_layout_debounce_cb (gpointer user_data)
+{
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(user_data);
+	priv->layout_debounce_timeout = 0;
+
+	update_layout(DBUSMENU_CLIENT(user_data));
+
+	return FALSE;
+}
+
+/* We know that we're behind the server, but if it's in the middle
+   of rebuilding things we'd rather wait for it to settle than get
+   the layout for each step along the way. */
+static void
+update_layout_debounced (DbusmenuClient * client)
+{
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+
+	if (priv->layout_debounce == 0) {
+		update_layout(client);
+		return;
+	}
+
+	gint64 now = g_get_monotonic_time();
+	if (priv->layout_stale_since == 0) {
+		priv->layout_stale_since = now;
+	}
+
+	/* Starting over means the one we were waiting on gets
+	   folded into this one */
+	if (priv->layout_debounce_timeout != 0) {
+		g_source_remove(priv->layout_debounce_timeout);
+		priv->layout_debounce_timeout = 0;
+		priv->layout_fetches_saved++;
+	}
+
+	guint wait = priv->layout_debounce;
+
+	if (priv->layout_max_staleness > 0) {
+		gint64 deadline = priv->layout_stale_since + (gint64)priv->layout_max_staleness * 1000;
+		if (now >= deadline) {
+			update_layout(client);
+			return;
+		}
+
+		wait = MIN(wait, (deadline - now) / 1000);
+	}
+
+	priv->layout_debounce_timeout = g_timeout_add(wait, update_layout_debounce_cb, client);
+
+	return;
+}
+
+/* Get the entire layout from the server, which is what we need
+   when we're starting out or we've gotten lost */
+static void
+update_layout_full (DbusmenuClient * client)
+{
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+
+	if ((priv->menuproxy == NULL && priv->lean_owner == NULL) || priv->layoutcall != NULL) {
 		return;
 	}
 
 	priv->layoutcall = g_cancellable_new();
+	priv->dirty_parent = -1;
 
 	GVariantBuilder tupleb;
 	g_variant_builder_init(&tupleb, G_VARIANT_TYPE_TUPLE);
 	
 	g_variant_builder_add_value(&tupleb, g_variant_new_int32(0)); // root
-	g_variant_builder_add_value(&tupleb, g_variant_new_int32(-1)); // recurse
+	g_variant_builder_add_value(&tupleb, g_variant_new_int32(layout_depth(priv))); // recurse
 	g_variant_builder_add_value(&tupleb, priv->layout_props); // props
 
 	GVariant * args = g_variant_builder_end(&tupleb);
 	// g_debug("Args (type: %s): %s", g_variant_get_type_string(args), g_variant_print(args, TRUE));
 
 	g_object_ref(G_OBJECT(client));
-	g_dbus_proxy_call(priv->menuproxy,
-	                  "GetLayout",
-	                  args,
-	                  G_DBUS_CALL_FLAGS_NONE,
-	                  -1,   /* timeout */
-	                  priv->layoutcall, /* cancellable */
-	                  update_layout_cb,
-	                  client);
+	client_call(client,
+	            "GetLayout",
+	            args,
+	            G_DBUS_CALL_FLAGS_NONE,
+	            -1,   /* timeout */
+	            priv->layoutcall, /* cancellable */
+	            update_layout_cb,
+	            client);
+
+	return;
+}
+
+/* The layout of a submenu that we didn't have has come back,
+   put it into place. */
+static void
+fetch_submenu_cb (GObject * proxy, GAsyncResult * res, gpointer data)
+{
+	subtree_call_t * call = (subtree_call_t *)data;
+	DbusmenuClient * client = call->client;
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+
+	GError * error = NULL;
+	GVariant * params = client_call_finish(proxy, res, &error);
+
+	if (error != NULL) {
+		if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			g_warning("Unable to get the submenu for %d: %s", call->parent, error->message);
+		}
+		g_error_free(error);
+		goto out;
+	}
+
+	DbusmenuMenuitem * item = NULL;
+	if (priv->root != NULL && g_hash_table_contains(priv->lazy_items, GINT_TO_POINTER(call->parent))) {
+		item = item_index_lookup(priv, call->parent);
+	}
+
+	/* It's either gone or we got it some other way */
+	if (item != NULL) {
+		GVariant * layout = g_variant_get_child_value(params, 1);
+		parse_layout_apply_props(item, layout);
+		parse_layout_xml(client, layout, item, dbusmenu_menuitem_get_parent(item), priv->menuproxy, LAZY_LAYOUT_DEPTH);
+		g_variant_unref(layout);
+
+		g_signal_emit(G_OBJECT(client), signals[LAYOUT_UPDATED], 0, TRUE);
+		layout_cache_queue(client);
+	}
+
+	g_variant_unref(params);
+
+out:
+	if (priv->lazy_calls != NULL) {
+		g_hash_table_remove(priv->lazy_calls, GINT_TO_POINTER(call->parent));
+	}
 
+	g_object_unref(G_OBJECT(client));
+	g_free(call);
 	return;
 }
 
@@ -2510,6 +4870,14 @@ dbusmenu_client_get_root (DbusmenuClient * client)
 
 	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
 
+	/* With a flat layout the menuitems get built the first time
+	   someone wants them, and are kept up to date after that */
+	if (priv->root == NULL && priv->flat != NULL && priv->flat->ids->len > 0) {
+		GVariant * layout = g_variant_ref_sink(flat_build_layout(priv->flat, 0));
+		parse_layout(client, layout, -1);
+		g_variant_unref(layout);
+	}
+
 	#ifdef MASSIVEDEBUGGING
 	g_debug("Client get root: %p", priv->root);
 	#endif
@@ -2672,3 +5040,384 @@ dbusmenu_client_get_icon_paths (DbusmenuClient * client)
 	return priv->icon_dirs;
 }
 
+/**
+ * dbusmenu_client_set_property_filter:
+ * @client: The #DbusmenuClient to limit the properties on
+ * @properties: (allow-none) (array zero-terminated=1): A %NULL terminated
+ * 	list of property names that the client cares about, or %NULL
+ * 	to get all of them.
+ * 
+ * Limits the properties that are requested from the server for each
+ * menu item to the ones in @properties.  This allows for consumers
+ * that are not going to use some properties, for instance a text only
+ * display that has no need of #DBUSMENU_MENUITEM_PROP_ICON_DATA, to
+ * avoid having them sent over the bus.  The #DBUSMENU_MENUITEM_PROP_TYPE
+ * property is always requested as it is needed to handle the items.
+ * 
+ * The filter is used for all requests made after it is set, so it is
+ * best to set it before the client fetches the layout.
+ */
+void
+dbusmenu_client_set_property_filter (DbusmenuClient * client, const gchar * const * properties)
+{
+	g_return_if_fail(DBUSMENU_IS_CLIENT(client));
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+
+	if (priv->property_filter != NULL) {
+		g_strfreev(priv->property_filter);
+		priv->property_filter = NULL;
+	}
+
+	if (properties != NULL) {
+		GPtrArray * filter = g_ptr_array_new();
+		gboolean has_type = FALSE;
+		gint i;
+
+		for (i = 0; properties[i] != NULL; i++) {
+			if (g_strcmp0(properties[i], DBUSMENU_MENUITEM_PROP_TYPE) == 0) {
+				has_type = TRUE;
+			}
+			g_ptr_array_add(filter, g_strdup(properties[i]));
+		}
+
+		if (!has_type) {
+			g_ptr_array_add(filter, g_strdup(DBUSMENU_MENUITEM_PROP_TYPE));
+		}
+
+		g_ptr_array_add(filter, NULL);
+		priv->property_filter = (GStrv)g_ptr_array_free(filter, FALSE);
+	}
+
+	build_layout_props(priv);
+
+	return;
+}
+
+/**
+ * dbusmenu_client_fetch_submenu:
+ * @client: The #DbusmenuClient that @item came from
+ * @item: The #DbusmenuMenuitem to get the children of
+ * 
+ * When the #DbusmenuClient:lazy-layout property is set the client
+ * only gets the submenus of items as they're needed.  This function
+ * asks for the children of @item if the client doesn't have them
+ * yet.  They are added to @item when the server replies, and
+ * #DbusmenuClient::layout-updated is signaled.  This is done for
+ * you when the menu is about to be shown.
+ */
+void
+dbusmenu_client_fetch_submenu (DbusmenuClient * client, DbusmenuMenuitem * item)
+{
+	g_return_if_fail(DBUSMENU_IS_CLIENT(client));
+	g_return_if_fail(DBUSMENU_IS_MENUITEM(item));
+
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+	gint id = dbusmenu_menuitem_get_id(item);
+
+	/* Already have them */
+	if (!g_hash_table_contains(priv->lazy_items, GINT_TO_POINTER(id))) {
+		return;
+	}
+
+	/* Already asked for them */
+	if (g_hash_table_contains(priv->lazy_calls, GINT_TO_POINTER(id))) {
+		return;
+	}
+
+	if (priv->menuproxy == NULL && priv->lean_owner == NULL) {
+		return;
+	}
+
+	GCancellable * cancel = g_cancellable_new();
+	g_hash_table_insert(priv->lazy_calls, GINT_TO_POINTER(id), cancel);
+
+	subtree_call_t * call = g_new0(subtree_call_t, 1);
+	call->client = client;
+	call->parent = id;
+	call->revision = priv->current_revision;
+
+	g_object_ref(G_OBJECT(client));
+	client_call(client,
+	            "GetLayout",
+	            g_variant_new("(ii@as)", id, LAZY_LAYOUT_DEPTH, priv->layout_props),
+	            G_DBUS_CALL_FLAGS_NONE,
+	            -1,   /* timeout */
+	            cancel, /* cancellable */
+	            fetch_submenu_cb,
+	            call);
+
+	return;
+}
+
+/**
+ * dbusmenu_client_get_intern_stats:
+ * @values: (out) (allow-none): Where to put how many distinct values are being shared
+ * @hits: (out) (allow-none): Where to put how many times a value was shared instead of kept again
+ * @bytes_saved: (out) (allow-none): Where to put how many bytes of values didn't need to be kept
+ *
+ * The values of properties that come from servers are shared by all
+ * the clients in the process, so that things like the same icon on
+ * many items are only kept in memory once.  This reports how well
+ * that is working, which is mostly useful for debugging.  The hits
+ * and bytes are counted from when the process started.
+ */
+void
+dbusmenu_client_get_intern_stats (guint * values, guint * hits, gsize * bytes_saved)
+{
+	G_LOCK(interned);
+
+	if (values != NULL) {
+		*values = interned_values != NULL ? g_hash_table_size(interned_values) : 0;
+	}
+
+	if (hits != NULL) {
+		*hits = interned_hits;
+	}
+
+	if (bytes_saved != NULL) {
+		*bytes_saved = interned_bytes_saved;
+	}
+
+	G_UNLOCK(interned);
+
+	return;
+}
+
+/* Get the flat layout, checking that there's an item at @index */
+static flat_mirror_t *
+flat_get (DbusmenuClient * client, guint index)
+{
+	g_return_val_if_fail(DBUSMENU_IS_CLIENT(client), NULL);
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+	g_return_val_if_fail(priv->flat != NULL, NULL);
+	g_return_val_if_fail(index < priv->flat->ids->len, NULL);
+
+	return priv->flat;
+}
+
+/**
+ * dbusmenu_client_flat_get_length:
+ * @client: A #DbusmenuClient with #DbusmenuClient:flat-layout set
+ *
+ * Gets how many items there are in the flat layout.  Items are
+ * numbered from zero, the root is always zero.  The numbers are
+ * only good until the next #DbusmenuClient::layout-updated signal.
+ *
+ * Return value: The number of items, zero if there isn't a layout yet
+ */
+guint
+dbusmenu_client_flat_get_length (DbusmenuClient * client)
+{
+	g_return_val_if_fail(DBUSMENU_IS_CLIENT(client), 0);
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+	g_return_val_if_fail(priv->flat != NULL, 0);
+
+	return priv->flat->ids->len;
+}
+
+/**
+ * dbusmenu_client_flat_lookup:
+ * @client: A #DbusmenuClient with #DbusmenuClient:flat-layout set
+ * @id: ID of the menu item on the server
+ *
+ * Finds where the item with @id is in the flat layout.
+ *
+ * Return value: The index of the item or -1 if there isn't one
+ */
+gint
+dbusmenu_client_flat_lookup (DbusmenuClient * client, gint id)
+{
+	g_return_val_if_fail(DBUSMENU_IS_CLIENT(client), -1);
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+	g_return_val_if_fail(priv->flat != NULL, -1);
+
+	return GPOINTER_TO_INT(g_hash_table_lookup(priv->flat->id_index, GINT_TO_POINTER(id))) - 1;
+}
+
+/**
+ * dbusmenu_client_flat_get_id:
+ * @client: A #DbusmenuClient with #DbusmenuClient:flat-layout set
+ * @index: Index of the item in the flat layout
+ *
+ * Gets the ID the server uses for the item, which is what
+ * dbusmenu_client_send_event() and friends need.
+ *
+ * Return value: The ID of the item or -1 if @index is out of range
+ */
+gint
+dbusmenu_client_flat_get_id (DbusmenuClient * client, guint index)
+{
+	flat_mirror_t * flat = flat_get(client, index);
+	g_return_val_if_fail(flat != NULL, -1);
+
+	return g_array_index(flat->ids, gint, index);
+}
+
+/**
+ * dbusmenu_client_flat_get_parent:
+ * @client: A #DbusmenuClient with #DbusmenuClient:flat-layout set
+ * @index: Index of the item in the flat layout
+ *
+ * Gets the index of the item that @index is a child of.
+ *
+ * Return value: The index of the parent or -1 for the root
+ */
+gint
+dbusmenu_client_flat_get_parent (DbusmenuClient * client, guint index)
+{
+	flat_mirror_t * flat = flat_get(client, index);
+	g_return_val_if_fail(flat != NULL, -1);
+
+	return g_array_index(flat->parents, gint, index);
+}
+
+/**
+ * dbusmenu_client_flat_get_property:
+ * @client: A #DbusmenuClient with #DbusmenuClient:flat-layout set
+ * @index: Index of the item in the flat layout
+ * @property: Name of the property to get
+ *
+ * Gets the value of a property on an item in the flat layout.
+ * Properties that the server didn't set, because they have the
+ * default value, aren't there.
+ *
+ * Return value: (transfer none): The value or %NULL if it's not set
+ */
+GVariant *
+dbusmenu_client_flat_get_property (DbusmenuClient * client, guint index, const gchar * property)
+{
+	flat_mirror_t * flat = flat_get(client, index);
+	g_return_val_if_fail(flat != NULL, NULL);
+	g_return_val_if_fail(property != NULL, NULL);
+
+	/* If there's no quark nobody has set it */
+	GQuark quark = g_quark_try_string(property);
+	if (quark == 0) {
+		return NULL;
+	}
+
+	guint start = g_array_index(flat->prop_start, guint, index);
+	guint count = g_array_index(flat->prop_count, guint, index);
+	guint i;
+	for (i = start; i < start + count; i++) {
+		if (g_array_index(flat->prop_names, GQuark, i) == quark) {
+			return g_ptr_array_index(flat->prop_values, i);
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * dbusmenu_client_flat_find:
+ * @client: A #DbusmenuClient with #DbusmenuClient:flat-layout set
+ * @property: Name of the property to look at
+ * @value: (allow-none): Value the property should have
+ *
+ * Finds all the items where @property is set to @value, or that
+ * have @property set at all if @value is %NULL.  The items are in
+ * the order of the flat layout, which has the items nearer to the
+ * root first.
+ *
+ * Return value: (transfer full) (element-type guint): The indexes of the items that match
+ */
+GArray *
+dbusmenu_client_flat_find (DbusmenuClient * client, const gchar * property, GVariant * value)
+{
+	g_return_val_if_fail(DBUSMENU_IS_CLIENT(client), NULL);
+	g_return_val_if_fail(property != NULL, NULL);
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+	g_return_val_if_fail(priv->flat != NULL, NULL);
+
+	flat_mirror_t * flat = priv->flat;
+	GArray * found = g_array_new(FALSE, FALSE, sizeof(guint));
+	GQuark quark = g_quark_try_string(property);
+
+	if (value != NULL) {
+		g_variant_ref_sink(value);
+	}
+
+	guint index;
+	for (index = 0; quark != 0 && index < flat->ids->len; index++) {
+		guint start = g_array_index(flat->prop_start, guint, index);
+		guint count = g_array_index(flat->prop_count, guint, index);
+		guint i;
+
+		for (i = start; i < start + count; i++) {
+			if (g_array_index(flat->prop_names, GQuark, i) != quark) {
+				continue;
+			}
+
+			if (value == NULL || g_variant_equal(value, g_ptr_array_index(flat->prop_values, i))) {
+				g_array_append_val(found, index);
+			}
+			break;
+		}
+	}
+
+	if (value != NULL) {
+		g_variant_unref(value);
+	}
+
+	return found;
+}
+
+/**
+ * dbusmenu_client_flat_iter_init:
+ * @iter: A #DbusmenuClientFlatIter to set up
+ * @client: A #DbusmenuClient with #DbusmenuClient:flat-layout set
+ * @parent: Index of the item whose children to go through, or -1
+ *    for every item in the layout
+ *
+ * Sets up @iter to go through the children of @parent with
+ * dbusmenu_client_flat_iter_next().  The iterator doesn't need
+ * to be freed, but isn't good after the layout changes.
+ */
+void
+dbusmenu_client_flat_iter_init (DbusmenuClientFlatIter * iter, DbusmenuClient * client, gint parent)
+{
+	g_return_if_fail(iter != NULL);
+
+	iter->client = client;
+	iter->next = 0;
+	iter->end = 0;
+
+	if (parent < 0) {
+		iter->end = dbusmenu_client_flat_get_length(client);
+		return;
+	}
+
+	flat_mirror_t * flat = flat_get(client, parent);
+	g_return_if_fail(flat != NULL);
+
+	iter->next = g_array_index(flat->child_start, guint, parent);
+	iter->end = iter->next + g_array_index(flat->child_count, guint, parent);
+
+	return;
+}
+
+/**
+ * dbusmenu_client_flat_iter_next:
+ * @iter: A #DbusmenuClientFlatIter from dbusmenu_client_flat_iter_init()
+ * @index: (out): Where to put the index of the next item
+ *
+ * Moves @iter on to the next item.
+ *
+ * Return value: %FALSE when there are no more items
+ */
+gboolean
+dbusmenu_client_flat_iter_next (DbusmenuClientFlatIter * iter, guint * index)
+{
+	g_return_val_if_fail(iter != NULL, FALSE);
+
+	if (iter->next >= iter->end) {
+		return FALSE;
+	}
+
+	if (index != NULL) {
+		*index = iter->next;
+	}
+	iter->next++;
+
+	return TRUE;
+}
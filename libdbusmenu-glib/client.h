@@ -80,6 +80,12 @@ G_BEGIN_DECLS
  * String to attach to signal #DbusmenuClient::icon-theme-dirs-changed
  */
 #define DBUSMENU_CLIENT_SIGNAL_ICON_THEME_DIRS_CHANGED    "icon-theme-dirs-changed"
+/**
+ * DBUSMENU_CLIENT_SIGNAL_ITEMS_PROPERTIES_CHANGED:
+ *
+ * String to attach to signal #DbusmenuClient::items-properties-changed
+ */
+#define DBUSMENU_CLIENT_SIGNAL_ITEMS_PROPERTIES_CHANGED    "items-properties-changed"
 
 /**
  * DBUSMENU_CLIENT_PROP_DBUS_NAME:
@@ -111,6 +117,60 @@ G_BEGIN_DECLS
  * String to access property #DbusmenuClient:group-events
  */
 #define DBUSMENU_CLIENT_PROP_GROUP_EVENTS "group-events"
+/**
+ * DBUSMENU_CLIENT_PROP_LAZY_LAYOUT:
+ *
+ * String to access property #DbusmenuClient:lazy-layout
+ */
+#define DBUSMENU_CLIENT_PROP_LAZY_LAYOUT  "lazy-layout"
+/**
+ * DBUSMENU_CLIENT_PROP_CACHE_LAYOUT:
+ *
+ * String to access property #DbusmenuClient:cache-layout
+ */
+#define DBUSMENU_CLIENT_PROP_CACHE_LAYOUT  "cache-layout"
+/**
+ * DBUSMENU_CLIENT_PROP_LAYOUT_DEBOUNCE:
+ *
+ * String to access property #DbusmenuClient:layout-debounce
+ */
+#define DBUSMENU_CLIENT_PROP_LAYOUT_DEBOUNCE  "layout-debounce"
+/**
+ * DBUSMENU_CLIENT_PROP_LAYOUT_MAX_STALENESS:
+ *
+ * String to access property #DbusmenuClient:layout-max-staleness
+ */
+#define DBUSMENU_CLIENT_PROP_LAYOUT_MAX_STALENESS  "layout-max-staleness"
+/**
+ * DBUSMENU_CLIENT_PROP_LAYOUT_FETCHES_SAVED:
+ *
+ * String to access property #DbusmenuClient:layout-fetches-saved
+ */
+#define DBUSMENU_CLIENT_PROP_LAYOUT_FETCHES_SAVED  "layout-fetches-saved"
+/**
+ * DBUSMENU_CLIENT_PROP_SHARED_CONNECTION:
+ *
+ * String to access property #DbusmenuClient:shared-connection
+ */
+#define DBUSMENU_CLIENT_PROP_SHARED_CONNECTION  "shared-connection"
+/**
+ * DBUSMENU_CLIENT_PROP_LEAN_TRANSPORT:
+ *
+ * String to access property #DbusmenuClient:lean-transport
+ */
+#define DBUSMENU_CLIENT_PROP_LEAN_TRANSPORT  "lean-transport"
+/**
+ * DBUSMENU_CLIENT_PROP_RECONNECT_GRACE:
+ *
+ * String to access property #DbusmenuClient:reconnect-grace
+ */
+#define DBUSMENU_CLIENT_PROP_RECONNECT_GRACE  "reconnect-grace"
+/**
+ * DBUSMENU_CLIENT_PROP_FLAT_LAYOUT:
+ *
+ * String to access property #DbusmenuClient:flat-layout
+ */
+#define DBUSMENU_CLIENT_PROP_FLAT_LAYOUT  "flat-layout"
 
 /**
  * DBUSMENU_CLIENT_TYPES_DEFAULT:
@@ -146,7 +206,7 @@ typedef struct _DbusmenuClientPrivate DbusmenuClientPrivate;
 	@item_activate: Slot for #DbusmenuClient::item-activate.
 	@event_result: Slot for #DbusmenuClient::event-error.
 	@icon_theme_dirs: Slot for #DbusmenuClient::icon-theme-dirs-changed.
-	@reserved1: Reserved for future use.
+	@items_properties_changed: Slot for #DbusmenuClient::items-properties-changed.
 	@reserved2: Reserved for future use.
 	@reserved3: Reserved for future use.
 	@reserved4: Reserved for future use.
@@ -166,9 +226,9 @@ struct _DbusmenuClientClass {
 	void (*item_activate) (DbusmenuMenuitem * item, guint timestamp);
 	void (*event_result) (DbusmenuMenuitem * item, gchar * event, GVariant * data, guint timestamp, GError * error);
 	void (*icon_theme_dirs) (DbusmenuMenuitem * item, gpointer theme_dirs, GError * error);
+	void (*items_properties_changed) (GHashTable * changes);
 
 	/*< Private >*/
-	void (*reserved1) (void);
 	void (*reserved2) (void);
 	void (*reserved3) (void);
 	void (*reserved4) (void);
@@ -205,6 +265,21 @@ struct _DbusmenuClient {
 */
 typedef gboolean (*DbusmenuClientTypeHandler) (DbusmenuMenuitem * newitem, DbusmenuMenuitem * parent, DbusmenuClient * client, gpointer user_data);
 
+/**
+	DbusmenuClientFlatIter:
+
+	Goes through the items of a flat layout, see
+	dbusmenu_client_flat_iter_init().  It can be kept on the stack
+	and doesn't need to be freed.
+*/
+typedef struct _DbusmenuClientFlatIter DbusmenuClientFlatIter;
+struct _DbusmenuClientFlatIter {
+	/*< private >*/
+	DbusmenuClient * client;
+	guint next;
+	guint end;
+};
+
 GType                dbusmenu_client_get_type          (void);
 DbusmenuClient *     dbusmenu_client_new               (const gchar * name,
                                                         const gchar * object);
@@ -220,6 +295,31 @@ gboolean             dbusmenu_client_add_type_handler_full (DbusmenuClient * cli
 DbusmenuTextDirection dbusmenu_client_get_text_direction (DbusmenuClient * client);
 DbusmenuStatus       dbusmenu_client_get_status        (DbusmenuClient * client);
 GStrv                dbusmenu_client_get_icon_paths    (DbusmenuClient * client);
+void                 dbusmenu_client_set_property_filter (DbusmenuClient * client,
+                                                        const gchar * const * properties);
+void                 dbusmenu_client_fetch_submenu     (DbusmenuClient * client,
+                                                        DbusmenuMenuitem * item);
+void                 dbusmenu_client_get_intern_stats  (guint * values,
+                                                        guint * hits,
+                                                        gsize * bytes_saved);
+guint                dbusmenu_client_flat_get_length   (DbusmenuClient * client);
+gint                 dbusmenu_client_flat_lookup       (DbusmenuClient * client,
+                                                        gint id);
+gint                 dbusmenu_client_flat_get_id       (DbusmenuClient * client,
+                                                        guint index);
+gint                 dbusmenu_client_flat_get_parent   (DbusmenuClient * client,
+                                                        guint index);
+GVariant *           dbusmenu_client_flat_get_property (DbusmenuClient * client,
+                                                        guint index,
+                                                        const gchar * property);
+GArray *             dbusmenu_client_flat_find         (DbusmenuClient * client,
+                                                        const gchar * property,
+                                                        GVariant * value);
+void                 dbusmenu_client_flat_iter_init    (DbusmenuClientFlatIter * iter,
+                                                        DbusmenuClient * client,
+                                                        gint parent);
+gboolean             dbusmenu_client_flat_iter_next    (DbusmenuClientFlatIter * iter,
+                                                        guint * index);
 
 /**
 	SECTION:client
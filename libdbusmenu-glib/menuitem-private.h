@@ -33,12 +33,29 @@ License version 3 and version 2.1 along with this program.  If not, see
 
 G_BEGIN_DECLS
 
+/* Something that owns a menuitem, like a server, and wants to know
+   about every change to it.  This saves a pile of signal handlers
+   on each item, and the signals aren't emitted at all if no one
+   else is listening to them. */
+typedef struct _DbusmenuMenuitemObserver DbusmenuMenuitemObserver;
+struct _DbusmenuMenuitemObserver {
+	void (*property_changed) (DbusmenuMenuitem * mi, const gchar * property, GVariant * value, gpointer data);
+	void (*properties_changed) (DbusmenuMenuitem * mi, GVariant * changed, GStrv removed, gpointer data);
+	void (*child_added) (DbusmenuMenuitem * mi, DbusmenuMenuitem * child, guint position, gpointer data);
+	void (*child_removed) (DbusmenuMenuitem * mi, DbusmenuMenuitem * child, gpointer data);
+	void (*child_moved) (DbusmenuMenuitem * mi, DbusmenuMenuitem * child, guint newpos, guint oldpos, gpointer data);
+	void (*show_to_user) (DbusmenuMenuitem * mi, guint timestamp, gpointer data);
+};
+
 GVariant * dbusmenu_menuitem_build_variant (DbusmenuMenuitem * mi, const gchar ** properties, gint recurse);
 gboolean dbusmenu_menuitem_realized (DbusmenuMenuitem * mi);
 void dbusmenu_menuitem_set_realized (DbusmenuMenuitem * mi);
 GVariant * dbusmenu_menuitem_properties_variant (DbusmenuMenuitem * mi, const gchar ** properties);
 gboolean dbusmenu_menuitem_property_is_default (DbusmenuMenuitem * mi, const gchar * property);
 gboolean dbusmenu_menuitem_exposed (DbusmenuMenuitem * mi);
+gboolean dbusmenu_menuitem_in_property_batch (DbusmenuMenuitem * mi);
+void dbusmenu_menuitem_set_observer (DbusmenuMenuitem * mi, const DbusmenuMenuitemObserver * observer, gpointer data);
+void dbusmenu_menuitem_clear_observer (DbusmenuMenuitem * mi, gpointer data);
 
 G_END_DECLS
 
@@ -31,10 +31,12 @@ License version 3 and version 2.1 along with this program.  If not, see
 #endif
 
 #include "menuitem-proxy.h"
+#include "menuitem-private.h"
 
 struct _DbusmenuMenuitemProxyPrivate {
 	DbusmenuMenuitem * mi;
 	gulong sig_property_changed;
+	gulong sig_properties_changed;
 	gulong sig_child_added;
 	gulong sig_child_removed;
 	gulong sig_child_moved;
@@ -97,6 +99,7 @@ dbusmenu_menuitem_proxy_init (DbusmenuMenuitemProxy *self)
 	priv->mi = NULL;
 
 	priv->sig_property_changed = 0;
+	priv->sig_properties_changed = 0;
 	priv->sig_child_added = 0;
 	priv->sig_child_removed = 0;
 	priv->sig_child_moved = 0;
@@ -175,11 +178,48 @@ handle_event (DbusmenuMenuitem * mi, const gchar * name, GVariant * variant, gui
 static void
 proxy_item_property_changed (DbusmenuMenuitem * mi, gchar * property, GVariant * variant, gpointer user_data)
 {
+	/* Comes as a set in proxy_item_properties_changed */
+	if (dbusmenu_menuitem_in_property_batch(mi)) {
+		return;
+	}
+
 	DbusmenuMenuitemProxy * pmi = DBUSMENU_MENUITEM_PROXY(user_data);
 	dbusmenu_menuitem_property_set_variant(DBUSMENU_MENUITEM(pmi), property, variant);
 	return;
 }
 
+/* Copies a whole set of property changes over in one go so that
+   whoever is watching us gets them as a set as well. */
+static void
+proxy_item_properties_changed (DbusmenuMenuitem * mi, GVariant * changed, GStrv removed, gpointer user_data)
+{
+	DbusmenuMenuitemProxy * pmi = DBUSMENU_MENUITEM_PROXY(user_data);
+	guint nchanged = g_variant_n_children(changed);
+	guint nremoved = (removed != NULL) ? g_strv_length(removed) : 0;
+	const gchar ** names = g_new(const gchar *, nchanged + nremoved);
+	GVariant ** values = g_new(GVariant *, nchanged + nremoved);
+	guint i;
+
+	for (i = 0; i < nchanged; i++) {
+		g_variant_get_child(changed, i, "{&sv}", &names[i], &values[i]);
+	}
+
+	for (i = 0; i < nremoved; i++) {
+		names[nchanged + i] = removed[i];
+		values[nchanged + i] = NULL;
+	}
+
+	dbusmenu_menuitem_properties_set_manyv(DBUSMENU_MENUITEM(pmi), nchanged + nremoved, names, values);
+
+	for (i = 0; i < nchanged; i++) {
+		g_variant_unref(values[i]);
+	}
+	g_free(values);
+	g_free(names);
+
+	return;
+}
+
 /* Looks for a child getting added and wraps it and places it
    in our list of children. */
 static void
@@ -265,18 +305,17 @@ add_menuitem (DbusmenuMenuitemProxy * pmi, DbusmenuMenuitem * mi)
 
 	/* Attach signals */
 	priv->sig_property_changed = g_signal_connect(G_OBJECT(priv->mi), DBUSMENU_MENUITEM_SIGNAL_PROPERTY_CHANGED, G_CALLBACK(proxy_item_property_changed), pmi);
+	priv->sig_properties_changed = g_signal_connect(G_OBJECT(priv->mi), DBUSMENU_MENUITEM_SIGNAL_PROPERTIES_CHANGED, G_CALLBACK(proxy_item_properties_changed), pmi);
 	priv->sig_child_added =      g_signal_connect(G_OBJECT(priv->mi), DBUSMENU_MENUITEM_SIGNAL_CHILD_ADDED,      G_CALLBACK(proxy_item_child_added),      pmi);
 	priv->sig_child_removed =    g_signal_connect(G_OBJECT(priv->mi), DBUSMENU_MENUITEM_SIGNAL_CHILD_REMOVED,    G_CALLBACK(proxy_item_child_removed),    pmi);
 	priv->sig_child_moved =      g_signal_connect(G_OBJECT(priv->mi), DBUSMENU_MENUITEM_SIGNAL_CHILD_MOVED,      G_CALLBACK(proxy_item_child_moved),      pmi);
 
 	/* Grab (cache) Properties */
-	GList * props = dbusmenu_menuitem_properties_list(priv->mi);
-	GList * prop;
-	for (prop = props; prop != NULL; prop = g_list_next(prop)) {
-		gchar * prop_name = (gchar *)prop->data;
-		dbusmenu_menuitem_property_set_variant(DBUSMENU_MENUITEM(pmi), prop_name, dbusmenu_menuitem_property_get_variant(priv->mi, prop_name));
+	GVariant * props = dbusmenu_menuitem_properties_variant(priv->mi, NULL);
+	if (props != NULL) {
+		dbusmenu_menuitem_properties_set_many(DBUSMENU_MENUITEM(pmi), props);
+		g_variant_unref(props);
 	}
-	g_list_free(props);
 
 	/* Go through children and wrap them */
 	GList * children = dbusmenu_menuitem_get_children(priv->mi);
@@ -304,6 +343,9 @@ remove_menuitem (DbusmenuMenuitemProxy * pmi)
 	if (priv->sig_property_changed != 0) {
 		g_signal_handler_disconnect(G_OBJECT(priv->mi), priv->sig_property_changed);
 	}
+	if (priv->sig_properties_changed != 0) {
+		g_signal_handler_disconnect(G_OBJECT(priv->mi), priv->sig_properties_changed);
+	}
 	if (priv->sig_child_added != 0) {
 		g_signal_handler_disconnect(G_OBJECT(priv->mi), priv->sig_child_added);
 	}
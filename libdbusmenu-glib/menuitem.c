@@ -27,6 +27,7 @@ License version 3 and version 2.1 along with this program.  If not, see
 */
 
 #include <stdlib.h>
+#include <string.h>
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
@@ -40,14 +41,76 @@ License version 3 and version 2.1 along with this program.  If not, see
 #define ID(x)     dbusmenu_menuitem_get_id(DBUSMENU_MENUITEM(x))
 #endif
 
+/* Most items only carry a handful of properties, so they're kept
+   in a small array and only moved into a hash table once there are
+   more than this many of them. */
+#define PROPS_ARRAY_MAX  8
+
+typedef struct _prop_entry_t prop_entry_t;
+struct _prop_entry_t {
+	const gchar * name; /* one of prop_names or our own copy */
+	GVariant * value;
+};
+
+/* Someone watching an item through a #DbusmenuMenuitemObserver */
+typedef struct _observer_t observer_t;
+struct _observer_t {
+	const DbusmenuMenuitemObserver * observer;
+	gpointer data;
+};
+
+/* The names that nearly every item has.  These are shared by all
+   the items instead of each one keeping a copy.  Names that aren't
+   in here are copied, names from a server can be anything and
+   shouldn't stay around after the item is gone. */
+static const gchar * const prop_names[] = {
+	DBUSMENU_MENUITEM_PROP_TYPE,
+	DBUSMENU_MENUITEM_PROP_VISIBLE,
+	DBUSMENU_MENUITEM_PROP_ENABLED,
+	DBUSMENU_MENUITEM_PROP_LABEL,
+	DBUSMENU_MENUITEM_PROP_ICON_NAME,
+	DBUSMENU_MENUITEM_PROP_ICON_DATA,
+	DBUSMENU_MENUITEM_PROP_ACCESSIBLE_DESC,
+	DBUSMENU_MENUITEM_PROP_TOGGLE_TYPE,
+	DBUSMENU_MENUITEM_PROP_TOGGLE_STATE,
+	DBUSMENU_MENUITEM_PROP_SHORTCUT,
+	DBUSMENU_MENUITEM_PROP_CHILD_DISPLAY,
+	DBUSMENU_MENUITEM_PROP_DISPOSITION
+};
+
 /* Private */
 /**
 	DbusmenuMenuitemPrivate:
 	@id: The ID of this menu item
 	@children: A list of #DbusmenuMenuitem objects that are
 	      children to this one.
-	@properties: All of the properties on this menu item.
+	@child_array: The same children as @children in an array,
+	      created when the first child is added.
+	@position: Where this item is in its parent's @child_array.
+	@link: This item's entry in its parent's @children.
+	@realized_children: How many of the children are realized.
+	@props: The properties on this menu item, in the order they
+	      were set, while there are only a few of them.
+	@props_len: The number of entries used in @props.
+	@props_alloc: The number of entries allocated for @props.
+	@props_table: All of the properties on this menu item once
+	      there are too many for @props.
 	@root: Whether this node is the root node
+	@props_variant: The properties built into an "a{sv}" the last
+	      time someone asked, cleared when a property changes.
+	@layout_variant: The last layout built for this item and its
+	      children, cleared when anything below it changes.
+	@layout_key: The properties that @layout_variant was built
+	      with, joined into one string.
+	@layout_recurse: The recursion depth @layout_variant was
+	      built with.
+	@in_batch: Set while the single property signals for a call
+	      to dbusmenu_menuitem_properties_set_manyv() are emitted.
+	@observer: Called directly for changes to this item, see
+	      #DbusmenuMenuitemObserver.  Nearly every item is only in
+	      one server so the first one is kept here.
+	@observers: Any more observers after @observer, NULL when
+	      there aren't any.
 
 	These are the little secrets that we don't want getting
 	out of data that we have.  They can still be gotten using
@@ -57,17 +120,32 @@ struct _DbusmenuMenuitemPrivate
 {
 	gint id;
 	GList * children;
-	GHashTable * properties;
+	GPtrArray * child_array;
+	guint position;
+	GList * link;
+	guint realized_children;
+	prop_entry_t * props;
+	guint8 props_len;
+	guint8 props_alloc;
+	GHashTable * props_table;
 	gboolean root;
 	gboolean realized;
 	DbusmenuDefaults * defaults;
 	gboolean exposed;
 	DbusmenuMenuitem * parent;
+	GVariant * props_variant;
+	GVariant * layout_variant;
+	gchar * layout_key;
+	gint layout_recurse;
+	gboolean in_batch;
+	observer_t observer;
+	GArray * observers;
 };
 
 /* Signals */
 enum {
 	PROPERTY_CHANGED,
+	PROPERTIES_CHANGED,
 	ITEM_ACTIVATED,
 	CHILD_ADDED,
 	CHILD_REMOVED,
@@ -102,6 +180,7 @@ static void g_value_transform_STRING_BOOLEAN (const GValue * in, GValue * out);
 static void g_value_transform_STRING_INT (const GValue * in, GValue * out);
 static void handle_event (DbusmenuMenuitem * mi, const gchar * name, GVariant * variant, guint timestamp);
 static void send_about_to_show (DbusmenuMenuitem * mi, void (*cb) (DbusmenuMenuitem * mi, gpointer user_data), gpointer cb_data);
+static void layout_variant_invalidate (DbusmenuMenuitem * mi);
 
 /* GObject stuff */
 G_DEFINE_TYPE (DbusmenuMenuitem, dbusmenu_menuitem, G_TYPE_OBJECT);
@@ -137,6 +216,25 @@ dbusmenu_menuitem_class_init (DbusmenuMenuitemClass *klass)
 	                                           NULL, NULL,
 	                                           _dbusmenu_menuitem_marshal_VOID__STRING_VARIANT,
 	                                           G_TYPE_NONE, 2, G_TYPE_STRING, G_TYPE_VARIANT);
+	/**
+		DbusmenuMenuitem::properties-changed:
+		@arg0: The #DbusmenuMenuitem object.
+		@arg1: A dictionary of the properties that were set
+		@arg2: The names of the properties that were removed
+
+		Emitted once for each call to
+		dbusmenu_menuitem_properties_set_many() or
+		dbusmenu_menuitem_properties_set_manyv() that changed
+		something.  #DbusmenuMenuitem::property-changed is still
+		emitted for each property before this.
+	*/
+	signals[PROPERTIES_CHANGED] = g_signal_new(DBUSMENU_MENUITEM_SIGNAL_PROPERTIES_CHANGED,
+	                                           G_TYPE_FROM_CLASS(klass),
+	                                           G_SIGNAL_RUN_LAST,
+	                                           G_STRUCT_OFFSET(DbusmenuMenuitemClass, properties_changed),
+	                                           NULL, NULL,
+	                                           _dbusmenu_menuitem_marshal_VOID__VARIANT_BOXED,
+	                                           G_TYPE_NONE, 2, G_TYPE_VARIANT, G_TYPE_STRV);
 	/**
 		DbusmenuMenuitem::item-activated:
 		@arg0: The #DbusmenuMenuitem object.
@@ -318,8 +416,203 @@ _g_variant_unref (gpointer data)
 	return;
 }
 
-/* Initialize the values of the in the object, and build the
-   properties hash table. */
+/* A name to keep for @property, the shared one if it's in
+   prop_names and otherwise a copy */
+static const gchar *
+prop_name_new (const gchar * property)
+{
+	guint i;
+	for (i = 0; i < G_N_ELEMENTS(prop_names); i++) {
+		if (prop_names[i] == property || strcmp(prop_names[i], property) == 0) {
+			return prop_names[i];
+		}
+	}
+
+	return g_strdup(property);
+}
+
+/* Frees a name from prop_name_new() unless it's a shared one */
+static void
+prop_name_free (gpointer name)
+{
+	guint i;
+	for (i = 0; i < G_N_ELEMENTS(prop_names); i++) {
+		if (prop_names[i] == name) {
+			return;
+		}
+	}
+
+	g_free(name);
+	return;
+}
+
+/* Finds the entry for @property in the array.  Names from
+   prop_names often match on the pointer, anything else gets
+   compared. */
+static prop_entry_t *
+props_find (DbusmenuMenuitemPrivate * priv, const gchar * property)
+{
+	guint i;
+
+	for (i = 0; i < priv->props_len; i++) {
+		if (priv->props[i].name == property) {
+			return &priv->props[i];
+		}
+	}
+
+	for (i = 0; i < priv->props_len; i++) {
+		if (strcmp(priv->props[i].name, property) == 0) {
+			return &priv->props[i];
+		}
+	}
+
+	return NULL;
+}
+
+/* Gets the value stored for @property, or NULL */
+static GVariant *
+props_lookup (DbusmenuMenuitemPrivate * priv, const gchar * property)
+{
+	if (priv->props_table != NULL) {
+		return (GVariant *)g_hash_table_lookup(priv->props_table, property);
+	}
+
+	prop_entry_t * entry = props_find(priv, property);
+	return (entry != NULL) ? entry->value : NULL;
+}
+
+/* Stores @value for @property, taking the reference on @value and
+   unreffing any value that was there before */
+static void
+props_insert (DbusmenuMenuitemPrivate * priv, const gchar * property, GVariant * value)
+{
+	if (priv->props_table == NULL) {
+		prop_entry_t * entry = props_find(priv, property);
+
+		if (entry != NULL) {
+			GVariant * old = entry->value;
+			entry->value = value;
+			g_variant_unref(old);
+			return;
+		}
+
+		if (priv->props_len < PROPS_ARRAY_MAX) {
+			if (priv->props_len == priv->props_alloc) {
+				priv->props_alloc = MAX(2, priv->props_alloc * 2);
+				priv->props = g_renew(prop_entry_t, priv->props, priv->props_alloc);
+			}
+
+			priv->props[priv->props_len].name = prop_name_new(property);
+			priv->props[priv->props_len].value = value;
+			priv->props_len++;
+			return;
+		}
+
+		/* That's a lot of properties, move them into a table */
+		priv->props_table = g_hash_table_new_full(g_str_hash, g_str_equal, prop_name_free, _g_variant_unref);
+
+		guint i;
+		for (i = 0; i < priv->props_len; i++) {
+			g_hash_table_insert(priv->props_table, (gpointer)priv->props[i].name, priv->props[i].value);
+		}
+
+		g_free(priv->props);
+		priv->props = NULL;
+		priv->props_len = 0;
+		priv->props_alloc = 0;
+	}
+
+	/* If it's already there the table frees the new name */
+	g_hash_table_insert(priv->props_table, (gpointer)prop_name_new(property), value);
+	return;
+}
+
+/* Takes @property out without unreffing the value, which is
+   returned so the caller can do that when it's done with it */
+static GVariant *
+props_steal (DbusmenuMenuitemPrivate * priv, const gchar * property)
+{
+	if (priv->props_table != NULL) {
+		gpointer key = NULL;
+		gpointer value = NULL;
+
+		if (!g_hash_table_lookup_extended(priv->props_table, property, &key, &value)) {
+			return NULL;
+		}
+
+		g_hash_table_steal(priv->props_table, property);
+		prop_name_free(key);
+		return (GVariant *)value;
+	}
+
+	prop_entry_t * entry = props_find(priv, property);
+	if (entry == NULL) {
+		return NULL;
+	}
+
+	GVariant * value = entry->value;
+	prop_name_free((gpointer)entry->name);
+
+	/* Keep the rest in the order they were set */
+	guint pos = entry - priv->props;
+	memmove(entry, entry + 1, (priv->props_len - pos - 1) * sizeof(prop_entry_t));
+	priv->props_len--;
+
+	return value;
+}
+
+/* How many properties are set */
+static guint
+props_size (DbusmenuMenuitemPrivate * priv)
+{
+	if (priv->props_table != NULL) {
+		return g_hash_table_size(priv->props_table);
+	}
+
+	return priv->props_len;
+}
+
+/* Calls @func with the name and value of each property */
+static void
+props_foreach (DbusmenuMenuitemPrivate * priv, GHFunc func, gpointer user_data)
+{
+	if (priv->props_table != NULL) {
+		g_hash_table_foreach(priv->props_table, func, user_data);
+		return;
+	}
+
+	guint i;
+	for (i = 0; i < priv->props_len; i++) {
+		func((gpointer)priv->props[i].name, priv->props[i].value, user_data);
+	}
+
+	return;
+}
+
+/* Drops all the properties */
+static void
+props_free (DbusmenuMenuitemPrivate * priv)
+{
+	if (priv->props_table != NULL) {
+		g_hash_table_destroy(priv->props_table);
+		priv->props_table = NULL;
+	}
+
+	guint i;
+	for (i = 0; i < priv->props_len; i++) {
+		prop_name_free((gpointer)priv->props[i].name);
+		g_variant_unref(priv->props[i].value);
+	}
+
+	g_free(priv->props);
+	priv->props = NULL;
+	priv->props_len = 0;
+	priv->props_alloc = 0;
+
+	return;
+}
+
+/* Initialize the values of the in the object. */
 static void
 dbusmenu_menuitem_init (DbusmenuMenuitem *self)
 {
@@ -329,14 +622,29 @@ dbusmenu_menuitem_init (DbusmenuMenuitem *self)
 
 	priv->id = -1; 
 	priv->children = NULL;
+	priv->child_array = NULL;
+	priv->position = 0;
+	priv->link = NULL;
+	priv->realized_children = 0;
 
-	priv->properties = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, _g_variant_unref);
+	priv->props = NULL;
+	priv->props_len = 0;
+	priv->props_alloc = 0;
+	priv->props_table = NULL;
 
 	priv->root = FALSE;
 	priv->realized = FALSE;
 
 	priv->defaults = dbusmenu_defaults_ref_default();
 	priv->exposed = FALSE;
+	priv->props_variant = NULL;
+	priv->layout_variant = NULL;
+	priv->layout_key = NULL;
+	priv->layout_recurse = 0;
+	priv->in_batch = FALSE;
+	priv->observer.observer = NULL;
+	priv->observer.data = NULL;
+	priv->observers = NULL;
 	
 	return;
 }
@@ -353,6 +661,12 @@ dbusmenu_menuitem_dispose (GObject *object)
 	g_list_free(priv->children);
 	priv->children = NULL;
 
+	if (priv->child_array != NULL) {
+		g_ptr_array_free(priv->child_array, TRUE);
+		priv->child_array = NULL;
+	}
+	priv->realized_children = 0;
+
 	if (priv->defaults != NULL) {
 		g_object_unref(priv->defaults);
 		priv->defaults = NULL;
@@ -373,9 +687,24 @@ dbusmenu_menuitem_finalize (GObject *object)
 	/* g_debug("Menuitem dying"); */
 	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(object);
 
-	if (priv->properties != NULL) {
-		g_hash_table_destroy(priv->properties);
-		priv->properties = NULL;
+	props_free(priv);
+
+	if (priv->props_variant != NULL) {
+		g_variant_unref(priv->props_variant);
+		priv->props_variant = NULL;
+	}
+
+	if (priv->layout_variant != NULL) {
+		g_variant_unref(priv->layout_variant);
+		priv->layout_variant = NULL;
+	}
+
+	g_free(priv->layout_key);
+	priv->layout_key = NULL;
+
+	if (priv->observers != NULL) {
+		g_array_free(priv->observers, TRUE);
+		priv->observers = NULL;
 	}
 
 	G_OBJECT_CLASS (dbusmenu_menuitem_parent_class)->finalize (object);
@@ -475,13 +804,191 @@ static const gchar *
 menuitem_get_type (const DbusmenuMenuitem * mi)
 {
 	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
-	GVariant * currentval = (GVariant *)g_hash_table_lookup(priv->properties, DBUSMENU_MENUITEM_PROP_TYPE);
+	GVariant * currentval = props_lookup(priv, DBUSMENU_MENUITEM_PROP_TYPE);
 	if (currentval != NULL) {
 		return g_variant_get_string(currentval, NULL);
 	}
 	return NULL;
 }
 
+/* Whether emitting @signal would get to anyone.  The class
+   handler counts as someone for subclasses that override it.
+   Every server gets its own observer, so none of them are
+   counting on the signals and it's only the handlers connected
+   to them that matter. */
+static inline gboolean
+signal_wanted (DbusmenuMenuitem * mi, guint signal, gboolean class_handler)
+{
+	return class_handler || g_signal_has_handler_pending(mi, signals[signal], 0, TRUE);
+}
+
+/* Calls @func on each of the observers of @mi that has it, with
+   the observer's data added on the end of the arguments.  The
+   array is looked at again each time around as an observer can
+   add or remove others. */
+#define OBSERVERS_CALL(mi, func, ...) \
+	G_STMT_START { \
+		DbusmenuMenuitemPrivate * opriv = DBUSMENU_MENUITEM_GET_PRIVATE(mi); \
+		if (opriv->observer.observer != NULL && opriv->observer.observer->func != NULL) { \
+			opriv->observer.observer->func(__VA_ARGS__, opriv->observer.data); \
+		} \
+		guint oi; \
+		for (oi = 0; opriv->observers != NULL && oi < opriv->observers->len; oi++) { \
+			observer_t * extra = &g_array_index(opriv->observers, observer_t, oi); \
+			if (extra->observer->func != NULL) { \
+				extra->observer->func(__VA_ARGS__, extra->data); \
+			} \
+		} \
+	} G_STMT_END
+
+/* Each of these tell the observers, if there are any, and then
+   everyone else if there is anyone. */
+static void
+notify_child_added (DbusmenuMenuitem * mi, DbusmenuMenuitem * child, guint position)
+{
+	OBSERVERS_CALL(mi, child_added, mi, child, position);
+
+	if (signal_wanted(mi, CHILD_ADDED, DBUSMENU_MENUITEM_GET_CLASS(mi)->child_added != NULL)) {
+		g_signal_emit(G_OBJECT(mi), signals[CHILD_ADDED], 0, child, position, TRUE);
+	}
+
+	return;
+}
+
+static void
+notify_child_removed (DbusmenuMenuitem * mi, DbusmenuMenuitem * child)
+{
+	OBSERVERS_CALL(mi, child_removed, mi, child);
+
+	if (signal_wanted(mi, CHILD_REMOVED, DBUSMENU_MENUITEM_GET_CLASS(mi)->child_removed != NULL)) {
+		g_signal_emit(G_OBJECT(mi), signals[CHILD_REMOVED], 0, child, TRUE);
+	}
+
+	return;
+}
+
+static void
+notify_child_moved (DbusmenuMenuitem * mi, DbusmenuMenuitem * child, guint newpos, guint oldpos)
+{
+	OBSERVERS_CALL(mi, child_moved, mi, child, newpos, oldpos);
+
+	if (signal_wanted(mi, CHILD_MOVED, DBUSMENU_MENUITEM_GET_CLASS(mi)->child_moved != NULL)) {
+		g_signal_emit(G_OBJECT(mi), signals[CHILD_MOVED], 0, child, newpos, oldpos, TRUE);
+	}
+
+	return;
+}
+
+/* The children are kept both in the list that we hand out and in
+   an array.  Each child knows its index in the array and its link
+   in the list so that finding, adding and removing them doesn't
+   need to walk either one. */
+
+/* Where @child is in the children of @mi, or -1 if it isn't there */
+static gint
+child_index (DbusmenuMenuitemPrivate * priv, DbusmenuMenuitem * child)
+{
+	if (priv->child_array == NULL) {
+		return -1;
+	}
+
+	guint position = DBUSMENU_MENUITEM_GET_PRIVATE(child)->position;
+	if (position < priv->child_array->len && g_ptr_array_index(priv->child_array, position) == child) {
+		return position;
+	}
+
+	return -1;
+}
+
+/* Fix up the positions of the children from @start on */
+static void
+child_renumber (DbusmenuMenuitemPrivate * priv, guint start)
+{
+	guint i;
+	for (i = start; i < priv->child_array->len; i++) {
+		DBUSMENU_MENUITEM_GET_PRIVATE(g_ptr_array_index(priv->child_array, i))->position = i;
+	}
+	return;
+}
+
+/* Puts @child at @position, or at the end if there aren't that
+   many children.  Doesn't take a reference. */
+static void
+child_insert (DbusmenuMenuitemPrivate * priv, DbusmenuMenuitem * child, guint position)
+{
+	DbusmenuMenuitemPrivate * cpriv = DBUSMENU_MENUITEM_GET_PRIVATE(child);
+
+	if (priv->child_array == NULL) {
+		priv->child_array = g_ptr_array_new();
+	}
+
+	GPtrArray * array = priv->child_array;
+	GList * link = g_list_alloc();
+	link->data = child;
+
+	if (position < array->len) {
+		GList * next = DBUSMENU_MENUITEM_GET_PRIVATE(g_ptr_array_index(array, position))->link;
+
+		link->prev = next->prev;
+		link->next = next;
+		if (next->prev != NULL) {
+			next->prev->next = link;
+		} else {
+			priv->children = link;
+		}
+		next->prev = link;
+
+		/* Open up a spot in the array */
+		g_ptr_array_add(array, NULL);
+		memmove(&array->pdata[position + 1], &array->pdata[position], (array->len - position - 1) * sizeof(gpointer));
+		array->pdata[position] = child;
+	} else {
+		GList * prev = NULL;
+		if (array->len > 0) {
+			prev = DBUSMENU_MENUITEM_GET_PRIVATE(g_ptr_array_index(array, array->len - 1))->link;
+		}
+
+		link->prev = prev;
+		link->next = NULL;
+		if (prev != NULL) {
+			prev->next = link;
+		} else {
+			priv->children = link;
+		}
+
+		position = array->len;
+		g_ptr_array_add(array, child);
+	}
+
+	cpriv->link = link;
+	child_renumber(priv, position);
+
+	if (cpriv->realized) {
+		priv->realized_children++;
+	}
+
+	return;
+}
+
+/* Takes the child at @position out, doesn't drop the reference. */
+static void
+child_remove (DbusmenuMenuitemPrivate * priv, guint position)
+{
+	DbusmenuMenuitemPrivate * cpriv = DBUSMENU_MENUITEM_GET_PRIVATE(g_ptr_array_index(priv->child_array, position));
+
+	priv->children = g_list_delete_link(priv->children, cpriv->link);
+	cpriv->link = NULL;
+
+	g_ptr_array_remove_index(priv->child_array, position);
+	child_renumber(priv, position);
+
+	if (cpriv->realized) {
+		priv->realized_children--;
+	}
+
+	return;
+}
+
 /* Public interface */
 
 /**
@@ -570,6 +1077,11 @@ dbusmenu_menuitem_set_realized (DbusmenuMenuitem * mi)
 	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
 	if (priv->realized) {
 		g_warning("Realized entry realized again?  ID: %d", dbusmenu_menuitem_get_id(mi));
+	} else if (priv->parent != NULL) {
+		DbusmenuMenuitemPrivate * ppriv = DBUSMENU_MENUITEM_GET_PRIVATE(priv->parent);
+		if (child_index(ppriv, mi) >= 0) {
+			ppriv->realized_children++;
+		}
 	}
 	priv->realized = TRUE;
 	g_signal_emit(G_OBJECT(mi), signals[REALIZED], 0, TRUE);
@@ -604,7 +1116,7 @@ take_children_helper (gpointer data, gpointer user_data)
 	g_debug("Menuitem %d (%s) signalling child removed %d (%s)", ID(user_data), LABEL(user_data), ID(data), LABEL(data));
 	#endif
 	dbusmenu_menuitem_unparent(DBUSMENU_MENUITEM(data));
-	g_signal_emit(G_OBJECT(user_data), signals[CHILD_REMOVED], 0, DBUSMENU_MENUITEM(data), TRUE);
+	notify_child_removed(DBUSMENU_MENUITEM(user_data), DBUSMENU_MENUITEM(data));
 	return;
 }
 
@@ -629,6 +1141,11 @@ dbusmenu_menuitem_take_children (DbusmenuMenuitem * mi)
 	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
 	GList * children = priv->children;
 	priv->children = NULL;
+	if (priv->child_array != NULL) {
+		g_ptr_array_set_size(priv->child_array, 0);
+	}
+	priv->realized_children = 0;
+	layout_variant_invalidate(mi);
 	g_list_foreach(children, take_children_helper, mi);
 
 	dbusmenu_menuitem_property_remove(mi, DBUSMENU_MENUITEM_PROP_CHILD_DISPLAY);
@@ -659,14 +1176,8 @@ dbusmenu_menuitem_get_position (DbusmenuMenuitem * mi, DbusmenuMenuitem * parent
 	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(mi), 0);
 	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(parent), 0);
 
-	GList * childs = dbusmenu_menuitem_get_children(parent);
-	if (childs == NULL) return 0;
-	guint count = 0;
-	for ( ; childs != NULL; childs = childs->next, count++) {
-		if (childs->data == mi) break;
-	}
-
-	if (childs == NULL) return 0;
+	gint count = child_index(DBUSMENU_MENUITEM_GET_PRIVATE(parent), mi);
+	if (count < 0) return 0;
 
 	#ifdef MASSIVEDEBUGGING
 	g_debug("Getting position of %d (%s), it's at: %d", ID(mi), LABEL(mi), count);
@@ -697,21 +1208,24 @@ dbusmenu_menuitem_get_position_realized (DbusmenuMenuitem * mi, DbusmenuMenuitem
 	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(mi), 0);
 	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(parent), 0);
 
-	GList * childs = dbusmenu_menuitem_get_children(parent);
-	if (childs == NULL) return 0;
-	guint count = 0;
-	for ( ; childs != NULL; childs = childs->next, count++) {
-		if (!dbusmenu_menuitem_realized(DBUSMENU_MENUITEM(childs->data))) {
-			count--;
-			continue;
-		}
-		if (childs->data == mi) {
-			break;
+	DbusmenuMenuitemPrivate * ppriv = DBUSMENU_MENUITEM_GET_PRIVATE(parent);
+	gint position = child_index(ppriv, mi);
+	if (position < 0) return 0;
+	if (!dbusmenu_menuitem_realized(mi)) return 0;
+
+	/* Usually they're all realized and then it's the same as the
+	   position, otherwise count the realized ones before us */
+	guint count = position;
+	if (ppriv->realized_children != ppriv->child_array->len) {
+		guint i;
+		count = 0;
+		for (i = 0; i < (guint)position; i++) {
+			if (dbusmenu_menuitem_realized(DBUSMENU_MENUITEM(g_ptr_array_index(ppriv->child_array, i)))) {
+				count++;
+			}
 		}
 	}
 
-	if (childs == NULL) return 0;
-
 	#ifdef MASSIVEDEBUGGING
 	g_debug("Getting position of %d (%s), it's at: %d", ID(mi), LABEL(mi), count);
 	#endif
@@ -736,7 +1250,7 @@ dbusmenu_menuitem_child_append (DbusmenuMenuitem * mi, DbusmenuMenuitem * child)
 	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(child), FALSE);
 
 	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
-	g_return_val_if_fail(g_list_find(priv->children, child) == NULL, FALSE);
+	g_return_val_if_fail(child_index(priv, child) < 0, FALSE);
 
 	if (!dbusmenu_menuitem_set_parent(child, mi)) {
 		return FALSE;
@@ -746,12 +1260,13 @@ dbusmenu_menuitem_child_append (DbusmenuMenuitem * mi, DbusmenuMenuitem * child)
 		dbusmenu_menuitem_property_set(mi, DBUSMENU_MENUITEM_PROP_CHILD_DISPLAY, DBUSMENU_MENUITEM_CHILD_DISPLAY_SUBMENU);
 	}
 
-	priv->children = g_list_append(priv->children, child);
+	child_insert(priv, child, G_MAXUINT);
+	layout_variant_invalidate(mi);
 	#ifdef MASSIVEDEBUGGING
-	g_debug("Menuitem %d (%s) signalling child added %d (%s) at %d", ID(mi), LABEL(mi), ID(child), LABEL(child), g_list_length(priv->children) - 1);
+	g_debug("Menuitem %d (%s) signalling child added %d (%s) at %d", ID(mi), LABEL(mi), ID(child), LABEL(child), priv->child_array->len - 1);
 	#endif
 	g_object_ref(G_OBJECT(child));
-	g_signal_emit(G_OBJECT(mi), signals[CHILD_ADDED], 0, child, g_list_length(priv->children) - 1, TRUE);
+	notify_child_added(mi, child, priv->child_array->len - 1);
 	return TRUE;
 }
 
@@ -772,7 +1287,7 @@ dbusmenu_menuitem_child_prepend (DbusmenuMenuitem * mi, DbusmenuMenuitem * child
 	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(child), FALSE);
 
 	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
-	g_return_val_if_fail(g_list_find(priv->children, child) == NULL, FALSE);
+	g_return_val_if_fail(child_index(priv, child) < 0, FALSE);
 
 	if (!dbusmenu_menuitem_set_parent(child, mi)) {
 		return FALSE;
@@ -782,12 +1297,13 @@ dbusmenu_menuitem_child_prepend (DbusmenuMenuitem * mi, DbusmenuMenuitem * child
 		dbusmenu_menuitem_property_set(mi, DBUSMENU_MENUITEM_PROP_CHILD_DISPLAY, DBUSMENU_MENUITEM_CHILD_DISPLAY_SUBMENU);
 	}
 
-	priv->children = g_list_prepend(priv->children, child);
+	child_insert(priv, child, 0);
+	layout_variant_invalidate(mi);
 	#ifdef MASSIVEDEBUGGING
 	g_debug("Menuitem %d (%s) signalling child added %d (%s) at %d", ID(mi), LABEL(mi), ID(child), LABEL(child), 0);
 	#endif
 	g_object_ref(G_OBJECT(child));
-	g_signal_emit(G_OBJECT(mi), signals[CHILD_ADDED], 0, child, 0, TRUE);
+	notify_child_added(mi, child, 0);
 	return TRUE;
 }
 
@@ -814,12 +1330,16 @@ dbusmenu_menuitem_child_delete (DbusmenuMenuitem * mi, DbusmenuMenuitem * child)
 	}
 
 	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
-	priv->children = g_list_remove(priv->children, child);
+	gint position = child_index(priv, child);
+	if (position >= 0) {
+		child_remove(priv, position);
+	}
+	layout_variant_invalidate(mi);
 	dbusmenu_menuitem_unparent(child);
 	#ifdef MASSIVEDEBUGGING
 	g_debug("Menuitem %d (%s) signalling child removed %d (%s)", ID(mi), LABEL(mi), ID(child), LABEL(child));
 	#endif
-	g_signal_emit(G_OBJECT(mi), signals[CHILD_REMOVED], 0, child, TRUE);
+	notify_child_removed(mi, child);
 	g_object_unref(G_OBJECT(child));
 
 	if (priv->children == NULL) {
@@ -848,7 +1368,7 @@ dbusmenu_menuitem_child_add_position (DbusmenuMenuitem * mi, DbusmenuMenuitem *
 	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(child), FALSE);
 
 	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
-	g_return_val_if_fail(g_list_find(priv->children, child) == NULL, FALSE);
+	g_return_val_if_fail(child_index(priv, child) < 0, FALSE);
 
 	if (!dbusmenu_menuitem_set_parent(child, mi)) {
 		return FALSE;
@@ -858,12 +1378,13 @@ dbusmenu_menuitem_child_add_position (DbusmenuMenuitem * mi, DbusmenuMenuitem *
 		dbusmenu_menuitem_property_set(mi, DBUSMENU_MENUITEM_PROP_CHILD_DISPLAY, DBUSMENU_MENUITEM_CHILD_DISPLAY_SUBMENU);
 	}
 
-	priv->children = g_list_insert(priv->children, child, position);
+	child_insert(priv, child, position);
+	layout_variant_invalidate(mi);
 	#ifdef MASSIVEDEBUGGING
 	g_debug("Menuitem %d (%s) signalling child added %d (%s) at %d", ID(mi), LABEL(mi), ID(child), LABEL(child), position);
 	#endif
 	g_object_ref(G_OBJECT(child));
-	g_signal_emit(G_OBJECT(mi), signals[CHILD_ADDED], 0, child, position, TRUE);
+	notify_child_added(mi, child, position);
 	return TRUE;
 }
 
@@ -886,7 +1407,7 @@ dbusmenu_menuitem_child_reorder(DbusmenuMenuitem * mi, DbusmenuMenuitem * child,
 	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(child), FALSE);
 
 	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
-	gint oldpos = g_list_index(priv->children, child);
+	gint oldpos = child_index(priv, child);
 
 	if (oldpos == -1) {
 		g_warning("Can not reorder child that isn't actually a child.");
@@ -896,13 +1417,14 @@ dbusmenu_menuitem_child_reorder(DbusmenuMenuitem * mi, DbusmenuMenuitem * child,
 		return TRUE;
 	}
 
-	priv->children = g_list_remove(priv->children, child);
-	priv->children = g_list_insert(priv->children, child, position);
+	child_remove(priv, oldpos);
+	child_insert(priv, child, position);
+	layout_variant_invalidate(mi);
 
 	#ifdef MASSIVEDEBUGGING
 	g_debug("Menuitem %d (%s) signalling child %d (%s) moved from %d to %d", ID(mi), LABEL(mi), ID(child), LABEL(child), oldpos, position);
 	#endif
-	g_signal_emit(G_OBJECT(mi), signals[CHILD_MOVED], 0, child, position, oldpos, TRUE);
+	notify_child_moved(mi, child, position, oldpos);
 
 	return TRUE;
 }
@@ -923,12 +1445,13 @@ dbusmenu_menuitem_child_find (DbusmenuMenuitem * mi, gint id)
 {
 	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(mi), NULL);
 
-	GList * childs = dbusmenu_menuitem_get_children(mi);
-	if (childs == NULL) return NULL;
+	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
+	if (priv->child_array == NULL) return NULL;
 
-	for ( ; childs == NULL; childs = g_list_next(childs)) {
-		DbusmenuMenuitem * lmi = DBUSMENU_MENUITEM(childs->data);
-		if (id == dbusmenu_menuitem_get_id(lmi)) {
+	guint i;
+	for (i = 0; i < priv->child_array->len; i++) {
+		DbusmenuMenuitem * lmi = DBUSMENU_MENUITEM(g_ptr_array_index(priv->child_array, i));
+		if (id == DBUSMENU_MENUITEM_GET_PRIVATE(lmi)->id) {
 			return lmi;
 		}
 	}
@@ -1161,33 +1684,17 @@ dbusmenu_menuitem_property_set_byte_array (DbusmenuMenuitem * mi, const gchar *
 	return dbusmenu_menuitem_property_set_variant(mi, property, variant);
 }
 
-/**
- * dbusmenu_menuitem_property_set_variant:
- * @mi: The #DbusmenuMenuitem to set the property on.
- * @property: Name of the property to set.
- * @value: The value of the property.
- * 
- * Takes the pair of @property and @value and places them as a
- * property on @mi.  If a property already exists by that name,
- * then the value is set to the new value.  If not, the property
- * is added.  If the value is changed or the property was previously
- * unset then the signal #DbusmenuMenuitem::prop-changed will be
- * emitted by this function.
- * 
- * Return value:  A boolean representing if the property value was set.
- */
-gboolean
-dbusmenu_menuitem_property_set_variant (DbusmenuMenuitem * mi, const gchar * property, GVariant * value)
+/* Puts @value into the property table for @property without
+   signaling anything, checking it against the defaults for @type.
+   Returns whether anything changed.  If the old entry was pulled
+   out of the table its value is returned in @stolen_value so that
+   it can be unref'd after the signal is sent. */
+static gboolean
+property_store (DbusmenuMenuitem * mi, const gchar * type, const gchar * property, GVariant * value, GVariant ** default_out, GVariant ** stolen_value)
 {
-	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(mi), FALSE);
-	g_return_val_if_fail(property != NULL, FALSE);
-	g_return_val_if_fail(g_utf8_validate(property, -1, NULL), FALSE);
-
 	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
 	GVariant * default_value = NULL;
 
-	const gchar * type = menuitem_get_type(mi);
-
 	if (value != NULL) {
 		/* Check the expected type to see if we want to have a warning */
 		GVariantType * default_type = dbusmenu_defaults_default_get_type(priv->defaults, type, property);
@@ -1204,6 +1711,7 @@ dbusmenu_menuitem_property_set_variant (DbusmenuMenuitem * mi, const gchar * pro
 	/* Check the defaults database to see if we have a default
 	   for this property. */
 	default_value = dbusmenu_defaults_default_get(priv->defaults, type, property);
+	*default_out = default_value;
 	if (default_value != NULL && value != NULL) {
 		/* Now see if we're setting this to the same value as the
 		   default.  If we are then we just want to swallow this variant
@@ -1216,15 +1724,8 @@ dbusmenu_menuitem_property_set_variant (DbusmenuMenuitem * mi, const gchar * pro
 	}
 
 	gboolean replaced = FALSE;
-	gboolean remove = FALSE;
-	gchar * hash_key = NULL;
-	GVariant * hash_variant = NULL;
-	gboolean inhash = g_hash_table_lookup_extended(priv->properties, property, (gpointer *)&hash_key, (gpointer *)&hash_variant);
-
-	if (inhash && hash_variant == NULL) {
-		g_warning("The property '%s' is in the hash with a NULL variant", property);
-		inhash = FALSE;
-	}
+	GVariant * hash_variant = props_lookup(priv, property);
+	gboolean inhash = (hash_variant != NULL);
 
 	if (value != NULL) {
 		/* NOTE: We're only marking this as replaced if this is true
@@ -1235,35 +1736,67 @@ dbusmenu_menuitem_property_set_variant (DbusmenuMenuitem * mi, const gchar * pro
 			replaced = TRUE;
 		}
 
-		gchar * lprop = g_strdup(property);
+		/* Sink before storing, the value being passed in could be
+		   the one that's already stored and that one gets unref'd */
 		g_variant_ref_sink(value);
-
-		/* Really important that this is _insert as that means the value
-		   that we just created in the _strdup is free'd and not the one
-		   currently in the hashtable.  That could be the same as the one
-		   being passed in and then the signal emit would be done with a
-		   bad value */
-		g_hash_table_insert(priv->properties, lprop, value);
+		props_insert(priv, property, value);
 	} else {
 		if (inhash) {
 		/* So the question you should be asking if you're paying attention
 		   is "Why not just do the remove here?"  It's a good question with
-		   an interesting answer.  Bascially it's the same reason as above,
-		   in a couple cases the passed in properties is the value in the hash
-		   table so we can avoid strdup'ing it by removing it (and thus free'ing
-		   it) after the signal emition */
-			remove = TRUE;
+		   an interesting answer.  In a couple cases the value being
+		   signaled is the one in the table, so we hold on to it until
+		   after the signal emition */
 			replaced = TRUE;
-			g_hash_table_steal(priv->properties, property);
+			*stolen_value = props_steal(priv, property);
 		}
 	}
 
+	return replaced;
+}
+
+/**
+ * dbusmenu_menuitem_property_set_variant:
+ * @mi: The #DbusmenuMenuitem to set the property on.
+ * @property: Name of the property to set.
+ * @value: The value of the property.
+ * 
+ * Takes the pair of @property and @value and places them as a
+ * property on @mi.  If a property already exists by that name,
+ * then the value is set to the new value.  If not, the property
+ * is added.  If the value is changed or the property was previously
+ * unset then the signal #DbusmenuMenuitem::prop-changed will be
+ * emitted by this function.
+ * 
+ * Return value:  A boolean representing if the property value was set.
+ */
+gboolean
+dbusmenu_menuitem_property_set_variant (DbusmenuMenuitem * mi, const gchar * property, GVariant * value)
+{
+	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(mi), FALSE);
+	g_return_val_if_fail(property != NULL, FALSE);
+	g_return_val_if_fail(g_utf8_validate(property, -1, NULL), FALSE);
+
+	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
+	GVariant * default_value = NULL;
+	GVariant * stolen = NULL;
+
+	gboolean replaced = property_store(mi, menuitem_get_type(mi), property, value, &default_value, &stolen);
+
 	/* NOTE: The actual value is invalid at this point
 	   becuse it has been unref'd when replaced in the hash
 	   table.  But the fact that there was a value is
 	   the imporant part. */
 	if (replaced) {
-		GVariant * signalval = value;
+		GVariant * signalval = props_lookup(priv, property);
+
+		/* The dictionary we had built isn't right anymore, and
+		   neither is any layout that had it in it. */
+		if (priv->props_variant != NULL) {
+			g_variant_unref(priv->props_variant);
+			priv->props_variant = NULL;
+		}
+		layout_variant_invalidate(mi);
 
 		if (signalval == NULL) {
 			/* Might also be NULL, but if it is we're definitely
@@ -1271,14 +1804,200 @@ dbusmenu_menuitem_property_set_variant (DbusmenuMenuitem * mi, const gchar * pro
 			signalval = default_value;
 		}
 
-		g_signal_emit(G_OBJECT(mi), signals[PROPERTY_CHANGED], 0, property, signalval, TRUE);
+		OBSERVERS_CALL(mi, property_changed, mi, property, signalval);
+
+		if (signal_wanted(mi, PROPERTY_CHANGED, DBUSMENU_MENUITEM_GET_CLASS(mi)->property_changed != NULL)) {
+			/* Someone setting a property from inside a batch isn't
+			   part of the batch */
+			gboolean in_batch = priv->in_batch;
+			priv->in_batch = FALSE;
+			g_signal_emit(G_OBJECT(mi), signals[PROPERTY_CHANGED], 0, property, signalval, TRUE);
+			priv->in_batch = in_batch;
+		}
+	}
+
+	if (stolen != NULL) {
+		g_variant_unref(stolen);
+	}
+
+	return TRUE;
+}
+
+/**
+ * dbusmenu_menuitem_properties_set_many:
+ * @mi: The #DbusmenuMenuitem to set the properties on.
+ * @properties: A dictionary of type "a{sv}" of properties to set.
+ * 
+ * Sets all of the properties in @properties on @mi as if each one
+ * was set with dbusmenu_menuitem_property_set_variant() but only
+ * sends a single #DbusmenuMenuitem::properties-changed signal for
+ * all of them.  If @properties is floating it is consumed.
+ * 
+ * Return value:  A boolean representing if the property values were set.
+ */
+gboolean
+dbusmenu_menuitem_properties_set_many (DbusmenuMenuitem * mi, GVariant * properties)
+{
+	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(mi), FALSE);
+	g_return_val_if_fail(properties != NULL, FALSE);
+	g_return_val_if_fail(g_variant_is_of_type(properties, G_VARIANT_TYPE("a{sv}")), FALSE);
+
+	g_variant_ref_sink(properties);
+
+	gsize count = g_variant_n_children(properties);
+	const gchar ** names = g_new(const gchar *, count);
+	GVariant ** values = g_new(GVariant *, count);
+	gsize i;
+
+	for (i = 0; i < count; i++) {
+		g_variant_get_child(properties, i, "{&sv}", &names[i], &values[i]);
+	}
+
+	gboolean retval = dbusmenu_menuitem_properties_set_manyv(mi, count, names, values);
+
+	for (i = 0; i < count; i++) {
+		g_variant_unref(values[i]);
+	}
+	g_free(values);
+	g_free(names);
+
+	g_variant_unref(properties);
+
+	return retval;
+}
+
+/**
+ * dbusmenu_menuitem_properties_set_manyv:
+ * @mi: The #DbusmenuMenuitem to set the properties on.
+ * @n_properties: The number of entries in @properties and @values.
+ * @properties: (array length=n_properties): Names of the properties to set.
+ * @values: (array length=n_properties): The values to set, a #NULL value
+ * 	removes the property.
+ * 
+ * Sets each of @properties to the matching entry in @values as if
+ * each one was set with dbusmenu_menuitem_property_set_variant()
+ * but only sends a single #DbusmenuMenuitem::properties-changed
+ * signal for all of them.  Floating values are consumed.  If any
+ * of the names are invalid nothing is set.
+ * 
+ * Return value:  A boolean representing if the property values were set.
+ */
+gboolean
+dbusmenu_menuitem_properties_set_manyv (DbusmenuMenuitem * mi, guint n_properties, const gchar ** properties, GVariant ** values)
+{
+	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(mi), FALSE);
+	g_return_val_if_fail(n_properties == 0 || (properties != NULL && values != NULL), FALSE);
+
+	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
+	guint i;
+
+	/* Check them all before we touch anything */
+	for (i = 0; i < n_properties; i++) {
+		if (properties[i] == NULL || !g_utf8_validate(properties[i], -1, NULL)) {
+			g_warning("Invalid property name at position %u, not setting any properties", i);
+
+			for (i = 0; i < n_properties; i++) {
+				if (values[i] != NULL) {
+					g_variant_unref(g_variant_ref_sink(values[i]));
+				}
+			}
+			return FALSE;
+		}
+	}
+
+	GPtrArray * changed = g_ptr_array_new();
+	GPtrArray * stolen = g_ptr_array_new();
+	guint pass;
+
+	/* The type decides which defaults the rest get checked
+	   against, so it needs to go in before any of them. */
+	for (pass = 0; pass < 2; pass++) {
+		const gchar * type = menuitem_get_type(mi);
+
+		for (i = 0; i < n_properties; i++) {
+			gboolean is_type = g_strcmp0(properties[i], DBUSMENU_MENUITEM_PROP_TYPE) == 0;
+			if (is_type != (pass == 0)) {
+				continue;
+			}
+
+			GVariant * default_value = NULL;
+			GVariant * stolen_value = NULL;
+
+			if (property_store(mi, type, properties[i], values[i], &default_value, &stolen_value)) {
+				g_ptr_array_add(changed, (gpointer)properties[i]);
+			}
+
+			if (stolen_value != NULL) {
+				g_ptr_array_add(stolen, stolen_value);
+			}
+		}
+	}
+
+	if (changed->len > 0) {
+		if (priv->props_variant != NULL) {
+			g_variant_unref(priv->props_variant);
+			priv->props_variant = NULL;
+		}
+		layout_variant_invalidate(mi);
+
+		const gchar * type = menuitem_get_type(mi);
+		GHashTable * seen = g_hash_table_new(g_str_hash, g_str_equal);
+		GVariantBuilder builder;
+		GPtrArray * removed = g_ptr_array_new();
+		g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
+
+		/* Everyone listening to single properties still gets
+		   told, but we already know they're part of a batch.  The
+		   observer only gets the batch. */
+		gboolean single = signal_wanted(mi, PROPERTY_CHANGED, DBUSMENU_MENUITEM_GET_CLASS(mi)->property_changed != NULL);
+		priv->in_batch = TRUE;
+
+		for (i = 0; i < changed->len; i++) {
+			const gchar * property = g_ptr_array_index(changed, i);
+
+			/* Set more than once, the last one is what stuck */
+			if (g_hash_table_contains(seen, property)) {
+				continue;
+			}
+			g_hash_table_add(seen, (gpointer)property);
+
+			GVariant * value = props_lookup(priv, property);
+
+			if (value != NULL) {
+				g_variant_builder_add(&builder, "{sv}", property, value);
+			} else {
+				g_ptr_array_add(removed, (gpointer)property);
+				value = dbusmenu_defaults_default_get(priv->defaults, type, property);
+			}
+
+			if (single) {
+				g_signal_emit(G_OBJECT(mi), signals[PROPERTY_CHANGED], 0, property, value, TRUE);
+			}
+		}
+
+		priv->in_batch = FALSE;
+
+		g_ptr_array_add(removed, NULL);
+		GVariant * changedvariant = g_variant_ref_sink(g_variant_builder_end(&builder));
+
+		OBSERVERS_CALL(mi, properties_changed, mi, changedvariant, (GStrv)removed->pdata);
+
+		if (signal_wanted(mi, PROPERTIES_CHANGED, DBUSMENU_MENUITEM_GET_CLASS(mi)->properties_changed != NULL)) {
+			g_signal_emit(G_OBJECT(mi), signals[PROPERTIES_CHANGED], 0, changedvariant, (GStrv)removed->pdata, TRUE);
+		}
+
+		g_variant_unref(changedvariant);
+		g_ptr_array_free(removed, TRUE);
+		g_hash_table_destroy(seen);
 	}
 
-	if (remove) {
-		g_free(hash_key);
-		g_variant_unref(hash_variant);
+	for (i = 0; i < stolen->len; i++) {
+		g_variant_unref(g_ptr_array_index(stolen, i));
 	}
 
+	g_ptr_array_free(stolen, TRUE);
+	g_ptr_array_free(changed, TRUE);
+
 	return TRUE;
 }
 
@@ -1323,7 +2042,7 @@ dbusmenu_menuitem_property_get_variant (const DbusmenuMenuitem * mi, const gchar
 
 	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
 
-	GVariant * currentval = (GVariant *)g_hash_table_lookup(priv->properties, property);
+	GVariant * currentval = props_lookup(priv, property);
 
 	if (currentval == NULL) {
 		currentval = dbusmenu_defaults_default_get(priv->defaults, menuitem_get_type(mi), property);
@@ -1439,9 +2158,7 @@ dbusmenu_menuitem_property_exist (const DbusmenuMenuitem * mi, const gchar * pro
 
 	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
 
-	gpointer value = g_hash_table_lookup(priv->properties, property);
-
-	return value != NULL;
+	return props_lookup(priv, property) != NULL;
 }
 
 /**
@@ -1462,6 +2179,15 @@ dbusmenu_menuitem_property_remove (DbusmenuMenuitem * mi, const gchar * property
 	return;
 }
 
+/* Puts the name of each property on the list */
+static void
+list_helper (gpointer in_key, gpointer in_value, gpointer in_data)
+{
+	GList ** list = (GList **)in_data;
+	*list = g_list_prepend(*list, in_key);
+	return;
+}
+
 /**
  * dbusmenu_menuitem_properties_list:
  * @mi: #DbusmenuMenuitem to list the properties on
@@ -1480,7 +2206,9 @@ dbusmenu_menuitem_properties_list (DbusmenuMenuitem * mi)
 	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(mi), NULL);
 
 	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
-	return g_hash_table_get_keys(priv->properties);
+	GList * list = NULL;
+	props_foreach(priv, list_helper, &list);
+	return g_list_reverse(list);
 }
 
 /* Copy the keys and make references to the variants that are
@@ -1519,7 +2247,7 @@ dbusmenu_menuitem_properties_copy (DbusmenuMenuitem * mi)
 	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(mi), ret);
 
 	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
-	g_hash_table_foreach(priv->properties, copy_helper, ret);
+	props_foreach(priv, copy_helper, ret);
 
 	return ret;
 }
@@ -1538,11 +2266,17 @@ variant_helper (gpointer in_key, gpointer in_value, gpointer user_data)
 /**
  * dbusmenu_menuitem_properties_variant:
  * @mi: #DbusmenuMenuitem to get properties from
+ * @properties: (allow-none): Names of the properties to include, or
+ *     #NULL (or an empty list) for all of them
  * 
  * Grabs the properties of the menuitem as a GVariant with the
- * type "a{sv}".
+ * type "a{sv}".  When all of the properties are requested the
+ * dictionary is kept on the menuitem and shared until one of
+ * the properties changes.
  * 
  * Return Value: (transfer full): A GVariant of type "a{sv}" or NULL on error.
+ *     This is a normal reference, not a floating one, and needs to
+ *     be unref'd by the caller.
  */
 GVariant *
 dbusmenu_menuitem_properties_variant (DbusmenuMenuitem * mi, const gchar ** properties)
@@ -1553,13 +2287,17 @@ dbusmenu_menuitem_properties_variant (DbusmenuMenuitem * mi, const gchar ** prop
 
 	GVariant * final_variant = NULL;
 
-	if ((properties == NULL || properties[0] == NULL) && g_hash_table_size(priv->properties) > 0) {
-		GVariantBuilder builder;
-		g_variant_builder_init(&builder, G_VARIANT_TYPE_ARRAY);
+	if ((properties == NULL || properties[0] == NULL) && props_size(priv) > 0) {
+		if (priv->props_variant == NULL) {
+			GVariantBuilder builder;
+			g_variant_builder_init(&builder, G_VARIANT_TYPE_ARRAY);
 
-		g_hash_table_foreach(priv->properties, variant_helper, &builder);
+			props_foreach(priv, variant_helper, &builder);
 
-		final_variant = g_variant_builder_end(&builder);
+			priv->props_variant = g_variant_ref_sink(g_variant_builder_end(&builder));
+		}
+
+		final_variant = g_variant_ref(priv->props_variant);
 	}
 
 	if (properties != NULL) {
@@ -1585,7 +2323,7 @@ dbusmenu_menuitem_properties_variant (DbusmenuMenuitem * mi, const gchar ** prop
 		}
 
 		if (builder_init) {
-			final_variant = g_variant_builder_end(&builder);
+			final_variant = g_variant_ref_sink(g_variant_builder_end(&builder));
 		}
 	}
 
@@ -1605,6 +2343,10 @@ dbusmenu_menuitem_set_root (DbusmenuMenuitem * mi, gboolean root)
 {
 	g_return_if_fail(DBUSMENU_IS_MENUITEM(mi));
 	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
+	if (priv->root != root) {
+		/* Root items are always ID zero in the layout */
+		layout_variant_invalidate(mi);
+	}
 	priv->root = root;
 	return;
 }
@@ -1627,26 +2369,43 @@ dbusmenu_menuitem_get_root (DbusmenuMenuitem * mi)
 }
 
 
-/**
- * dbusmenu_menuitem_buildvariant:
- * @mi: #DbusmenuMenuitem to represent in a variant
- * @properties: (element-type utf8): A list of string that will be put into
- *      a variant
- * 
- * This function will put at least one entry if this menu item has no children.
- * If it has children it will put two for this entry, one representing the
- * start tag and one that is a closing tag.  It will allow its
- * children to place their own tags in the array in between those two.
- *
- * Return value: (transfer full): Variant representing @properties
-*/
-GVariant *
-dbusmenu_menuitem_build_variant (DbusmenuMenuitem * mi, const gchar ** properties, gint recurse)
+/* Drops the layout that we built for this item and all of the
+   ones above it, as they've got a copy of ours inside them. */
+static void
+layout_variant_invalidate (DbusmenuMenuitem * mi)
+{
+	while (mi != NULL) {
+		DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
+
+		if (priv->layout_variant != NULL) {
+			g_variant_unref(priv->layout_variant);
+			priv->layout_variant = NULL;
+			g_free(priv->layout_key);
+			priv->layout_key = NULL;
+		}
+
+		mi = priv->parent;
+	}
+
+	return;
+}
+
+/* The recursive part of building the variant, @key is @properties
+   joined into one string so that we can check the cached layouts
+   with a single compare.  The key comes from whoever is asking
+   over the bus, so each item keeps its own copy rather than
+   interning it, which would keep every list anyone ever sent. */
+static GVariant *
+build_variant_helper (DbusmenuMenuitem * mi, const gchar ** properties, const gchar * key, gint recurse)
 {
-	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(mi), NULL);
 	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
 	priv->exposed = TRUE;
 
+	/* If nothing has changed under us since last time, we're done */
+	if (priv->layout_variant != NULL && priv->layout_recurse == recurse && g_strcmp0(priv->layout_key, key) == 0) {
+		return g_variant_ref(priv->layout_variant);
+	}
+
 	gint id = 0;
 	if (!dbusmenu_menuitem_get_root(mi)) {
 		id = dbusmenu_menuitem_get_id(mi);
@@ -1664,6 +2423,7 @@ dbusmenu_menuitem_build_variant (DbusmenuMenuitem * mi, const gchar ** propertie
 	GVariant * props = dbusmenu_menuitem_properties_variant(mi, properties);
 	if (props != NULL) {
 		g_variant_builder_add_value(&tupleb, props);
+		g_variant_unref(props);
 	} else {
 		GVariant *empty_props = g_variant_parse(G_VARIANT_TYPE("a{sv}"), "[ ]", NULL, NULL, NULL);
 		g_variant_builder_add_value(&tupleb, empty_props);
@@ -1679,15 +2439,71 @@ dbusmenu_menuitem_build_variant (DbusmenuMenuitem * mi, const gchar ** propertie
 		g_variant_builder_init(&childrenbuilder, G_VARIANT_TYPE_ARRAY);
 
 		for ( ; children != NULL; children = children->next) {
-			GVariant * child = dbusmenu_menuitem_build_variant(DBUSMENU_MENUITEM(children->data), properties, recurse - 1);
+			/* All of the negative values mean everything, keep
+			   them at -1 so the children match the cache */
+			GVariant * child = build_variant_helper(DBUSMENU_MENUITEM(children->data), properties, key, recurse < 0 ? recurse : recurse - 1);
 
 			g_variant_builder_add_value(&childrenbuilder, g_variant_new_variant(child));
+			g_variant_unref(child);
 		}
 
 		g_variant_builder_add_value(&tupleb, g_variant_builder_end(&childrenbuilder));
 	}
 
-	return g_variant_builder_end(&tupleb);
+	if (priv->layout_variant != NULL) {
+		g_variant_unref(priv->layout_variant);
+	}
+
+	priv->layout_variant = g_variant_ref_sink(g_variant_builder_end(&tupleb));
+	if (g_strcmp0(priv->layout_key, key) != 0) {
+		g_free(priv->layout_key);
+		priv->layout_key = g_strdup(key);
+	}
+	priv->layout_recurse = recurse;
+
+	return g_variant_ref(priv->layout_variant);
+}
+
+/**
+ * dbusmenu_menuitem_buildvariant:
+ * @mi: #DbusmenuMenuitem to represent in a variant
+ * @properties: (element-type utf8): A list of string that will be put into
+ *      a variant
+ * @recurse: How many levels of children to include, or -1 for all
+ * 
+ * This function will put at least one entry if this menu item has no children.
+ * If it has children it will put two for this entry, one representing the
+ * start tag and one that is a closing tag.  It will allow its
+ * children to place their own tags in the array in between those two.
+ *
+ * The result is kept on each menuitem in the tree so that building
+ * the same layout again only rebuilds the parts that have changed.
+ *
+ * Return value: (transfer full): Variant representing @properties, this
+ *    is a normal reference that needs to be unref'd.
+*/
+GVariant *
+dbusmenu_menuitem_build_variant (DbusmenuMenuitem * mi, const gchar ** properties, gint recurse)
+{
+	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(mi), NULL);
+
+	/* Negative values all mean the same thing, make sure they
+	   look the same in the cache */
+	if (recurse < 0) {
+		recurse = -1;
+	}
+
+	gchar * key = NULL;
+	if (properties != NULL && properties[0] != NULL) {
+		key = g_strjoinv("\n", (gchar **)properties);
+	} else {
+		key = g_strdup("");
+	}
+
+	GVariant * retval = build_variant_helper(mi, properties, key, recurse);
+	g_free(key);
+
+	return retval;
 }
 
 typedef struct {
@@ -1813,7 +2629,11 @@ dbusmenu_menuitem_show_to_user (DbusmenuMenuitem * mi, guint timestamp)
 {
 	g_return_if_fail(DBUSMENU_IS_MENUITEM(mi));
 
-	g_signal_emit(G_OBJECT(mi), signals[SHOW_TO_USER], 0, timestamp, TRUE);
+	OBSERVERS_CALL(mi, show_to_user, mi, timestamp);
+
+	if (signal_wanted(mi, SHOW_TO_USER, DBUSMENU_MENUITEM_GET_CLASS(mi)->show_to_user != NULL)) {
+		g_signal_emit(G_OBJECT(mi), signals[SHOW_TO_USER], 0, timestamp, TRUE);
+	}
 
 	return;
 }
@@ -1826,7 +2646,7 @@ dbusmenu_menuitem_property_is_default (DbusmenuMenuitem * mi, const gchar * prop
 	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(mi), FALSE);
 	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
 
-	GVariant * currentval = (GVariant *)g_hash_table_lookup(priv->properties, property);
+	GVariant * currentval = props_lookup(priv, property);
 	if (currentval != NULL) {
 		/* If we're storing it locally, then it shouldn't be a default */
 		return FALSE;
@@ -1845,3 +2665,88 @@ dbusmenu_menuitem_exposed (DbusmenuMenuitem * mi)
 	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
 	return priv->exposed;
 }
+
+/* Whether the property-changed signal being emitted is one of
+   the ones for a call to dbusmenu_menuitem_properties_set_manyv(),
+   in which case there is a properties-changed coming after it */
+gboolean
+dbusmenu_menuitem_in_property_batch (DbusmenuMenuitem * mi)
+{
+	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(mi), FALSE);
+	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
+	return priv->in_batch;
+}
+
+/* Adds someone to be told directly about changes to @mi.  Each
+   @data can only be there once, setting it again replaces the
+   observer that it had. */
+void
+dbusmenu_menuitem_set_observer (DbusmenuMenuitem * mi, const DbusmenuMenuitemObserver * observer, gpointer data)
+{
+	g_return_if_fail(DBUSMENU_IS_MENUITEM(mi));
+	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
+
+	if (observer == NULL) {
+		dbusmenu_menuitem_clear_observer(mi, data);
+		return;
+	}
+
+	if (priv->observer.observer == NULL || priv->observer.data == data) {
+		priv->observer.observer = observer;
+		priv->observer.data = data;
+		return;
+	}
+
+	if (priv->observers == NULL) {
+		priv->observers = g_array_sized_new(FALSE, FALSE, sizeof(observer_t), 1);
+	}
+
+	guint i;
+	for (i = 0; i < priv->observers->len; i++) {
+		observer_t * extra = &g_array_index(priv->observers, observer_t, i);
+		if (extra->data == data) {
+			extra->observer = observer;
+			return;
+		}
+	}
+
+	observer_t extra = { observer, data };
+	g_array_append_val(priv->observers, extra);
+
+	return;
+}
+
+/* Removes the observer on @mi that was set with @data, leaving
+   everyone else's alone */
+void
+dbusmenu_menuitem_clear_observer (DbusmenuMenuitem * mi, gpointer data)
+{
+	g_return_if_fail(DBUSMENU_IS_MENUITEM(mi));
+	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
+
+	if (priv->observer.observer != NULL && priv->observer.data == data) {
+		priv->observer.observer = NULL;
+		priv->observer.data = NULL;
+
+		/* The next one in line moves up */
+		if (priv->observers != NULL && priv->observers->len > 0) {
+			priv->observer = g_array_index(priv->observers, observer_t, 0);
+			g_array_remove_index(priv->observers, 0);
+		}
+	} else if (priv->observers != NULL) {
+		guint i;
+		for (i = 0; i < priv->observers->len; i++) {
+			if (g_array_index(priv->observers, observer_t, i).data == data) {
+				g_array_remove_index(priv->observers, i);
+				break;
+			}
+		}
+	}
+
+	if (priv->observers != NULL && priv->observers->len == 0) {
+		g_array_free(priv->observers, TRUE);
+		priv->observers = NULL;
+	}
+
+	return;
+}
@@ -50,6 +50,12 @@ G_BEGIN_DECLS
  * String to attach to signal #DbusmenuServer::property-changed
  */
 #define DBUSMENU_MENUITEM_SIGNAL_PROPERTY_CHANGED    "property-changed"
+/**
+ * DBUSMENU_MENUITEM_SIGNAL_PROPERTIES_CHANGED:
+ *
+ * String to attach to signal #DbusmenuServer::properties-changed
+ */
+#define DBUSMENU_MENUITEM_SIGNAL_PROPERTIES_CHANGED  "properties-changed"
 /**
  * DBUSMENU_MENUITEM_SIGNAL_ITEM_ACTIVATED:
  *
@@ -430,7 +436,7 @@ typedef GVariant * (*dbusmenu_menuitem_buildvariant_slot_t) (DbusmenuMenuitem *
  * @send_about_to_show: Virtual function that notifies server that the client is about to show a menu.
  * @show_to_user: Slot for #DbusmenuMenuitem::show-to-user.
  * @event: Slot for #DbsumenuMenuitem::event.
- * @reserved1: Reserved for future use.
+ * @properties_changed: Slot for #DbusmenuMenuitem::properties-changed.
  * @reserved2: Reserved for future use.
  * @reserved3: Reserved for future use.
  * @reserved4: Reserved for future use.
@@ -462,8 +468,9 @@ struct _DbusmenuMenuitemClass
 
 	void (*event) (const gchar * name, GVariant * value, guint timestamp);
 
+	void (*properties_changed) (DbusmenuMenuitem * mi, GVariant * changed, GStrv removed);
+
 	/*< Private >*/
-	void (*reserved1) (void);
 	void (*reserved2) (void);
 	void (*reserved3) (void);
 	void (*reserved4) (void);
@@ -498,6 +505,8 @@ gboolean dbusmenu_menuitem_property_set_variant (DbusmenuMenuitem * mi, const gc
 gboolean dbusmenu_menuitem_property_set_bool (DbusmenuMenuitem * mi, const gchar * property, const gboolean value);
 gboolean dbusmenu_menuitem_property_set_int (DbusmenuMenuitem * mi, const gchar * property, const gint value);
 gboolean dbusmenu_menuitem_property_set_byte_array (DbusmenuMenuitem * mi, const gchar * property, const guchar * value, gsize nelements);
+gboolean dbusmenu_menuitem_properties_set_many (DbusmenuMenuitem * mi, GVariant * properties);
+gboolean dbusmenu_menuitem_properties_set_manyv (DbusmenuMenuitem * mi, guint n_properties, const gchar ** properties, GVariant ** values);
 const gchar * dbusmenu_menuitem_property_get (const DbusmenuMenuitem * mi, const gchar * property);
 GVariant * dbusmenu_menuitem_property_get_variant (const DbusmenuMenuitem * mi, const gchar * property);
 gboolean dbusmenu_menuitem_property_get_bool (const DbusmenuMenuitem * mi, const gchar * property);
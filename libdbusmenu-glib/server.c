@@ -40,11 +40,23 @@ License version 3 and version 2.1 along with this program.  If not, see
 
 #include "dbus-menu-clean.xml.h"
 
-static void layout_update_signal (DbusmenuServer * server);
+static void layout_update_signal (DbusmenuServer * server, DbusmenuMenuitem * parent);
+static void layout_delta_reset (DbusmenuServer * server);
 
-#define DBUSMENU_VERSION_NUMBER    3
+#define DBUSMENU_VERSION_NUMBER    4
 #define DBUSMENU_INTERFACE         "com.canonical.dbusmenu"
 
+/* How many structural changes we remember so that clients can
+   ask for only what changed with GetLayoutDelta */
+#define LAYOUT_DELTA_MAX_OPS       64
+
+typedef struct _layout_op_t layout_op_t;
+struct _layout_op_t {
+	guint revision;
+	gint parent;
+	gint added; /* -1 if this wasn't an addition */
+};
+
 /* Privates, I'll show you mine... */
 struct _DbusmenuServerPrivate
 {
@@ -52,6 +64,7 @@ struct _DbusmenuServerPrivate
 	gchar * dbusobject;
 	gint layout_revision;
 	guint layout_idle;
+	gint layout_dirty; /* -1 when there's nothing to signal */
 
 	GDBusConnection * bus;
 	guint find_server_signal;
@@ -62,10 +75,33 @@ struct _DbusmenuServerPrivate
 	DbusmenuStatus status;
 	GStrv icon_dirs;
 
-	GArray * prop_array;
+	GHashTable * prop_table;
 	guint property_idle;
 
 	GHashTable * lookup_cache;
+
+	GHashTable * layout_cache;
+	guint layout_cache_hits;
+	guint layout_cache_misses;
+
+	layout_op_t layout_ops[LAYOUT_DELTA_MAX_OPS];
+	guint layout_ops_head;
+	guint layout_ops_len;
+	guint delta_floor;
+
+	guint freeze_count;
+	GHashTable * frozen_parents; /* items whose children changed while frozen */
+};
+
+/* How many different GetLayout replies we'll hold on to before
+   we figure someone is just asking for random things */
+#define LAYOUT_CACHE_MAX_ENTRIES   32
+
+typedef struct _layout_cache_t layout_cache_t;
+struct _layout_cache_t {
+	DbusmenuMenuitem * mi;
+	gint recurse;
+	GVariant * layout;
 };
 
 #define DBUSMENU_SERVER_GET_PRIVATE(o) (DBUSMENU_SERVER(o)->priv)
@@ -89,7 +125,9 @@ enum {
 	PROP_VERSION,
 	PROP_TEXT_DIRECTION,
 	PROP_STATUS,
-	PROP_ICON_THEME_DIRS
+	PROP_ICON_THEME_DIRS,
+	PROP_LAYOUT_CACHE_HITS,
+	PROP_LAYOUT_CACHE_MISSES
 };
 
 /* Errors */
@@ -99,6 +137,7 @@ enum {
 	UNKNOWN_DBUS_ERROR,
 	NOT_IMPLEMENTED,
 	NO_VALID_LAYOUT,
+	LAYOUT_REVISION_UNAVAILABLE,
 	LAST_ERROR
 };
 
@@ -113,6 +152,7 @@ struct _method_table_t {
 
 enum {
 	METHOD_GET_LAYOUT = 0,
+	METHOD_GET_LAYOUT_DELTA,
 	METHOD_GET_GROUP_PROPERTIES,
 	METHOD_GET_CHILDREN,
 	METHOD_GET_PROPERTY,
@@ -159,25 +199,24 @@ static GVariant * bus_get_prop                (GDBusConnection * connection,
                                                GError ** error,
                                                gpointer user_data);
 static void       menuitem_property_changed   (DbusmenuMenuitem * mi,
-                                               gchar * property,
+                                               const gchar * property,
                                                GVariant * variant,
-                                               DbusmenuServer * server);
-static void       menuitem_child_added        (DbusmenuMenuitem * parent,
-                                               DbusmenuMenuitem * child,
-                                               guint pos,
-                                               DbusmenuServer * server);
-static void       menuitem_child_removed      (DbusmenuMenuitem * parent,
-                                               DbusmenuMenuitem * child,
-                                               DbusmenuServer * server);
-static void       menuitem_signals_create     (DbusmenuMenuitem * mi,
+                                               gpointer user_data);
+static void       menuitem_observe            (DbusmenuMenuitem * mi,
                                                gpointer data);
-static void       menuitem_signals_remove     (DbusmenuMenuitem * mi,
+static void       menuitem_unobserve          (DbusmenuMenuitem * mi,
                                                gpointer data);
 static GQuark     error_quark                 (void);
-static void       prop_array_teardown         (GArray * prop_array);
+static void       prop_idle_item_free         (gpointer data);
+static void       layout_cache_free           (gpointer data);
+static void       layout_cache_invalidate     (DbusmenuServer * server,
+                                               DbusmenuMenuitem * mi);
 static void       bus_get_layout              (DbusmenuServer * server,
                                                GVariant * params,
                                                GDBusMethodInvocation * invocation);
+static void       bus_get_layout_delta        (DbusmenuServer * server,
+                                               GVariant * params,
+                                               GDBusMethodInvocation * invocation);
 static void       bus_get_group_properties    (DbusmenuServer * server,
                                                GVariant * params,
                                                GDBusMethodInvocation * invocation);
@@ -328,6 +367,16 @@ dbusmenu_server_class_init (DbusmenuServerClass *class)
 	                                              "Exports over DBus whether the menus should be given special visuals",
 	                                              DBUSMENU_TYPE_STATUS, DBUSMENU_STATUS_NORMAL,
 	                                              G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property (object_class, PROP_LAYOUT_CACHE_HITS,
+	                                 g_param_spec_uint(DBUSMENU_SERVER_PROP_LAYOUT_CACHE_HITS, "GetLayout replies served from cache",
+	                                              "The number of GetLayout calls that were answered without rebuilding the layout",
+	                                              0, G_MAXUINT, 0,
+	                                              G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property (object_class, PROP_LAYOUT_CACHE_MISSES,
+	                                 g_param_spec_uint(DBUSMENU_SERVER_PROP_LAYOUT_CACHE_MISSES, "GetLayout replies that were built",
+	                                              "The number of GetLayout calls that had to build the layout from the menuitems",
+	                                              0, G_MAXUINT, 0,
+	                                              G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
 
 	if (dbusmenu_node_info == NULL) {
 		GError * error = NULL;
@@ -351,6 +400,9 @@ dbusmenu_server_class_init (DbusmenuServerClass *class)
 	dbusmenu_method_table[METHOD_GET_LAYOUT].interned_name = g_intern_static_string("GetLayout");
 	dbusmenu_method_table[METHOD_GET_LAYOUT].func          = bus_get_layout;
 
+	dbusmenu_method_table[METHOD_GET_LAYOUT_DELTA].interned_name = g_intern_static_string("GetLayoutDelta");
+	dbusmenu_method_table[METHOD_GET_LAYOUT_DELTA].func          = bus_get_layout_delta;
+
 	dbusmenu_method_table[METHOD_GET_GROUP_PROPERTIES].interned_name = g_intern_static_string("GetGroupProperties");
 	dbusmenu_method_table[METHOD_GET_GROUP_PROPERTIES].func          = bus_get_group_properties;
 
@@ -389,6 +441,7 @@ dbusmenu_server_init (DbusmenuServer *self)
 	priv->dbusobject = NULL;
 	priv->layout_revision = 1;
 	priv->layout_idle = 0;
+	priv->layout_dirty = -1;
 	priv->bus = NULL;
 	priv->bus_lookup = NULL;
 	priv->find_server_signal = 0;
@@ -396,6 +449,17 @@ dbusmenu_server_init (DbusmenuServer *self)
 
 	priv->lookup_cache = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_object_unref);
 
+	priv->layout_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, layout_cache_free);
+	priv->layout_cache_hits = 0;
+	priv->layout_cache_misses = 0;
+
+	priv->layout_ops_head = 0;
+	priv->layout_ops_len = 0;
+	priv->delta_floor = priv->layout_revision;
+
+	priv->freeze_count = 0;
+	priv->frozen_parents = NULL;
+
 	default_text_direction(self);
 	priv->status = DBUSMENU_STATUS_NORMAL;
 	priv->icon_dirs = NULL;
@@ -418,13 +482,22 @@ dbusmenu_server_dispose (GObject *object)
 		priv->property_idle = 0;
 	}
 
-	if (priv->prop_array != NULL) {
-		prop_array_teardown(priv->prop_array);
-		priv->prop_array = NULL;
+	if (priv->prop_table != NULL) {
+		g_hash_table_destroy(priv->prop_table);
+		priv->prop_table = NULL;
+	}
+
+	if (priv->layout_cache != NULL) {
+		g_hash_table_remove_all(priv->layout_cache);
+	}
+
+	if (priv->frozen_parents != NULL) {
+		g_hash_table_destroy(priv->frozen_parents);
+		priv->frozen_parents = NULL;
 	}
 
 	if (priv->root != NULL) {
-		dbusmenu_menuitem_foreach(priv->root, menuitem_signals_remove, object);
+		dbusmenu_menuitem_foreach(priv->root, menuitem_unobserve, object);
 		g_object_unref(priv->root);
 	}
 
@@ -478,6 +551,11 @@ dbusmenu_server_finalize (GObject *object)
 		priv->lookup_cache = NULL;
 	}
 
+	if (priv->layout_cache) {
+		g_hash_table_destroy(priv->layout_cache);
+		priv->layout_cache = NULL;
+	}
+
 	G_OBJECT_CLASS (dbusmenu_server_parent_class)->finalize (object);
 	return;
 }
@@ -541,7 +619,7 @@ set_property (GObject * obj, guint id, const GValue * value, GParamSpec * pspec)
 		break;
 	case PROP_ROOT_NODE:
 		if (priv->root != NULL) {
-			dbusmenu_menuitem_foreach(priv->root, menuitem_signals_remove, obj);
+			dbusmenu_menuitem_foreach(priv->root, menuitem_unobserve, obj);
 			dbusmenu_menuitem_set_root(priv->root, FALSE);
 			cache_remove_entries_for_menuitem(priv->lookup_cache, priv->root);
 
@@ -561,7 +639,7 @@ set_property (GObject * obj, guint id, const GValue * value, GParamSpec * pspec)
 			g_object_ref(G_OBJECT(priv->root));
 			cache_add_entries_for_menuitem(priv->lookup_cache, priv->root);
 			dbusmenu_menuitem_set_root(priv->root, TRUE);
-			dbusmenu_menuitem_foreach(priv->root, menuitem_signals_create, obj);
+			dbusmenu_menuitem_foreach(priv->root, menuitem_observe, obj);
 
 			GList * properties = dbusmenu_menuitem_properties_list(priv->root);
 			GList * iter;
@@ -573,7 +651,8 @@ set_property (GObject * obj, guint id, const GValue * value, GParamSpec * pspec)
 		} else {
 			g_debug("Setting root node to NULL");
 		}
-		layout_update_signal(DBUSMENU_SERVER(obj));
+		layout_update_signal(DBUSMENU_SERVER(obj), NULL);
+		layout_delta_reset(DBUSMENU_SERVER(obj));
 		break;
 	case PROP_TEXT_DIRECTION: {
 		DbusmenuTextDirection indir = g_value_get_enum(value);
@@ -662,6 +741,12 @@ get_property (GObject * obj, guint id, GValue * value, GParamSpec * pspec)
 	case PROP_STATUS:
 		g_value_set_enum(value, priv->status);
 		break;
+	case PROP_LAYOUT_CACHE_HITS:
+		g_value_set_uint(value, priv->layout_cache_hits);
+		break;
+	case PROP_LAYOUT_CACHE_MISSES:
+		g_value_set_uint(value, priv->layout_cache_misses);
+		break;
 	default:
 		g_return_if_reached();
 		break;
@@ -884,14 +969,21 @@ layout_update_idle (gpointer user_data)
 	DbusmenuServer * server = DBUSMENU_SERVER(user_data);
 	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
 
-	g_signal_emit(G_OBJECT(server), signals[LAYOUT_UPDATED], 0, priv->layout_revision, 0, TRUE);
+	/* Only point at the part of the tree that changed */
+	gint parent = priv->layout_dirty;
+	if (parent < 0 || lookup_menuitem_by_id(server, parent) == NULL) {
+		parent = 0;
+	}
+	priv->layout_dirty = -1;
+
+	g_signal_emit(G_OBJECT(server), signals[LAYOUT_UPDATED], 0, priv->layout_revision, parent, TRUE);
 	if (priv->dbusobject != NULL && priv->bus != NULL) {
 		g_dbus_connection_emit_signal(priv->bus,
 		                              NULL,
 		                              priv->dbusobject,
 		                              DBUSMENU_INTERFACE,
 		                              "LayoutUpdated",
-		                              g_variant_new("(ui)", priv->layout_revision, 0),
+		                              g_variant_new("(ui)", priv->layout_revision, parent),
 		                              NULL);
 	}
 
@@ -900,13 +992,96 @@ layout_update_idle (gpointer user_data)
 	return FALSE;
 }
 
-/* Signals that the layout has been updated */
+/* How many parents there are above @mi */
+static guint
+layout_dirty_depth (DbusmenuMenuitem * mi)
+{
+	guint depth = 0;
+
+	for (mi = dbusmenu_menuitem_get_parent(mi); mi != NULL; mi = dbusmenu_menuitem_get_parent(mi)) {
+		depth++;
+	}
+
+	return depth;
+}
+
+/* Find the closest item that has both @a and @b under it, which
+   is the narrowest subtree that covers both changes.  Returns
+   zero, the root, if they're not in the same tree. */
+static gint
+layout_dirty_merge (DbusmenuServer * server, gint a, gint b)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+
+	if (a == b) {
+		return a;
+	}
+
+	if (a == 0 || b == 0) {
+		return 0;
+	}
+
+	DbusmenuMenuitem * ami = lookup_menuitem_by_id(server, a);
+	DbusmenuMenuitem * bmi = lookup_menuitem_by_id(server, b);
+
+	if (ami == NULL || bmi == NULL) {
+		return 0;
+	}
+
+	/* Bring them up to the same depth, then walk up together
+	   until they meet */
+	guint adepth = layout_dirty_depth(ami);
+	guint bdepth = layout_dirty_depth(bmi);
+
+	for (; adepth > bdepth; adepth--) {
+		ami = dbusmenu_menuitem_get_parent(ami);
+	}
+	for (; bdepth > adepth; bdepth--) {
+		bmi = dbusmenu_menuitem_get_parent(bmi);
+	}
+
+	while (ami != bmi) {
+		ami = dbusmenu_menuitem_get_parent(ami);
+		bmi = dbusmenu_menuitem_get_parent(bmi);
+	}
+
+	if (ami == NULL || ami == priv->root) {
+		return 0;
+	}
+
+	return dbusmenu_menuitem_get_id(ami);
+}
+
+/* Signals that the layout has been updated under @parent, or
+   the whole layout if @parent is NULL */
 static void
-layout_update_signal (DbusmenuServer * server)
+layout_update_signal (DbusmenuServer * server, DbusmenuMenuitem * parent)
 {
 	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
 	priv->layout_revision++;
 
+	/* Track the smallest subtree that covers everything that's
+	   changed before we get to signal it */
+	gint parentid = 0;
+	if (parent != NULL && parent != priv->root) {
+		parentid = dbusmenu_menuitem_get_id(parent);
+	}
+
+	if (priv->layout_dirty < 0) {
+		priv->layout_dirty = parentid;
+	} else {
+		priv->layout_dirty = layout_dirty_merge(server, priv->layout_dirty, parentid);
+	}
+
+	/* Every reply we've got has the old revision and the old
+	   structure in it, none of them are any good now. */
+	g_hash_table_remove_all(priv->layout_cache);
+
+	/* Thawing will signal it for us */
+	if (priv->freeze_count > 0) {
+		return;
+	}
+
 	if (priv->layout_idle == 0) {
 		priv->layout_idle = g_idle_add(layout_update_idle, server);
 	}
@@ -914,45 +1089,91 @@ layout_update_signal (DbusmenuServer * server)
 	return;
 }
 
+/* Forget all the changes that we've recorded, clients older
+   than the current revision will need to get a full layout */
+static void
+layout_delta_reset (DbusmenuServer * server)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+
+	priv->layout_ops_head = 0;
+	priv->layout_ops_len = 0;
+	priv->delta_floor = priv->layout_revision;
+
+	return;
+}
+
+/* Record a structural change to @parent at the current revision
+   so that we can tell clients about it with GetLayoutDelta */
+static void
+layout_delta_record (DbusmenuServer * server, DbusmenuMenuitem * parent, DbusmenuMenuitem * added)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+
+	if (priv->layout_ops_len == LAYOUT_DELTA_MAX_OPS) {
+		/* Dropping the oldest entry means that we can no longer
+		   answer for anyone from before it */
+		priv->delta_floor = priv->layout_ops[priv->layout_ops_head].revision;
+		priv->layout_ops_head = (priv->layout_ops_head + 1) % LAYOUT_DELTA_MAX_OPS;
+		priv->layout_ops_len--;
+	}
+
+	layout_op_t * op = &priv->layout_ops[(priv->layout_ops_head + priv->layout_ops_len) % LAYOUT_DELTA_MAX_OPS];
+	priv->layout_ops_len++;
+
+	op->revision = priv->layout_revision;
+	/* The root is always zero on the bus */
+	op->parent = (parent == priv->root) ? 0 : dbusmenu_menuitem_get_id(parent);
+	op->added = (added != NULL) ? dbusmenu_menuitem_get_id(added) : -1;
+
+	return;
+}
+
+/* All of the properties that have changed on a single menuitem
+   since the last time we signaled.  The property names are
+   interned so the table can use pointer compares, and a NULL
+   value means the property was removed. */
 typedef struct _prop_idle_item_t prop_idle_item_t;
 struct _prop_idle_item_t {
 	DbusmenuMenuitem * mi;
-	GArray * array;
+	GHashTable * props;
 };
 
-typedef struct _prop_idle_prop_t prop_idle_prop_t;
-struct _prop_idle_prop_t {
-	gchar * property;
-	GVariant * variant;
-};
+/* Unref a variant that might be NULL */
+static void
+prop_idle_value_free (gpointer data)
+{
+	if (data != NULL) {
+		g_variant_unref((GVariant *)data);
+	}
+	return;
+}
 
 /* Takes appart our data structure so we don't leak any
    memory or references. */
 static void
-prop_array_teardown (GArray * prop_array)
+prop_idle_item_free (gpointer data)
 {
-	int i, j;
+	prop_idle_item_t * item = (prop_idle_item_t *)data;
 
-	for (i = 0; i < prop_array->len; i++) {
-		prop_idle_item_t * iitem = &g_array_index(prop_array, prop_idle_item_t, i);
-		
-		for (j = 0; j < iitem->array->len; j++) {
-			prop_idle_prop_t * iprop = &g_array_index(iitem->array, prop_idle_prop_t, j);
+	g_hash_table_destroy(item->props);
+	g_object_unref(G_OBJECT(item->mi));
+	g_free(item);
 
-			g_free(iprop->property);
+	return;
+}
 
-			if (iprop->variant != NULL) {
-				g_variant_unref(iprop->variant);
-			}
-		}
+/* Removes any pending property changes for an item and all of its
+   children as they're not in our tree anymore. */
+static void
+prop_table_remove_entries_for_menuitem (GHashTable * table, DbusmenuMenuitem * item)
+{
+	g_hash_table_remove(table, item);
 
-		g_object_unref(G_OBJECT(iitem->mi));
-		g_array_free(iitem->array, TRUE);
+	GList *child, *children = dbusmenu_menuitem_get_children(item);
+	for (child = children; child != NULL; child = child->next) {
+		prop_table_remove_entries_for_menuitem(table, child->data);
 	}
-
-	g_array_free(prop_array, TRUE);
-
-	return;
 }
 
 /* Works in the idle to send a set of property updates so that they'll
@@ -966,19 +1187,22 @@ menuitem_property_idle (gpointer user_data)
 	priv->property_idle = 0;
 
 	/* If there are no items, let's just not signal */
-	if (priv->prop_array == NULL) {
+	if (priv->prop_table == NULL) {
 		return FALSE;
 	}
 
-	int i, j;
 	GVariantBuilder itembuilder;
 	gboolean item_init = FALSE;
 
 	GVariantBuilder removeitembuilder;
 	gboolean removeitem_init = FALSE;
 
-	for (i = 0; i < priv->prop_array->len; i++) {
-		prop_idle_item_t * iitem = &g_array_index(priv->prop_array, prop_idle_item_t, i);
+	GHashTableIter itemiter;
+	gpointer itemvalue;
+	g_hash_table_iter_init(&itemiter, priv->prop_table);
+
+	while (g_hash_table_iter_next(&itemiter, NULL, &itemvalue)) {
+		prop_idle_item_t * iitem = (prop_idle_item_t *)itemvalue;
 
 		/* if it's not exposed we're going to block it's properties
 		   from getting into the dbus message */
@@ -991,20 +1215,22 @@ menuitem_property_idle (gpointer user_data)
 
 		GVariantBuilder removedictbuilder;
 		gboolean removedictinit = FALSE;
+
+		GHashTableIter propiter;
+		gpointer propname, propvalue;
+		g_hash_table_iter_init(&propiter, iitem->props);
 		
 		/* Go throught each item and see if it should go in the removal list
 		   or the additive list. */
-		for (j = 0; j < iitem->array->len; j++) {
-			prop_idle_prop_t * iprop = &g_array_index(iitem->array, prop_idle_prop_t, j);
-
-			if (iprop->variant != NULL) {
+		while (g_hash_table_iter_next(&propiter, &propname, &propvalue)) {
+			if (propvalue != NULL) {
 				if (!dictinit) {
 					g_variant_builder_init(&dictbuilder, G_VARIANT_TYPE_DICTIONARY);
 					dictinit = TRUE;
 				}
 
-				GVariant * entry = g_variant_new_dict_entry(g_variant_new_string(iprop->property),
-				                                            g_variant_new_variant(iprop->variant));
+				GVariant * entry = g_variant_new_dict_entry(g_variant_new_string((const gchar *)propname),
+				                                            g_variant_new_variant((GVariant *)propvalue));
 
 				g_variant_builder_add_value(&dictbuilder, entry);
 			} else {
@@ -1013,7 +1239,7 @@ menuitem_property_idle (gpointer user_data)
 					removedictinit = TRUE;
 				}
 
-				g_variant_builder_add_value(&removedictbuilder, g_variant_new_string(iprop->property));
+				g_variant_builder_add_value(&removedictbuilder, g_variant_new_string((const gchar *)propname));
 			}
 		}
 
@@ -1108,16 +1334,17 @@ menuitem_property_idle (gpointer user_data)
 	}
 
 	/* Clean everything up */
-	prop_array_teardown(priv->prop_array);
-	priv->prop_array = NULL;
+	g_hash_table_destroy(priv->prop_table);
+	priv->prop_table = NULL;
 
 	return FALSE;
 }
 
-static void 
-menuitem_property_changed (DbusmenuMenuitem * mi, gchar * property, GVariant * variant, DbusmenuServer * server)
+/* Queues up a single property change on @mi to go out with the
+   next ItemsPropertiesUpdated */
+static void
+menuitem_property_queue (DbusmenuServer * server, DbusmenuMenuitem * mi, const gchar * property, GVariant * variant)
 {
-	int i;
 	gint item_id;
 
 	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
@@ -1126,45 +1353,21 @@ menuitem_property_changed (DbusmenuMenuitem * mi, gchar * property, GVariant * v
 
 	g_signal_emit(G_OBJECT(server), signals[ID_PROP_UPDATE], 0, item_id, property, variant, TRUE);
 
-	/* See if we have a property array, if not, we need to
+	/* See if we have a property table, if not, we need to
 	   build one of these suckers */
-	if (priv->prop_array == NULL) {
-		priv->prop_array = g_array_new(FALSE, FALSE, sizeof(prop_idle_item_t));
-	}
-
-	/* Look to see if we already have this item in the list
-	   and use it if so */
-	prop_idle_item_t * item = NULL;
-	for (i = 0; i < priv->prop_array->len; i++) {
-		prop_idle_item_t * iitem = &g_array_index(priv->prop_array, prop_idle_item_t, i);
-		if (iitem->mi == mi) {
-			item = iitem;
-			break;
-		}
+	if (priv->prop_table == NULL) {
+		priv->prop_table = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, prop_idle_item_free);
 	}
 
-	GArray * properties = NULL;
-	/* If not, we'll need to build ourselves one */
+	/* Look to see if we already have this item in the table
+	   and build one if not */
+	prop_idle_item_t * item = g_hash_table_lookup(priv->prop_table, mi);
 	if (item == NULL) {
-		prop_idle_item_t myitem;
-		myitem.mi = mi;
-		g_object_ref(G_OBJECT(mi));
-		myitem.array = g_array_new(FALSE, FALSE, sizeof(prop_idle_prop_t));
-
-		g_array_append_val(priv->prop_array, myitem);
-		properties = myitem.array;
-	} else {
-		properties = item->array;
-	}
+		item = g_new0(prop_idle_item_t, 1);
+		item->mi = g_object_ref(G_OBJECT(mi));
+		item->props = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, prop_idle_value_free);
 
-	/* Check to see if this property is in the list */
-	prop_idle_prop_t * prop = NULL;
-	for (i = 0; i < properties->len; i++) {
-		prop_idle_prop_t * iprop = &g_array_index(properties, prop_idle_prop_t, i);
-		if (g_strcmp0(iprop->property, property) == 0) {
-			prop = iprop;
-			break;
-		}
+		g_hash_table_insert(priv->prop_table, mi, item);
 	}
 
 	/* If it's the default value we want to treat it like a clearing
@@ -1174,82 +1377,163 @@ menuitem_property_changed (DbusmenuMenuitem * mi, gchar * property, GVariant * v
 		variant = NULL;
 	}
 
-	/* If so, we need to swap the value */
-	if (prop != NULL) {
-		if (prop->variant != NULL) {
-			g_variant_unref(prop->variant);
-		}
-		prop->variant = variant;
-	} else {
-	/* else we need to add it */
-		prop_idle_prop_t myprop;
-		myprop.property = g_strdup(property);
-		myprop.variant = variant;
-
-		g_array_append_val(properties, myprop);
-	}
 	if (variant != NULL) {
 		g_variant_ref_sink(variant);
 	}
 
+	/* Replaces the value if we already had one for this property */
+	g_hash_table_insert(item->props, (gpointer)g_intern_string(property), variant);
+
 	/* Check to see if the idle is already queued, and queue it
-	   if not. */
-	if (priv->property_idle == 0) {
+	   if not.  When we're frozen thawing sends them all. */
+	if (priv->property_idle == 0 && priv->freeze_count == 0) {
 		priv->property_idle = g_idle_add(menuitem_property_idle, server);
 	}
 
 	return;
 }
 
-/* Adds the signals for this entry to the list and looks at
-   the children of this entry to add the signals we need
-   as well.  We like signals. */
+static void 
+menuitem_property_changed (DbusmenuMenuitem * mi, const gchar * property, GVariant * variant, gpointer user_data)
+{
+	DbusmenuServer * server = DBUSMENU_SERVER(user_data);
+
+	layout_cache_invalidate(server, mi);
+	menuitem_property_queue(server, mi, property, variant);
+
+	return;
+}
+
+/* A whole set of properties changed on @mi at once */
+static void
+menuitem_properties_changed (DbusmenuMenuitem * mi, GVariant * changed, GStrv removed, gpointer user_data)
+{
+	DbusmenuServer * server = DBUSMENU_SERVER(user_data);
+	layout_cache_invalidate(server, mi);
+
+	GVariantIter iter;
+	const gchar * property;
+	GVariant * variant;
+
+	g_variant_iter_init(&iter, changed);
+	while (g_variant_iter_loop(&iter, "{&sv}", &property, &variant)) {
+		menuitem_property_queue(server, mi, property, variant);
+	}
+
+	gint i;
+	for (i = 0; removed != NULL && removed[i] != NULL; i++) {
+		menuitem_property_queue(server, mi, removed[i], dbusmenu_menuitem_property_get_variant(mi, removed[i]));
+	}
+
+	return;
+}
+
+/* Starts watching this entry and then looks at the children
+   of this entry to watch them as well. */
 static void
 added_check_children (gpointer data, gpointer user_data)
 {
 	DbusmenuMenuitem * mi = (DbusmenuMenuitem *)data;
 	DbusmenuServer * server = (DbusmenuServer *)user_data;
 
-	menuitem_signals_create(mi, server);
+	menuitem_observe(mi, server);
 	g_list_foreach(dbusmenu_menuitem_get_children(mi), added_check_children, server);
 
 	return;
 }
 
+/* Remember that the children of @parent changed while we were
+   frozen, we'll sort out what that means when we thaw. */
+static void
+frozen_parent_add (DbusmenuServer * server, DbusmenuMenuitem * parent)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+
+	/* The signal waits for the thaw, but the removed items are
+	   already gone from the lookup cache.  A cached reply would
+	   still have them, so anyone asking now gets the tree as it
+	   is instead. */
+	g_hash_table_remove_all(priv->layout_cache);
+
+	if (priv->frozen_parents == NULL) {
+		priv->frozen_parents = g_hash_table_new_full(g_direct_hash, g_direct_equal, g_object_unref, NULL);
+	}
+
+	if (!g_hash_table_contains(priv->frozen_parents, parent)) {
+		g_hash_table_add(priv->frozen_parents, g_object_ref(parent));
+	}
+
+	return;
+}
+
 /* Callback for when a child is added.  We need to connect everything
    up and signal that the layout has changed. */
 static void
-menuitem_child_added (DbusmenuMenuitem * parent, DbusmenuMenuitem * child, guint pos, DbusmenuServer * server)
+menuitem_child_added (DbusmenuMenuitem * parent, DbusmenuMenuitem * child, guint pos, gpointer user_data)
 {
-	menuitem_signals_create(child, server);
+	DbusmenuServer * server = DBUSMENU_SERVER(user_data);
+
+	/* The child gets connected up on thaw, along with anything
+	   that gets added under it in the meantime. */
+	if (server->priv->freeze_count > 0) {
+		frozen_parent_add(server, parent);
+		return;
+	}
+
+	menuitem_observe(child, server);
 	cache_add_entries_for_menuitem(server->priv->lookup_cache, child);
 	g_list_foreach(dbusmenu_menuitem_get_children(child), added_check_children, server);
 
-	layout_update_signal(server);
+	layout_update_signal(server, parent);
+	layout_delta_record(server, parent, child);
 	return;
 }
 
 static void 
-menuitem_child_removed (DbusmenuMenuitem * parent, DbusmenuMenuitem * child, DbusmenuServer * server)
+menuitem_child_removed (DbusmenuMenuitem * parent, DbusmenuMenuitem * child, gpointer user_data)
 {
-	menuitem_signals_remove(child, server);
+	DbusmenuServer * server = DBUSMENU_SERVER(user_data);
+
+	/* Everything under the child is going with it */
+	dbusmenu_menuitem_foreach(child, menuitem_unobserve, server);
 	cache_remove_entries_for_menuitem(server->priv->lookup_cache, child);
-	layout_update_signal(server);
+
+	/* No one is going to ask about these properties now */
+	if (server->priv->prop_table != NULL) {
+		prop_table_remove_entries_for_menuitem(server->priv->prop_table, child);
+	}
+
+	if (server->priv->freeze_count > 0) {
+		frozen_parent_add(server, parent);
+		return;
+	}
+
+	layout_update_signal(server, parent);
+	layout_delta_record(server, parent, NULL);
 	return;
 }
 
 static void 
-menuitem_child_moved (DbusmenuMenuitem * parent, DbusmenuMenuitem * child, guint newpos, guint oldpos, DbusmenuServer * server)
+menuitem_child_moved (DbusmenuMenuitem * parent, DbusmenuMenuitem * child, guint newpos, guint oldpos, gpointer user_data)
 {
-	layout_update_signal(server);
+	DbusmenuServer * server = DBUSMENU_SERVER(user_data);
+
+	if (server->priv->freeze_count > 0) {
+		frozen_parent_add(server, parent);
+		return;
+	}
+
+	layout_update_signal(server, parent);
+	layout_delta_record(server, parent, NULL);
 	return;
 }
 
 /* Called when a menu item emits its activated signal so it
    gets passed across the bus. */
 static void 
-menuitem_shown (DbusmenuMenuitem * mi, guint timestamp, DbusmenuServer * server)
+menuitem_shown (DbusmenuMenuitem * mi, guint timestamp, gpointer user_data)
 {
+	DbusmenuServer * server = DBUSMENU_SERVER(user_data);
 	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
 
 	g_signal_emit(G_OBJECT(server), signals[ITEM_ACTIVATION], 0, dbusmenu_menuitem_get_id(mi), timestamp, TRUE);
@@ -1267,29 +1551,30 @@ menuitem_shown (DbusmenuMenuitem * mi, guint timestamp, DbusmenuServer * server)
 	return;
 }
 
-/* Connects all the signals that we're interested in
-   coming from a menuitem */
+/* Everything that the server wants to hear about from the
+   menuitems in its tree, set once on each item */
+static const DbusmenuMenuitemObserver server_observer = {
+	.property_changed   = menuitem_property_changed,
+	.properties_changed = menuitem_properties_changed,
+	.child_added        = menuitem_child_added,
+	.child_removed      = menuitem_child_removed,
+	.child_moved        = menuitem_child_moved,
+	.show_to_user       = menuitem_shown
+};
+
+/* Start watching @mi for changes */
 static void
-menuitem_signals_create (DbusmenuMenuitem * mi, gpointer data)
+menuitem_observe (DbusmenuMenuitem * mi, gpointer data)
 {
-	g_signal_connect(G_OBJECT(mi), DBUSMENU_MENUITEM_SIGNAL_CHILD_ADDED, G_CALLBACK(menuitem_child_added), data);
-	g_signal_connect(G_OBJECT(mi), DBUSMENU_MENUITEM_SIGNAL_CHILD_REMOVED, G_CALLBACK(menuitem_child_removed), data);
-	g_signal_connect(G_OBJECT(mi), DBUSMENU_MENUITEM_SIGNAL_CHILD_MOVED, G_CALLBACK(menuitem_child_moved), data);
-	g_signal_connect(G_OBJECT(mi), DBUSMENU_MENUITEM_SIGNAL_PROPERTY_CHANGED, G_CALLBACK(menuitem_property_changed), data);
-	g_signal_connect(G_OBJECT(mi), DBUSMENU_MENUITEM_SIGNAL_SHOW_TO_USER, G_CALLBACK(menuitem_shown), data);
+	dbusmenu_menuitem_set_observer(mi, &server_observer, data);
 	return;
 }
 
-/* Removes all the signals that we're interested in
-   coming from a menuitem */
+/* Stop watching @mi for changes */
 static void
-menuitem_signals_remove (DbusmenuMenuitem * mi, gpointer data)
+menuitem_unobserve (DbusmenuMenuitem * mi, gpointer data)
 {
-	g_signal_handlers_disconnect_by_func(G_OBJECT(mi), G_CALLBACK(menuitem_child_added), data);
-	g_signal_handlers_disconnect_by_func(G_OBJECT(mi), G_CALLBACK(menuitem_child_removed), data);
-	g_signal_handlers_disconnect_by_func(G_OBJECT(mi), G_CALLBACK(menuitem_child_moved), data);
-	g_signal_handlers_disconnect_by_func(G_OBJECT(mi), G_CALLBACK(menuitem_property_changed), data);
-	g_signal_handlers_disconnect_by_func(G_OBJECT(mi), G_CALLBACK(menuitem_shown), data);
+	dbusmenu_menuitem_clear_observer(mi, data);
 	return;
 }
 
@@ -1303,6 +1588,65 @@ error_quark (void)
 	return quark;
 }
 
+/* Frees an entry in the layout cache */
+static void
+layout_cache_free (gpointer data)
+{
+	layout_cache_t * entry = (layout_cache_t *)data;
+
+	g_variant_unref(entry->layout);
+	g_free(entry);
+
+	return;
+}
+
+/* Looks to see if the menuitem that changed is inside the
+   layout that the cache entry is holding */
+static gboolean
+layout_cache_covers (gpointer key, gpointer value, gpointer user_data)
+{
+	layout_cache_t * entry = (layout_cache_t *)value;
+	DbusmenuMenuitem * mi = DBUSMENU_MENUITEM(user_data);
+	gint depth = 0;
+
+	while (mi != NULL) {
+		if (mi == entry->mi) {
+			return entry->recurse < 0 || depth <= entry->recurse;
+		}
+
+		mi = dbusmenu_menuitem_get_parent(mi);
+		depth++;
+	}
+
+	return FALSE;
+}
+
+/* Drop all of the cached layouts that have the properties of
+   the menuitem @mi in them. */
+static void
+layout_cache_invalidate (DbusmenuServer * server, DbusmenuMenuitem * mi)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+
+	if (g_hash_table_size(priv->layout_cache) == 0) {
+		return;
+	}
+
+	g_hash_table_foreach_remove(priv->layout_cache, layout_cache_covers, mi);
+	return;
+}
+
+/* Build the key for the layout cache out of the parameters
+   that were passed to GetLayout */
+static gchar *
+layout_cache_key (gint parent, gint recurse, const gchar ** props)
+{
+	gchar * joined = g_strjoinv("\n", (gchar **)props);
+	gchar * key = g_strdup_printf("%d:%d:%s", parent, recurse, joined);
+	g_free(joined);
+	return key;
+}
+
 /* DBus interface */
 static void
 bus_get_layout (DbusmenuServer * server, GVariant * params, GDBusMethodInvocation * invocation)
@@ -1323,12 +1667,34 @@ bus_get_layout (DbusmenuServer * server, GVariant * params, GDBusMethodInvocatio
 	GVariant * items = NULL;
 
 	if (priv->root != NULL) {
-		DbusmenuMenuitem * mi = lookup_menuitem_by_id(server, parent);
+		gchar * key = layout_cache_key(parent, recurse, props);
+		layout_cache_t * entry = g_hash_table_lookup(priv->layout_cache, key);
 
-		if (mi != NULL) {
-			items = dbusmenu_menuitem_build_variant(mi, props, recurse);
-			if (items) {
-				g_variant_ref_sink(items);
+		if (entry != NULL) {
+			priv->layout_cache_hits++;
+			items = g_variant_ref(entry->layout);
+			g_free(key);
+		} else {
+			DbusmenuMenuitem * mi = lookup_menuitem_by_id(server, parent);
+
+			if (mi != NULL) {
+				priv->layout_cache_misses++;
+				items = dbusmenu_menuitem_build_variant(mi, props, recurse);
+			}
+
+			if (items != NULL) {
+				if (g_hash_table_size(priv->layout_cache) >= LAYOUT_CACHE_MAX_ENTRIES) {
+					g_hash_table_remove_all(priv->layout_cache);
+				}
+
+				entry = g_new0(layout_cache_t, 1);
+				entry->mi = mi;
+				entry->recurse = recurse;
+				entry->layout = g_variant_ref(items);
+
+				g_hash_table_insert(priv->layout_cache, key, entry);
+			} else {
+				g_free(key);
 			}
 		}
 	}
@@ -1368,6 +1734,98 @@ bus_get_layout (DbusmenuServer * server, GVariant * params, GDBusMethodInvocatio
 	return;
 }
 
+/* Sends back only the parts of the layout that have changed since
+   the revision the client has.  For each parent that has changed we
+   send the IDs of all of its children in order, and the full layout
+   of the ones that have been added since then. */
+static void
+bus_get_layout_delta (DbusmenuServer * server, GVariant * params, GDBusMethodInvocation * invocation)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+
+	/* Input */
+	guint since;
+	const gchar ** props;
+
+	g_variant_get(params, "(u^a&s)", &since, &props);
+
+	if (priv->root == NULL || since < priv->delta_floor || since > (guint)priv->layout_revision) {
+		g_free(props);
+		g_dbus_method_invocation_return_error(invocation,
+		                                      error_quark(),
+		                                      LAYOUT_REVISION_UNAVAILABLE,
+		                                      "Changes since revision %u are not available, use GetLayout",
+		                                      since);
+		return;
+	}
+
+	/* Figure out which parents have changed, and which of the items
+	   the client won't know about yet. */
+	GArray * parents = g_array_new(FALSE, FALSE, sizeof(gint));
+	GHashTable * dirty = g_hash_table_new(g_direct_hash, g_direct_equal);
+	GHashTable * added = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+	guint i;
+	for (i = 0; i < priv->layout_ops_len; i++) {
+		layout_op_t * op = &priv->layout_ops[(priv->layout_ops_head + i) % LAYOUT_DELTA_MAX_OPS];
+
+		if (op->revision <= since) {
+			continue;
+		}
+
+		if (!g_hash_table_contains(dirty, GINT_TO_POINTER(op->parent))) {
+			g_hash_table_add(dirty, GINT_TO_POINTER(op->parent));
+			g_array_append_val(parents, op->parent);
+		}
+
+		if (op->added >= 0) {
+			g_hash_table_add(added, GINT_TO_POINTER(op->added));
+		}
+	}
+
+	/* Output */
+	GVariantBuilder updates;
+	g_variant_builder_init(&updates, G_VARIANT_TYPE("a(iaiav)"));
+
+	for (i = 0; i < parents->len; i++) {
+		gint parentid = g_array_index(parents, gint, i);
+		DbusmenuMenuitem * parent = lookup_menuitem_by_id(server, parentid);
+
+		/* It's been removed itself, which its parent covers */
+		if (parent == NULL) {
+			continue;
+		}
+
+		GVariantBuilder ids;
+		GVariantBuilder layouts;
+		g_variant_builder_init(&ids, G_VARIANT_TYPE("ai"));
+		g_variant_builder_init(&layouts, G_VARIANT_TYPE("av"));
+
+		GList * child;
+		for (child = dbusmenu_menuitem_get_children(parent); child != NULL; child = g_list_next(child)) {
+			gint childid = dbusmenu_menuitem_get_id(DBUSMENU_MENUITEM(child->data));
+			g_variant_builder_add(&ids, "i", childid);
+
+			if (g_hash_table_contains(added, GINT_TO_POINTER(childid))) {
+				GVariant * layout = dbusmenu_menuitem_build_variant(DBUSMENU_MENUITEM(child->data), props, -1);
+				g_variant_builder_add_value(&layouts, g_variant_new_variant(layout));
+				g_variant_unref(layout);
+			}
+		}
+
+		g_variant_builder_add(&updates, "(i@ai@av)", parentid, g_variant_builder_end(&ids), g_variant_builder_end(&layouts));
+	}
+
+	g_hash_table_destroy(added);
+	g_hash_table_destroy(dirty);
+	g_array_free(parents, TRUE);
+	g_free(props);
+
+	g_dbus_method_invocation_return_value(invocation,
+	                                      g_variant_new("(u@a(iaiav))", priv->layout_revision, g_variant_builder_end(&updates)));
+	return;
+}
+
 /* Get a single property off of a single menuitem */
 static void
 bus_get_property (DbusmenuServer * server, GVariant * params, GDBusMethodInvocation * invocation)
@@ -1442,8 +1900,12 @@ bus_get_properties (DbusmenuServer * server, GVariant * params, GDBusMethodInvoc
 	}
 
 	GVariant * dict = dbusmenu_menuitem_properties_variant(mi, NULL);
+	if (dict == NULL) {
+		dict = g_variant_ref_sink(g_variant_new_array(G_VARIANT_TYPE("{sv}"), NULL, 0));
+	}
 
-	g_dbus_method_invocation_return_value(invocation, g_variant_new("(a{sv})", dict));
+	g_dbus_method_invocation_return_value(invocation, g_variant_new("(@a{sv})", dict));
+	g_variant_unref(dict);
 
 	return;
 }
@@ -1485,8 +1947,14 @@ bus_get_group_properties (DbusmenuServer * server, GVariant * params, GDBusMetho
 	}
 
 	GVariantIter *ids;
-	g_variant_get(params, "(aias)", &ids, NULL);
-	/* TODO: implementation ignores propertyNames declared in XML */
+	const gchar ** props_names = NULL;
+	g_variant_get(params, "(ai^a&s)", &ids, &props_names);
+
+	/* An empty list means that they want all of them */
+	if (props_names != NULL && props_names[0] == NULL) {
+		g_free(props_names);
+		props_names = NULL;
+	}
 
 	GVariantBuilder builder;
 	gboolean builder_init = FALSE;
@@ -1504,10 +1972,7 @@ bus_get_group_properties (DbusmenuServer * server, GVariant * params, GDBusMetho
 		GVariantBuilder wbuilder;
 		g_variant_builder_init(&wbuilder, G_VARIANT_TYPE_TUPLE);
 		g_variant_builder_add(&wbuilder, "i", id);
-		GVariant * props = dbusmenu_menuitem_properties_variant(mi, NULL);
-		if (props != NULL) {
-			g_variant_ref(props);
-		}
+		GVariant * props = dbusmenu_menuitem_properties_variant(mi, props_names);
 
 		if (props == NULL) {
 			GError * error = NULL;
@@ -1526,6 +1991,7 @@ bus_get_group_properties (DbusmenuServer * server, GVariant * params, GDBusMetho
 		g_variant_builder_add_value(&builder, mi_data);
 	}
 	g_variant_iter_free(ids);
+	g_free(props_names);
 
 	/* a standard reference that must be unrefed */
 	GVariant * ret = NULL;
@@ -1572,7 +2038,12 @@ serialize_menuitem(gpointer data, gpointer user_data)
 	g_variant_builder_add_value(&tuple, g_variant_new_int32(id));
 
 	GVariant * props = dbusmenu_menuitem_properties_variant(mi, NULL);
-	g_variant_builder_add_value(&tuple, props);
+	if (props != NULL) {
+		g_variant_builder_add_value(&tuple, props);
+		g_variant_unref(props);
+	} else {
+		g_variant_builder_add_value(&tuple, g_variant_new_array(G_VARIANT_TYPE("{sv}"), NULL, 0));
+	}
 
 	g_variant_builder_add_value(builder, g_variant_builder_end(&tuple));
 
@@ -2108,3 +2579,153 @@ dbusmenu_server_set_icon_paths (DbusmenuServer * server, GStrv icon_paths)
 
 	return;
 }
+
+/* Watches @mi and everything under it that we don't already
+   know about.  Anything that is in the lookup cache is already
+   watched and any changes under it were noted on their own. */
+static void
+frozen_attach (DbusmenuServer * server, DbusmenuMenuitem * mi)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+	gint id = dbusmenu_menuitem_get_id(mi);
+
+	if (g_hash_table_lookup(priv->lookup_cache, GINT_TO_POINTER(id)) == mi) {
+		return;
+	}
+
+	menuitem_observe(mi, server);
+	g_hash_table_insert(priv->lookup_cache, GINT_TO_POINTER(id), g_object_ref(mi));
+
+	GList * child;
+	for (child = dbusmenu_menuitem_get_children(mi); child != NULL; child = g_list_next(child)) {
+		frozen_attach(server, DBUSMENU_MENUITEM(child->data));
+	}
+
+	return;
+}
+
+/* Checks whether @mi is still hanging off of our root */
+static gboolean
+frozen_in_tree (DbusmenuServer * server, DbusmenuMenuitem * mi)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+
+	for (; mi != NULL; mi = dbusmenu_menuitem_get_parent(mi)) {
+		if (mi == priv->root) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/**
+	dbusmenu_server_freeze:
+	@server: The #DbusmenuServer to stop signaling changes on
+
+	Stops the server from tracking and signaling each change to its
+	menu tree.  This is useful when rebuilding large parts of a menu
+	as the only thing that is remembered while frozen is which items
+	had their children change.  Calls nest, and must be matched by
+	the same number of calls to dbusmenu_server_thaw().
+*/
+void
+dbusmenu_server_freeze (DbusmenuServer * server)
+{
+	g_return_if_fail(DBUSMENU_IS_SERVER(server));
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+
+	if (priv->freeze_count++ > 0) {
+		return;
+	}
+
+	/* Anything that is already queued goes out with the thaw */
+	if (priv->layout_idle != 0) {
+		g_source_remove(priv->layout_idle);
+		priv->layout_idle = 0;
+	}
+
+	if (priv->property_idle != 0) {
+		g_source_remove(priv->property_idle);
+		priv->property_idle = 0;
+	}
+
+	return;
+}
+
+/**
+	dbusmenu_server_thaw:
+	@server: The #DbusmenuServer to start signaling changes on again
+
+	Undoes a call to dbusmenu_server_freeze().  When the last freeze
+	is undone the server connects up any items that were added while
+	it was frozen and then signals a single layout update and a single
+	property update covering everything that changed.
+*/
+void
+dbusmenu_server_thaw (DbusmenuServer * server)
+{
+	g_return_if_fail(DBUSMENU_IS_SERVER(server));
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+	g_return_if_fail(priv->freeze_count > 0);
+
+	if (--priv->freeze_count > 0) {
+		return;
+	}
+
+	if (priv->frozen_parents != NULL) {
+		GHashTable * parents = priv->frozen_parents;
+		priv->frozen_parents = NULL;
+
+		GHashTableIter iter;
+		gpointer key;
+		g_hash_table_iter_init(&iter, parents);
+		while (g_hash_table_iter_next(&iter, &key, NULL)) {
+			DbusmenuMenuitem * parent = DBUSMENU_MENUITEM(key);
+
+			/* Went away with something further up */
+			if (!frozen_in_tree(server, parent)) {
+				continue;
+			}
+
+			gboolean added = FALSE;
+			GList * child;
+			for (child = dbusmenu_menuitem_get_children(parent); child != NULL; child = g_list_next(child)) {
+				DbusmenuMenuitem * mi = DBUSMENU_MENUITEM(child->data);
+
+				if (g_hash_table_lookup(priv->lookup_cache, GINT_TO_POINTER(dbusmenu_menuitem_get_id(mi))) == mi) {
+					continue;
+				}
+
+				frozen_attach(server, mi);
+
+				layout_update_signal(server, parent);
+				layout_delta_record(server, parent, mi);
+				added = TRUE;
+			}
+
+			/* Only removed or moved things */
+			if (!added) {
+				layout_update_signal(server, parent);
+				layout_delta_record(server, parent, NULL);
+			}
+		}
+
+		g_hash_table_destroy(parents);
+	}
+
+	if (priv->layout_idle != 0) {
+		g_source_remove(priv->layout_idle);
+		priv->layout_idle = 0;
+	}
+
+	if (priv->layout_dirty >= 0) {
+		layout_update_idle(server);
+	}
+
+	if (priv->prop_table != NULL) {
+		menuitem_property_idle(server);
+	}
+
+	return;
+}
@@ -105,6 +105,18 @@ G_BEGIN_DECLS
  * String to access property #DbusmenuServer:status
  */
 #define DBUSMENU_SERVER_PROP_STATUS            "status"
+/**
+ * DBUSMENU_SERVER_PROP_LAYOUT_CACHE_HITS:
+ *
+ * String to access property #DbusmenuServer:layout-cache-hits
+ */
+#define DBUSMENU_SERVER_PROP_LAYOUT_CACHE_HITS    "layout-cache-hits"
+/**
+ * DBUSMENU_SERVER_PROP_LAYOUT_CACHE_MISSES:
+ *
+ * String to access property #DbusmenuServer:layout-cache-misses
+ */
+#define DBUSMENU_SERVER_PROP_LAYOUT_CACHE_MISSES  "layout-cache-misses"
 
 typedef struct _DbusmenuServerPrivate DbusmenuServerPrivate;
 
@@ -171,6 +183,8 @@ void                    dbusmenu_server_set_status          (DbusmenuServer *
 GStrv                   dbusmenu_server_get_icon_paths      (DbusmenuServer *       server);
 void                    dbusmenu_server_set_icon_paths      (DbusmenuServer *       server,
                                                              GStrv                  icon_paths);
+void                    dbusmenu_server_freeze              (DbusmenuServer *       server);
+void                    dbusmenu_server_thaw                (DbusmenuServer *       server);
 
 /**
 	SECTION:server
@@ -43,6 +43,8 @@ License version 3 and version 2.1 along with this program.  If not, see
 struct _DbusmenuGtkClientPrivate {
 	GStrv old_themedirs;
 	GtkAccelGroup * agroup;
+	GHashTable * pending; /* DbusmenuMenuitem -> GPtrArray of property names */
+	guint pending_idle;
 };
 
 GHashTable * theme_dir_db = NULL;
@@ -60,6 +62,7 @@ static void new_child (DbusmenuMenuitem * mi, DbusmenuMenuitem * child, guint po
 static void delete_child (DbusmenuMenuitem * mi, DbusmenuMenuitem * child, DbusmenuGtkClient * gtkclient);
 static void move_child (DbusmenuMenuitem * mi, DbusmenuMenuitem * child, guint new, guint old, DbusmenuGtkClient * gtkclient);
 static void item_activate (DbusmenuClient * client, DbusmenuMenuitem * mi, guint timestamp, gpointer userdata);
+static void items_properties_changed (DbusmenuClient * client, GHashTable * batch, gpointer userdata);
 static void theme_dir_changed (DbusmenuClient * client, GStrv theme_dirs, gpointer userdata);
 static void remove_theme_dirs (GtkIconTheme * theme, GStrv dirs);
 static void event_result (DbusmenuClient * client, DbusmenuMenuitem * mi, const gchar * event, GVariant * variant, guint timestamp, GError * error);
@@ -99,6 +102,8 @@ dbusmenu_gtkclient_init (DbusmenuGtkClient *self)
 
 	priv->agroup = NULL;
 	priv->old_themedirs = NULL;
+	priv->pending = g_hash_table_new_full(g_direct_hash, g_direct_equal, g_object_unref, (GDestroyNotify)g_ptr_array_unref);
+	priv->pending_idle = 0;
 
 	/* We either build the theme db or we get a reference
 	   to it.  This way when all clients die the hashtable
@@ -124,6 +129,7 @@ dbusmenu_gtkclient_init (DbusmenuGtkClient *self)
 	g_signal_connect(G_OBJECT(self), DBUSMENU_CLIENT_SIGNAL_ITEM_ACTIVATE, G_CALLBACK(item_activate), NULL);
 	g_signal_connect(G_OBJECT(self), DBUSMENU_CLIENT_SIGNAL_ICON_THEME_DIRS_CHANGED, G_CALLBACK(theme_dir_changed), NULL);
 	g_signal_connect(G_OBJECT(self), DBUSMENU_CLIENT_SIGNAL_EVENT_RESULT, G_CALLBACK(event_result), NULL);
+	g_signal_connect(G_OBJECT(self), DBUSMENU_CLIENT_SIGNAL_ITEMS_PROPERTIES_CHANGED, G_CALLBACK(items_properties_changed), NULL);
 
 	theme_dir_changed(DBUSMENU_CLIENT(self), dbusmenu_client_get_icon_paths(DBUSMENU_CLIENT(self)), NULL);
 
@@ -156,6 +162,16 @@ dbusmenu_gtkclient_dispose (GObject *object)
 		dbusmenu_menuitem_foreach (root, clear_shortcut_foreach, object);
 	g_clear_object (&priv->agroup);
 
+	if (priv->pending_idle != 0) {
+		g_source_remove(priv->pending_idle);
+		priv->pending_idle = 0;
+	}
+
+	if (priv->pending != NULL) {
+		g_hash_table_unref(priv->pending);
+		priv->pending = NULL;
+	}
+
 	if (priv->old_themedirs) {
 		remove_theme_dirs(gtk_icon_theme_get_default(), priv->old_themedirs);
 		g_strfreev(priv->old_themedirs);
@@ -776,12 +792,12 @@ process_a11y_desc (DbusmenuMenuitem * mi, GtkMenuItem * gmi, GVariant * variant,
 	return;
 }
 
-/* Whenever we have a property change on a DbusmenuMenuitem
-   we need to be responsive to that. */
+/* Brings the GTK side of one item up to date with the current
+   value of @prop on the DbusmenuMenuitem */
 static void
-menu_prop_change_cb (DbusmenuMenuitem * mi, gchar * prop, GVariant * variant, DbusmenuGtkClient * gtkclient)
+menu_prop_apply (DbusmenuGtkClient * gtkclient, DbusmenuMenuitem * mi, GtkMenuItem * gmi, const gchar * prop)
 {
-	GtkMenuItem * gmi = dbusmenu_gtkclient_menuitem_get(gtkclient, mi);
+	GVariant * variant = dbusmenu_menuitem_property_get_variant(mi, prop);
 
 	if (!g_strcmp0(prop, DBUSMENU_MENUITEM_PROP_LABEL)) {
 		gtk_menu_item_set_label(gmi, variant == NULL ? NULL : g_variant_get_string(variant, NULL));
@@ -801,6 +817,125 @@ menu_prop_change_cb (DbusmenuMenuitem * mi, gchar * prop, GVariant * variant, Db
 		process_a11y_desc(mi, gmi, variant, gtkclient);
 	} else if (!g_strcmp0(prop, DBUSMENU_MENUITEM_PROP_SHORTCUT)) {
 		refresh_shortcut(gtkclient, mi);
+	} else if (!g_strcmp0(prop, DBUSMENU_MENUITEM_PROP_ICON_NAME) ||
+			!g_strcmp0(prop, DBUSMENU_MENUITEM_PROP_ICON_DATA)) {
+		/* Only the items we built can hold an image */
+		if (IS_GENERICMENUITEM(gmi)) {
+			image_property_handle(mi, prop, variant, gtkclient);
+		}
+	}
+
+	return;
+}
+
+/* Applies a list of changed properties to an item, each
+   property only gets looked at once. */
+static void
+menu_props_apply (DbusmenuGtkClient * gtkclient, DbusmenuMenuitem * mi, const gchar * const * props, guint len)
+{
+	GtkMenuItem * gmi = dbusmenu_gtkclient_menuitem_get(gtkclient, mi);
+	if (gmi == NULL) {
+		return;
+	}
+
+	guint i;
+	for (i = 0; i < len; i++) {
+		menu_prop_apply(gtkclient, mi, gmi, props[i]);
+	}
+
+	return;
+}
+
+/* Anything that didn't come in with a batch from the server,
+   like changes made locally, gets applied here. */
+static gboolean
+pending_idle (gpointer user_data)
+{
+	DbusmenuGtkClient * gtkclient = DBUSMENU_GTKCLIENT(user_data);
+	DbusmenuGtkClientPrivate * priv = DBUSMENU_GTKCLIENT_GET_PRIVATE(gtkclient);
+
+	priv->pending_idle = 0;
+
+	/* Swap it out so that changes made while applying
+	   start a new list */
+	GHashTable * pending = priv->pending;
+	priv->pending = g_hash_table_new_full(g_direct_hash, g_direct_equal, g_object_unref, (GDestroyNotify)g_ptr_array_unref);
+
+	GHashTableIter iter;
+	gpointer key, value;
+	g_hash_table_iter_init(&iter, pending);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		GPtrArray * props = (GPtrArray *)value;
+		menu_props_apply(gtkclient, DBUSMENU_MENUITEM(key), (const gchar * const *)props->pdata, props->len);
+	}
+
+	g_hash_table_unref(pending);
+
+	return FALSE;
+}
+
+/* Whenever we have a property change on a DbusmenuMenuitem
+   we need to be responsive to that.  Most come from the server
+   in batches, so we just note them and wait for the batch. */
+static void
+menu_prop_change_cb (DbusmenuMenuitem * mi, gchar * prop, GVariant * variant, DbusmenuGtkClient * gtkclient)
+{
+	DbusmenuGtkClientPrivate * priv = DBUSMENU_GTKCLIENT_GET_PRIVATE(gtkclient);
+
+	/* We've been disposed, nothing left to update */
+	if (priv->pending == NULL) {
+		return;
+	}
+
+	GPtrArray * props = g_hash_table_lookup(priv->pending, mi);
+	if (props == NULL) {
+		props = g_ptr_array_new_with_free_func(g_free);
+		g_hash_table_insert(priv->pending, g_object_ref(mi), props);
+	}
+
+	guint i;
+	for (i = 0; i < props->len; i++) {
+		if (g_strcmp0(g_ptr_array_index(props, i), prop) == 0) {
+			break;
+		}
+	}
+	if (i == props->len) {
+		g_ptr_array_add(props, g_strdup(prop));
+	}
+
+	if (priv->pending_idle == 0) {
+		priv->pending_idle = g_idle_add_full(G_PRIORITY_HIGH_IDLE, pending_idle, gtkclient, NULL);
+	}
+
+	return;
+}
+
+/* The server sent a set of property changes and they've all been
+   applied, so we can update each item once with all of its keys. */
+static void
+items_properties_changed (DbusmenuClient * client, GHashTable * batch, gpointer userdata)
+{
+	DbusmenuGtkClient * gtkclient = DBUSMENU_GTKCLIENT(client);
+	DbusmenuGtkClientPrivate * priv = DBUSMENU_GTKCLIENT_GET_PRIVATE(gtkclient);
+
+	if (priv->pending == NULL) {
+		return;
+	}
+
+	GHashTableIter iter;
+	gpointer key, value;
+	g_hash_table_iter_init(&iter, batch);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		DbusmenuMenuitem * mi = DBUSMENU_MENUITEM(key);
+		gchar ** props = (gchar **)value;
+
+		menu_props_apply(gtkclient, mi, (const gchar * const *)props, g_strv_length(props));
+		g_hash_table_remove(priv->pending, mi);
+	}
+
+	if (g_hash_table_size(priv->pending) == 0 && priv->pending_idle != 0) {
+		g_source_remove(priv->pending_idle);
+		priv->pending_idle = 0;
 	}
 
 	return;
@@ -1106,10 +1241,6 @@ new_item_normal (DbusmenuMenuitem * newitem, DbusmenuMenuitem * parent, Dbusmenu
 	                      DBUSMENU_MENUITEM_PROP_ICON_DATA,
 	                      dbusmenu_menuitem_property_get_variant(newitem, DBUSMENU_MENUITEM_PROP_ICON_DATA),
 	                      client);
-	g_signal_connect(G_OBJECT(newitem),
-	                 DBUSMENU_MENUITEM_SIGNAL_PROPERTY_CHANGED,
-	                 G_CALLBACK(image_property_handle),
-	                 client);
 
 	return TRUE;
 }
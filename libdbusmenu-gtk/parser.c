@@ -539,15 +539,8 @@ parse_menu_structure_helper (GtkWidget * widget, RecurseContext * recurse)
 		/* Check to see if we're in our parents list of children, if we have
 		   a parent. */
 		if (recurse->parent != NULL) {
-			GList * children = dbusmenu_menuitem_get_children (recurse->parent);
-			GList * peek = NULL;
-
-			if (children != NULL) {
-				peek = g_list_find (children, thisitem);
-			}
-
 			/* Oops, let's tell our parents about us */
-			if (peek == NULL) {
+			if (dbusmenu_menuitem_get_parent (thisitem) != recurse->parent) {
 				g_object_ref(thisitem);
 
 				DbusmenuMenuitem * parent = dbusmenu_menuitem_get_parent(thisitem);
@@ -647,13 +640,18 @@ construct_dbusmenu_for_widget (GtkWidget * widget)
 
       ParserData *pdata = (ParserData *)g_object_get_data(G_OBJECT(mi), PARSER_DATA);
 
+      // Collect the properties up so that they get set, and
+      // signaled, all at once
+      GVariantBuilder props;
+      g_variant_builder_init (&props, G_VARIANT_TYPE ("a{sv}"));
+
       gboolean visible = FALSE;
       gboolean sensitive = FALSE;
       if (GTK_IS_SEPARATOR_MENU_ITEM (widget) || !find_menu_child (widget, GTK_TYPE_LABEL))
         {
-          dbusmenu_menuitem_property_set (mi,
-                                          DBUSMENU_MENUITEM_PROP_TYPE,
-                                          DBUSMENU_CLIENT_TYPES_SEPARATOR);
+          g_variant_builder_add (&props, "{sv}",
+                                 DBUSMENU_MENUITEM_PROP_TYPE,
+                                 g_variant_new_string (DBUSMENU_CLIENT_TYPES_SEPARATOR));
 
           visible = gtk_widget_get_visible (widget);
           sensitive = gtk_widget_get_sensitive (widget);
@@ -667,13 +665,13 @@ construct_dbusmenu_for_widget (GtkWidget * widget)
 
           if (GTK_IS_CHECK_MENU_ITEM (widget))
             {
-              dbusmenu_menuitem_property_set (mi,
-                                              DBUSMENU_MENUITEM_PROP_TOGGLE_TYPE,
-                                              gtk_check_menu_item_get_draw_as_radio (GTK_CHECK_MENU_ITEM (widget)) ? DBUSMENU_MENUITEM_TOGGLE_RADIO : DBUSMENU_MENUITEM_TOGGLE_CHECK);
+              g_variant_builder_add (&props, "{sv}",
+                                     DBUSMENU_MENUITEM_PROP_TOGGLE_TYPE,
+                                     g_variant_new_string (gtk_check_menu_item_get_draw_as_radio (GTK_CHECK_MENU_ITEM (widget)) ? DBUSMENU_MENUITEM_TOGGLE_RADIO : DBUSMENU_MENUITEM_TOGGLE_CHECK));
 
-              dbusmenu_menuitem_property_set_int (mi,
-                                                  DBUSMENU_MENUITEM_PROP_TOGGLE_STATE,
-                                                  gtk_check_menu_item_get_active (GTK_CHECK_MENU_ITEM (widget)) ? DBUSMENU_MENUITEM_TOGGLE_STATE_CHECKED : DBUSMENU_MENUITEM_TOGGLE_STATE_UNCHECKED);
+              g_variant_builder_add (&props, "{sv}",
+                                     DBUSMENU_MENUITEM_PROP_TOGGLE_STATE,
+                                     g_variant_new_int32 (gtk_check_menu_item_get_active (GTK_CHECK_MENU_ITEM (widget)) ? DBUSMENU_MENUITEM_TOGGLE_STATE_CHECKED : DBUSMENU_MENUITEM_TOGGLE_STATE_UNCHECKED));
 
               pdata->widget_toggle_handler_id = g_signal_connect (widget, "activate", G_CALLBACK (checkbox_toggled), mi);
             }
@@ -701,7 +699,8 @@ construct_dbusmenu_for_widget (GtkWidget * widget)
           // Sometimes, an app will directly find and modify the label
           // (like empathy), so watch the label especially for that.
           gchar * text = sanitize_label (GTK_LABEL (label));
-          dbusmenu_menuitem_property_set (mi, DBUSMENU_MENUITEM_PROP_LABEL, text);
+          if (text != NULL)
+            g_variant_builder_add (&props, "{sv}", DBUSMENU_MENUITEM_PROP_LABEL, g_variant_new_string (text));
           g_free (text);
 
           pdata->label = label;
@@ -716,8 +715,8 @@ construct_dbusmenu_for_widget (GtkWidget * widget)
               // accessible name.
               const gchar * label_text = gtk_label_get_text (GTK_LABEL (label));
               const gchar * a11y_name = atk_object_get_name (accessible);
-              if (g_strcmp0 (a11y_name, label_text))
-                dbusmenu_menuitem_property_set (mi, DBUSMENU_MENUITEM_PROP_ACCESSIBLE_DESC, a11y_name);
+              if (g_strcmp0 (a11y_name, label_text) && a11y_name != NULL)
+                g_variant_builder_add (&props, "{sv}", DBUSMENU_MENUITEM_PROP_ACCESSIBLE_DESC, g_variant_new_string (a11y_name));
 
               // An application may set an alternate accessible name in the future,
               // so we had better watch out for it.
@@ -781,13 +780,15 @@ construct_dbusmenu_for_widget (GtkWidget * widget)
                             widget);
         }
 
-      dbusmenu_menuitem_property_set_bool (mi,
-                                           DBUSMENU_MENUITEM_PROP_VISIBLE,
-                                           visible);
+      g_variant_builder_add (&props, "{sv}",
+                             DBUSMENU_MENUITEM_PROP_VISIBLE,
+                             g_variant_new_boolean (visible));
 
-      dbusmenu_menuitem_property_set_bool (mi,
-                                           DBUSMENU_MENUITEM_PROP_ENABLED,
-                                           sensitive);
+      g_variant_builder_add (&props, "{sv}",
+                             DBUSMENU_MENUITEM_PROP_ENABLED,
+                             g_variant_new_boolean (sensitive));
+
+      dbusmenu_menuitem_properties_set_many (mi, g_variant_builder_end (&props));
 
       pdata->widget_notify_handler_id = g_signal_connect (widget, "notify",
                                                           G_CALLBACK (widget_notify_cb), mi);
@@ -124,6 +124,9 @@ set_props (DbusmenuMenuitem * mi, JsonObject * node)
 {
 	if (node == NULL) return;
 
+	GVariantBuilder builder;
+	g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
+
 	GList * members = NULL;
 	for (members = json_object_get_members(node); members != NULL; members = g_list_next(members)) {
 		const gchar * member = members->data;
@@ -135,10 +138,12 @@ set_props (DbusmenuMenuitem * mi, JsonObject * node)
 		GVariant * variant = node2variant(lnode, member);
 
 		if (variant != NULL) {
-			dbusmenu_menuitem_property_set_variant(mi, member, variant);
+			g_variant_builder_add(&builder, "{sv}", member, variant);
 		}
 	}
 
+	dbusmenu_menuitem_properties_set_many(mi, g_variant_builder_end(&builder));
+
 	return;
 }
 
@@ -0,0 +1,151 @@
+/*
+A test for libdbusmenu to ensure its quality.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it 
+under the terms of the GNU General Public License version 3, as published 
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but 
+WITHOUT ANY WARRANTY; without even the implied warranties of 
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR 
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along 
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <glib.h>
+
+#include <libdbusmenu-glib/client.h>
+#include <libdbusmenu-glib/menuitem.h>
+
+static GMainLoop * mainloop = NULL;
+static gboolean passed = TRUE;
+static guint batches = 0;
+
+/* Looks for the item in the batch and makes sure that it
+   has exactly the keys that we expect */
+static gboolean
+verify_keys (GHashTable * batch, DbusmenuMenuitem * root, gint id, const gchar ** expected)
+{
+	DbusmenuMenuitem * mi = dbusmenu_menuitem_find_id(root, id);
+	if (mi == NULL) {
+		g_debug("Unable to find item %d", id);
+		return FALSE;
+	}
+
+	gchar ** keys = g_hash_table_lookup(batch, mi);
+
+	if (expected == NULL) {
+		if (keys != NULL) {
+			g_debug("Item %d shouldn't be in the batch", id);
+			return FALSE;
+		}
+		return TRUE;
+	}
+
+	if (keys == NULL) {
+		g_debug("Item %d isn't in the batch", id);
+		return FALSE;
+	}
+
+	if (g_strv_length(keys) != g_strv_length((gchar **)expected)) {
+		g_debug("Item %d has %d keys instead of %d", id, g_strv_length(keys), g_strv_length((gchar **)expected));
+		return FALSE;
+	}
+
+	guint i;
+	for (i = 0; expected[i] != NULL; i++) {
+		guint j;
+		for (j = 0; keys[j] != NULL; j++) {
+			if (g_strcmp0(keys[j], expected[i]) == 0) {
+				break;
+			}
+		}
+
+		if (keys[j] == NULL) {
+			g_debug("Item %d is missing key '%s'", id, expected[i]);
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static gboolean
+done_func (gpointer data)
+{
+	g_main_loop_quit(mainloop);
+	return FALSE;
+}
+
+static void
+batch_cb (DbusmenuClient * client, GHashTable * batch, gpointer data)
+{
+	DbusmenuMenuitem * root = dbusmenu_client_get_root(client);
+	g_debug("Got a batch of %d items", g_hash_table_size(batch));
+
+	batches++;
+	if (batches != 1) {
+		g_debug("Expected only one batch");
+		passed = FALSE;
+		return;
+	}
+
+	const gchar * one[] = {DBUSMENU_MENUITEM_PROP_LABEL, DBUSMENU_MENUITEM_PROP_ICON_NAME, NULL};
+	const gchar * two[] = {DBUSMENU_MENUITEM_PROP_LABEL, NULL};
+	const gchar * three[] = {DBUSMENU_MENUITEM_PROP_ICON_NAME, NULL};
+
+	if (g_hash_table_size(batch) != 3 ||
+			!verify_keys(batch, root, 1, one) ||
+			!verify_keys(batch, root, 2, two) ||
+			!verify_keys(batch, root, 3, three) ||
+			!verify_keys(batch, root, 4, NULL)) {
+		passed = FALSE;
+	}
+
+	/* Everything should already be applied by the time we hear */
+	if (g_strcmp0(dbusmenu_menuitem_property_get(dbusmenu_menuitem_find_id(root, 2), DBUSMENU_MENUITEM_PROP_LABEL), "Two Final") != 0 ||
+			dbusmenu_menuitem_property_exist(dbusmenu_menuitem_find_id(root, 3), DBUSMENU_MENUITEM_PROP_ICON_NAME)) {
+		g_debug("Batch signaled before the values were applied");
+		passed = FALSE;
+	}
+
+	/* Give a bit to see if anything else comes in */
+	g_timeout_add(1000, done_func, NULL);
+
+	return;
+}
+
+static gboolean
+timer_func (gpointer data)
+{
+	g_debug("Death timer.  Oops.  Got %d batches", batches);
+	passed = FALSE;
+	g_main_loop_quit(mainloop);
+	return FALSE;
+}
+
+int
+main (int argc, char ** argv)
+{
+	DbusmenuClient * client = dbusmenu_client_new("org.dbusmenu.test", "/org/test");
+	g_signal_connect(G_OBJECT(client), DBUSMENU_CLIENT_SIGNAL_ITEMS_PROPERTIES_CHANGED, G_CALLBACK(batch_cb), NULL);
+
+	g_timeout_add_seconds(60, timer_func, client);
+
+	mainloop = g_main_loop_new(NULL, FALSE);
+	g_main_loop_run(mainloop);
+
+	g_object_unref(G_OBJECT(client));
+
+	if (passed && batches == 1) {
+		g_debug("Quiting");
+		return 0;
+	} else {
+		g_debug("Quiting as we're a failure");
+		return 1;
+	}
+}
@@ -0,0 +1,112 @@
+/*
+A test for libdbusmenu to ensure its quality.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it 
+under the terms of the GNU General Public License version 3, as published 
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but 
+WITHOUT ANY WARRANTY; without even the implied warranties of 
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR 
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along 
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <libdbusmenu-glib/server.h>
+#include <libdbusmenu-glib/menuitem.h>
+
+static DbusmenuServer * server = NULL;
+static DbusmenuMenuitem * root = NULL;
+static GMainLoop * mainloop = NULL;
+
+static DbusmenuMenuitem *
+find_item (gint id)
+{
+	return dbusmenu_menuitem_find_id(root, id);
+}
+
+/* Change a few things all at once so that they go out
+   in a single ItemsPropertiesUpdated */
+static gboolean
+change_props (gpointer data)
+{
+	g_debug("Changing properties");
+
+	dbusmenu_menuitem_property_set(find_item(1), DBUSMENU_MENUITEM_PROP_LABEL, "One Changed");
+	dbusmenu_menuitem_property_set(find_item(1), DBUSMENU_MENUITEM_PROP_ICON_NAME, "one-icon");
+	dbusmenu_menuitem_property_set(find_item(2), DBUSMENU_MENUITEM_PROP_LABEL, "Two Changed");
+	dbusmenu_menuitem_property_set(find_item(2), DBUSMENU_MENUITEM_PROP_LABEL, "Two Final");
+	dbusmenu_menuitem_property_remove(find_item(3), DBUSMENU_MENUITEM_PROP_ICON_NAME);
+
+	return FALSE;
+}
+
+static gboolean
+timer_func (gpointer data)
+{
+	g_main_loop_quit(mainloop);
+	return FALSE;
+}
+
+static void
+on_bus (GDBusConnection * connection, const gchar * name, gpointer user_data)
+{
+	server = dbusmenu_server_new("/org/test");
+
+	root = dbusmenu_menuitem_new_with_id(0);
+
+	gint id;
+	for (id = 1; id <= 4; id++) {
+		DbusmenuMenuitem * mi = dbusmenu_menuitem_new_with_id(id);
+		gchar * label = g_strdup_printf("Item %d", id);
+		dbusmenu_menuitem_property_set(mi, DBUSMENU_MENUITEM_PROP_LABEL, label);
+		g_free(label);
+		dbusmenu_menuitem_property_set(mi, DBUSMENU_MENUITEM_PROP_ICON_NAME, "start-icon");
+		dbusmenu_menuitem_child_append(root, mi);
+		g_object_unref(mi);
+	}
+
+	dbusmenu_server_set_root(server, root);
+
+	g_timeout_add(2000, change_props, NULL);
+	g_timeout_add(5000, timer_func, NULL);
+
+	return;
+}
+
+static void
+name_lost (GDBusConnection * connection, const gchar * name, gpointer user_data)
+{
+	g_error("Unable to get name '%s' on DBus", name);
+	g_main_loop_quit(mainloop);
+	return;
+}
+
+int
+main (int argc, char ** argv)
+{
+	g_bus_own_name(G_BUS_TYPE_SESSION,
+	               "org.dbusmenu.test",
+	               G_BUS_NAME_OWNER_FLAGS_NONE,
+	               on_bus,
+	               NULL,
+	               name_lost,
+	               NULL,
+	               NULL);
+
+	mainloop = g_main_loop_new(NULL, FALSE);
+	g_main_loop_run(mainloop);
+
+	g_object_unref(G_OBJECT(server));
+	g_object_unref(G_OBJECT(root));
+	g_debug("Quiting");
+
+	return 0;
+}
@@ -0,0 +1,197 @@
+/*
+A benchmark for libdbusmenu to watch how layout updates scale.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Builds a submenu of N children on a server, mirrors it with a
+   client in the same process and then times how long it takes the
+   client to catch up with small changes to the server's layout. */
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <libdbusmenu-glib/client.h>
+#include <libdbusmenu-glib/server.h>
+#include <libdbusmenu-glib/menuitem.h>
+
+#define ROUNDS  10
+#define TIMEOUT 60
+
+static const guint sizes[] = { 10, 100, 1000, 10000 };
+
+static guint moves = 0;
+
+static void
+child_moved (DbusmenuMenuitem * parent, DbusmenuMenuitem * child, guint newpos, guint oldpos, gpointer user_data)
+{
+	moves++;
+	return;
+}
+
+/* Check that the client's children have the same IDs in the same
+   order as the server's */
+static gboolean
+in_sync (DbusmenuMenuitem * serverroot, DbusmenuClient * client)
+{
+	DbusmenuMenuitem * clientroot = dbusmenu_client_get_root(client);
+	if (clientroot == NULL) {
+		return FALSE;
+	}
+
+	GList * serverchild = dbusmenu_menuitem_get_children(serverroot);
+	GList * clientchild = dbusmenu_menuitem_get_children(clientroot);
+
+	while (serverchild != NULL && clientchild != NULL) {
+		if (dbusmenu_menuitem_get_id(DBUSMENU_MENUITEM(serverchild->data)) != dbusmenu_menuitem_get_id(DBUSMENU_MENUITEM(clientchild->data))) {
+			return FALSE;
+		}
+
+		serverchild = g_list_next(serverchild);
+		clientchild = g_list_next(clientchild);
+	}
+
+	return serverchild == NULL && clientchild == NULL;
+}
+
+/* Spin the mainloop until the client matches the server, returns
+   the time it took in microseconds or -1 if it never did. */
+static gint64
+wait_for_sync (DbusmenuMenuitem * serverroot, DbusmenuClient * client)
+{
+	gint64 start = g_get_monotonic_time();
+
+	while (!in_sync(serverroot, client)) {
+		if (g_get_monotonic_time() - start > TIMEOUT * G_USEC_PER_SEC) {
+			return -1;
+		}
+		g_main_context_iteration(NULL, TRUE);
+	}
+
+	return g_get_monotonic_time() - start;
+}
+
+static void
+watch_client_root (DbusmenuClient * client, DbusmenuMenuitem * newroot, gpointer user_data)
+{
+	if (newroot != NULL) {
+		g_signal_connect(G_OBJECT(newroot), DBUSMENU_MENUITEM_SIGNAL_CHILD_MOVED, G_CALLBACK(child_moved), NULL);
+	}
+	return;
+}
+
+static gboolean
+bench_size (GDBusConnection * bus, guint size)
+{
+	gchar * path = g_strdup_printf("/org/dbusmenu/bench/%d", size);
+	DbusmenuServer * server = dbusmenu_server_new(path);
+	DbusmenuMenuitem * root = dbusmenu_menuitem_new();
+	guint i;
+
+	for (i = 0; i < size; i++) {
+		DbusmenuMenuitem * child = dbusmenu_menuitem_new();
+		gchar * label = g_strdup_printf("Item %d", i);
+		dbusmenu_menuitem_property_set(child, DBUSMENU_MENUITEM_PROP_LABEL, label);
+		dbusmenu_menuitem_child_append(root, child);
+		g_object_unref(child);
+		g_free(label);
+	}
+
+	dbusmenu_server_set_root(server, root);
+
+	DbusmenuClient * client = dbusmenu_client_new(g_dbus_connection_get_unique_name(bus), path);
+	g_signal_connect(G_OBJECT(client), DBUSMENU_CLIENT_SIGNAL_ROOT_CHANGED, G_CALLBACK(watch_client_root), NULL);
+
+	gboolean passed = TRUE;
+	gint64 initial = wait_for_sync(root, client);
+	gint64 rotate = 0;
+	gint64 replace = 0;
+	guint rotatemoves = 0;
+
+	if (initial < 0) {
+		g_warning("Client never got the initial layout for %d children", size);
+		passed = FALSE;
+	}
+
+	/* Take the last item and put it at the top, one move each time */
+	moves = 0;
+	for (i = 0; i < ROUNDS && passed; i++) {
+		GList * last = g_list_last(dbusmenu_menuitem_get_children(root));
+		dbusmenu_menuitem_child_reorder(root, DBUSMENU_MENUITEM(last->data), 0);
+
+		gint64 elapsed = wait_for_sync(root, client);
+		if (elapsed < 0) {
+			g_warning("Client never caught up with rotation %d for %d children", i, size);
+			passed = FALSE;
+		}
+		rotate += elapsed;
+	}
+	rotatemoves = moves;
+
+	/* Drop an item out of the middle and add a new one at the end */
+	for (i = 0; i < ROUNDS && passed; i++) {
+		GList * middle = g_list_nth(dbusmenu_menuitem_get_children(root), size / 2);
+		dbusmenu_menuitem_child_delete(root, DBUSMENU_MENUITEM(middle->data));
+
+		DbusmenuMenuitem * child = dbusmenu_menuitem_new();
+		dbusmenu_menuitem_property_set(child, DBUSMENU_MENUITEM_PROP_LABEL, "Replacement");
+		dbusmenu_menuitem_child_append(root, child);
+		g_object_unref(child);
+
+		gint64 elapsed = wait_for_sync(root, client);
+		if (elapsed < 0) {
+			g_warning("Client never caught up with replacement %d for %d children", i, size);
+			passed = FALSE;
+		}
+		replace += elapsed;
+	}
+
+	if (passed) {
+		g_print("%6d children: initial %8.2f ms  rotate %8.2f ms  replace %8.2f ms  (%d moves for %d rotations)\n",
+		        size,
+		        initial / 1000.0,
+		        rotate / 1000.0 / ROUNDS,
+		        replace / 1000.0 / ROUNDS,
+		        rotatemoves, ROUNDS);
+	}
+
+	g_object_unref(client);
+	g_object_unref(server);
+	g_object_unref(root);
+	g_free(path);
+
+	return passed;
+}
+
+int
+main (int argc, char ** argv)
+{
+	GDBusConnection * bus = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, NULL);
+	if (bus == NULL) {
+		g_warning("Unable to get the session bus");
+		return 1;
+	}
+
+	gboolean passed = TRUE;
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS(sizes) && passed; i++) {
+		passed = bench_size(bus, sizes[i]);
+	}
+
+	g_object_unref(bus);
+
+	return passed ? 0 : 1;
+}
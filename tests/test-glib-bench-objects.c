@@ -0,0 +1,181 @@
+/*
+A benchmark for libdbusmenu to watch what exporting a big tree costs.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Builds a tree of menuitems and times how long it takes a server
+   to start and stop exporting it, along with how much memory the
+   items themselves and the server's bookkeeping on them take.  No
+   bus is needed. */
+
+#include <string.h>
+
+#include <glib.h>
+#include <glib-object.h>
+
+#include <libdbusmenu-glib/server.h>
+#include <libdbusmenu-glib/menuitem.h>
+
+#define ITEMS   10000
+#define WIDTH   100
+#define ROUNDS  10
+
+/* Resident memory in kB, or zero if we can't tell */
+static gsize
+resident_kb (void)
+{
+	gchar * contents = NULL;
+	gsize resident = 0;
+
+	if (!g_file_get_contents("/proc/self/status", &contents, NULL, NULL)) {
+		return 0;
+	}
+
+	gchar * line = strstr(contents, "VmRSS:");
+	if (line != NULL) {
+		resident = g_ascii_strtoull(line + strlen("VmRSS:"), NULL, 10);
+	}
+
+	g_free(contents);
+	return resident;
+}
+
+/* A root with WIDTH submenus of ITEMS / WIDTH items each, all
+   of them with @property set */
+static DbusmenuMenuitem *
+build_tree (const gchar * property)
+{
+	DbusmenuMenuitem * root = dbusmenu_menuitem_new();
+	guint i, j;
+
+	for (i = 0; i < WIDTH; i++) {
+		DbusmenuMenuitem * submenu = dbusmenu_menuitem_new();
+		dbusmenu_menuitem_property_set(submenu, property, "Submenu");
+
+		for (j = 0; j < ITEMS / WIDTH - 1; j++) {
+			DbusmenuMenuitem * child = dbusmenu_menuitem_new();
+			dbusmenu_menuitem_property_set(child, property, "Item");
+			dbusmenu_menuitem_child_append(submenu, child);
+			g_object_unref(child);
+		}
+
+		dbusmenu_menuitem_child_append(root, submenu);
+		g_object_unref(submenu);
+	}
+
+	return root;
+}
+
+/* Sets the label on @mi and everything under it */
+static void
+set_all (DbusmenuMenuitem * mi, const gchar * label)
+{
+	GList * child;
+
+	dbusmenu_menuitem_property_set(mi, DBUSMENU_MENUITEM_PROP_LABEL, label);
+
+	for (child = dbusmenu_menuitem_get_children(mi); child != NULL; child = g_list_next(child)) {
+		set_all(DBUSMENU_MENUITEM(child->data), label);
+	}
+
+	return;
+}
+
+int
+main (int argc, char ** argv)
+{
+	gsize unbuilt = resident_kb();
+	DbusmenuMenuitem * trees[2] = { build_tree(DBUSMENU_MENUITEM_PROP_LABEL), NULL };
+	gsize built = resident_kb();
+	trees[1] = build_tree(DBUSMENU_MENUITEM_PROP_LABEL);
+
+	/* Names that aren't one of the standard ones get a copy
+	   for each item instead of being shared */
+	gsize otherunbuilt = resident_kb();
+	DbusmenuMenuitem * other = build_tree("x-bench-label");
+	gsize otherbuilt = resident_kb();
+	g_object_unref(other);
+
+	gint64 set_root = 0;
+	gint64 swap_root = 0;
+	gint64 teardown = 0;
+	gint64 prop_set = 0;
+	gsize before = 0;
+	gsize after = 0;
+	guint i;
+
+	for (i = 0; i < ROUNDS; i++) {
+		/* Not exported on the bus, so the server is just its
+		   bookkeeping on the items */
+		DbusmenuServer * server = g_object_new(DBUSMENU_TYPE_SERVER, NULL);
+		gint64 start;
+
+		/* Only the first time counts, after that it's reusing
+		   what the last server free'd */
+		if (i == 0) {
+			before = resident_kb();
+		}
+
+		g_object_ref(trees[0]);
+		start = g_get_monotonic_time();
+		dbusmenu_server_set_root(server, trees[0]);
+		set_root += g_get_monotonic_time() - start;
+
+		if (i == 0) {
+			after = resident_kb();
+		}
+
+		g_object_ref(trees[1]);
+		start = g_get_monotonic_time();
+		dbusmenu_server_set_root(server, trees[1]);
+		swap_root += g_get_monotonic_time() - start;
+
+		/* Every item telling the server about a change */
+		start = g_get_monotonic_time();
+		set_all(trees[1], i % 2 == 0 ? "Even" : "Odd");
+		prop_set += g_get_monotonic_time() - start;
+
+		start = g_get_monotonic_time();
+		g_object_unref(server);
+		teardown += g_get_monotonic_time() - start;
+	}
+
+	g_print("%d items: set_root %8.2f ms  swap root %8.2f ms  teardown %8.2f ms\n",
+	        ITEMS,
+	        set_root / 1000.0 / ROUNDS,
+	        swap_root / 1000.0 / ROUNDS,
+	        teardown / 1000.0 / ROUNDS);
+	g_print("%d items: setting a label on all of them while exported %8.2f ms\n",
+	        ITEMS,
+	        prop_set / 1000.0 / ROUNDS);
+	if (unbuilt != 0 && built >= unbuilt) {
+		g_print("%d items: building the tree grew resident memory by %" G_GSIZE_FORMAT " kB (%.1f bytes per item)\n",
+		        ITEMS, built - unbuilt, (built - unbuilt) * 1024.0 / ITEMS);
+	}
+	if (otherunbuilt != 0 && otherbuilt >= otherunbuilt) {
+		g_print("%d items: with a non-standard property name it grew by %" G_GSIZE_FORMAT " kB (%.1f bytes per item)\n",
+		        ITEMS, otherbuilt - otherunbuilt, (otherbuilt - otherunbuilt) * 1024.0 / ITEMS);
+	}
+	if (before != 0 && after >= before) {
+		g_print("%d items: exporting grew resident memory by %" G_GSIZE_FORMAT " kB (%.1f bytes per item)\n",
+		        ITEMS, after - before, (after - before) * 1024.0 / ITEMS);
+	}
+
+	g_object_unref(trees[0]);
+	g_object_unref(trees[1]);
+
+	return 0;
+}
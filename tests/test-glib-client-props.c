@@ -0,0 +1,397 @@
+/*
+A test for libdbusmenu to ensure its quality.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it 
+under the terms of the GNU General Public License version 3, as published 
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but 
+WITHOUT ANY WARRANTY; without even the implied warranties of 
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR 
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along 
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <libdbusmenu-glib/client.h>
+#include <libdbusmenu-glib/server.h>
+#include <libdbusmenu-glib/menuitem.h>
+
+#include "test-glib-inproc.h"
+
+static const guchar icon[] = { 0x89, 'P', 'N', 'G', 0x0d, 0x0a, 0x1a, 0x0a };
+static const gchar * labelonly[] = { DBUSMENU_MENUITEM_PROP_LABEL, NULL };
+
+/* Three items that all have a label and some icon data */
+static void
+filter_setup (test_fixture_t * test, const gchar * path)
+{
+	DbusmenuMenuitem * root = test_menu_new(3);
+
+	GList * child;
+	for (child = dbusmenu_menuitem_get_children(root); child != NULL; child = g_list_next(child)) {
+		dbusmenu_menuitem_property_set_byte_array(DBUSMENU_MENUITEM(child->data), DBUSMENU_MENUITEM_PROP_ICON_DATA, icon, sizeof(icon));
+	}
+
+	test_fixture_setup(test, path, root);
+
+	return;
+}
+
+/* A client that only wants @filter, or everything if it's NULL */
+static void
+filter_connect (test_fixture_t * test, const gchar * const * filter)
+{
+	DbusmenuClient * client = dbusmenu_client_new(g_dbus_connection_get_unique_name(test->bus), test->path);
+	dbusmenu_client_set_property_filter(client, filter);
+	test_fixture_connect(test, client);
+	return;
+}
+
+static DbusmenuMenuitem *
+filter_client_item (DbusmenuClient * client, gint id)
+{
+	DbusmenuMenuitem * item = dbusmenu_menuitem_find_id(dbusmenu_client_get_root(client), id);
+	g_assert(item != NULL);
+	return item;
+}
+
+/* The icon data shouldn't be in the layout the server sends
+   back, but it should be there for a client that wants it */
+static void
+test_filter_layout (void)
+{
+	test_fixture_t test;
+	filter_setup(&test, "/org/test/filter/layout");
+	test_calls_reset();
+	test_watch_property(DBUSMENU_MENUITEM_PROP_ICON_DATA);
+
+	filter_connect(&test, labelonly);
+
+	g_assert(test_calls_count("GetLayout") >= 1);
+	g_assert(test_watch_count() == 0);
+
+	DbusmenuMenuitem * item = filter_client_item(test.client, 2);
+	g_assert(g_strcmp0(dbusmenu_menuitem_property_get(item, DBUSMENU_MENUITEM_PROP_LABEL), "Item 2") == 0);
+	g_assert(!dbusmenu_menuitem_property_exist(item, DBUSMENU_MENUITEM_PROP_ICON_DATA));
+
+	g_object_unref(test.client);
+	test_settle();
+
+	/* Without a filter it comes across */
+	filter_connect(&test, NULL);
+
+	g_assert(test_watch_count() > 0);
+	g_assert(dbusmenu_menuitem_property_exist(filter_client_item(test.client, 2), DBUSMENU_MENUITEM_PROP_ICON_DATA));
+
+	test_fixture_teardown(&test);
+	return;
+}
+
+/* When the server says an item was updated the client refetches
+   its properties, that should only ask for the filtered ones */
+static void
+test_filter_group_properties (void)
+{
+	test_fixture_t test;
+	filter_setup(&test, "/org/test/filter/group");
+	filter_connect(&test, labelonly);
+
+	/* Change the label behind the client's back and then tell it
+	   that the item needs to be looked at again */
+	DbusmenuMenuitem * serveritem = dbusmenu_menuitem_find_id(test.root, 2);
+	test_calls_reset();
+	test_watch_property(DBUSMENU_MENUITEM_PROP_ICON_DATA);
+
+	dbusmenu_menuitem_property_set(serveritem, DBUSMENU_MENUITEM_PROP_LABEL, "Updated");
+	g_dbus_connection_emit_signal(test.bus, NULL, test.path,
+	                              "com.canonical.dbusmenu", "ItemUpdated",
+	                              g_variant_new("(i)", 2), NULL);
+
+	g_assert(test_wait_for_calls("GetGroupProperties", 1));
+	test_settle();
+
+	g_assert(test_watch_count() == 0);
+
+	DbusmenuMenuitem * item = filter_client_item(test.client, 2);
+	g_assert(g_strcmp0(dbusmenu_menuitem_property_get(item, DBUSMENU_MENUITEM_PROP_LABEL), "Updated") == 0);
+	g_assert(!dbusmenu_menuitem_property_exist(item, DBUSMENU_MENUITEM_PROP_ICON_DATA));
+
+	/* New icon data on the server isn't wanted either */
+	dbusmenu_menuitem_property_set_byte_array(serveritem, DBUSMENU_MENUITEM_PROP_ICON_DATA, icon, sizeof(icon) / 2);
+	test_settle();
+	g_assert(!dbusmenu_menuitem_property_exist(item, DBUSMENU_MENUITEM_PROP_ICON_DATA));
+
+	test_fixture_teardown(&test);
+	return;
+}
+
+#define INTERN_ITEMS      10
+#define INTERN_ICON_SIZE  1024
+
+typedef struct _intern_stats_t intern_stats_t;
+struct _intern_stats_t {
+	guint values;
+	guint hits;
+	gsize bytes_saved;
+};
+
+static void
+intern_stats (intern_stats_t * stats)
+{
+	dbusmenu_client_get_intern_stats(&stats->values, &stats->hits, &stats->bytes_saved);
+	return;
+}
+
+/* Items with their own labels, but all with the same icon */
+static void
+intern_setup (test_fixture_t * test, const gchar * path)
+{
+	DbusmenuMenuitem * root = test_menu_new(INTERN_ITEMS);
+
+	guchar icon[INTERN_ICON_SIZE];
+	guint i;
+	for (i = 0; i < INTERN_ICON_SIZE; i++) {
+		icon[i] = i % 251;
+	}
+
+	GList * child;
+	for (child = dbusmenu_menuitem_get_children(root); child != NULL; child = g_list_next(child)) {
+		dbusmenu_menuitem_property_set_byte_array(DBUSMENU_MENUITEM(child->data), DBUSMENU_MENUITEM_PROP_ICON_DATA, icon, sizeof(icon));
+	}
+
+	test_fixture_setup(test, path, root);
+
+	return;
+}
+
+static DbusmenuClient *
+intern_client (test_fixture_t * test)
+{
+	DbusmenuClient * client = dbusmenu_client_new(g_dbus_connection_get_unique_name(test->bus), test->path);
+
+	g_assert(test_wait_for_sync(test->root, client));
+	test_settle();
+
+	return client;
+}
+
+static GVariant *
+intern_client_icon (DbusmenuClient * client, gint id)
+{
+	DbusmenuMenuitem * item = dbusmenu_menuitem_find_id(dbusmenu_client_get_root(client), id);
+	g_assert(item != NULL);
+	return dbusmenu_menuitem_property_get_variant(item, DBUSMENU_MENUITEM_PROP_ICON_DATA);
+}
+
+/* The same icon on every item is only kept once */
+static void
+test_intern_items (void)
+{
+	test_fixture_t test;
+	intern_setup(&test, "/org/test/intern/items");
+
+	intern_stats_t before, after;
+	intern_stats(&before);
+
+	DbusmenuClient * client = intern_client(&test);
+	intern_stats(&after);
+
+	/* The first one is kept, the rest are shared */
+	g_assert(after.hits - before.hits >= INTERN_ITEMS - 1);
+	g_assert(after.bytes_saved - before.bytes_saved >= (INTERN_ITEMS - 1) * INTERN_ICON_SIZE);
+
+	/* Each label, and then the icon, are all that's new */
+	g_assert(after.values - before.values <= INTERN_ITEMS + 1);
+
+	GVariant * icon = intern_client_icon(client, 1);
+	g_assert(icon != NULL);
+	g_assert(g_variant_get_size(icon) == INTERN_ICON_SIZE);
+
+	guint i;
+	for (i = 2; i <= INTERN_ITEMS; i++) {
+		g_assert(intern_client_icon(client, i) == icon);
+	}
+
+	g_object_unref(client);
+	test_fixture_teardown(&test);
+	return;
+}
+
+/* A second client on the same menu has everything already */
+static void
+test_intern_clients (void)
+{
+	test_fixture_t test;
+	intern_setup(&test, "/org/test/intern/clients");
+
+	DbusmenuClient * first = intern_client(&test);
+
+	intern_stats_t before, after;
+	intern_stats(&before);
+
+	DbusmenuClient * second = intern_client(&test);
+	intern_stats(&after);
+
+	/* Every label and every icon was there */
+	g_assert(after.hits - before.hits >= 2 * INTERN_ITEMS);
+	g_assert(after.values == before.values);
+
+	g_assert(intern_client_icon(first, 3) == intern_client_icon(second, 3));
+
+	DbusmenuMenuitem * firstitem = dbusmenu_menuitem_find_id(dbusmenu_client_get_root(first), 3);
+	DbusmenuMenuitem * seconditem = dbusmenu_menuitem_find_id(dbusmenu_client_get_root(second), 3);
+	g_assert(dbusmenu_menuitem_property_get_variant(firstitem, DBUSMENU_MENUITEM_PROP_LABEL) ==
+	         dbusmenu_menuitem_property_get_variant(seconditem, DBUSMENU_MENUITEM_PROP_LABEL));
+
+	g_object_unref(second);
+	g_object_unref(first);
+	test_fixture_teardown(&test);
+	return;
+}
+
+static gboolean
+intern_flat_ready (gpointer data)
+{
+	return dbusmenu_client_flat_lookup(DBUSMENU_CLIENT(data), INTERN_ITEMS) >= 0;
+}
+
+static GVariant *
+intern_flat_icon (DbusmenuClient * client, gint id)
+{
+	gint index = dbusmenu_client_flat_lookup(client, id);
+	g_assert(index >= 0);
+	return dbusmenu_client_flat_get_property(client, index, DBUSMENU_MENUITEM_PROP_ICON_DATA);
+}
+
+/* The flat layout shares them the same way */
+static void
+test_intern_flat (void)
+{
+	test_fixture_t test;
+	intern_setup(&test, "/org/test/intern/flat");
+
+	intern_stats_t before, after;
+	intern_stats(&before);
+
+	DbusmenuClient * client = DBUSMENU_CLIENT(g_object_new(DBUSMENU_TYPE_CLIENT,
+	                                                       DBUSMENU_CLIENT_PROP_DBUS_NAME, g_dbus_connection_get_unique_name(test.bus),
+	                                                       DBUSMENU_CLIENT_PROP_DBUS_OBJECT, test.path,
+	                                                       DBUSMENU_CLIENT_PROP_FLAT_LAYOUT, TRUE,
+	                                                       NULL));
+	g_assert(test_wait_for(intern_flat_ready, client));
+	test_settle();
+
+	intern_stats(&after);
+	g_assert(after.hits - before.hits >= INTERN_ITEMS - 1);
+
+	GVariant * icon = intern_flat_icon(client, 1);
+	g_assert(icon != NULL);
+	g_assert(intern_flat_icon(client, INTERN_ITEMS) == icon);
+
+	g_object_unref(client);
+	test_fixture_teardown(&test);
+	return;
+}
+
+#define GROUP_ITEMS  150
+
+static gboolean
+group_relabeled (gpointer data)
+{
+	DbusmenuClient * client = DBUSMENU_CLIENT(data);
+	DbusmenuMenuitem * root = dbusmenu_client_get_root(client);
+	gint id;
+
+	for (id = 1; id <= GROUP_ITEMS; id++) {
+		gchar * label = g_strdup_printf("Group %d", id);
+		gboolean match = g_strcmp0(dbusmenu_menuitem_property_get(dbusmenu_menuitem_find_id(root, id), DBUSMENU_MENUITEM_PROP_LABEL), label) == 0;
+		g_free(label);
+
+		if (!match) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+/* A lot of items updated at once are asked for together, and
+   each reply finds its way back to the right item */
+static void
+test_group_many (void)
+{
+	test_fixture_t test;
+	test_fixture_setup(&test, "/org/test/group/many", test_menu_new(GROUP_ITEMS));
+	test_fixture_connect(&test, dbusmenu_client_new(g_dbus_connection_get_unique_name(test.bus), "/org/test/group/many"));
+	test_calls_reset();
+
+	/* Frozen, the server doesn't send the new labels itself so
+	   they can only come from the client asking */
+	dbusmenu_server_freeze(test.server);
+
+	gint id;
+	for (id = GROUP_ITEMS; id > 0; id--) {
+		gchar * label = g_strdup_printf("Group %d", id);
+		dbusmenu_menuitem_property_set(dbusmenu_menuitem_find_id(test.root, id), DBUSMENU_MENUITEM_PROP_LABEL, label);
+		g_free(label);
+
+		g_dbus_connection_emit_signal(test.bus, NULL, test.path,
+		                              "com.canonical.dbusmenu", "ItemUpdated",
+		                              g_variant_new("(i)", id), NULL);
+	}
+
+	g_assert(test_wait_for(group_relabeled, test.client));
+	g_assert(test_calls_count("ItemsPropertiesUpdated") == 0);
+	g_assert(test_calls_count("GetGroupProperties") >= 1);
+	g_assert(test_calls_count("GetGroupProperties") < GROUP_ITEMS / 2);
+
+	dbusmenu_server_thaw(test.server);
+
+	test_fixture_teardown(&test);
+	return;
+}
+
+/* Build the test suites */
+static void
+test_glib_filter_suite (void)
+{
+	g_test_add_func ("/dbusmenu/glib/filter/layout",           test_filter_layout);
+	g_test_add_func ("/dbusmenu/glib/filter/group_properties", test_filter_group_properties);
+	return;
+}
+
+static void
+test_glib_intern_suite (void)
+{
+	g_test_add_func ("/dbusmenu/glib/intern/items",   test_intern_items);
+	g_test_add_func ("/dbusmenu/glib/intern/clients", test_intern_clients);
+	g_test_add_func ("/dbusmenu/glib/intern/flat",    test_intern_flat);
+	return;
+}
+
+static void
+test_glib_group_suite (void)
+{
+	g_test_add_func ("/dbusmenu/glib/group/many", test_group_many);
+	return;
+}
+
+gint
+main (gint argc, gchar * argv[])
+{
+	g_test_init(&argc, &argv, NULL);
+
+	/* Test suites */
+	test_glib_filter_suite();
+	test_glib_intern_suite();
+	test_glib_group_suite();
+
+	return g_test_run ();
+}
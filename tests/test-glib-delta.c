@@ -0,0 +1,759 @@
+/*
+A test for libdbusmenu to ensure its quality.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it 
+under the terms of the GNU General Public License version 3, as published 
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but 
+WITHOUT ANY WARRANTY; without even the implied warranties of 
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR 
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along 
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <libdbusmenu-glib/client.h>
+#include <libdbusmenu-glib/server.h>
+#include <libdbusmenu-glib/menuitem.h>
+
+#include "test-glib-inproc.h"
+
+static void
+delta_setup (test_fixture_t * test, const gchar * path, guint count)
+{
+	test_fixture_setup(test, path, test_menu_new(count));
+	test_fixture_connect(test, dbusmenu_client_new(g_dbus_connection_get_unique_name(test->bus), path));
+	test_calls_reset();
+
+	return;
+}
+
+static void
+delta_append (DbusmenuMenuitem * parent, gint id, const gchar * label)
+{
+	DbusmenuMenuitem * mi = dbusmenu_menuitem_new_with_id(id);
+	dbusmenu_menuitem_property_set(mi, DBUSMENU_MENUITEM_PROP_LABEL, label);
+	dbusmenu_menuitem_child_append(parent, mi);
+	g_object_unref(mi);
+	return;
+}
+
+/* One new item, only the delta should be asked for */
+static void
+test_delta_append (void)
+{
+	test_fixture_t test;
+	delta_setup(&test, "/org/test/delta/append", 3);
+
+	delta_append(test.root, 4, "Item 4");
+	g_assert(test_wait_for_sync(test.root, test.client));
+
+	g_assert(test_calls_count("GetLayoutDelta") == 1);
+	g_assert(test_calls_count("GetLayout") == 0);
+
+	DbusmenuMenuitem * mi = dbusmenu_menuitem_find_id(dbusmenu_client_get_root(test.client), 4);
+	g_assert(mi != NULL);
+	g_assert(g_strcmp0(dbusmenu_menuitem_property_get(mi, DBUSMENU_MENUITEM_PROP_LABEL), "Item 4") == 0);
+
+	test_fixture_teardown(&test);
+	return;
+}
+
+/* The server only remembers 64 changes, if we're further
+   behind than that it tells us to get the whole thing */
+static void
+test_delta_too_far_behind (void)
+{
+	test_fixture_t test;
+	delta_setup(&test, "/org/test/delta/behind", 3);
+
+	gint id;
+	for (id = 100; id < 170; id++) {
+		gchar * label = g_strdup_printf("Item %d", id);
+		delta_append(test.root, id, label);
+		g_free(label);
+	}
+
+	g_assert(test_wait_for_sync(test.root, test.client));
+
+	/* Asked for the delta, was refused, got the layout */
+	g_assert(test_calls_count("GetLayoutDelta") == 1);
+	g_assert(test_calls_count("GetLayout") == 1);
+
+	/* And after that the deltas work again */
+	test_calls_reset();
+	delta_append(test.root, 200, "Item 200");
+	g_assert(test_wait_for_sync(test.root, test.client));
+
+	g_assert(test_calls_count("GetLayoutDelta") == 1);
+	g_assert(test_calls_count("GetLayout") == 0);
+
+	test_fixture_teardown(&test);
+	return;
+}
+
+static gboolean
+delta_readded (gpointer data)
+{
+	test_sync_t * test = (test_sync_t *)data;
+
+	if (!test_in_sync(data)) {
+		return FALSE;
+	}
+
+	DbusmenuMenuitem * mi = dbusmenu_menuitem_find_id(dbusmenu_client_get_root(test->client), 2);
+	return mi != NULL && g_strcmp0(dbusmenu_menuitem_property_get(mi, DBUSMENU_MENUITEM_PROP_LABEL), "Again") == 0;
+}
+
+/* Moving items around and taking one out and putting a
+   new one in with the same ID */
+static void
+test_delta_move_readd (void)
+{
+	test_fixture_t test;
+	delta_setup(&test, "/org/test/delta/move", 5);
+
+	DbusmenuMenuitem * clientroot = dbusmenu_client_get_root(test.client);
+	DbusmenuMenuitem * clientfive = dbusmenu_menuitem_find_id(clientroot, 5);
+
+	/* The last to the first */
+	dbusmenu_menuitem_child_reorder(test.root, dbusmenu_menuitem_find_id(test.root, 5), 0);
+	g_assert(test_wait_for_sync(test.root, test.client));
+
+	/* Should be the same object, just moved */
+	g_assert(dbusmenu_menuitem_find_id(clientroot, 5) == clientfive);
+
+	g_assert(test_calls_count("GetLayoutDelta") == 1);
+	g_assert(test_calls_count("GetLayout") == 0);
+	test_calls_reset();
+
+	/* Out and back in with different properties */
+	dbusmenu_menuitem_child_delete(test.root, dbusmenu_menuitem_find_id(test.root, 2));
+	delta_append(test.root, 2, "Again");
+
+	test_sync_t sync = { test.root, test.client };
+	g_assert(test_wait_for(delta_readded, &sync));
+
+	g_assert(test_calls_count("GetLayoutDelta") >= 1);
+	g_assert(test_calls_count("GetLayout") == 0);
+
+	test_fixture_teardown(&test);
+	return;
+}
+
+static void
+delta_child_moved (DbusmenuMenuitem * parent, DbusmenuMenuitem * child, guint newpos, guint oldpos, gpointer user_data)
+{
+	(*(guint *)user_data)++;
+	return;
+}
+
+/* Puts the children of the server's root in @order and waits for
+   the client to catch up.  Returns how many times the client moved
+   one of its items to get there. */
+static guint
+delta_reorder (test_fixture_t * test, const gint * order, guint len)
+{
+	DbusmenuMenuitem * clientroot = dbusmenu_client_get_root(test->client);
+	guint moved = 0;
+	guint i;
+
+	gulong handler = g_signal_connect(clientroot, DBUSMENU_MENUITEM_SIGNAL_CHILD_MOVED, G_CALLBACK(delta_child_moved), &moved);
+
+	for (i = 0; i < len; i++) {
+		dbusmenu_menuitem_child_reorder(test->root, dbusmenu_menuitem_find_id(test->root, order[i]), i);
+	}
+	g_assert(test_wait_for_sync(test->root, test->client));
+
+	g_signal_handler_disconnect(clientroot, handler);
+
+	return moved;
+}
+
+/* Reordering on the server should only move the items on the
+   client that have to move, and keep them the same objects */
+static void
+test_delta_reorder (void)
+{
+	test_fixture_t test;
+	delta_setup(&test, "/org/test/delta/reorder", 6);
+
+	DbusmenuMenuitem * clientroot = dbusmenu_client_get_root(test.client);
+	DbusmenuMenuitem * items[6];
+	guint i;
+	for (i = 0; i < G_N_ELEMENTS(items); i++) {
+		items[i] = dbusmenu_menuitem_find_id(clientroot, i + 1);
+		g_assert(items[i] != NULL);
+	}
+
+	/* Backwards, only one of them can stay */
+	const gint reversed[] = { 6, 5, 4, 3, 2, 1 };
+	g_assert(delta_reorder(&test, reversed, G_N_ELEMENTS(reversed)) == 5);
+
+	/* The first to the end, everything else stays */
+	const gint rotated[] = { 5, 4, 3, 2, 1, 6 };
+	g_assert(delta_reorder(&test, rotated, G_N_ELEMENTS(rotated)) == 1);
+
+	/* Two swapped, 4 3 2 6 are still in order */
+	const gint swapped[] = { 1, 4, 3, 2, 5, 6 };
+	g_assert(delta_reorder(&test, swapped, G_N_ELEMENTS(swapped)) == 2);
+
+	/* And the same again, nothing to do */
+	g_assert(delta_reorder(&test, swapped, G_N_ELEMENTS(swapped)) == 0);
+
+	for (i = 0; i < G_N_ELEMENTS(items); i++) {
+		g_assert(dbusmenu_menuitem_find_id(clientroot, i + 1) == items[i]);
+	}
+	g_assert(dbusmenu_client_get_root(test.client) == clientroot);
+	g_assert(test_calls_count("GetLayout") == 0);
+
+	test_fixture_teardown(&test);
+	return;
+}
+
+/* A submenu under 2 with 21 and 22, and 221 under 22 */
+static void
+delta_submenu (test_fixture_t * test)
+{
+	DbusmenuMenuitem * two = dbusmenu_menuitem_find_id(test->root, 2);
+	delta_append(two, 21, "Item 21");
+	delta_append(two, 22, "Item 22");
+	delta_append(dbusmenu_menuitem_find_id(test->root, 22), 221, "Item 221");
+
+	g_assert(test_wait_for_sync(test->root, test->client));
+	test_calls_reset();
+
+	return;
+}
+
+/* Taking out an item takes everything under it with it */
+static void
+test_delta_remove_subtree (void)
+{
+	test_fixture_t test;
+	delta_setup(&test, "/org/test/delta/remove", 3);
+	delta_submenu(&test);
+
+	DbusmenuMenuitem * clientroot = dbusmenu_client_get_root(test.client);
+	DbusmenuMenuitem * clientone = dbusmenu_menuitem_find_id(clientroot, 1);
+	DbusmenuMenuitem * clientthree = dbusmenu_menuitem_find_id(clientroot, 3);
+
+	dbusmenu_menuitem_child_delete(test.root, dbusmenu_menuitem_find_id(test.root, 2));
+	g_assert(test_wait_for_sync(test.root, test.client));
+
+	g_assert(dbusmenu_menuitem_find_id(clientroot, 2) == NULL);
+	g_assert(dbusmenu_menuitem_find_id(clientroot, 21) == NULL);
+	g_assert(dbusmenu_menuitem_find_id(clientroot, 22) == NULL);
+	g_assert(dbusmenu_menuitem_find_id(clientroot, 221) == NULL);
+
+	/* The rest were left where they were */
+	g_assert(dbusmenu_client_get_root(test.client) == clientroot);
+	g_assert(dbusmenu_menuitem_find_id(clientroot, 1) == clientone);
+	g_assert(dbusmenu_menuitem_find_id(clientroot, 3) == clientthree);
+
+	g_assert(test_calls_count("GetLayoutDelta") == 1);
+	g_assert(test_calls_count("GetLayout") == 0);
+
+	test_fixture_teardown(&test);
+	return;
+}
+
+typedef struct _delta_label_t delta_label_t;
+struct _delta_label_t {
+	DbusmenuMenuitem * mi;
+	const gchar * label;
+};
+
+static gboolean
+delta_has_label (gpointer data)
+{
+	delta_label_t * check = (delta_label_t *)data;
+	return g_strcmp0(dbusmenu_menuitem_property_get(check->mi, DBUSMENU_MENUITEM_PROP_LABEL), check->label) == 0;
+}
+
+/* Once a submenu is taken out, changes for its IDs shouldn't find
+   the old items, and when the IDs come back they should find the
+   new ones */
+static void
+test_delta_index (void)
+{
+	test_fixture_t test;
+	delta_setup(&test, "/org/test/delta/index", 3);
+	delta_submenu(&test);
+
+	DbusmenuMenuitem * clientroot = dbusmenu_client_get_root(test.client);
+	DbusmenuMenuitem * oldtwo = g_object_ref(dbusmenu_menuitem_find_id(clientroot, 2));
+	DbusmenuMenuitem * oldchild = g_object_ref(dbusmenu_menuitem_find_id(clientroot, 21));
+	DbusmenuMenuitem * oldgrandchild = g_object_ref(dbusmenu_menuitem_find_id(clientroot, 221));
+
+	dbusmenu_menuitem_child_delete(test.root, dbusmenu_menuitem_find_id(test.root, 2));
+	g_assert(test_wait_for_sync(test.root, test.client));
+
+	/* Changes for the IDs that are gone, they'd land on the old
+	   items if the index still had them */
+	GVariantBuilder items;
+	g_variant_builder_init(&items, G_VARIANT_TYPE("a(ia{sv})"));
+	g_variant_builder_add_parsed(&items, "(2, {'label': <'Stale'>})");
+	g_variant_builder_add_parsed(&items, "(21, {'label': <'Stale'>})");
+	g_variant_builder_add_parsed(&items, "(221, {'label': <'Stale'>})");
+	g_dbus_connection_emit_signal(test.bus, NULL, "/org/test/delta/index", "com.canonical.dbusmenu", "ItemsPropertiesUpdated",
+	                              g_variant_new("(a(ia{sv})a(ias))", &items, NULL), NULL);
+
+	/* The server sends its change after ours, so once it's here
+	   ours has been handled */
+	dbusmenu_menuitem_property_set(dbusmenu_menuitem_find_id(test.root, 1), DBUSMENU_MENUITEM_PROP_LABEL, "Marker");
+	delta_label_t marker = { dbusmenu_menuitem_find_id(clientroot, 1), "Marker" };
+	g_assert(test_wait_for(delta_has_label, &marker));
+
+	g_assert_cmpstr(dbusmenu_menuitem_property_get(oldtwo, DBUSMENU_MENUITEM_PROP_LABEL), ==, "Item 2");
+	g_assert_cmpstr(dbusmenu_menuitem_property_get(oldchild, DBUSMENU_MENUITEM_PROP_LABEL), ==, "Item 21");
+	g_assert_cmpstr(dbusmenu_menuitem_property_get(oldgrandchild, DBUSMENU_MENUITEM_PROP_LABEL), ==, "Item 221");
+
+	/* Back in with the same IDs */
+	delta_append(test.root, 2, "Item 2");
+	delta_append(dbusmenu_menuitem_find_id(test.root, 2), 21, "Item 21");
+	g_assert(test_wait_for_sync(test.root, test.client));
+
+	DbusmenuMenuitem * newchild = dbusmenu_menuitem_find_id(clientroot, 21);
+	g_assert(newchild != NULL);
+	g_assert(newchild != oldchild);
+
+	dbusmenu_menuitem_property_set(dbusmenu_menuitem_find_id(test.root, 21), DBUSMENU_MENUITEM_PROP_LABEL, "Fresh");
+	delta_label_t fresh = { newchild, "Fresh" };
+	g_assert(test_wait_for(delta_has_label, &fresh));
+	g_assert_cmpstr(dbusmenu_menuitem_property_get(oldchild, DBUSMENU_MENUITEM_PROP_LABEL), ==, "Item 21");
+
+	g_object_unref(oldtwo);
+	g_object_unref(oldchild);
+	g_object_unref(oldgrandchild);
+
+	test_fixture_teardown(&test);
+	return;
+}
+
+/* Moving a submenu to another parent, it has to come out of
+   the old one and show up with its children in the new one */
+static void
+test_delta_reparent (void)
+{
+	test_fixture_t test;
+	delta_setup(&test, "/org/test/delta/reparent", 3);
+	delta_submenu(&test);
+
+	DbusmenuMenuitem * clientroot = dbusmenu_client_get_root(test.client);
+	DbusmenuMenuitem * clienttwentyone = dbusmenu_menuitem_find_id(clientroot, 21);
+
+	DbusmenuMenuitem * twentytwo = g_object_ref(dbusmenu_menuitem_find_id(test.root, 22));
+	dbusmenu_menuitem_child_delete(dbusmenu_menuitem_find_id(test.root, 2), twentytwo);
+	dbusmenu_menuitem_child_append(dbusmenu_menuitem_find_id(test.root, 3), twentytwo);
+	g_object_unref(twentytwo);
+
+	g_assert(test_wait_for_sync(test.root, test.client));
+
+	DbusmenuMenuitem * clienttwo = dbusmenu_menuitem_find_id(clientroot, 2);
+	DbusmenuMenuitem * clientthree = dbusmenu_menuitem_find_id(clientroot, 3);
+	DbusmenuMenuitem * clienttwentytwo = dbusmenu_menuitem_find_id(clientroot, 22);
+
+	g_assert(clienttwentytwo != NULL);
+	g_assert(dbusmenu_menuitem_get_parent(clienttwentytwo) == clientthree);
+	g_assert(dbusmenu_menuitem_child_find(clienttwo, 22) == NULL);
+	g_assert(dbusmenu_menuitem_child_find(clientthree, 22) == clienttwentytwo);
+	g_assert(dbusmenu_menuitem_find_id(clientroot, 21) == clienttwentyone);
+
+	DbusmenuMenuitem * clienttwotwoone = dbusmenu_menuitem_child_find(clienttwentytwo, 221);
+	g_assert(clienttwotwoone != NULL);
+	g_assert(g_strcmp0(dbusmenu_menuitem_property_get(clienttwotwoone, DBUSMENU_MENUITEM_PROP_LABEL), "Item 221") == 0);
+
+	g_assert(test_calls_count("GetLayoutDelta") >= 1);
+	g_assert(test_calls_count("GetLayout") == 0);
+
+	test_fixture_teardown(&test);
+	return;
+}
+
+static void
+delta_activated (DbusmenuClient * client, DbusmenuMenuitem * item, guint timestamp, gpointer user_data)
+{
+	*((DbusmenuMenuitem **)user_data) = item;
+	return;
+}
+
+static gboolean
+delta_activated_set (gpointer data)
+{
+	return *((DbusmenuMenuitem **)data) != NULL;
+}
+
+/* The server asking for an item to be shown finds it by ID, even
+   when it's deep and has been moved */
+static void
+test_delta_activate (void)
+{
+	test_fixture_t test;
+	delta_setup(&test, "/org/test/delta/activate", 3);
+	delta_submenu(&test);
+
+	DbusmenuMenuitem * activated = NULL;
+	g_signal_connect(test.client, DBUSMENU_CLIENT_SIGNAL_ITEM_ACTIVATE, G_CALLBACK(delta_activated), &activated);
+
+	DbusmenuMenuitem * clientroot = dbusmenu_client_get_root(test.client);
+	DbusmenuMenuitem * twotwoone = dbusmenu_menuitem_find_id(test.root, 221);
+
+	dbusmenu_menuitem_show_to_user(twotwoone, 0);
+	g_assert(test_wait_for(delta_activated_set, &activated));
+	g_assert(activated == dbusmenu_menuitem_find_id(clientroot, 221));
+
+	/* Over to another parent, it's the same item */
+	DbusmenuMenuitem * clienttwotwoone = activated;
+	DbusmenuMenuitem * twentytwo = g_object_ref(dbusmenu_menuitem_find_id(test.root, 22));
+	dbusmenu_menuitem_child_delete(dbusmenu_menuitem_find_id(test.root, 2), twentytwo);
+	dbusmenu_menuitem_child_append(dbusmenu_menuitem_find_id(test.root, 3), twentytwo);
+	g_object_unref(twentytwo);
+	g_assert(test_wait_for_sync(test.root, test.client));
+
+	activated = NULL;
+	dbusmenu_menuitem_show_to_user(twotwoone, 0);
+	g_assert(test_wait_for(delta_activated_set, &activated));
+	g_assert(activated == clienttwotwoone);
+	g_assert(dbusmenu_menuitem_get_id(dbusmenu_menuitem_get_parent(activated)) == 22);
+
+	g_signal_handlers_disconnect_by_func(test.client, delta_activated, &activated);
+
+	test_fixture_teardown(&test);
+	return;
+}
+
+typedef struct _delta_reply_t delta_reply_t;
+struct _delta_reply_t {
+	gboolean done;
+	GVariant * reply;
+	GError * error;
+};
+
+static void
+delta_call_cb (GObject * bus, GAsyncResult * res, gpointer user_data)
+{
+	delta_reply_t * reply = (delta_reply_t *)user_data;
+	reply->reply = g_dbus_connection_call_finish(G_DBUS_CONNECTION(bus), res, &reply->error);
+	reply->done = TRUE;
+	return;
+}
+
+static gboolean
+delta_call_done (gpointer data)
+{
+	return ((delta_reply_t *)data)->done;
+}
+
+/* Calls @method on the server ourselves.  It's answered from our
+   own main loop, so we can't block on it. */
+static GVariant *
+delta_call (test_fixture_t * test, const gchar * path, const gchar * method, GVariant * params, GError ** error)
+{
+	delta_reply_t reply = { FALSE, NULL, NULL };
+
+	g_dbus_connection_call(test->bus, g_dbus_connection_get_unique_name(test->bus), path,
+	                       "com.canonical.dbusmenu", method, params, NULL,
+	                       G_DBUS_CALL_FLAGS_NONE, -1, NULL, delta_call_cb, &reply);
+	g_assert(test_wait_for(delta_call_done, &reply));
+
+	g_propagate_error(error, reply.error);
+	return reply.reply;
+}
+
+/* Revisions the server doesn't have the changes for, either
+   because they've fallen out of its list or because it never
+   had them, get an error instead of a wrong answer */
+static void
+test_delta_unknown_revision (void)
+{
+	test_fixture_t test;
+	const gchar * path = "/org/test/delta/unknown";
+	delta_setup(&test, path, 3);
+
+	gint id;
+	for (id = 100; id < 170; id++) {
+		gchar * label = g_strdup_printf("Item %d", id);
+		delta_append(test.root, id, label);
+		g_free(label);
+	}
+	g_assert(test_wait_for_sync(test.root, test.client));
+
+	GError * error = NULL;
+	GVariant * layout = delta_call(&test, path, "GetLayout", g_variant_new("(ii@as)", 0, 0, g_variant_new_strv(NULL, 0)), &error);
+	g_assert_no_error(error);
+	guint revision;
+	g_variant_get_child(layout, 0, "u", &revision);
+	g_variant_unref(layout);
+
+	/* Up to date is nothing to do */
+	GVariant * delta = delta_call(&test, path, "GetLayoutDelta", g_variant_new("(u@as)", revision, g_variant_new_strv(NULL, 0)), &error);
+	g_assert_no_error(error);
+	GVariant * updates = g_variant_get_child_value(delta, 1);
+	g_assert(g_variant_n_children(updates) == 0);
+	g_variant_unref(updates);
+	g_variant_unref(delta);
+
+	/* One that's fallen out of the list */
+	delta = delta_call(&test, path, "GetLayoutDelta", g_variant_new("(u@as)", 1, g_variant_new_strv(NULL, 0)), &error);
+	g_assert(delta == NULL);
+	g_assert(error != NULL);
+	g_clear_error(&error);
+
+	/* And one from the future, like a client that was talking
+	   to a server that's been restarted */
+	delta = delta_call(&test, path, "GetLayoutDelta", g_variant_new("(u@as)", revision + 10, g_variant_new_strv(NULL, 0)), &error);
+	g_assert(delta == NULL);
+	g_assert(error != NULL);
+	g_clear_error(&error);
+
+	test_fixture_teardown(&test);
+	return;
+}
+
+/* A server that only speaks version 3, without GetLayoutDelta */
+static const gchar * v3_xml =
+"<node>"
+"  <interface name='com.canonical.dbusmenu'>"
+"    <property name='Version' type='u' access='read'/>"
+"    <property name='TextDirection' type='s' access='read'/>"
+"    <property name='Status' type='s' access='read'/>"
+"    <property name='IconThemePath' type='as' access='read'/>"
+"    <method name='GetLayout'>"
+"      <arg type='i' name='parentId' direction='in'/>"
+"      <arg type='i' name='recursionDepth' direction='in'/>"
+"      <arg type='as' name='propertyNames' direction='in'/>"
+"      <arg type='u' name='revision' direction='out'/>"
+"      <arg type='(ia{sv}av)' name='layout' direction='out'/>"
+"    </method>"
+"    <signal name='LayoutUpdated'>"
+"      <arg type='u' name='revision'/>"
+"      <arg type='i' name='parent'/>"
+"    </signal>"
+"  </interface>"
+"</node>";
+
+/* The same server claiming version 4, but with a GetLayoutDelta
+   that gives back children that aren't layouts */
+static const gchar * v4_xml =
+"<node>"
+"  <interface name='com.canonical.dbusmenu'>"
+"    <property name='Version' type='u' access='read'/>"
+"    <property name='TextDirection' type='s' access='read'/>"
+"    <property name='Status' type='s' access='read'/>"
+"    <property name='IconThemePath' type='as' access='read'/>"
+"    <method name='GetLayout'>"
+"      <arg type='i' name='parentId' direction='in'/>"
+"      <arg type='i' name='recursionDepth' direction='in'/>"
+"      <arg type='as' name='propertyNames' direction='in'/>"
+"      <arg type='u' name='revision' direction='out'/>"
+"      <arg type='(ia{sv}av)' name='layout' direction='out'/>"
+"    </method>"
+"    <method name='GetLayoutDelta'>"
+"      <arg type='u' name='sinceRevision' direction='in'/>"
+"      <arg type='as' name='propertyNames' direction='in'/>"
+"      <arg type='u' name='revision' direction='out'/>"
+"      <arg type='a(iaiav)' name='updates' direction='out'/>"
+"    </method>"
+"    <signal name='LayoutUpdated'>"
+"      <arg type='u' name='revision'/>"
+"      <arg type='i' name='parent'/>"
+"    </signal>"
+"  </interface>"
+"</node>";
+
+static guint v3_version = 3;
+static guint v3_revision = 1;
+static guint v3_children = 2;
+
+static void
+v3_method (GDBusConnection * connection, const gchar * sender, const gchar * path, const gchar * interface, const gchar * method, GVariant * params, GDBusMethodInvocation * invocation, gpointer user_data)
+{
+	if (g_strcmp0(method, "GetLayoutDelta") == 0) {
+		/* All the IDs, with the new one's layout as a number */
+		GVariantBuilder ids;
+		g_variant_builder_init(&ids, G_VARIANT_TYPE("ai"));
+
+		guint i;
+		for (i = 0; i < v3_children; i++) {
+			g_variant_builder_add(&ids, "i", i + 1);
+		}
+
+		GVariant * layout = g_variant_new_variant(g_variant_new_int32(v3_children));
+
+		GVariantBuilder updates;
+		g_variant_builder_init(&updates, G_VARIANT_TYPE("a(iaiav)"));
+		g_variant_builder_add(&updates, "(i@ai@av)", 0,
+		                      g_variant_builder_end(&ids),
+		                      g_variant_new_array(G_VARIANT_TYPE_VARIANT, &layout, 1));
+
+		g_dbus_method_invocation_return_value(invocation,
+			g_variant_new("(u@a(iaiav))", v3_revision, g_variant_builder_end(&updates)));
+		return;
+	}
+
+	GVariantBuilder children;
+	g_variant_builder_init(&children, G_VARIANT_TYPE("av"));
+
+	guint i;
+	for (i = 0; i < v3_children; i++) {
+		GVariantBuilder props;
+		g_variant_builder_init(&props, G_VARIANT_TYPE("a{sv}"));
+
+		gchar * label = g_strdup_printf("Item %d", i + 1);
+		g_variant_builder_add(&props, "{sv}", DBUSMENU_MENUITEM_PROP_LABEL, g_variant_new_string(label));
+		g_free(label);
+
+		g_variant_builder_add(&children, "v", g_variant_new("(i@a{sv}@av)", i + 1,
+		                                                    g_variant_builder_end(&props),
+		                                                    g_variant_new_array(G_VARIANT_TYPE_VARIANT, NULL, 0)));
+	}
+
+	g_dbus_method_invocation_return_value(invocation,
+		g_variant_new("(u(i@a{sv}@av))", v3_revision, 0,
+		              g_variant_new_array(G_VARIANT_TYPE("{sv}"), NULL, 0),
+		              g_variant_builder_end(&children)));
+
+	return;
+}
+
+static GVariant *
+v3_property (GDBusConnection * connection, const gchar * sender, const gchar * path, const gchar * interface, const gchar * property, GError ** error, gpointer user_data)
+{
+	if (g_strcmp0(property, "Version") == 0) {
+		return g_variant_new_uint32(v3_version);
+	} else if (g_strcmp0(property, "TextDirection") == 0) {
+		return g_variant_new_string("ltr");
+	} else if (g_strcmp0(property, "Status") == 0) {
+		return g_variant_new_string("normal");
+	} else if (g_strcmp0(property, "IconThemePath") == 0) {
+		return g_variant_new_strv(NULL, 0);
+	}
+
+	return NULL;
+}
+
+static const GDBusInterfaceVTable v3_vtable = {
+	v3_method,
+	v3_property,
+	NULL
+};
+
+static gboolean
+v3_has_children (gpointer data)
+{
+	DbusmenuMenuitem * root = dbusmenu_client_get_root(DBUSMENU_CLIENT(data));
+	return root != NULL && g_list_length(dbusmenu_menuitem_get_children(root)) == v3_children;
+}
+
+/* Against an older server the client has to use GetLayout */
+static void
+test_delta_old_server (void)
+{
+	GDBusConnection * bus = test_bus();
+	GDBusNodeInfo * info = g_dbus_node_info_new_for_xml(v3_xml, NULL);
+	g_assert(info != NULL);
+
+	guint object = g_dbus_connection_register_object(bus, "/org/test/delta/v3", info->interfaces[0], &v3_vtable, NULL, NULL, NULL);
+	g_assert(object != 0);
+
+	DbusmenuClient * client = dbusmenu_client_new(g_dbus_connection_get_unique_name(bus), "/org/test/delta/v3");
+	g_assert(test_wait_for(v3_has_children, client));
+	test_settle();
+	test_calls_reset();
+
+	v3_revision = 2;
+	v3_children = 3;
+	g_dbus_connection_emit_signal(bus, NULL, "/org/test/delta/v3", "com.canonical.dbusmenu", "LayoutUpdated",
+	                              g_variant_new("(ui)", v3_revision, 0), NULL);
+
+	g_assert(test_wait_for(v3_has_children, client));
+
+	g_assert(test_calls_count("GetLayoutDelta") == 0);
+	g_assert(test_calls_count("GetLayout") >= 1);
+
+	g_object_unref(client);
+	g_dbus_connection_unregister_object(bus, object);
+	g_dbus_node_info_unref(info);
+	test_settle();
+	g_object_unref(bus);
+
+	return;
+}
+
+/* A delta with something other than a layout in it can't be
+   applied, so the client has to get the whole layout */
+static void
+test_delta_bad_child (void)
+{
+	GDBusConnection * bus = test_bus();
+	GDBusNodeInfo * info = g_dbus_node_info_new_for_xml(v4_xml, NULL);
+	g_assert(info != NULL);
+
+	v3_version = 4;
+	v3_revision = 1;
+	v3_children = 2;
+
+	guint object = g_dbus_connection_register_object(bus, "/org/test/delta/v4", info->interfaces[0], &v3_vtable, NULL, NULL, NULL);
+	g_assert(object != 0);
+
+	DbusmenuClient * client = dbusmenu_client_new(g_dbus_connection_get_unique_name(bus), "/org/test/delta/v4");
+	g_assert(test_wait_for(v3_has_children, client));
+	test_calls_reset();
+
+	v3_revision = 2;
+	v3_children = 3;
+	g_dbus_connection_emit_signal(bus, NULL, "/org/test/delta/v4", "com.canonical.dbusmenu", "LayoutUpdated",
+	                              g_variant_new("(ui)", v3_revision, 0), NULL);
+
+	g_assert(test_wait_for(v3_has_children, client));
+
+	/* Asked for the delta, couldn't use it, got the layout */
+	g_assert(test_calls_count("GetLayoutDelta") == 1);
+	g_assert(test_calls_count("GetLayout") == 1);
+
+	g_object_unref(client);
+	g_dbus_connection_unregister_object(bus, object);
+	g_dbus_node_info_unref(info);
+	v3_version = 3;
+	test_settle();
+	g_object_unref(bus);
+
+	return;
+}
+
+/* Build the test suite */
+static void
+test_glib_delta_suite (void)
+{
+	g_test_add_func ("/dbusmenu/glib/delta/append",        test_delta_append);
+	g_test_add_func ("/dbusmenu/glib/delta/too_far_behind", test_delta_too_far_behind);
+	g_test_add_func ("/dbusmenu/glib/delta/move_readd",    test_delta_move_readd);
+	g_test_add_func ("/dbusmenu/glib/delta/old_server",    test_delta_old_server);
+	g_test_add_func ("/dbusmenu/glib/delta/remove_subtree", test_delta_remove_subtree);
+	g_test_add_func ("/dbusmenu/glib/delta/index",         test_delta_index);
+	g_test_add_func ("/dbusmenu/glib/delta/reparent",      test_delta_reparent);
+	g_test_add_func ("/dbusmenu/glib/delta/activate",      test_delta_activate);
+	g_test_add_func ("/dbusmenu/glib/delta/unknown_revision", test_delta_unknown_revision);
+	g_test_add_func ("/dbusmenu/glib/delta/bad_child",     test_delta_bad_child);
+	g_test_add_func ("/dbusmenu/glib/delta/reorder",       test_delta_reorder);
+	return;
+}
+
+gint
+main (gint argc, gchar * argv[])
+{
+	g_test_init(&argc, &argv, NULL);
+
+	/* Test suites */
+	test_glib_delta_suite();
+
+	return g_test_run ();
+}
@@ -0,0 +1,456 @@
+/*
+A test for libdbusmenu to ensure its quality.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it 
+under the terms of the GNU General Public License version 3, as published 
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but 
+WITHOUT ANY WARRANTY; without even the implied warranties of 
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR 
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along 
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <libdbusmenu-glib/client.h>
+#include <libdbusmenu-glib/server.h>
+#include <libdbusmenu-glib/menuitem.h>
+
+#include "test-glib-inproc.h"
+
+static gboolean
+flat_has_id (gpointer data)
+{
+	test_fixture_t * test = (test_fixture_t *)data;
+	return dbusmenu_client_flat_lookup(test->client, GPOINTER_TO_INT(g_object_get_data(G_OBJECT(test->client), "test-wait-id"))) >= 0;
+}
+
+/* Wait until the flat layout has an item with @id */
+static gboolean
+flat_wait_for_id (test_fixture_t * test, gint id)
+{
+	g_object_set_data(G_OBJECT(test->client), "test-wait-id", GINT_TO_POINTER(id));
+	return test_wait_for(flat_has_id, test);
+}
+
+/* The root has 1, 2 and 3.  1 has 11 and 12 under it. */
+static void
+flat_setup (test_fixture_t * test, const gchar * path)
+{
+	DbusmenuMenuitem * root = test_menu_new(3);
+	DbusmenuMenuitem * one = dbusmenu_menuitem_find_id(root, 1);
+	DbusmenuMenuitem * child;
+
+	child = dbusmenu_menuitem_new_with_id(11);
+	dbusmenu_menuitem_property_set(child, DBUSMENU_MENUITEM_PROP_LABEL, "Item 11");
+	dbusmenu_menuitem_child_append(one, child);
+	g_object_unref(child);
+
+	child = dbusmenu_menuitem_new_with_id(12);
+	dbusmenu_menuitem_property_set(child, DBUSMENU_MENUITEM_PROP_LABEL, "Item 12");
+	dbusmenu_menuitem_property_set(child, DBUSMENU_MENUITEM_PROP_ICON_NAME, "twelve");
+	dbusmenu_menuitem_child_append(one, child);
+	g_object_unref(child);
+
+	test_fixture_setup(test, path, root);
+
+	/* There's no tree to wait for, just the flat layout */
+	test->client = DBUSMENU_CLIENT(g_object_new(DBUSMENU_TYPE_CLIENT,
+	                                            DBUSMENU_CLIENT_PROP_DBUS_NAME, g_dbus_connection_get_unique_name(test->bus),
+	                                            DBUSMENU_CLIENT_PROP_DBUS_OBJECT, path,
+	                                            DBUSMENU_CLIENT_PROP_FLAT_LAYOUT, TRUE,
+	                                            NULL));
+
+	g_assert(flat_wait_for_id(test, 12));
+	test_settle();
+
+	return;
+}
+
+/* Gets the label of an item as a string, NULL if it doesn't have one */
+static const gchar *
+flat_label (DbusmenuClient * client, gint id)
+{
+	gint index = dbusmenu_client_flat_lookup(client, id);
+	g_assert(index >= 0);
+
+	GVariant * label = dbusmenu_client_flat_get_property(client, index, DBUSMENU_MENUITEM_PROP_LABEL);
+	if (label == NULL) {
+		return NULL;
+	}
+
+	return g_variant_get_string(label, NULL);
+}
+
+/* Find each item by ID and make sure it's under the right parent */
+static void
+test_flat_lookup (void)
+{
+	test_fixture_t test;
+	flat_setup(&test, "/org/test/flat/lookup");
+
+	g_assert(dbusmenu_client_flat_get_length(test.client) == 6);
+	g_assert(dbusmenu_client_flat_lookup(test.client, 0) == 0);
+	g_assert(dbusmenu_client_flat_get_parent(test.client, 0) == -1);
+	g_assert(dbusmenu_client_flat_lookup(test.client, 42) == -1);
+
+	gint ids[] = {1, 2, 3, 11, 12};
+	gint parents[] = {0, 0, 0, 1, 1};
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS(ids); i++) {
+		gint index = dbusmenu_client_flat_lookup(test.client, ids[i]);
+		g_assert(index > 0);
+		g_assert(dbusmenu_client_flat_get_id(test.client, index) == ids[i]);
+
+		gint parent = dbusmenu_client_flat_get_parent(test.client, index);
+		g_assert(parent >= 0);
+		g_assert(dbusmenu_client_flat_get_id(test.client, parent) == parents[i]);
+	}
+
+	/* The client shouldn't have built menuitems for any of that */
+	g_assert(g_strcmp0(flat_label(test.client, 11), "Item 11") == 0);
+
+	test_fixture_teardown(&test);
+	return;
+}
+
+/* Go through the children of the root, of item 1, and everything */
+static void
+test_flat_iter (void)
+{
+	test_fixture_t test;
+	flat_setup(&test, "/org/test/flat/iter");
+
+	DbusmenuClientFlatIter iter;
+	guint index;
+	guint count;
+
+	/* The root's children in order */
+	gint rootchildren[] = {1, 2, 3};
+	count = 0;
+	dbusmenu_client_flat_iter_init(&iter, test.client, 0);
+	while (dbusmenu_client_flat_iter_next(&iter, &index)) {
+		g_assert(count < G_N_ELEMENTS(rootchildren));
+		g_assert(dbusmenu_client_flat_get_id(test.client, index) == rootchildren[count]);
+		count++;
+	}
+	g_assert(count == G_N_ELEMENTS(rootchildren));
+
+	/* Item one's children */
+	gint onechildren[] = {11, 12};
+	count = 0;
+	dbusmenu_client_flat_iter_init(&iter, test.client, dbusmenu_client_flat_lookup(test.client, 1));
+	while (dbusmenu_client_flat_iter_next(&iter, &index)) {
+		g_assert(count < G_N_ELEMENTS(onechildren));
+		g_assert(dbusmenu_client_flat_get_id(test.client, index) == onechildren[count]);
+		count++;
+	}
+	g_assert(count == G_N_ELEMENTS(onechildren));
+
+	/* An item without children */
+	dbusmenu_client_flat_iter_init(&iter, test.client, dbusmenu_client_flat_lookup(test.client, 2));
+	g_assert(!dbusmenu_client_flat_iter_next(&iter, NULL));
+
+	/* Everything, and each parent comes before its children */
+	count = 0;
+	dbusmenu_client_flat_iter_init(&iter, test.client, -1);
+	while (dbusmenu_client_flat_iter_next(&iter, &index)) {
+		g_assert(index == count);
+		g_assert(dbusmenu_client_flat_get_parent(test.client, index) < (gint)index);
+		count++;
+	}
+	g_assert(count == 6);
+
+	test_fixture_teardown(&test);
+	return;
+}
+
+/* Look at properties and search on them */
+static void
+test_flat_properties (void)
+{
+	test_fixture_t test;
+	flat_setup(&test, "/org/test/flat/properties");
+
+	g_assert(g_strcmp0(flat_label(test.client, 2), "Item 2") == 0);
+	g_assert(g_strcmp0(flat_label(test.client, 12), "Item 12") == 0);
+	g_assert(dbusmenu_client_flat_get_property(test.client, dbusmenu_client_flat_lookup(test.client, 2), DBUSMENU_MENUITEM_PROP_ICON_NAME) == NULL);
+	g_assert(dbusmenu_client_flat_get_property(test.client, 0, "not-a-property-anyone-has-set") == NULL);
+
+	/* By value */
+	GArray * found = dbusmenu_client_flat_find(test.client, DBUSMENU_MENUITEM_PROP_LABEL, g_variant_new_string("Item 3"));
+	g_assert(found->len == 1);
+	g_assert(dbusmenu_client_flat_get_id(test.client, g_array_index(found, guint, 0)) == 3);
+	g_array_free(found, TRUE);
+
+	/* Just having it */
+	found = dbusmenu_client_flat_find(test.client, DBUSMENU_MENUITEM_PROP_ICON_NAME, NULL);
+	g_assert(found->len == 1);
+	g_assert(dbusmenu_client_flat_get_id(test.client, g_array_index(found, guint, 0)) == 12);
+	g_array_free(found, TRUE);
+
+	/* Nothing */
+	found = dbusmenu_client_flat_find(test.client, DBUSMENU_MENUITEM_PROP_LABEL, g_variant_new_string("Item 42"));
+	g_assert(found->len == 0);
+	g_array_free(found, TRUE);
+
+	test_fixture_teardown(&test);
+	return;
+}
+
+static gboolean
+flat_label_gone (gpointer data)
+{
+	test_fixture_t * test = (test_fixture_t *)data;
+	return flat_label(test->client, 2) == NULL;
+}
+
+static gboolean
+flat_icon_set (gpointer data)
+{
+	test_fixture_t * test = (test_fixture_t *)data;
+	GVariant * icon = dbusmenu_client_flat_get_property(test->client, dbusmenu_client_flat_lookup(test->client, 11), DBUSMENU_MENUITEM_PROP_ICON_NAME);
+	return icon != NULL && g_strcmp0(g_variant_get_string(icon, NULL), "eleven") == 0;
+}
+
+/* Properties that the server removes or adds get tracked
+   without refetching the layout */
+static void
+test_flat_property_removal (void)
+{
+	test_fixture_t test;
+	flat_setup(&test, "/org/test/flat/removal");
+	test_calls_reset();
+
+	dbusmenu_menuitem_property_remove(dbusmenu_menuitem_find_id(test.root, 2), DBUSMENU_MENUITEM_PROP_LABEL);
+	g_assert(test_wait_for(flat_label_gone, &test));
+
+	/* A new one on an item in the middle has to be moved
+	   to have room, the others should be unharmed */
+	dbusmenu_menuitem_property_set(dbusmenu_menuitem_find_id(test.root, 11), DBUSMENU_MENUITEM_PROP_ICON_NAME, "eleven");
+	g_assert(test_wait_for(flat_icon_set, &test));
+
+	g_assert(g_strcmp0(flat_label(test.client, 11), "Item 11") == 0);
+	g_assert(g_strcmp0(flat_label(test.client, 12), "Item 12") == 0);
+	g_assert(g_strcmp0(flat_label(test.client, 3), "Item 3") == 0);
+
+	g_assert(test_calls_count("GetLayout") == 0);
+	g_assert(test_calls_count("GetLayoutDelta") == 0);
+
+	test_fixture_teardown(&test);
+	return;
+}
+
+static gboolean
+flat_delta_done (gpointer data)
+{
+	test_fixture_t * test = (test_fixture_t *)data;
+	return dbusmenu_client_flat_lookup(test->client, 13) >= 0 &&
+		dbusmenu_client_flat_lookup(test->client, 3) < 0;
+}
+
+/* Layout changes should come as a delta, not a whole new layout */
+static void
+test_flat_delta (void)
+{
+	test_fixture_t test;
+	flat_setup(&test, "/org/test/flat/delta");
+	test_calls_reset();
+
+	DbusmenuMenuitem * child = dbusmenu_menuitem_new_with_id(13);
+	dbusmenu_menuitem_property_set(child, DBUSMENU_MENUITEM_PROP_LABEL, "Item 13");
+	dbusmenu_menuitem_child_append(dbusmenu_menuitem_find_id(test.root, 1), child);
+	g_object_unref(child);
+
+	dbusmenu_menuitem_child_delete(test.root, dbusmenu_menuitem_find_id(test.root, 3));
+
+	g_assert(test_wait_for(flat_delta_done, &test));
+	test_settle();
+
+	g_assert(test_calls_count("GetLayoutDelta") >= 1);
+	g_assert(test_calls_count("GetLayout") == 0);
+
+	g_assert(dbusmenu_client_flat_get_length(test.client) == 6);
+	g_assert(g_strcmp0(flat_label(test.client, 13), "Item 13") == 0);
+	g_assert(g_strcmp0(flat_label(test.client, 12), "Item 12") == 0);
+
+	gint index = dbusmenu_client_flat_lookup(test.client, 13);
+	g_assert(dbusmenu_client_flat_get_id(test.client, dbusmenu_client_flat_get_parent(test.client, index)) == 1);
+
+	test_fixture_teardown(&test);
+	return;
+}
+
+/* A version 4 server that gives a delta where 1 and 2 are
+   each other's child, so it doesn't make a tree */
+static const gchar * loop_xml =
+"<node>"
+"  <interface name='com.canonical.dbusmenu'>"
+"    <property name='Version' type='u' access='read'/>"
+"    <property name='TextDirection' type='s' access='read'/>"
+"    <property name='Status' type='s' access='read'/>"
+"    <property name='IconThemePath' type='as' access='read'/>"
+"    <method name='GetLayout'>"
+"      <arg type='i' name='parentId' direction='in'/>"
+"      <arg type='i' name='recursionDepth' direction='in'/>"
+"      <arg type='as' name='propertyNames' direction='in'/>"
+"      <arg type='u' name='revision' direction='out'/>"
+"      <arg type='(ia{sv}av)' name='layout' direction='out'/>"
+"    </method>"
+"    <method name='GetLayoutDelta'>"
+"      <arg type='u' name='sinceRevision' direction='in'/>"
+"      <arg type='as' name='propertyNames' direction='in'/>"
+"      <arg type='u' name='revision' direction='out'/>"
+"      <arg type='a(iaiav)' name='updates' direction='out'/>"
+"    </method>"
+"    <signal name='LayoutUpdated'>"
+"      <arg type='u' name='revision'/>"
+"      <arg type='i' name='parent'/>"
+"    </signal>"
+"  </interface>"
+"</node>";
+
+static guint loop_revision = 1;
+
+/* The layout is the root with as many items as the revision */
+static void
+loop_method (GDBusConnection * connection, const gchar * sender, const gchar * path, const gchar * interface, const gchar * method, GVariant * params, GDBusMethodInvocation * invocation, gpointer user_data)
+{
+	if (g_strcmp0(method, "GetLayoutDelta") == 0) {
+		GVariantBuilder updates;
+		g_variant_builder_init(&updates, G_VARIANT_TYPE("a(iaiav)"));
+
+		/* Parent and its only child */
+		const gint loop[3][2] = { { 0, 1 }, { 1, 2 }, { 2, 1 } };
+		guint i;
+		for (i = 0; i < G_N_ELEMENTS(loop); i++) {
+			g_variant_builder_add(&updates, "(i@ai@av)", loop[i][0],
+			                      g_variant_new_fixed_array(G_VARIANT_TYPE_INT32, &loop[i][1], 1, sizeof(gint)),
+			                      g_variant_new_array(G_VARIANT_TYPE_VARIANT, NULL, 0));
+		}
+
+		g_dbus_method_invocation_return_value(invocation,
+			g_variant_new("(u@a(iaiav))", loop_revision, g_variant_builder_end(&updates)));
+		return;
+	}
+
+	GVariantBuilder children;
+	g_variant_builder_init(&children, G_VARIANT_TYPE("av"));
+
+	guint i;
+	for (i = 0; i < loop_revision; i++) {
+		g_variant_builder_add(&children, "v", g_variant_new("(i@a{sv}@av)", i + 1,
+		                                                    g_variant_new_array(G_VARIANT_TYPE("{sv}"), NULL, 0),
+		                                                    g_variant_new_array(G_VARIANT_TYPE_VARIANT, NULL, 0)));
+	}
+
+	g_dbus_method_invocation_return_value(invocation,
+		g_variant_new("(u(i@a{sv}@av))", loop_revision, 0,
+		              g_variant_new_array(G_VARIANT_TYPE("{sv}"), NULL, 0),
+		              g_variant_builder_end(&children)));
+
+	return;
+}
+
+static GVariant *
+loop_property (GDBusConnection * connection, const gchar * sender, const gchar * path, const gchar * interface, const gchar * property, GError ** error, gpointer user_data)
+{
+	if (g_strcmp0(property, "Version") == 0) {
+		return g_variant_new_uint32(4);
+	} else if (g_strcmp0(property, "TextDirection") == 0) {
+		return g_variant_new_string("ltr");
+	} else if (g_strcmp0(property, "Status") == 0) {
+		return g_variant_new_string("normal");
+	} else if (g_strcmp0(property, "IconThemePath") == 0) {
+		return g_variant_new_strv(NULL, 0);
+	}
+
+	return NULL;
+}
+
+static const GDBusInterfaceVTable loop_vtable = {
+	loop_method,
+	loop_property,
+	NULL
+};
+
+static gboolean
+loop_caught_up (gpointer data)
+{
+	DbusmenuClient * client = DBUSMENU_CLIENT(data);
+	return dbusmenu_client_flat_get_length(client) == loop_revision + 1;
+}
+
+/* A delta that doesn't make a tree out of the items can't be
+   used, the flat layout has to come from GetLayout again */
+static void
+test_flat_delta_loop (void)
+{
+	GDBusConnection * bus = test_bus();
+	GDBusNodeInfo * info = g_dbus_node_info_new_for_xml(loop_xml, NULL);
+	g_assert(info != NULL);
+
+	guint object = g_dbus_connection_register_object(bus, "/org/test/flat/loop", info->interfaces[0], &loop_vtable, NULL, NULL, NULL);
+	g_assert(object != 0);
+
+	loop_revision = 2;
+	DbusmenuClient * client = DBUSMENU_CLIENT(g_object_new(DBUSMENU_TYPE_CLIENT,
+	                                                       DBUSMENU_CLIENT_PROP_DBUS_NAME, g_dbus_connection_get_unique_name(bus),
+	                                                       DBUSMENU_CLIENT_PROP_DBUS_OBJECT, "/org/test/flat/loop",
+	                                                       DBUSMENU_CLIENT_PROP_FLAT_LAYOUT, TRUE,
+	                                                       NULL));
+	g_assert(test_wait_for(loop_caught_up, client));
+	test_calls_reset();
+
+	loop_revision = 3;
+	g_dbus_connection_emit_signal(bus, NULL, "/org/test/flat/loop", "com.canonical.dbusmenu", "LayoutUpdated",
+	                              g_variant_new("(ui)", loop_revision, 0), NULL);
+
+	g_assert(test_wait_for(loop_caught_up, client));
+
+	/* Asked for the delta, couldn't use it, got the layout */
+	g_assert(test_calls_count("GetLayoutDelta") == 1);
+	g_assert(test_calls_count("GetLayout") == 1);
+	g_assert(dbusmenu_client_flat_lookup(client, 3) >= 0);
+	g_assert(dbusmenu_client_flat_get_id(client, dbusmenu_client_flat_get_parent(client, dbusmenu_client_flat_lookup(client, 2))) == 0);
+
+	g_object_unref(client);
+	g_dbus_connection_unregister_object(bus, object);
+	g_dbus_node_info_unref(info);
+	test_settle();
+	g_object_unref(bus);
+
+	return;
+}
+
+/* Build the test suite */
+static void
+test_glib_flat_suite (void)
+{
+	g_test_add_func ("/dbusmenu/glib/flat/lookup",           test_flat_lookup);
+	g_test_add_func ("/dbusmenu/glib/flat/iter",             test_flat_iter);
+	g_test_add_func ("/dbusmenu/glib/flat/properties",       test_flat_properties);
+	g_test_add_func ("/dbusmenu/glib/flat/property_removal", test_flat_property_removal);
+	g_test_add_func ("/dbusmenu/glib/flat/delta",            test_flat_delta);
+	g_test_add_func ("/dbusmenu/glib/flat/delta_loop",       test_flat_delta_loop);
+	return;
+}
+
+gint
+main (gint argc, gchar * argv[])
+{
+	g_test_init(&argc, &argv, NULL);
+
+	/* Test suites */
+	test_glib_flat_suite();
+
+	return g_test_run ();
+}
@@ -0,0 +1,192 @@
+/*
+A test for libdbusmenu to ensure its quality.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it 
+under the terms of the GNU General Public License version 3, as published 
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but 
+WITHOUT ANY WARRANTY; without even the implied warranties of 
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR 
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along 
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <libdbusmenu-glib/client.h>
+#include <libdbusmenu-glib/menuitem.h>
+
+#include "test-glib-freeze.h"
+
+#define DEATH_TIME 60
+
+static guint phaseon = 0;
+static GMainLoop * mainloop = NULL;
+static gboolean passed = TRUE;
+static guint settle = 0;
+
+/* What we've seen on the bus during this phase */
+static gint layout_updates = 0;
+static gint property_updates = 0;
+
+/* Counts the signals from the server as they come over the
+   bus, before the client has a chance to fold any together */
+static void
+wire_signal (GDBusConnection * connection, const gchar * sender, const gchar * path, const gchar * interface, const gchar * signal, GVariant * params, gpointer user_data)
+{
+	if (g_strcmp0(signal, "LayoutUpdated") == 0) {
+		layout_updates++;
+	} else if (g_strcmp0(signal, "ItemsPropertiesUpdated") == 0) {
+		property_updates++;
+	}
+
+	return;
+}
+
+/* Check the children of the root against the phase */
+static gboolean
+verify_items (DbusmenuMenuitem * root, freeze_item_t * items)
+{
+	if (root == NULL) {
+		return FALSE;
+	}
+
+	GList * children = dbusmenu_menuitem_get_children(root);
+	guint i;
+
+	for (i = 0; items[i].id != -1; i++, children = g_list_next(children)) {
+		if (children == NULL) {
+			return FALSE;
+		}
+
+		DbusmenuMenuitem * mi = DBUSMENU_MENUITEM(children->data);
+		if (dbusmenu_menuitem_get_id(mi) != items[i].id) {
+			return FALSE;
+		}
+
+		if (g_strcmp0(dbusmenu_menuitem_property_get(mi, DBUSMENU_MENUITEM_PROP_LABEL), items[i].label) != 0) {
+			return FALSE;
+		}
+	}
+
+	return children == NULL;
+}
+
+/* The phase has had time for anything extra to show up, check
+   that only what we expect came over the bus. */
+static gboolean
+phase_done (gpointer data)
+{
+	freeze_phase_t * phase = &phases[phaseon];
+	settle = 0;
+
+	g_debug("Phase %d done with %d layout updates and %d property updates", phaseon, layout_updates, property_updates);
+
+	if (phase->layout_updates >= 0 && layout_updates != phase->layout_updates) {
+		g_debug("Failed as phase %d should have %d layout updates", phaseon, phase->layout_updates);
+		passed = FALSE;
+	}
+
+	if (phase->property_updates >= 0 && property_updates != phase->property_updates) {
+		g_debug("Failed as phase %d should have %d property updates", phaseon, phase->property_updates);
+		passed = FALSE;
+	}
+
+	/* The tree shouldn't have moved on without the server */
+	if (!verify_items(dbusmenu_client_get_root(DBUSMENU_CLIENT(data)), phase->items)) {
+		g_debug("Failed as the tree changed after phase %d", phaseon);
+		passed = FALSE;
+	}
+
+	layout_updates = 0;
+	property_updates = 0;
+	phaseon++;
+
+	if (phases[phaseon].items == NULL || !passed) {
+		g_main_loop_quit(mainloop);
+	}
+
+	return FALSE;
+}
+
+/* Something has changed, see if we've gotten to the next phase */
+static void
+check_phase (DbusmenuClient * client)
+{
+	if (settle != 0 || phases[phaseon].items == NULL) {
+		return;
+	}
+
+	if (!verify_items(dbusmenu_client_get_root(client), phases[phaseon].items)) {
+		return;
+	}
+
+	g_debug("Client matches phase %d", phaseon);
+	settle = g_timeout_add(PHASE_TIME * 1000 / 3, phase_done, client);
+
+	return;
+}
+
+static void
+layout_updated (DbusmenuClient * client, gpointer data)
+{
+	check_phase(client);
+	return;
+}
+
+static void
+properties_changed (DbusmenuClient * client, GHashTable * batch, gpointer data)
+{
+	check_phase(client);
+	return;
+}
+
+static gboolean
+timer_func (gpointer data)
+{
+	g_debug("Death timer.  Oops.  Got to: %d", phaseon);
+	passed = FALSE;
+	g_main_loop_quit(mainloop);
+	return FALSE;
+}
+
+int
+main (int argc, char ** argv)
+{
+	GDBusConnection * bus = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, NULL);
+	g_dbus_connection_signal_subscribe(bus,
+	                                   "org.dbusmenu.test",
+	                                   "com.canonical.dbusmenu",
+	                                   NULL, /* member */
+	                                   "/org/test",
+	                                   NULL, /* arg0 */
+	                                   G_DBUS_SIGNAL_FLAGS_NONE,
+	                                   wire_signal,
+	                                   NULL, NULL);
+
+	DbusmenuClient * client = dbusmenu_client_new("org.dbusmenu.test", "/org/test");
+	g_signal_connect(G_OBJECT(client), DBUSMENU_CLIENT_SIGNAL_LAYOUT_UPDATED, G_CALLBACK(layout_updated), NULL);
+	g_signal_connect(G_OBJECT(client), DBUSMENU_CLIENT_SIGNAL_ITEMS_PROPERTIES_CHANGED, G_CALLBACK(properties_changed), NULL);
+
+	g_timeout_add_seconds(DEATH_TIME, timer_func, client);
+
+	mainloop = g_main_loop_new(NULL, FALSE);
+	g_main_loop_run(mainloop);
+
+	g_object_unref(G_OBJECT(client));
+	g_object_unref(bus);
+
+	if (passed) {
+		g_debug("Quiting");
+		return 0;
+	} else {
+		g_debug("Quiting as we're a failure");
+		return 1;
+	}
+}
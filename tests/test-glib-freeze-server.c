@@ -0,0 +1,169 @@
+/*
+A test for libdbusmenu to ensure its quality.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it 
+under the terms of the GNU General Public License version 3, as published 
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but 
+WITHOUT ANY WARRANTY; without even the implied warranties of 
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR 
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along 
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <libdbusmenu-glib/server.h>
+#include <libdbusmenu-glib/menuitem.h>
+
+#include "test-glib-freeze.h"
+
+static DbusmenuServer * server = NULL;
+static DbusmenuMenuitem * root = NULL;
+static GMainLoop * mainloop = NULL;
+static guint phase = 0;
+
+static void
+append_item (DbusmenuMenuitem * parent, gint id)
+{
+	DbusmenuMenuitem * mi = dbusmenu_menuitem_new_with_id(id);
+	gchar * label = g_strdup_printf("Item %d", id);
+	dbusmenu_menuitem_property_set(mi, DBUSMENU_MENUITEM_PROP_LABEL, label);
+	g_free(label);
+	dbusmenu_menuitem_child_append(parent, mi);
+	g_object_unref(mi);
+	return;
+}
+
+static void
+delete_item (gint id)
+{
+	dbusmenu_menuitem_child_delete(root, dbusmenu_menuitem_find_id(root, id));
+	return;
+}
+
+static void
+set_label (gint id, const gchar * label)
+{
+	dbusmenu_menuitem_property_set(dbusmenu_menuitem_find_id(root, id), DBUSMENU_MENUITEM_PROP_LABEL, label);
+	return;
+}
+
+/* The second half of the nested freeze.  The inner thaw was a
+   while ago and nothing should have gone out since. */
+static gboolean
+nested_thaw (gpointer data)
+{
+	g_debug("Outer thaw");
+	dbusmenu_server_thaw(server);
+	return FALSE;
+}
+
+static gboolean
+timer_func (gpointer data)
+{
+	gint id;
+	gchar * label;
+
+	phase++;
+	g_debug("Phase %d", phase);
+
+	switch (phase) {
+	case 1:
+		/* Rebuild most of the menu all at once */
+		dbusmenu_server_freeze(server);
+		for (id = 1; id <= 5; id++) {
+			delete_item(id);
+		}
+		for (id = 11; id <= 15; id++) {
+			append_item(root, id);
+		}
+		for (id = 6; id <= 10; id++) {
+			label = g_strdup_printf("Changed %d", id);
+			set_label(id, label);
+			g_free(label);
+		}
+		dbusmenu_server_thaw(server);
+		break;
+	case 2:
+		/* Freezes inside of freezes only go out on the last thaw */
+		dbusmenu_server_freeze(server);
+		append_item(root, 16);
+		dbusmenu_server_freeze(server);
+		set_label(6, "Nested");
+		delete_item(7);
+		dbusmenu_server_thaw(server);
+		g_timeout_add(500, nested_thaw, NULL);
+		break;
+	case 3:
+		/* Things that are changed and then go away, or come
+		   and go, while we're frozen */
+		dbusmenu_server_freeze(server);
+		set_label(9, "Gone");
+		delete_item(9);
+		append_item(root, 21);
+		delete_item(21);
+		set_label(10, "Ten");
+		dbusmenu_server_thaw(server);
+		break;
+	default:
+		g_main_loop_quit(mainloop);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void
+on_bus (GDBusConnection * connection, const gchar * name, gpointer user_data)
+{
+	server = dbusmenu_server_new("/org/test");
+	root = dbusmenu_menuitem_new_with_id(0);
+
+	gint id;
+	for (id = 1; id <= 10; id++) {
+		append_item(root, id);
+	}
+
+	dbusmenu_server_set_root(server, root);
+
+	g_timeout_add_seconds(PHASE_TIME, timer_func, NULL);
+
+	return;
+}
+
+static void
+name_lost (GDBusConnection * connection, const gchar * name, gpointer user_data)
+{
+	g_error("Unable to get name '%s' on DBus", name);
+	g_main_loop_quit(mainloop);
+	return;
+}
+
+int
+main (int argc, char ** argv)
+{
+	g_bus_own_name(G_BUS_TYPE_SESSION,
+	               "org.dbusmenu.test",
+	               G_BUS_NAME_OWNER_FLAGS_NONE,
+	               on_bus,
+	               NULL,
+	               name_lost,
+	               NULL,
+	               NULL);
+
+	mainloop = g_main_loop_new(NULL, FALSE);
+	g_main_loop_run(mainloop);
+
+	g_object_unref(G_OBJECT(server));
+	g_object_unref(G_OBJECT(root));
+	g_debug("Quiting");
+
+	return 0;
+}
@@ -0,0 +1,105 @@
+/*
+A test for libdbusmenu to ensure its quality.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it 
+under the terms of the GNU General Public License version 3, as published 
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but 
+WITHOUT ANY WARRANTY; without even the implied warranties of 
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR 
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along 
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <glib.h>
+
+/* Seconds between each of the server's changes */
+#define PHASE_TIME 3
+
+typedef struct _freeze_item_t freeze_item_t;
+struct _freeze_item_t {
+	gint id;
+	gchar * label;
+};
+
+typedef struct _freeze_phase_t freeze_phase_t;
+struct _freeze_phase_t {
+	freeze_item_t * items;  /* Children of the root */
+	gint layout_updates;    /* How many LayoutUpdated, -1 to not check */
+	gint property_updates;  /* How many ItemsPropertiesUpdated */
+};
+
+freeze_item_t items_start[] = {
+	{id: 1, label: "Item 1"},
+	{id: 2, label: "Item 2"},
+	{id: 3, label: "Item 3"},
+	{id: 4, label: "Item 4"},
+	{id: 5, label: "Item 5"},
+	{id: 6, label: "Item 6"},
+	{id: 7, label: "Item 7"},
+	{id: 8, label: "Item 8"},
+	{id: 9, label: "Item 9"},
+	{id: 10, label: "Item 10"},
+	{id: -1, label: NULL}
+};
+
+/* Deleted the first half, added five and changed the labels
+   on the rest all in one freeze */
+freeze_item_t items_rebuild[] = {
+	{id: 6, label: "Changed 6"},
+	{id: 7, label: "Changed 7"},
+	{id: 8, label: "Changed 8"},
+	{id: 9, label: "Changed 9"},
+	{id: 10, label: "Changed 10"},
+	{id: 11, label: "Item 11"},
+	{id: 12, label: "Item 12"},
+	{id: 13, label: "Item 13"},
+	{id: 14, label: "Item 14"},
+	{id: 15, label: "Item 15"},
+	{id: -1, label: NULL}
+};
+
+/* Added 16 in the outer freeze, relabeled 6 and deleted 7
+   in the inner one */
+freeze_item_t items_nested[] = {
+	{id: 6, label: "Nested"},
+	{id: 8, label: "Changed 8"},
+	{id: 9, label: "Changed 9"},
+	{id: 10, label: "Changed 10"},
+	{id: 11, label: "Item 11"},
+	{id: 12, label: "Item 12"},
+	{id: 13, label: "Item 13"},
+	{id: 14, label: "Item 14"},
+	{id: 15, label: "Item 15"},
+	{id: 16, label: "Item 16"},
+	{id: -1, label: NULL}
+};
+
+/* Relabeled and deleted 9, added and deleted 21 and
+   relabeled 10 */
+freeze_item_t items_removed[] = {
+	{id: 6, label: "Nested"},
+	{id: 8, label: "Changed 8"},
+	{id: 10, label: "Ten"},
+	{id: 11, label: "Item 11"},
+	{id: 12, label: "Item 12"},
+	{id: 13, label: "Item 13"},
+	{id: 14, label: "Item 14"},
+	{id: 15, label: "Item 15"},
+	{id: 16, label: "Item 16"},
+	{id: -1, label: NULL}
+};
+
+freeze_phase_t phases[] = {
+	{items: items_start,   layout_updates: -1, property_updates: -1},
+	{items: items_rebuild, layout_updates: 1,  property_updates: 1},
+	{items: items_nested,  layout_updates: 1,  property_updates: 1},
+	{items: items_removed, layout_updates: 1,  property_updates: 1},
+	{items: NULL,          layout_updates: -1, property_updates: -1}
+};
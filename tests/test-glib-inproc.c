@@ -0,0 +1,352 @@
+/*
+A test for libdbusmenu to ensure its quality.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it 
+under the terms of the GNU General Public License version 3, as published 
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but 
+WITHOUT ANY WARRANTY; without even the implied warranties of 
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR 
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along 
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+
+#include "test-glib-inproc.h"
+
+#define TEST_TIMEOUT 10
+
+static GMutex test_calls_lock;
+static GHashTable * test_calls = NULL;
+static guint test_sent = 0;
+static gchar * test_watched = NULL;
+static guint test_watched_count = 0;
+
+static gboolean
+test_flag_cb (gpointer data)
+{
+	*((gboolean *)data) = TRUE;
+	return FALSE;
+}
+
+static gboolean
+test_flag_set (gpointer data)
+{
+	return *((gboolean *)data);
+}
+
+/* Spin the mainloop until @condition is TRUE, returns FALSE if
+   that never happens */
+gboolean
+test_wait_for (test_condition_t condition, gpointer data)
+{
+	return test_wait_for_msec(condition, data, TEST_TIMEOUT * 1000);
+}
+
+/* Like test_wait_for() but only giving @condition @msec, for
+   checking that something doesn't happen in that time */
+gboolean
+test_wait_for_msec (test_condition_t condition, gpointer data, guint msec)
+{
+	gboolean timedout = FALSE;
+	guint timer = g_timeout_add(msec, test_flag_cb, &timedout);
+
+	while (!condition(data) && !timedout) {
+		g_main_context_iteration(NULL, TRUE);
+	}
+
+	if (!timedout) {
+		g_source_remove(timer);
+	}
+
+	return condition(data);
+}
+
+/* Counts the dbusmenu calls and signals that we send, this is
+   in the GDBus thread so it's all under the lock */
+static GDBusMessage *
+test_calls_filter (GDBusConnection * connection, GDBusMessage * message, gboolean incoming, gpointer user_data)
+{
+	if (incoming) {
+		return message;
+	}
+
+	GDBusMessageType type = g_dbus_message_get_message_type(message);
+	g_mutex_lock(&test_calls_lock);
+
+	/* The bus itself is only talked to by test_settle() */
+	if (g_strcmp0(g_dbus_message_get_destination(message), "org.freedesktop.DBus") != 0) {
+		test_sent++;
+	}
+
+	/* Replies don't have an interface, so they're looked at
+	   for the watched property before anything else */
+	if (type == G_DBUS_MESSAGE_TYPE_METHOD_RETURN && test_watched != NULL && g_dbus_message_get_body(message) != NULL) {
+		gchar * body = g_variant_print(g_dbus_message_get_body(message), FALSE);
+		if (strstr(body, test_watched) != NULL) {
+			test_watched_count++;
+		}
+		g_free(body);
+	}
+
+	if ((type == G_DBUS_MESSAGE_TYPE_METHOD_CALL || type == G_DBUS_MESSAGE_TYPE_SIGNAL) &&
+			g_strcmp0(g_dbus_message_get_interface(message), "com.canonical.dbusmenu") == 0) {
+		const gchar * member = g_dbus_message_get_member(message);
+		guint count = GPOINTER_TO_UINT(g_hash_table_lookup(test_calls, member));
+		g_hash_table_insert(test_calls, g_strdup(member), GUINT_TO_POINTER(count + 1));
+	}
+
+	g_mutex_unlock(&test_calls_lock);
+
+	return message;
+}
+
+/* How many times we've sent @member since the last reset */
+guint
+test_calls_count (const gchar * member)
+{
+	g_mutex_lock(&test_calls_lock);
+	guint count = GPOINTER_TO_UINT(g_hash_table_lookup(test_calls, member));
+	g_mutex_unlock(&test_calls_lock);
+
+	return count;
+}
+
+void
+test_calls_reset (void)
+{
+	g_mutex_lock(&test_calls_lock);
+	g_hash_table_remove_all(test_calls);
+	g_mutex_unlock(&test_calls_lock);
+
+	return;
+}
+
+static guint
+test_sent_count (void)
+{
+	g_mutex_lock(&test_calls_lock);
+	guint count = test_sent;
+	g_mutex_unlock(&test_calls_lock);
+
+	return count;
+}
+
+typedef struct _test_calls_wait_t test_calls_wait_t;
+struct _test_calls_wait_t {
+	const gchar * member;
+	guint count;
+};
+
+static gboolean
+test_calls_reached (gpointer data)
+{
+	test_calls_wait_t * wait = (test_calls_wait_t *)data;
+	return test_calls_count(wait->member) >= wait->count;
+}
+
+/* Wait until @member has been sent @count times since the
+   last reset */
+gboolean
+test_wait_for_calls (const gchar * member, guint count)
+{
+	test_calls_wait_t wait = { member, count };
+	return test_wait_for(test_calls_reached, &wait);
+}
+
+static void
+test_settle_cb (GObject * bus, GAsyncResult * res, gpointer user_data)
+{
+	GVariant * reply = g_dbus_connection_call_finish(G_DBUS_CONNECTION(bus), res, NULL);
+	if (reply != NULL) {
+		g_variant_unref(reply);
+	}
+
+	*((gboolean *)user_data) = TRUE;
+	return;
+}
+
+/* Runs whatever is ready and then goes to the bus and back,
+   which gets everything we've sent delivered.  That's done
+   until a trip goes by without anything new being sent, then
+   there's nothing left to happen that isn't waiting on a timer. */
+void
+test_settle (void)
+{
+	GDBusConnection * bus = test_bus();
+	guint sent;
+
+	do {
+		while (g_main_context_iteration(NULL, FALSE));
+		sent = test_sent_count();
+
+		gboolean done = FALSE;
+		g_dbus_connection_call(bus, "org.freedesktop.DBus", "/org/freedesktop/DBus", "org.freedesktop.DBus",
+		                       "GetId", NULL, G_VARIANT_TYPE("(s)"), G_DBUS_CALL_FLAGS_NONE, -1, NULL,
+		                       test_settle_cb, &done);
+		g_assert(test_wait_for(test_flag_set, &done));
+
+		while (g_main_context_iteration(NULL, FALSE));
+	} while (sent != test_sent_count());
+
+	g_object_unref(bus);
+	return;
+}
+
+/* Start counting the replies that have @property in them */
+void
+test_watch_property (const gchar * property)
+{
+	g_mutex_lock(&test_calls_lock);
+	g_free(test_watched);
+	test_watched = g_strdup_printf("'%s'", property);
+	test_watched_count = 0;
+	g_mutex_unlock(&test_calls_lock);
+
+	return;
+}
+
+/* How many replies had the watched property */
+guint
+test_watch_count (void)
+{
+	g_mutex_lock(&test_calls_lock);
+	guint count = test_watched_count;
+	g_mutex_unlock(&test_calls_lock);
+
+	return count;
+}
+
+/* Gets the session bus with the counting filter on it */
+GDBusConnection *
+test_bus (void)
+{
+	GDBusConnection * bus = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, NULL);
+	g_assert(bus != NULL);
+
+	if (test_calls == NULL) {
+		test_calls = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+		g_dbus_connection_add_filter(bus, test_calls_filter, NULL, NULL);
+	}
+
+	return bus;
+}
+
+/* A menu with @count children, labeled by their position */
+DbusmenuMenuitem *
+test_menu_new (guint count)
+{
+	DbusmenuMenuitem * root = dbusmenu_menuitem_new_with_id(0);
+	guint i;
+
+	for (i = 0; i < count; i++) {
+		DbusmenuMenuitem * child = dbusmenu_menuitem_new_with_id(i + 1);
+		gchar * label = g_strdup_printf("Item %d", i + 1);
+		dbusmenu_menuitem_property_set(child, DBUSMENU_MENUITEM_PROP_LABEL, label);
+		dbusmenu_menuitem_child_append(root, child);
+		g_object_unref(child);
+		g_free(label);
+	}
+
+	return root;
+}
+
+/* Check that the client's tree has the same IDs in the same
+   order as the server's, all the way down */
+gboolean
+test_tree_matches (DbusmenuMenuitem * server, DbusmenuMenuitem * client)
+{
+	if (server == NULL || client == NULL) {
+		return server == client;
+	}
+
+	if (!dbusmenu_menuitem_get_root(server) &&
+			dbusmenu_menuitem_get_id(server) != dbusmenu_menuitem_get_id(client)) {
+		return FALSE;
+	}
+
+	GList * serverchild = dbusmenu_menuitem_get_children(server);
+	GList * clientchild = dbusmenu_menuitem_get_children(client);
+
+	while (serverchild != NULL && clientchild != NULL) {
+		if (!test_tree_matches(DBUSMENU_MENUITEM(serverchild->data), DBUSMENU_MENUITEM(clientchild->data))) {
+			return FALSE;
+		}
+
+		serverchild = g_list_next(serverchild);
+		clientchild = g_list_next(clientchild);
+	}
+
+	return serverchild == NULL && clientchild == NULL;
+}
+
+gboolean
+test_in_sync (gpointer data)
+{
+	test_sync_t * sync = (test_sync_t *)data;
+	DbusmenuMenuitem * clientroot = dbusmenu_client_get_root(sync->client);
+
+	if (clientroot == NULL) {
+		return FALSE;
+	}
+
+	return test_tree_matches(sync->root, clientroot);
+}
+
+/* Wait for the client to have the same tree as @root */
+gboolean
+test_wait_for_sync (DbusmenuMenuitem * root, DbusmenuClient * client)
+{
+	test_sync_t sync = { root, client };
+	return test_wait_for(test_in_sync, &sync);
+}
+
+/* Puts @root on a server at @path */
+void
+test_fixture_setup (test_fixture_t * test, const gchar * path, DbusmenuMenuitem * root)
+{
+	test->bus = test_bus();
+	test->path = path;
+	test->server = dbusmenu_server_new(path);
+	test->root = root;
+	test->client = NULL;
+
+	dbusmenu_server_set_root(test->server, test->root);
+
+	return;
+}
+
+/* Takes @client and waits for it to have the menu and for
+   anything left over from it starting up to be done */
+void
+test_fixture_connect (test_fixture_t * test, DbusmenuClient * client)
+{
+	test->client = client;
+	g_assert(test_wait_for_sync(test->root, test->client));
+	test_settle();
+
+	return;
+}
+
+void
+test_fixture_teardown (test_fixture_t * test)
+{
+	if (test->client != NULL) {
+		g_object_unref(test->client);
+		test->client = NULL;
+	}
+
+	g_object_unref(test->server);
+	g_object_unref(test->root);
+
+	test_settle();
+	g_object_unref(test->bus);
+
+	return;
+}
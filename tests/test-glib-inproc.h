@@ -0,0 +1,78 @@
+/*
+A test for libdbusmenu to ensure its quality.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it 
+under the terms of the GNU General Public License version 3, as published 
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but 
+WITHOUT ANY WARRANTY; without even the implied warranties of 
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR 
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along 
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Helpers for the tests that run a server and a client in the
+   same process, on the session bus that dbus-test-runner gives us */
+
+#ifndef __TEST_GLIB_INPROC_H__
+#define __TEST_GLIB_INPROC_H__
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <libdbusmenu-glib/client.h>
+#include <libdbusmenu-glib/server.h>
+#include <libdbusmenu-glib/menuitem.h>
+
+typedef gboolean (*test_condition_t) (gpointer data);
+
+/* The pair that test_in_sync() compares */
+typedef struct _test_sync_t test_sync_t;
+struct _test_sync_t {
+	DbusmenuMenuitem * root;
+	DbusmenuClient * client;
+};
+
+/* A server at @path with @root on it, and the client that
+   test_fixture_connect() was given */
+typedef struct _test_fixture_t test_fixture_t;
+struct _test_fixture_t {
+	GDBusConnection * bus;
+	const gchar * path;
+	DbusmenuServer * server;
+	DbusmenuMenuitem * root;
+	DbusmenuClient * client;
+};
+
+GDBusConnection * test_bus           (void);
+gboolean          test_wait_for      (test_condition_t condition,
+                                      gpointer data);
+gboolean          test_wait_for_msec (test_condition_t condition,
+                                      gpointer data,
+                                      guint msec);
+void              test_settle        (void);
+guint             test_calls_count   (const gchar * member);
+void              test_calls_reset   (void);
+gboolean          test_wait_for_calls (const gchar * member,
+                                      guint count);
+void              test_watch_property (const gchar * property);
+guint             test_watch_count   (void);
+DbusmenuMenuitem * test_menu_new     (guint count);
+gboolean          test_tree_matches  (DbusmenuMenuitem * server,
+                                      DbusmenuMenuitem * client);
+gboolean          test_in_sync       (gpointer data);
+gboolean          test_wait_for_sync (DbusmenuMenuitem * root,
+                                      DbusmenuClient * client);
+void              test_fixture_setup (test_fixture_t * test,
+                                      const gchar * path,
+                                      DbusmenuMenuitem * root);
+void              test_fixture_connect (test_fixture_t * test,
+                                      DbusmenuClient * client);
+void              test_fixture_teardown (test_fixture_t * test);
+
+#endif /* __TEST_GLIB_INPROC_H__ */
@@ -0,0 +1,232 @@
+/*
+A test for libdbusmenu to ensure its quality.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it 
+under the terms of the GNU General Public License version 3, as published 
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but 
+WITHOUT ANY WARRANTY; without even the implied warranties of 
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR 
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along 
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include <libdbusmenu-glib/client.h>
+#include <libdbusmenu-glib/server.h>
+#include <libdbusmenu-glib/menuitem.h>
+
+#include "test-glib-inproc.h"
+
+#define CACHE_NAME  "org.dbusmenu.test.cache"
+
+/* Where the clients write their layouts, under our own
+   cache directory so that it starts out empty */
+static gchar *
+cache_dir (void)
+{
+	return g_build_filename(g_get_user_cache_dir(), "libdbusmenu", NULL);
+}
+
+/* How many layouts have been written out */
+static guint
+cache_count (void)
+{
+	gchar * dirname = cache_dir();
+	GDir * dir = g_dir_open(dirname, 0, NULL);
+	guint count = 0;
+
+	if (dir != NULL) {
+		const gchar * name;
+		while ((name = g_dir_read_name(dir)) != NULL) {
+			if (g_str_has_suffix(name, ".layout")) {
+				count++;
+			}
+		}
+		g_dir_close(dir);
+	}
+
+	g_free(dirname);
+	return count;
+}
+
+/* Throw away all the layouts */
+static void
+cache_clear (void)
+{
+	gchar * dirname = cache_dir();
+	GDir * dir = g_dir_open(dirname, 0, NULL);
+
+	if (dir != NULL) {
+		const gchar * name;
+		while ((name = g_dir_read_name(dir)) != NULL) {
+			gchar * filename = g_build_filename(dirname, name, NULL);
+			g_unlink(filename);
+			g_free(filename);
+		}
+		g_dir_close(dir);
+	}
+
+	g_free(dirname);
+	return;
+}
+
+static void
+cache_name_acquired (GDBusConnection * connection, const gchar * name, gpointer user_data)
+{
+	*(gboolean *)user_data = TRUE;
+	return;
+}
+
+static gboolean
+cache_name_owned (gpointer data)
+{
+	return *(gboolean *)data;
+}
+
+static DbusmenuClient *
+cache_client_new (const gchar * name, const gchar * path)
+{
+	return DBUSMENU_CLIENT(g_object_new(DBUSMENU_TYPE_CLIENT,
+	                                    DBUSMENU_CLIENT_PROP_DBUS_NAME, name,
+	                                    DBUSMENU_CLIENT_PROP_DBUS_OBJECT, path,
+	                                    DBUSMENU_CLIENT_PROP_CACHE_LAYOUT, TRUE,
+	                                    NULL));
+}
+
+typedef struct _cache_first_t cache_first_t;
+struct _cache_first_t {
+	gboolean seen;
+	gboolean from_cache;
+};
+
+/* The first layout the client has should be the one from
+   before the server changed, which it can only get from disk */
+static void
+cache_first_layout (DbusmenuClient * client, gpointer user_data)
+{
+	cache_first_t * first = (cache_first_t *)user_data;
+
+	if (first->seen) {
+		return;
+	}
+	first->seen = TRUE;
+
+	DbusmenuMenuitem * root = dbusmenu_client_get_root(client);
+	DbusmenuMenuitem * two = dbusmenu_menuitem_find_id(root, 2);
+
+	first->from_cache = dbusmenu_menuitem_find_id(root, 3) != NULL &&
+		dbusmenu_menuitem_find_id(root, 4) == NULL &&
+		two != NULL &&
+		g_strcmp0(dbusmenu_menuitem_property_get(two, DBUSMENU_MENUITEM_PROP_LABEL), "Item 2") == 0;
+
+	return;
+}
+
+/* A second client for the same name starts from what the first
+   one saw, then catches up with the server */
+static void
+test_cache_reload (void)
+{
+	test_fixture_t test;
+	test_fixture_setup(&test, "/org/test/cache/reload", test_menu_new(3));
+
+	gboolean owned = FALSE;
+	guint owner = g_bus_own_name_on_connection(test.bus, CACHE_NAME, G_BUS_NAME_OWNER_FLAGS_NONE, cache_name_acquired, NULL, &owned, NULL);
+	g_assert(test_wait_for(cache_name_owned, &owned));
+
+	test_fixture_connect(&test, cache_client_new(CACHE_NAME, test.path));
+
+	/* It gets written when the client goes away, if not before */
+	g_object_unref(test.client);
+	test.client = NULL;
+	g_assert(cache_count() == 1);
+
+	/* Things change while nobody is looking */
+	dbusmenu_menuitem_property_set(dbusmenu_menuitem_find_id(test.root, 2), DBUSMENU_MENUITEM_PROP_LABEL, "Changed");
+	dbusmenu_menuitem_child_delete(test.root, dbusmenu_menuitem_find_id(test.root, 3));
+
+	DbusmenuMenuitem * four = dbusmenu_menuitem_new_with_id(4);
+	dbusmenu_menuitem_property_set(four, DBUSMENU_MENUITEM_PROP_LABEL, "Item 4");
+	dbusmenu_menuitem_child_append(test.root, four);
+	g_object_unref(four);
+	test_settle();
+	test_calls_reset();
+
+	cache_first_t first = { FALSE, FALSE };
+	DbusmenuClient * client = cache_client_new(CACHE_NAME, test.path);
+	g_signal_connect(client, DBUSMENU_CLIENT_SIGNAL_LAYOUT_UPDATED, G_CALLBACK(cache_first_layout), &first);
+	test_fixture_connect(&test, client);
+
+	g_assert(first.seen);
+	g_assert(first.from_cache);
+	g_assert(test_calls_count("GetLayout") >= 1);
+
+	DbusmenuMenuitem * two = dbusmenu_menuitem_find_id(dbusmenu_client_get_root(test.client), 2);
+	g_assert(g_strcmp0(dbusmenu_menuitem_property_get(two, DBUSMENU_MENUITEM_PROP_LABEL), "Changed") == 0);
+
+	g_bus_unown_name(owner);
+	test_fixture_teardown(&test);
+	cache_clear();
+
+	return;
+}
+
+/* Unique names never come back, so they aren't worth keeping */
+static void
+test_cache_unique_name (void)
+{
+	test_fixture_t test;
+	test_fixture_setup(&test, "/org/test/cache/unique", test_menu_new(3));
+	test_fixture_connect(&test, cache_client_new(g_dbus_connection_get_unique_name(test.bus), test.path));
+
+	g_object_unref(test.client);
+	test.client = NULL;
+	g_assert(cache_count() == 0);
+
+	test_fixture_teardown(&test);
+
+	return;
+}
+
+/* Build the test suite */
+static void
+test_glib_layout_cache_suite (void)
+{
+	g_test_add_func ("/dbusmenu/glib/layout_cache/reload",      test_cache_reload);
+	g_test_add_func ("/dbusmenu/glib/layout_cache/unique_name", test_cache_unique_name);
+	return;
+}
+
+gint
+main (gint argc, gchar * argv[])
+{
+	/* Don't read or write over the real cache */
+	gchar * cachehome = g_dir_make_tmp("test-glib-layout-cache-XXXXXX", NULL);
+	g_assert(cachehome != NULL);
+	g_setenv("XDG_CACHE_HOME", cachehome, TRUE);
+
+	g_test_init(&argc, &argv, NULL);
+
+	/* Test suites */
+	test_glib_layout_cache_suite();
+
+	gint retval = g_test_run();
+
+	cache_clear();
+	gchar * dirname = cache_dir();
+	g_rmdir(dirname);
+	g_free(dirname);
+	g_rmdir(cachehome);
+	g_free(cachehome);
+
+	return retval;
+}
@@ -114,7 +114,14 @@ timer_func (gpointer data)
 int
 main (int argc, char ** argv)
 {
-	DbusmenuClient * client = dbusmenu_client_new("org.dbusmenu.test", "/org/test");
+	/* With --lean it's the same test without the proxy */
+	gboolean lean = argc > 1 && g_strcmp0(argv[1], "--lean") == 0;
+
+	DbusmenuClient * client = DBUSMENU_CLIENT(g_object_new(DBUSMENU_TYPE_CLIENT,
+	                                                       DBUSMENU_CLIENT_PROP_DBUS_NAME, "org.dbusmenu.test",
+	                                                       DBUSMENU_CLIENT_PROP_DBUS_OBJECT, "/org/test",
+	                                                       DBUSMENU_CLIENT_PROP_LEAN_TRANSPORT, lean,
+	                                                       NULL));
 	g_signal_connect(G_OBJECT(client), DBUSMENU_CLIENT_SIGNAL_LAYOUT_UPDATED, G_CALLBACK(layout_updated), NULL);
 
 	g_timeout_add_seconds(60, timer_func, client);
@@ -0,0 +1,214 @@
+/*
+A test for libdbusmenu to ensure its quality.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it 
+under the terms of the GNU General Public License version 3, as published 
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but 
+WITHOUT ANY WARRANTY; without even the implied warranties of 
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR 
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along 
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <libdbusmenu-glib/client.h>
+#include <libdbusmenu-glib/server.h>
+#include <libdbusmenu-glib/menuitem.h>
+
+#include "test-glib-inproc.h"
+
+static void
+lazy_append (DbusmenuMenuitem * parent, gint id)
+{
+	DbusmenuMenuitem * child = dbusmenu_menuitem_new_with_id(id);
+	gchar * label = g_strdup_printf("Item %d", id);
+	dbusmenu_menuitem_property_set(child, DBUSMENU_MENUITEM_PROP_LABEL, label);
+	dbusmenu_menuitem_child_append(parent, child);
+	g_object_unref(child);
+	g_free(label);
+	return;
+}
+
+/* The client's copy of @id, or NULL if it doesn't have it */
+static DbusmenuMenuitem *
+lazy_client_item (test_fixture_t * test, gint id)
+{
+	DbusmenuMenuitem * root = dbusmenu_client_get_root(test->client);
+	if (root == NULL) {
+		return NULL;
+	}
+	return dbusmenu_menuitem_find_id(root, id);
+}
+
+static gboolean
+lazy_has_second_level (gpointer data)
+{
+	return lazy_client_item((test_fixture_t *)data, 11) != NULL;
+}
+
+/* The root has 1 and 2, with 11 under 1 and 111 under 11.  The
+   client gets two levels at a time so 11 comes without 111. */
+static void
+lazy_setup (test_fixture_t * test, const gchar * path)
+{
+	DbusmenuMenuitem * root = test_menu_new(2);
+
+	lazy_append(dbusmenu_menuitem_find_id(root, 1), 11);
+	lazy_append(dbusmenu_menuitem_find_id(root, 11), 111);
+
+	test_fixture_setup(test, path, root);
+
+	/* It's never in sync with the whole tree, only the top */
+	test->client = DBUSMENU_CLIENT(g_object_new(DBUSMENU_TYPE_CLIENT,
+	                                            DBUSMENU_CLIENT_PROP_DBUS_NAME, g_dbus_connection_get_unique_name(test->bus),
+	                                            DBUSMENU_CLIENT_PROP_DBUS_OBJECT, path,
+	                                            DBUSMENU_CLIENT_PROP_LAZY_LAYOUT, TRUE,
+	                                            NULL));
+
+	g_assert(test_wait_for(lazy_has_second_level, test));
+	test_settle();
+
+	g_assert(lazy_client_item(test, 2) != NULL);
+	g_assert(dbusmenu_menuitem_get_children(lazy_client_item(test, 11)) == NULL);
+	g_assert(lazy_client_item(test, 111) == NULL);
+
+	return;
+}
+
+static gboolean
+lazy_has_third_level (gpointer data)
+{
+	return lazy_client_item((test_fixture_t *)data, 111) != NULL;
+}
+
+/* The server's new enough that they get grouped */
+static guint
+lazy_about_to_show_count (void)
+{
+	return test_calls_count("AboutToShow") + test_calls_count("AboutToShowGroup");
+}
+
+/* Showing the submenu gets its children, once */
+static void
+test_lazy_about_to_show (void)
+{
+	test_fixture_t test;
+	lazy_setup(&test, "/org/test/lazy/show");
+	test_calls_reset();
+
+	dbusmenu_menuitem_send_about_to_show(lazy_client_item(&test, 11), NULL, NULL);
+
+	g_assert(test_wait_for(lazy_has_third_level, &test));
+	test_settle();
+
+	g_assert(test_calls_count("GetLayout") == 1);
+	g_assert(lazy_about_to_show_count() == 1);
+	g_assert(test_tree_matches(test.root, dbusmenu_client_get_root(test.client)));
+
+	/* It's already got them now */
+	dbusmenu_menuitem_send_about_to_show(lazy_client_item(&test, 11), NULL, NULL);
+	test_settle();
+
+	g_assert(test_calls_count("GetLayout") == 1);
+	g_assert(lazy_about_to_show_count() == 2);
+
+	test_fixture_teardown(&test);
+	return;
+}
+
+/* Asking directly works the same as showing it */
+static void
+test_lazy_fetch_submenu (void)
+{
+	test_fixture_t test;
+	lazy_setup(&test, "/org/test/lazy/fetch");
+	test_calls_reset();
+
+	/* Asking twice before the reply only makes one call */
+	dbusmenu_client_fetch_submenu(test.client, lazy_client_item(&test, 11));
+	dbusmenu_client_fetch_submenu(test.client, lazy_client_item(&test, 11));
+
+	g_assert(test_wait_for(lazy_has_third_level, &test));
+	test_settle();
+
+	g_assert(test_calls_count("GetLayout") == 1);
+	g_assert(g_strcmp0(dbusmenu_menuitem_property_get(lazy_client_item(&test, 111), DBUSMENU_MENUITEM_PROP_LABEL), "Item 111") == 0);
+
+	test_fixture_teardown(&test);
+	return;
+}
+
+static gboolean
+lazy_has_twelve (gpointer data)
+{
+	return lazy_client_item((test_fixture_t *)data, 12) != NULL;
+}
+
+static gboolean
+lazy_has_both (gpointer data)
+{
+	test_fixture_t * test = (test_fixture_t *)data;
+	return lazy_client_item(test, 111) != NULL && lazy_client_item(test, 112) != NULL;
+}
+
+/* Changes under a submenu the client hasn't gotten yet don't
+   need to be fetched until it's shown */
+static void
+test_lazy_layout_updated (void)
+{
+	test_fixture_t test;
+	lazy_setup(&test, "/org/test/lazy/updated");
+	test_calls_reset();
+
+	lazy_append(dbusmenu_menuitem_find_id(test.root, 11), 112);
+
+	/* A change the client does have, to know that it's caught up */
+	lazy_append(dbusmenu_menuitem_find_id(test.root, 1), 12);
+	g_assert(test_wait_for(lazy_has_twelve, &test));
+	test_settle();
+
+	g_assert(test_calls_count("LayoutUpdated") >= 1);
+	g_assert(test_calls_count("GetLayout") == 0);
+	g_assert(dbusmenu_menuitem_get_children(lazy_client_item(&test, 11)) == NULL);
+	g_assert(lazy_client_item(&test, 112) == NULL);
+
+	/* Then it all comes when it's needed */
+	dbusmenu_menuitem_send_about_to_show(lazy_client_item(&test, 11), NULL, NULL);
+	g_assert(test_wait_for(lazy_has_both, &test));
+	test_settle();
+
+	g_assert(test_calls_count("GetLayout") == 1);
+	g_assert(test_tree_matches(test.root, dbusmenu_client_get_root(test.client)));
+
+	test_fixture_teardown(&test);
+	return;
+}
+
+/* Build the test suite */
+static void
+test_glib_lazy_suite (void)
+{
+	g_test_add_func ("/dbusmenu/glib/lazy/about_to_show",  test_lazy_about_to_show);
+	g_test_add_func ("/dbusmenu/glib/lazy/fetch_submenu",  test_lazy_fetch_submenu);
+	g_test_add_func ("/dbusmenu/glib/lazy/layout_updated", test_lazy_layout_updated);
+	return;
+}
+
+gint
+main (gint argc, gchar * argv[])
+{
+	g_test_init(&argc, &argv, NULL);
+
+	/* Test suites */
+	test_glib_lazy_suite();
+
+	return g_test_run ();
+}
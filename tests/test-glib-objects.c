@@ -23,6 +23,8 @@ with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <glib-object.h>
 
 #include <libdbusmenu-glib/menuitem.h>
+#include <libdbusmenu-glib/menuitem-private.h>
+#include <libdbusmenu-glib/server.h>
 
 /* Building the basic menu item, make sure we didn't break
    any core GObject stuff */
@@ -305,6 +307,420 @@ test_object_menuitem_props_removal (void)
 	return;
 }
 
+/* Checks the property names and that each has the value that
+   was set with it, which is its number */
+static void
+test_object_menuitem_props_table_check (DbusmenuMenuitem * item, const gint * props, guint len, gboolean ordered)
+{
+	GList * list = dbusmenu_menuitem_properties_list(item);
+	g_assert_cmpuint(g_list_length(list), ==, len);
+
+	if (!ordered) {
+		list = g_list_sort(list, (GCompareFunc)g_strcmp0);
+	}
+
+	GList * entry = list;
+	guint i;
+	for (i = 0; i < len; i++, entry = entry->next) {
+		gchar * name = g_strdup_printf("prop%02d", props[i]);
+		g_assert_cmpstr(entry->data, ==, name);
+		g_assert_cmpint(dbusmenu_menuitem_property_get_int(item, name), ==, props[i]);
+		g_free(name);
+	}
+
+	g_list_free(list);
+	return;
+}
+
+static void
+test_object_menuitem_props_table_set (DbusmenuMenuitem * item, gint prop)
+{
+	gchar * name = g_strdup_printf("prop%02d", prop);
+	dbusmenu_menuitem_property_set_int(item, name, prop);
+	g_free(name);
+	return;
+}
+
+/* The first eight properties are kept in the order they were
+   set, past that they go into a table */
+static void
+test_object_menuitem_props_table (void)
+{
+	DbusmenuMenuitem * item = dbusmenu_menuitem_new();
+	gint i;
+
+	for (i = 0; i < 8; i++) {
+		test_object_menuitem_props_table_set(item, i);
+	}
+
+	const gint full[] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+	test_object_menuitem_props_table_check(item, full, G_N_ELEMENTS(full), TRUE);
+
+	/* Taking one out leaves the rest in order */
+	dbusmenu_menuitem_property_remove(item, "prop03");
+	g_assert(!dbusmenu_menuitem_property_exist(item, "prop03"));
+	const gint removed[] = { 0, 1, 2, 4, 5, 6, 7 };
+	test_object_menuitem_props_table_check(item, removed, G_N_ELEMENTS(removed), TRUE);
+
+	/* And putting it back puts it at the end */
+	test_object_menuitem_props_table_set(item, 3);
+	const gint readded[] = { 0, 1, 2, 4, 5, 6, 7, 3 };
+	test_object_menuitem_props_table_check(item, readded, G_N_ELEMENTS(readded), TRUE);
+
+	/* Changing one doesn't move it */
+	dbusmenu_menuitem_property_set_int(item, "prop04", 40);
+	g_assert_cmpint(dbusmenu_menuitem_property_get_int(item, "prop04"), ==, 40);
+	test_object_menuitem_props_table_set(item, 4);
+	test_object_menuitem_props_table_check(item, readded, G_N_ELEMENTS(readded), TRUE);
+
+	/* Past eight everything moves into the table, where there's
+	   no order but nothing should be lost */
+	for (i = 8; i < 12; i++) {
+		test_object_menuitem_props_table_set(item, i);
+	}
+
+	const gint table[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+	test_object_menuitem_props_table_check(item, table, G_N_ELEMENTS(table), FALSE);
+
+	/* Taking them out of the table */
+	dbusmenu_menuitem_property_remove(item, "prop00");
+	dbusmenu_menuitem_property_remove(item, "prop11");
+	dbusmenu_menuitem_property_remove(item, "prop11");
+	g_assert(!dbusmenu_menuitem_property_exist(item, "prop00"));
+	g_assert(!dbusmenu_menuitem_property_exist(item, "prop11"));
+
+	const gint fewer[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+	test_object_menuitem_props_table_check(item, fewer, G_N_ELEMENTS(fewer), FALSE);
+
+	GHashTable * copy = dbusmenu_menuitem_properties_copy(item);
+	g_assert_cmpuint(g_hash_table_size(copy), ==, G_N_ELEMENTS(fewer));
+	g_hash_table_destroy(copy);
+
+	g_object_unref(item);
+
+	return;
+}
+
+/* The dictionary of all the properties is kept until one of
+   them changes */
+static void
+test_object_menuitem_props_variant (void)
+{
+	DbusmenuMenuitem * item = dbusmenu_menuitem_new();
+	dbusmenu_menuitem_property_set(item, DBUSMENU_MENUITEM_PROP_LABEL, "Label");
+	dbusmenu_menuitem_property_set_int(item, "myint", 12);
+
+	GVariant * first = dbusmenu_menuitem_properties_variant(item, NULL);
+	g_assert(first != NULL);
+	g_assert(!g_variant_is_floating(first));
+	g_assert_cmpuint(g_variant_n_children(first), ==, 2);
+
+	/* Asking again, or setting what's already there, is the same one */
+	GVariant * again = dbusmenu_menuitem_properties_variant(item, NULL);
+	g_assert(again == first);
+	g_variant_unref(again);
+
+	dbusmenu_menuitem_property_set_int(item, "myint", 12);
+	again = dbusmenu_menuitem_properties_variant(item, NULL);
+	g_assert(again == first);
+	g_variant_unref(again);
+
+	/* A change builds a new one, and the old one is left alone */
+	dbusmenu_menuitem_property_set_int(item, "myint", 13);
+	GVariant * changed = dbusmenu_menuitem_properties_variant(item, NULL);
+	g_assert(changed != first);
+	g_assert(!g_variant_equal(changed, first));
+
+	gint value = 0;
+	g_assert(g_variant_lookup(changed, "myint", "i", &value));
+	g_assert_cmpint(value, ==, 13);
+	g_assert(g_variant_lookup(first, "myint", "i", &value));
+	g_assert_cmpint(value, ==, 12);
+
+	/* So does taking one out */
+	dbusmenu_menuitem_property_remove(item, "myint");
+	GVariant * removed = dbusmenu_menuitem_properties_variant(item, NULL);
+	g_assert(removed != changed);
+	g_assert_cmpuint(g_variant_n_children(removed), ==, 1);
+
+	g_variant_unref(first);
+	g_variant_unref(changed);
+	g_variant_unref(removed);
+	g_object_unref(item);
+
+	return;
+}
+
+/* Counts the single property signals */
+static void
+test_object_menuitem_props_many_single (DbusmenuMenuitem * mi, gchar * property, GVariant * value, guint * count)
+{
+	(*count)++;
+	return;
+}
+
+/* Counts the batch signals and checks what's in them */
+static void
+test_object_menuitem_props_many_batch (DbusmenuMenuitem * mi, GVariant * changed, GStrv removed, guint * count)
+{
+	(*count)++;
+	g_assert(g_variant_is_of_type(changed, G_VARIANT_TYPE("a{sv}")));
+	g_assert(removed != NULL);
+	return;
+}
+
+/* Set a bunch of properties at once */
+static void
+test_object_menuitem_props_many (void)
+{
+	/* Build a menu item */
+	DbusmenuMenuitem * item = dbusmenu_menuitem_new();
+	guint single = 0;
+	guint batch = 0;
+
+	/* Test to make sure it's a happy object */
+	g_assert(item != NULL);
+
+	g_signal_connect(G_OBJECT(item), DBUSMENU_MENUITEM_SIGNAL_PROPERTY_CHANGED, G_CALLBACK(test_object_menuitem_props_many_single), &single);
+	g_signal_connect(G_OBJECT(item), DBUSMENU_MENUITEM_SIGNAL_PROPERTIES_CHANGED, G_CALLBACK(test_object_menuitem_props_many_batch), &batch);
+
+	/* Set three properties as a dictionary */
+	GVariantBuilder builder;
+	g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
+	g_variant_builder_add(&builder, "{sv}", DBUSMENU_MENUITEM_PROP_LABEL, g_variant_new_string("Label"));
+	g_variant_builder_add(&builder, "{sv}", "myint", g_variant_new_int32(12));
+	g_variant_builder_add(&builder, "{sv}", "mybool", g_variant_new_boolean(TRUE));
+	g_assert(dbusmenu_menuitem_properties_set_many(item, g_variant_builder_end(&builder)));
+
+	g_assert(!g_strcmp0(dbusmenu_menuitem_property_get(item, DBUSMENU_MENUITEM_PROP_LABEL), "Label"));
+	g_assert(dbusmenu_menuitem_property_get_int(item, "myint") == 12);
+	g_assert(dbusmenu_menuitem_property_get_bool(item, "mybool"));
+	g_assert(single == 3);
+	g_assert(batch == 1);
+
+	/* Remove one, change one and leave one the same */
+	const gchar * names[] = { "myint", "mybool", DBUSMENU_MENUITEM_PROP_LABEL };
+	GVariant * values[] = { NULL, g_variant_new_boolean(FALSE), g_variant_new_string("Label") };
+	g_assert(dbusmenu_menuitem_properties_set_manyv(item, G_N_ELEMENTS(names), names, values));
+
+	g_assert(!dbusmenu_menuitem_property_exist(item, "myint"));
+	g_assert(!dbusmenu_menuitem_property_get_bool(item, "mybool"));
+	g_assert(single == 5);
+	g_assert(batch == 2);
+
+	/* Nothing changing means nothing signaled */
+	GVariant * same[] = { NULL, g_variant_new_boolean(FALSE), g_variant_new_string("Label") };
+	g_assert(dbusmenu_menuitem_properties_set_manyv(item, G_N_ELEMENTS(names), names, same));
+	g_assert(single == 5);
+	g_assert(batch == 2);
+
+	g_object_unref(item);
+
+	return;
+}
+
+/* Check that the positions match the order of the children list */
+static void
+test_object_menuitem_children_check (DbusmenuMenuitem * parent, const gint * ids, guint len)
+{
+	GList * children = dbusmenu_menuitem_get_children(parent);
+	guint i;
+
+	g_assert(g_list_length(children) == len);
+
+	for (i = 0; i < len; i++, children = g_list_next(children)) {
+		DbusmenuMenuitem * child = DBUSMENU_MENUITEM(children->data);
+		g_assert(dbusmenu_menuitem_get_id(child) == ids[i]);
+		g_assert(dbusmenu_menuitem_get_position(child, parent) == i);
+		g_assert(dbusmenu_menuitem_child_find(parent, ids[i]) == child);
+	}
+
+	return;
+}
+
+/* Move children around and make sure they know where they are */
+static void
+test_object_menuitem_children (void)
+{
+	DbusmenuMenuitem * parent = dbusmenu_menuitem_new();
+	DbusmenuMenuitem * items[5];
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS(items); i++) {
+		items[i] = dbusmenu_menuitem_new_with_id(i + 1);
+	}
+
+	g_assert(dbusmenu_menuitem_child_append(parent, items[0]));
+	g_assert(dbusmenu_menuitem_child_append(parent, items[1]));
+	g_assert(dbusmenu_menuitem_child_prepend(parent, items[2]));
+	g_assert(dbusmenu_menuitem_child_add_position(parent, items[3], 1));
+	g_assert(dbusmenu_menuitem_child_add_position(parent, items[4], 100));
+	const gint added[] = { 3, 4, 1, 2, 5 };
+	test_object_menuitem_children_check(parent, added, G_N_ELEMENTS(added));
+
+	g_assert(dbusmenu_menuitem_child_reorder(parent, items[4], 0));
+	g_assert(dbusmenu_menuitem_child_reorder(parent, items[2], 3));
+	const gint moved[] = { 5, 4, 1, 3, 2 };
+	test_object_menuitem_children_check(parent, moved, G_N_ELEMENTS(moved));
+
+	g_assert(dbusmenu_menuitem_child_delete(parent, items[0]));
+	const gint deleted[] = { 5, 4, 3, 2 };
+	test_object_menuitem_children_check(parent, deleted, G_N_ELEMENTS(deleted));
+	g_assert(dbusmenu_menuitem_child_find(parent, 1) == NULL);
+
+	/* Only the realized ones count */
+	dbusmenu_menuitem_set_realized(items[4]);
+	dbusmenu_menuitem_set_realized(items[2]);
+	g_assert(dbusmenu_menuitem_get_position_realized(items[4], parent) == 0);
+	g_assert(dbusmenu_menuitem_get_position_realized(items[2], parent) == 1);
+
+	dbusmenu_menuitem_set_realized(items[3]);
+	dbusmenu_menuitem_set_realized(items[1]);
+	g_assert(dbusmenu_menuitem_get_position_realized(items[2], parent) == 2);
+	g_assert(dbusmenu_menuitem_get_position_realized(items[1], parent) == 3);
+
+	g_object_unref(parent);
+	for (i = 0; i < G_N_ELEMENTS(items); i++) {
+		g_object_unref(items[i]);
+	}
+
+	return;
+}
+
+static DbusmenuMenuitem *
+test_object_menuitem_layout_child (DbusmenuMenuitem * parent, gint id)
+{
+	DbusmenuMenuitem * child = dbusmenu_menuitem_new_with_id(id);
+	dbusmenu_menuitem_child_append(parent, child);
+	g_object_unref(child);
+	return child;
+}
+
+/* Each item keeps the layout it built.  Changing one item means
+   it and everything above it have to build theirs again, and the
+   rest keep the one they have. */
+static void
+test_object_menuitem_layout_cache (void)
+{
+	DbusmenuMenuitem * root = dbusmenu_menuitem_new_with_id(0);
+	DbusmenuMenuitem * one = test_object_menuitem_layout_child(root, 1);
+	DbusmenuMenuitem * two = test_object_menuitem_layout_child(root, 2);
+	DbusmenuMenuitem * eleven = test_object_menuitem_layout_child(one, 11);
+	DbusmenuMenuitem * twelve = test_object_menuitem_layout_child(one, 12);
+	DbusmenuMenuitem * twentyone = test_object_menuitem_layout_child(two, 21);
+	DbusmenuMenuitem * deep = test_object_menuitem_layout_child(eleven, 111);
+
+	DbusmenuMenuitem * items[] = { root, one, two, eleven, twelve, twentyone, deep };
+	GVariant * before[G_N_ELEMENTS(items)];
+	guint i;
+
+	/* Building the root builds them all */
+	GVariant * layout = dbusmenu_menuitem_build_variant(root, NULL, -1);
+	for (i = 0; i < G_N_ELEMENTS(items); i++) {
+		before[i] = dbusmenu_menuitem_build_variant(items[i], NULL, -1);
+	}
+	g_assert(layout == before[0]);
+	g_variant_unref(layout);
+
+	/* Asking again is the same one */
+	for (i = 0; i < G_N_ELEMENTS(items); i++) {
+		GVariant * again = dbusmenu_menuitem_build_variant(items[i], NULL, -1);
+		g_assert(again == before[i]);
+		g_variant_unref(again);
+	}
+
+	dbusmenu_menuitem_property_set(deep, DBUSMENU_MENUITEM_PROP_LABEL, "Deep");
+
+	/* The deep one and the ones above it are new, we're still
+	   holding the old ones so they can't be the same */
+	GVariant * after[G_N_ELEMENTS(items)];
+	for (i = 0; i < G_N_ELEMENTS(items); i++) {
+		after[i] = dbusmenu_menuitem_build_variant(items[i], NULL, -1);
+	}
+
+	g_assert(after[0] != before[0]);
+	g_assert(after[1] != before[1]);
+	g_assert(after[3] != before[3]);
+	g_assert(after[6] != before[6]);
+
+	/* Its sibling subtrees are still cached */
+	g_assert(after[2] == before[2]);
+	g_assert(after[4] == before[4]);
+	g_assert(after[5] == before[5]);
+
+	/* A different set of properties is a different layout */
+	const gchar * props[] = { DBUSMENU_MENUITEM_PROP_LABEL, NULL };
+	GVariant * labels = dbusmenu_menuitem_build_variant(two, props, -1);
+	g_assert(labels != after[2]);
+	g_variant_unref(labels);
+
+	for (i = 0; i < G_N_ELEMENTS(items); i++) {
+		g_variant_unref(before[i]);
+		g_variant_unref(after[i]);
+	}
+	g_object_unref(root);
+
+	return;
+}
+
+static void
+test_object_menuitem_servers_prop (DbusmenuServer * server, gint id, const gchar * property, GVariant * value, gpointer user_data)
+{
+	guint * count = (guint *)user_data;
+	(*count)++;
+	return;
+}
+
+/* An item that is in two servers has to tell both of them
+   about changes, and keep telling the one that's left */
+static void
+test_object_menuitem_servers (void)
+{
+	DbusmenuMenuitem * root = dbusmenu_menuitem_new();
+	DbusmenuMenuitem * child = dbusmenu_menuitem_new();
+	dbusmenu_menuitem_child_append(root, child);
+
+	/* Not on the bus, only their bookkeeping on the items */
+	DbusmenuServer * first = g_object_new(DBUSMENU_TYPE_SERVER, NULL);
+	DbusmenuServer * second = g_object_new(DBUSMENU_TYPE_SERVER, NULL);
+	guint firstcount = 0;
+	guint secondcount = 0;
+
+	g_signal_connect(first, DBUSMENU_SERVER_SIGNAL_ID_PROP_UPDATE, G_CALLBACK(test_object_menuitem_servers_prop), &firstcount);
+	g_signal_connect(second, DBUSMENU_SERVER_SIGNAL_ID_PROP_UPDATE, G_CALLBACK(test_object_menuitem_servers_prop), &secondcount);
+
+	dbusmenu_server_set_root(first, root);
+	dbusmenu_server_set_root(second, root);
+
+	dbusmenu_menuitem_property_set(child, DBUSMENU_MENUITEM_PROP_LABEL, "Both");
+	g_assert(firstcount == 1);
+	g_assert(secondcount == 1);
+
+	/* Ones that get added later are watched by both too */
+	DbusmenuMenuitem * later = dbusmenu_menuitem_new();
+	dbusmenu_menuitem_child_append(child, later);
+	dbusmenu_menuitem_property_set(later, DBUSMENU_MENUITEM_PROP_LABEL, "Later");
+	g_assert(firstcount == 2);
+	g_assert(secondcount == 2);
+
+	/* The first one going away leaves the second one watching */
+	g_object_unref(first);
+	dbusmenu_menuitem_property_set(child, DBUSMENU_MENUITEM_PROP_LABEL, "Second");
+	dbusmenu_menuitem_property_set(later, DBUSMENU_MENUITEM_PROP_LABEL, "Still second");
+	g_assert(firstcount == 2);
+	g_assert(secondcount == 4);
+
+	g_object_unref(second);
+	dbusmenu_menuitem_property_set(child, DBUSMENU_MENUITEM_PROP_LABEL, "Neither");
+	g_assert(secondcount == 4);
+
+	g_object_unref(later);
+	g_object_unref(child);
+	g_object_unref(root);
+
+	return;
+}
+
 /* Build the test suite */
 static void
 test_glib_objects_suite (void)
@@ -318,6 +734,12 @@ test_glib_objects_suite (void)
 	g_test_add_func ("/dbusmenu/glib/objects/menuitem/props_signals", test_object_menuitem_props_signals);
 	g_test_add_func ("/dbusmenu/glib/objects/menuitem/props_boolstr", test_object_menuitem_props_boolstr);
 	g_test_add_func ("/dbusmenu/glib/objects/menuitem/props_removal", test_object_menuitem_props_removal);
+	g_test_add_func ("/dbusmenu/glib/objects/menuitem/props_many",    test_object_menuitem_props_many);
+	g_test_add_func ("/dbusmenu/glib/objects/menuitem/props_variant", test_object_menuitem_props_variant);
+	g_test_add_func ("/dbusmenu/glib/objects/menuitem/props_table",   test_object_menuitem_props_table);
+	g_test_add_func ("/dbusmenu/glib/objects/menuitem/children",      test_object_menuitem_children);
+	g_test_add_func ("/dbusmenu/glib/objects/menuitem/layout_cache",  test_object_menuitem_layout_cache);
+	g_test_add_func ("/dbusmenu/glib/objects/menuitem/servers",       test_object_menuitem_servers);
 	return;
 }
 
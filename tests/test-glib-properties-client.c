@@ -157,7 +157,14 @@ main (int argc, char ** argv)
 	/* Make sure the server starts up and all that */
 	g_usleep(500000);
 
-	DbusmenuClient * client = dbusmenu_client_new(":1.0", "/org/test");
+	/* With --lean it's the same test without the proxy */
+	gboolean lean = argc > 1 && g_strcmp0(argv[1], "--lean") == 0;
+
+	DbusmenuClient * client = DBUSMENU_CLIENT(g_object_new(DBUSMENU_TYPE_CLIENT,
+	                                                       DBUSMENU_CLIENT_PROP_DBUS_NAME, ":1.0",
+	                                                       DBUSMENU_CLIENT_PROP_DBUS_OBJECT, "/org/test",
+	                                                       DBUSMENU_CLIENT_PROP_LEAN_TRANSPORT, lean,
+	                                                       NULL));
 	g_signal_connect(G_OBJECT(client), DBUSMENU_CLIENT_SIGNAL_LAYOUT_UPDATED, G_CALLBACK(layout_updated), NULL);
 
 	death_timer = g_timeout_add_seconds(DEATH_TIME, timer_func, client);
@@ -0,0 +1,257 @@
+/*
+A test for libdbusmenu to ensure its quality.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it 
+under the terms of the GNU General Public License version 3, as published 
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but 
+WITHOUT ANY WARRANTY; without even the implied warranties of 
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR 
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along 
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <libdbusmenu-glib/server.h>
+#include <libdbusmenu-glib/menuitem.h>
+
+#include "test-glib-inproc.h"
+
+typedef struct _cache_call_t cache_call_t;
+struct _cache_call_t {
+	gboolean done;
+	guint revision;
+	guint children;
+};
+
+static void
+cache_call_cb (GObject * object, GAsyncResult * res, gpointer user_data)
+{
+	cache_call_t * call = (cache_call_t *)user_data;
+	GError * error = NULL;
+
+	GVariant * reply = g_dbus_connection_call_finish(G_DBUS_CONNECTION(object), res, &error);
+	g_assert_no_error(error);
+
+	GVariant * layout = NULL;
+	g_variant_get(reply, "(u@(ia{sv}av))", &call->revision, &layout);
+
+	GVariant * children = g_variant_get_child_value(layout, 2);
+	call->children = g_variant_n_children(children);
+	g_variant_unref(children);
+
+	g_variant_unref(layout);
+	g_variant_unref(reply);
+
+	call->done = TRUE;
+	return;
+}
+
+static gboolean
+cache_call_done (gpointer data)
+{
+	return ((cache_call_t *)data)->done;
+}
+
+/* Calls GetLayout on ourselves.  It has to be async as the
+   server answers from our mainloop.  Returns how many children
+   @parent has in the reply. */
+static guint
+cache_get_layout (GDBusConnection * bus, const gchar * path, gint parent)
+{
+	cache_call_t call = { FALSE, 0, 0 };
+	const gchar * props[] = { NULL };
+
+	g_dbus_connection_call(bus,
+	                       g_dbus_connection_get_unique_name(bus),
+	                       path,
+	                       "com.canonical.dbusmenu",
+	                       "GetLayout",
+	                       g_variant_new("(ii^as)", parent, -1, props),
+	                       G_VARIANT_TYPE("(u(ia{sv}av))"),
+	                       G_DBUS_CALL_FLAGS_NONE,
+	                       -1,
+	                       NULL,
+	                       cache_call_cb,
+	                       &call);
+
+	g_assert(test_wait_for(cache_call_done, &call));
+	return call.children;
+}
+
+static void
+cache_counts (DbusmenuServer * server, guint * hits, guint * misses)
+{
+	g_object_get(G_OBJECT(server),
+	             DBUSMENU_SERVER_PROP_LAYOUT_CACHE_HITS, hits,
+	             DBUSMENU_SERVER_PROP_LAYOUT_CACHE_MISSES, misses,
+	             NULL);
+	return;
+}
+
+/* Asking for the same thing twice only builds it once */
+static void
+test_cache_repeat (void)
+{
+	test_fixture_t test;
+	test_fixture_setup(&test, "/org/test/cache/repeat", test_menu_new(5));
+	test_settle();
+
+	guint hits, misses;
+	cache_counts(test.server, &hits, &misses);
+	g_assert(hits == 0);
+	g_assert(misses == 0);
+
+	cache_get_layout(test.bus, test.path, 0);
+	cache_counts(test.server, &hits, &misses);
+	g_assert(hits == 0);
+	g_assert(misses == 1);
+
+	cache_get_layout(test.bus, test.path, 0);
+	cache_counts(test.server, &hits, &misses);
+	g_assert(hits == 1);
+	g_assert(misses == 1);
+
+	/* A different parent is a different layout */
+	cache_get_layout(test.bus, test.path, 3);
+	cache_counts(test.server, &hits, &misses);
+	g_assert(hits == 1);
+	g_assert(misses == 2);
+
+	test_fixture_teardown(&test);
+	return;
+}
+
+/* Changing a property drops the layouts that have it, and
+   only those */
+static void
+test_cache_property (void)
+{
+	test_fixture_t test;
+	test_fixture_setup(&test, "/org/test/cache/property", test_menu_new(5));
+	test_settle();
+
+	guint hits, misses;
+	cache_get_layout(test.bus, test.path, 0);
+	cache_get_layout(test.bus, test.path, 1);
+	cache_counts(test.server, &hits, &misses);
+	g_assert(hits == 0);
+	g_assert(misses == 2);
+
+	dbusmenu_menuitem_property_set(dbusmenu_menuitem_find_id(test.root, 2), DBUSMENU_MENUITEM_PROP_LABEL, "Changed");
+
+	/* The whole layout has item 2 in it */
+	cache_get_layout(test.bus, test.path, 0);
+	cache_counts(test.server, &hits, &misses);
+	g_assert(hits == 0);
+	g_assert(misses == 3);
+
+	/* Item 1's doesn't */
+	cache_get_layout(test.bus, test.path, 1);
+	cache_counts(test.server, &hits, &misses);
+	g_assert(hits == 1);
+	g_assert(misses == 3);
+
+	test_fixture_teardown(&test);
+	return;
+}
+
+/* Any change to the structure drops everything */
+static void
+test_cache_structure (void)
+{
+	test_fixture_t test;
+	test_fixture_setup(&test, "/org/test/cache/structure", test_menu_new(5));
+	test_settle();
+
+	guint hits, misses;
+	cache_get_layout(test.bus, test.path, 0);
+	cache_get_layout(test.bus, test.path, 1);
+	cache_counts(test.server, &hits, &misses);
+	g_assert(hits == 0);
+	g_assert(misses == 2);
+
+	DbusmenuMenuitem * child = dbusmenu_menuitem_new_with_id(6);
+	dbusmenu_menuitem_child_append(test.root, child);
+	g_object_unref(child);
+
+	cache_get_layout(test.bus, test.path, 0);
+	cache_get_layout(test.bus, test.path, 1);
+	cache_counts(test.server, &hits, &misses);
+	g_assert(hits == 0);
+	g_assert(misses == 4);
+
+	/* And then they're cached again */
+	cache_get_layout(test.bus, test.path, 0);
+	cache_counts(test.server, &hits, &misses);
+	g_assert(hits == 1);
+	g_assert(misses == 4);
+
+	test_fixture_teardown(&test);
+	return;
+}
+
+/* While frozen the layout isn't signaled, but items that are
+   removed are gone right away, and a cached reply can't still
+   have them in it */
+static void
+test_cache_frozen (void)
+{
+	test_fixture_t test;
+	test_fixture_setup(&test, "/org/test/cache/frozen", test_menu_new(5));
+	test_settle();
+
+	guint hits, misses;
+	g_assert(cache_get_layout(test.bus, test.path, 0) == 5);
+	cache_counts(test.server, &hits, &misses);
+	g_assert(hits == 0);
+	g_assert(misses == 1);
+
+	dbusmenu_server_freeze(test.server);
+	dbusmenu_menuitem_child_delete(test.root, dbusmenu_menuitem_find_id(test.root, 2));
+
+	g_assert(cache_get_layout(test.bus, test.path, 0) == 4);
+	cache_counts(test.server, &hits, &misses);
+	g_assert(hits == 0);
+	g_assert(misses == 2);
+
+	/* The thaw has a new revision, so it's built again */
+	dbusmenu_server_thaw(test.server);
+	g_assert(cache_get_layout(test.bus, test.path, 0) == 4);
+	g_assert(cache_get_layout(test.bus, test.path, 0) == 4);
+	cache_counts(test.server, &hits, &misses);
+	g_assert(hits == 1);
+	g_assert(misses == 3);
+
+	test_fixture_teardown(&test);
+	return;
+}
+
+/* Build the test suite */
+static void
+test_glib_server_cache_suite (void)
+{
+	g_test_add_func ("/dbusmenu/glib/server_cache/repeat",    test_cache_repeat);
+	g_test_add_func ("/dbusmenu/glib/server_cache/property",  test_cache_property);
+	g_test_add_func ("/dbusmenu/glib/server_cache/structure", test_cache_structure);
+	g_test_add_func ("/dbusmenu/glib/server_cache/frozen",    test_cache_frozen);
+	return;
+}
+
+gint
+main (gint argc, gchar * argv[])
+{
+	g_test_init(&argc, &argv, NULL);
+
+	/* Test suites */
+	test_glib_server_cache_suite();
+
+	return g_test_run ();
+}
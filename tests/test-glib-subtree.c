@@ -0,0 +1,498 @@
+/*
+A test for libdbusmenu to ensure its quality.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it 
+under the terms of the GNU General Public License version 3, as published 
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but 
+WITHOUT ANY WARRANTY; without even the implied warranties of 
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR 
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along 
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <libdbusmenu-glib/client.h>
+#include <libdbusmenu-glib/server.h>
+#include <libdbusmenu-glib/menuitem.h>
+
+#include "test-glib-inproc.h"
+
+static void
+subtree_append (DbusmenuMenuitem * parent, gint id)
+{
+	DbusmenuMenuitem * child = dbusmenu_menuitem_new_with_id(id);
+	gchar * label = g_strdup_printf("Item %d", id);
+	dbusmenu_menuitem_property_set(child, DBUSMENU_MENUITEM_PROP_LABEL, label);
+	dbusmenu_menuitem_child_append(parent, child);
+	g_object_unref(child);
+	g_free(label);
+	return;
+}
+
+/* The root has 1 and 2, 1 has 11 and 12, 11 has 111 and 112 */
+static DbusmenuMenuitem *
+subtree_menu_new (void)
+{
+	DbusmenuMenuitem * root = test_menu_new(2);
+	DbusmenuMenuitem * one = dbusmenu_menuitem_find_id(root, 1);
+
+	subtree_append(one, 11);
+	subtree_append(one, 12);
+	subtree_append(dbusmenu_menuitem_find_id(root, 11), 111);
+	subtree_append(dbusmenu_menuitem_find_id(root, 11), 112);
+
+	return root;
+}
+
+typedef struct _subtree_signals_t subtree_signals_t;
+struct _subtree_signals_t {
+	guint count;
+	gint parent;
+};
+
+static void
+subtree_layout_updated (GDBusConnection * connection, const gchar * sender, const gchar * path, const gchar * interface, const gchar * signal, GVariant * params, gpointer user_data)
+{
+	subtree_signals_t * signals = (subtree_signals_t *)user_data;
+	guint revision;
+
+	g_variant_get(params, "(ui)", &revision, &signals->parent);
+	signals->count++;
+
+	return;
+}
+
+static gboolean
+subtree_signaled (gpointer data)
+{
+	return ((subtree_signals_t *)data)->count > 0;
+}
+
+/* Make the changes between @a and @b in one go and get the
+   parent that the server signals for them */
+static gint
+subtree_signal_parent (DbusmenuMenuitem * root, subtree_signals_t * signals, gint a, gint aid, gint b, gint bid)
+{
+	signals->count = 0;
+
+	subtree_append(dbusmenu_menuitem_find_id(root, a), aid);
+	subtree_append(dbusmenu_menuitem_find_id(root, b), bid);
+
+	g_assert(test_wait_for(subtree_signaled, signals));
+	test_settle();
+	g_assert(signals->count == 1);
+
+	return signals->parent;
+}
+
+/* The server should point at the smallest part of the tree
+   that has all of the changes in it */
+static void
+test_subtree_narrowest_parent (void)
+{
+	GDBusConnection * bus = test_bus();
+	DbusmenuServer * server = dbusmenu_server_new("/org/test/subtree/server");
+	DbusmenuMenuitem * root = subtree_menu_new();
+	dbusmenu_server_set_root(server, root);
+	test_settle();
+
+	subtree_signals_t signals = { 0, -1 };
+	guint subscription = g_dbus_connection_signal_subscribe(bus,
+	                                                        g_dbus_connection_get_unique_name(bus),
+	                                                        "com.canonical.dbusmenu",
+	                                                        "LayoutUpdated",
+	                                                        "/org/test/subtree/server",
+	                                                        NULL, /* arg0 */
+	                                                        G_DBUS_SIGNAL_FLAGS_NONE,
+	                                                        subtree_layout_updated,
+	                                                        &signals, NULL);
+
+	/* Both under the same item */
+	g_assert(subtree_signal_parent(root, &signals, 11, 113, 11, 114) == 11);
+
+	/* One under 11 and one under 12, which meet at 1 */
+	g_assert(subtree_signal_parent(root, &signals, 11, 115, 12, 121) == 1);
+
+	/* An item and one of its children is the item */
+	g_assert(subtree_signal_parent(root, &signals, 1, 13, 11, 116) == 1);
+
+	/* Only the root has both of these */
+	g_assert(subtree_signal_parent(root, &signals, 11, 117, 2, 21) == 0);
+
+	/* A removal is signaled on the parent it was removed from */
+	signals.count = 0;
+	dbusmenu_menuitem_child_delete(dbusmenu_menuitem_find_id(root, 11), dbusmenu_menuitem_find_id(root, 111));
+	g_assert(test_wait_for(subtree_signaled, &signals));
+	g_assert(signals.parent == 11);
+
+	g_dbus_connection_signal_unsubscribe(bus, subscription);
+	g_object_unref(server);
+	g_object_unref(root);
+	test_settle();
+	g_object_unref(bus);
+
+	return;
+}
+
+/* A server that only speaks version 3, so the client can't use
+   GetLayoutDelta and has to get the part that changed */
+static const gchar * v3_xml =
+"<node>"
+"  <interface name='com.canonical.dbusmenu'>"
+"    <property name='Version' type='u' access='read'/>"
+"    <property name='TextDirection' type='s' access='read'/>"
+"    <property name='Status' type='s' access='read'/>"
+"    <property name='IconThemePath' type='as' access='read'/>"
+"    <method name='GetLayout'>"
+"      <arg type='i' name='parentId' direction='in'/>"
+"      <arg type='i' name='recursionDepth' direction='in'/>"
+"      <arg type='as' name='propertyNames' direction='in'/>"
+"      <arg type='u' name='revision' direction='out'/>"
+"      <arg type='(ia{sv}av)' name='layout' direction='out'/>"
+"    </method>"
+"    <signal name='LayoutUpdated'>"
+"      <arg type='u' name='revision'/>"
+"      <arg type='i' name='parent'/>"
+"    </signal>"
+"  </interface>"
+"</node>";
+
+typedef struct _v3_server_t v3_server_t;
+struct _v3_server_t {
+	DbusmenuMenuitem * root;
+	guint revision;
+	GArray * parents; /* The parents GetLayout was asked for */
+};
+
+static GVariant *
+v3_layout (DbusmenuMenuitem * mi)
+{
+	GVariantBuilder props;
+	g_variant_builder_init(&props, G_VARIANT_TYPE("a{sv}"));
+
+	if (dbusmenu_menuitem_property_exist(mi, DBUSMENU_MENUITEM_PROP_LABEL)) {
+		g_variant_builder_add(&props, "{sv}", DBUSMENU_MENUITEM_PROP_LABEL,
+		                      g_variant_new_string(dbusmenu_menuitem_property_get(mi, DBUSMENU_MENUITEM_PROP_LABEL)));
+	}
+
+	GVariantBuilder children;
+	g_variant_builder_init(&children, G_VARIANT_TYPE("av"));
+
+	GList * child;
+	for (child = dbusmenu_menuitem_get_children(mi); child != NULL; child = g_list_next(child)) {
+		g_variant_builder_add(&children, "v", v3_layout(DBUSMENU_MENUITEM(child->data)));
+	}
+
+	return g_variant_new("(i@a{sv}@av)", dbusmenu_menuitem_get_id(mi),
+	                     g_variant_builder_end(&props),
+	                     g_variant_builder_end(&children));
+}
+
+static void
+v3_method (GDBusConnection * connection, const gchar * sender, const gchar * path, const gchar * interface, const gchar * method, GVariant * params, GDBusMethodInvocation * invocation, gpointer user_data)
+{
+	v3_server_t * v3 = (v3_server_t *)user_data;
+	gint parent;
+	gint depth;
+	GVariant * props;
+
+	g_variant_get(params, "(ii@as)", &parent, &depth, &props);
+	g_variant_unref(props);
+	g_array_append_val(v3->parents, parent);
+
+	DbusmenuMenuitem * mi = dbusmenu_menuitem_find_id(v3->root, parent);
+	if (mi == NULL) {
+		g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS, "No item %d", parent);
+		return;
+	}
+
+	g_dbus_method_invocation_return_value(invocation,
+		g_variant_new("(u@(ia{sv}av))", v3->revision, v3_layout(mi)));
+
+	return;
+}
+
+static GVariant *
+v3_property (GDBusConnection * connection, const gchar * sender, const gchar * path, const gchar * interface, const gchar * property, GError ** error, gpointer user_data)
+{
+	if (g_strcmp0(property, "Version") == 0) {
+		return g_variant_new_uint32(3);
+	} else if (g_strcmp0(property, "TextDirection") == 0) {
+		return g_variant_new_string("ltr");
+	} else if (g_strcmp0(property, "Status") == 0) {
+		return g_variant_new_string("normal");
+	} else if (g_strcmp0(property, "IconThemePath") == 0) {
+		return g_variant_new_strv(NULL, 0);
+	}
+
+	return NULL;
+}
+
+static const GDBusInterfaceVTable v3_vtable = {
+	v3_method,
+	v3_property,
+	NULL
+};
+
+/* Tell the client that something changed under @parent */
+static void
+v3_layout_updated (GDBusConnection * bus, v3_server_t * v3, gint parent)
+{
+	v3->revision++;
+	g_dbus_connection_emit_signal(bus, NULL, "/org/test/subtree/v3", "com.canonical.dbusmenu", "LayoutUpdated",
+	                              g_variant_new("(ui)", v3->revision, parent), NULL);
+	return;
+}
+
+/* The client should only get the subtree it's told about, and
+   leave the items outside of it alone */
+static void
+test_subtree_refetch (void)
+{
+	GDBusConnection * bus = test_bus();
+	GDBusNodeInfo * info = g_dbus_node_info_new_for_xml(v3_xml, NULL);
+	g_assert(info != NULL);
+
+	v3_server_t v3;
+	v3.root = subtree_menu_new();
+	v3.revision = 1;
+	v3.parents = g_array_new(FALSE, FALSE, sizeof(gint));
+
+	guint object = g_dbus_connection_register_object(bus, "/org/test/subtree/v3", info->interfaces[0], &v3_vtable, &v3, NULL, NULL);
+	g_assert(object != 0);
+
+	DbusmenuClient * client = dbusmenu_client_new(g_dbus_connection_get_unique_name(bus), "/org/test/subtree/v3");
+	g_assert(test_wait_for_sync(v3.root, client));
+	test_settle();
+
+	DbusmenuMenuitem * clientroot = dbusmenu_client_get_root(client);
+	DbusmenuMenuitem * two = dbusmenu_menuitem_find_id(clientroot, 2);
+	DbusmenuMenuitem * twelve = dbusmenu_menuitem_find_id(clientroot, 12);
+	g_array_set_size(v3.parents, 0);
+	test_calls_reset();
+
+	/* Something new under 11 */
+	subtree_append(dbusmenu_menuitem_find_id(v3.root, 11), 113);
+	v3_layout_updated(bus, &v3, 11);
+
+	g_assert(test_wait_for_sync(v3.root, client));
+	test_settle();
+
+	g_assert(test_calls_count("GetLayout") == 1);
+	g_assert(v3.parents->len == 1);
+	g_assert(g_array_index(v3.parents, gint, 0) == 11);
+
+	/* Nothing else got rebuilt */
+	g_assert(dbusmenu_client_get_root(client) == clientroot);
+	g_assert(dbusmenu_menuitem_find_id(clientroot, 2) == two);
+	g_assert(dbusmenu_menuitem_find_id(clientroot, 12) == twelve);
+	g_assert(g_strcmp0(dbusmenu_menuitem_property_get(dbusmenu_menuitem_find_id(clientroot, 113), DBUSMENU_MENUITEM_PROP_LABEL), "Item 113") == 0);
+
+	/* Two updates that arrive together get merged into one
+	   request for the item that has both of them */
+	g_object_set(client, DBUSMENU_CLIENT_PROP_LAYOUT_DEBOUNCE, 50, NULL);
+	g_array_set_size(v3.parents, 0);
+	test_calls_reset();
+	subtree_append(dbusmenu_menuitem_find_id(v3.root, 11), 118);
+	v3_layout_updated(bus, &v3, 11);
+	subtree_append(dbusmenu_menuitem_find_id(v3.root, 12), 122);
+	v3_layout_updated(bus, &v3, 12);
+
+	g_assert(test_wait_for_sync(v3.root, client));
+	test_settle();
+
+	g_assert(test_calls_count("GetLayout") == 1);
+	g_assert(v3.parents->len == 1);
+	g_assert(g_array_index(v3.parents, gint, 0) == 1);
+	g_assert(dbusmenu_menuitem_find_id(clientroot, 2) == two);
+	g_object_set(client, DBUSMENU_CLIENT_PROP_LAYOUT_DEBOUNCE, 0, NULL);
+
+	/* A parent the client has never heard of means it's lost,
+	   so it has to start from the root */
+	g_array_set_size(v3.parents, 0);
+	subtree_append(dbusmenu_menuitem_find_id(v3.root, 2), 21);
+	subtree_append(dbusmenu_menuitem_find_id(v3.root, 21), 211);
+	v3_layout_updated(bus, &v3, 21);
+
+	g_assert(test_wait_for_sync(v3.root, client));
+	test_settle();
+
+	g_assert(v3.parents->len == 1);
+	g_assert(g_array_index(v3.parents, gint, 0) == 0);
+
+	g_object_unref(client);
+	g_dbus_connection_unregister_object(bus, object);
+	g_dbus_node_info_unref(info);
+	g_array_free(v3.parents, TRUE);
+	g_object_unref(v3.root);
+	test_settle();
+	g_object_unref(bus);
+
+	return;
+}
+
+/* A client that waits @debounce before fetching a changed
+   layout, but not longer than @staleness */
+static void
+debounce_setup (test_fixture_t * test, const gchar * path, guint debounce, guint staleness)
+{
+	test_fixture_setup(test, path, test_menu_new(3));
+	test_fixture_connect(test, DBUSMENU_CLIENT(g_object_new(DBUSMENU_TYPE_CLIENT,
+	                                                        DBUSMENU_CLIENT_PROP_DBUS_NAME, g_dbus_connection_get_unique_name(test->bus),
+	                                                        DBUSMENU_CLIENT_PROP_DBUS_OBJECT, path,
+	                                                        DBUSMENU_CLIENT_PROP_LAYOUT_DEBOUNCE, debounce,
+	                                                        DBUSMENU_CLIENT_PROP_LAYOUT_MAX_STALENESS, staleness,
+	                                                        NULL)));
+	test_calls_reset();
+
+	return;
+}
+
+/* Add an item, which the server signals on its own */
+static void
+debounce_append (DbusmenuMenuitem * root)
+{
+	subtree_append(root, 10 + g_list_length(dbusmenu_menuitem_get_children(root)));
+	return;
+}
+
+static guint
+debounce_fetches_saved (test_fixture_t * test)
+{
+	guint saved = 0;
+	g_object_get(test->client, DBUSMENU_CLIENT_PROP_LAYOUT_FETCHES_SAVED, &saved, NULL);
+	return saved;
+}
+
+/* A burst of changes is only fetched once, after it stops */
+static void
+test_debounce_coalesce (void)
+{
+	test_fixture_t test;
+	debounce_setup(&test, "/org/test/debounce/coalesce", 500, 0);
+
+	/* Each one gets to the client before the next */
+	guint i;
+	for (i = 0; i < 5; i++) {
+		debounce_append(test.root);
+		test_settle();
+	}
+
+	g_assert(test_calls_count("LayoutUpdated") == 5);
+	g_assert(test_calls_count("GetLayoutDelta") == 0);
+
+	g_assert(test_wait_for_sync(test.root, test.client));
+	test_settle();
+
+	g_assert(test_calls_count("GetLayoutDelta") == 1);
+	g_assert(test_calls_count("GetLayout") == 0);
+	g_assert(debounce_fetches_saved(&test) == 4);
+
+	test_fixture_teardown(&test);
+	return;
+}
+
+typedef struct _debounce_burst_t debounce_burst_t;
+struct _debounce_burst_t {
+	DbusmenuMenuitem * root;
+	guint count;
+};
+
+static gboolean
+debounce_burst_append (gpointer data)
+{
+	debounce_burst_t * burst = (debounce_burst_t *)data;
+	debounce_append(burst->root);
+	burst->count++;
+	return TRUE;
+}
+
+/* A server that never stops changing still gets fetched
+   once the layout is as old as we'll let it be */
+static void
+test_debounce_max_staleness (void)
+{
+	test_fixture_t test;
+	debounce_setup(&test, "/org/test/debounce/staleness", 300, 500);
+
+	/* None of them are 300ms apart, so only the deadline can
+	   get the client to fetch */
+	debounce_burst_t burst = { test.root, 0 };
+	debounce_burst_append(&burst);
+	guint timer = g_timeout_add(100, debounce_burst_append, &burst);
+
+	g_assert(test_wait_for_calls("GetLayoutDelta", 1));
+	g_source_remove(timer);
+	g_assert(burst.count > 1);
+
+	g_assert(test_wait_for_sync(test.root, test.client));
+	test_settle();
+
+	g_assert(test_calls_count("GetLayoutDelta") < burst.count);
+	g_assert(test_calls_count("GetLayout") == 0);
+	g_assert(debounce_fetches_saved(&test) > 0);
+	g_assert(debounce_fetches_saved(&test) + test_calls_count("GetLayoutDelta") <= burst.count);
+
+	test_fixture_teardown(&test);
+	return;
+}
+
+/* Without a debounce every change is fetched right away */
+static void
+test_debounce_off (void)
+{
+	test_fixture_t test;
+	debounce_setup(&test, "/org/test/debounce/off", 0, 0);
+
+	debounce_append(test.root);
+	g_assert(test_wait_for_sync(test.root, test.client));
+	test_settle();
+
+	debounce_append(test.root);
+	g_assert(test_wait_for_sync(test.root, test.client));
+	test_settle();
+
+	g_assert(test_calls_count("GetLayoutDelta") == 2);
+	g_assert(debounce_fetches_saved(&test) == 0);
+
+	test_fixture_teardown(&test);
+	return;
+}
+
+/* Build the test suites */
+static void
+test_glib_subtree_suite (void)
+{
+	g_test_add_func ("/dbusmenu/glib/subtree/narrowest_parent", test_subtree_narrowest_parent);
+	g_test_add_func ("/dbusmenu/glib/subtree/refetch",          test_subtree_refetch);
+	return;
+}
+
+static void
+test_glib_debounce_suite (void)
+{
+	g_test_add_func ("/dbusmenu/glib/debounce/coalesce",      test_debounce_coalesce);
+	g_test_add_func ("/dbusmenu/glib/debounce/max_staleness", test_debounce_max_staleness);
+	g_test_add_func ("/dbusmenu/glib/debounce/off",           test_debounce_off);
+	return;
+}
+
+gint
+main (gint argc, gchar * argv[])
+{
+	g_test_init(&argc, &argv, NULL);
+
+	/* Test suites */
+	test_glib_subtree_suite();
+	test_glib_debounce_suite();
+
+	return g_test_run ();
+}
@@ -0,0 +1,738 @@
+/*
+A test for libdbusmenu to ensure its quality.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it 
+under the terms of the GNU General Public License version 3, as published 
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but 
+WITHOUT ANY WARRANTY; without even the implied warranties of 
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR 
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along 
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <libdbusmenu-glib/client.h>
+#include <libdbusmenu-glib/server.h>
+#include <libdbusmenu-glib/menuitem.h>
+
+/* The hub isn't exported from the library, so it's built in here */
+#include <libdbusmenu-glib/client-hub.c>
+
+#include "test-glib-inproc.h"
+
+typedef struct _hub_route_test_t hub_route_test_t;
+struct _hub_route_test_t {
+	guint id;
+	guint count;
+	gchar * signal;
+	hub_route_test_t * drop; /* Unregister this one when called */
+};
+
+static void
+hub_route_cb (const gchar * sender, const gchar * signal, GVariant * params, gpointer user_data)
+{
+	hub_route_test_t * route = (hub_route_test_t *)user_data;
+
+	route->count++;
+	g_free(route->signal);
+	route->signal = g_strdup(signal);
+
+	if (route->drop != NULL && route->drop->id != 0) {
+		_dbusmenu_client_hub_unregister(route->drop->id);
+		route->drop->id = 0;
+	}
+
+	return;
+}
+
+static void
+hub_route_register (GDBusConnection * bus, const gchar * sender, const gchar * object, hub_route_test_t * route)
+{
+	route->count = 0;
+	route->signal = NULL;
+	route->drop = NULL;
+	route->id = _dbusmenu_client_hub_register(bus, sender, object, hub_route_cb, route);
+	g_assert(route->id != 0);
+	return;
+}
+
+static void
+hub_route_clear (hub_route_test_t * route)
+{
+	if (route->id != 0) {
+		_dbusmenu_client_hub_unregister(route->id);
+		route->id = 0;
+	}
+	g_free(route->signal);
+	route->signal = NULL;
+	return;
+}
+
+static void
+hub_emit (GDBusConnection * bus, const gchar * object, const gchar * signal)
+{
+	g_dbus_connection_emit_signal(bus, NULL, object, "com.canonical.dbusmenu", signal, NULL, NULL);
+	return;
+}
+
+static gboolean
+hub_route_called (gpointer data)
+{
+	return ((hub_route_test_t *)data)->count > 0;
+}
+
+/* Each route only gets the signals for its sender and object,
+   and routes for the same ones all get them */
+static void
+test_hub_routing (void)
+{
+	GDBusConnection * bus = test_bus();
+	const gchar * us = g_dbus_connection_get_unique_name(bus);
+
+	hub_route_test_t a, a2, b, other;
+	hub_route_register(bus, us, "/org/test/hub/a", &a);
+	hub_route_register(bus, us, "/org/test/hub/a", &a2);
+	hub_route_register(bus, us, "/org/test/hub/b", &b);
+	hub_route_register(bus, ":1.999999", "/org/test/hub/a", &other);
+
+	hub_emit(bus, "/org/test/hub/a", "LayoutUpdated");
+	g_assert(test_wait_for(hub_route_called, &a));
+	test_settle();
+
+	g_assert(a.count == 1);
+	g_assert(a2.count == 1);
+	g_assert(b.count == 0);
+	g_assert(other.count == 0);
+	g_assert(g_strcmp0(a.signal, "LayoutUpdated") == 0);
+
+	hub_emit(bus, "/org/test/hub/b", "ItemsPropertiesUpdated");
+	g_assert(test_wait_for(hub_route_called, &b));
+	test_settle();
+
+	g_assert(a.count == 1);
+	g_assert(b.count == 1);
+	g_assert(g_strcmp0(b.signal, "ItemsPropertiesUpdated") == 0);
+
+	/* Once one is gone the other still gets them */
+	hub_route_clear(&a);
+	hub_emit(bus, "/org/test/hub/a", "LayoutUpdated");
+	test_settle();
+	g_assert(a2.count == 2);
+
+	hub_route_clear(&a2);
+	hub_route_clear(&b);
+	hub_route_clear(&other);
+
+	/* With nobody left the hub went away, a new one works too */
+	g_assert(g_hash_table_size(hubs) == 0);
+
+	hub_route_register(bus, us, "/org/test/hub/b", &b);
+	hub_emit(bus, "/org/test/hub/b", "LayoutUpdated");
+	g_assert(test_wait_for(hub_route_called, &b));
+	hub_route_clear(&b);
+
+	test_settle();
+	g_object_unref(bus);
+	return;
+}
+
+/* A route that's unregistered while the signal is being handed
+   out doesn't get called, even though it was going to be */
+static void
+test_hub_unregister_in_dispatch (void)
+{
+	GDBusConnection * bus = test_bus();
+	const gchar * us = g_dbus_connection_get_unique_name(bus);
+
+	/* Newer routes are called first */
+	hub_route_test_t dropped, dropper;
+	hub_route_register(bus, us, "/org/test/hub/dispatch", &dropped);
+	hub_route_register(bus, us, "/org/test/hub/dispatch", &dropper);
+	dropper.drop = &dropped;
+
+	hub_emit(bus, "/org/test/hub/dispatch", "LayoutUpdated");
+	g_assert(test_wait_for(hub_route_called, &dropper));
+	test_settle();
+
+	g_assert(dropper.count == 1);
+	g_assert(dropped.count == 0);
+	g_assert(dropped.id == 0);
+
+	/* And one can take itself out */
+	dropper.drop = &dropper;
+	hub_emit(bus, "/org/test/hub/dispatch", "LayoutUpdated");
+	test_settle();
+
+	g_assert(dropper.count == 2);
+	g_assert(dropper.id == 0);
+	g_assert(g_hash_table_size(hubs) == 0);
+
+	hub_route_clear(&dropper);
+	hub_route_clear(&dropped);
+
+	test_settle();
+	g_object_unref(bus);
+	return;
+}
+
+typedef struct _hub_client_test_t hub_client_test_t;
+struct _hub_client_test_t {
+	DbusmenuClient * client;
+	guint changes;
+	hub_client_test_t * other; /* Unref this one when there are changes */
+};
+
+static void
+hub_client_changed (DbusmenuClient * client, GHashTable * changes, gpointer user_data)
+{
+	hub_client_test_t * test = (hub_client_test_t *)user_data;
+	test->changes++;
+
+	if (test->other != NULL && test->other->client != NULL) {
+		g_object_unref(test->other->client);
+		test->other->client = NULL;
+	}
+
+	return;
+}
+
+static void
+hub_client_new (hub_client_test_t * test, GDBusConnection * bus, const gchar * path, DbusmenuMenuitem * root)
+{
+	test->changes = 0;
+	test->other = NULL;
+	test->client = DBUSMENU_CLIENT(g_object_new(DBUSMENU_TYPE_CLIENT,
+	                                            DBUSMENU_CLIENT_PROP_DBUS_NAME, g_dbus_connection_get_unique_name(bus),
+	                                            DBUSMENU_CLIENT_PROP_DBUS_OBJECT, path,
+	                                            DBUSMENU_CLIENT_PROP_SHARED_CONNECTION, TRUE,
+	                                            NULL));
+	g_signal_connect(test->client, DBUSMENU_CLIENT_SIGNAL_ITEMS_PROPERTIES_CHANGED, G_CALLBACK(hub_client_changed), test);
+	g_assert(test_wait_for_sync(root, test->client));
+	return;
+}
+
+static gboolean
+hub_client_changes (gpointer data)
+{
+	return ((hub_client_test_t *)data)->changes > 0;
+}
+
+static const gchar *
+hub_client_label (hub_client_test_t * test, gint id)
+{
+	DbusmenuMenuitem * item = dbusmenu_menuitem_find_id(dbusmenu_client_get_root(test->client), id);
+	g_assert(item != NULL);
+	return dbusmenu_menuitem_property_get(item, DBUSMENU_MENUITEM_PROP_LABEL);
+}
+
+/* Clients sharing the connection each get the signals for their
+   own menu, and one can go away while another is handling them */
+static void
+test_hub_clients (void)
+{
+	GDBusConnection * bus = test_bus();
+
+	DbusmenuServer * serverone = dbusmenu_server_new("/org/test/hub/one");
+	DbusmenuMenuitem * rootone = test_menu_new(2);
+	dbusmenu_server_set_root(serverone, rootone);
+
+	DbusmenuServer * servertwo = dbusmenu_server_new("/org/test/hub/two");
+	DbusmenuMenuitem * roottwo = test_menu_new(2);
+	dbusmenu_server_set_root(servertwo, roottwo);
+
+	hub_client_test_t one, two;
+	hub_client_new(&one, bus, "/org/test/hub/one", rootone);
+	hub_client_new(&two, bus, "/org/test/hub/two", roottwo);
+	test_settle();
+	test_calls_reset();
+
+	dbusmenu_menuitem_property_set(dbusmenu_menuitem_find_id(rootone, 1), DBUSMENU_MENUITEM_PROP_LABEL, "One");
+	g_assert(test_wait_for(hub_client_changes, &one));
+	test_settle();
+
+	g_assert(one.changes == 1);
+	g_assert(two.changes == 0);
+	g_assert(g_strcmp0(hub_client_label(&one, 1), "One") == 0);
+	g_assert(g_strcmp0(hub_client_label(&two, 1), "Item 1") == 0);
+
+	dbusmenu_menuitem_property_set(dbusmenu_menuitem_find_id(roottwo, 1), DBUSMENU_MENUITEM_PROP_LABEL, "Two");
+	g_assert(test_wait_for(hub_client_changes, &two));
+	test_settle();
+
+	g_assert(one.changes == 1);
+	g_assert(two.changes == 1);
+	g_assert(g_strcmp0(hub_client_label(&two, 1), "Two") == 0);
+
+	/* Two clients on the same menu, whichever hears about the
+	   change first gets rid of the other one */
+	g_object_unref(two.client);
+
+	hub_client_test_t first, second;
+	hub_client_new(&first, bus, "/org/test/hub/one", rootone);
+	hub_client_new(&second, bus, "/org/test/hub/one", rootone);
+	first.other = &second;
+	second.other = &first;
+	one.changes = 0;
+	test_settle();
+
+	dbusmenu_menuitem_property_set(dbusmenu_menuitem_find_id(rootone, 2), DBUSMENU_MENUITEM_PROP_LABEL, "Gone");
+	g_assert(test_wait_for(hub_client_changes, &one));
+	test_settle();
+
+	g_assert(first.changes + second.changes == 1);
+	g_assert((first.client == NULL) != (second.client == NULL));
+	g_assert(one.changes == 1);
+
+	if (first.client != NULL) {
+		g_object_unref(first.client);
+	}
+	if (second.client != NULL) {
+		g_object_unref(second.client);
+	}
+	g_object_unref(one.client);
+
+	g_object_unref(serverone);
+	g_object_unref(rootone);
+	g_object_unref(servertwo);
+	g_object_unref(roottwo);
+	test_settle();
+	g_object_unref(bus);
+
+	return;
+}
+
+#define LEAN_NAME  "org.dbusmenu.test.lean"
+#define LEAN_PATH  "/org/test/lean"
+
+static void
+transport_name_acquired (GDBusConnection * connection, const gchar * name, gpointer user_data)
+{
+	*(gboolean *)user_data = TRUE;
+	return;
+}
+
+static gboolean
+transport_name_owned (gpointer data)
+{
+	return *(gboolean *)data;
+}
+
+/* Own @name on @bus and wait until we have it */
+static guint
+transport_own (GDBusConnection * bus, const gchar * name, GBusNameOwnerFlags flags)
+{
+	gboolean owned = FALSE;
+	guint owner = g_bus_own_name_on_connection(bus, name, flags, transport_name_acquired, NULL, &owned, NULL);
+	g_assert(test_wait_for(transport_name_owned, &owned));
+	return owner;
+}
+
+static DbusmenuClient *
+lean_client_new (void)
+{
+	return DBUSMENU_CLIENT(g_object_new(DBUSMENU_TYPE_CLIENT,
+	                                    DBUSMENU_CLIENT_PROP_DBUS_NAME, LEAN_NAME,
+	                                    DBUSMENU_CLIENT_PROP_DBUS_OBJECT, LEAN_PATH,
+	                                    DBUSMENU_CLIENT_PROP_LEAN_TRANSPORT, TRUE,
+	                                    NULL));
+}
+
+static gboolean
+lean_no_root (gpointer data)
+{
+	return dbusmenu_client_get_root(DBUSMENU_CLIENT(data)) == NULL;
+}
+
+/* The server leaving takes the menu with it, and when it comes
+   back the menu is fetched again */
+static void
+test_lean_reappear (void)
+{
+	GDBusConnection * bus = test_bus();
+	guint owner = transport_own(bus, LEAN_NAME, G_BUS_NAME_OWNER_FLAGS_NONE);
+
+	DbusmenuServer * server = dbusmenu_server_new(LEAN_PATH);
+	DbusmenuMenuitem * root = test_menu_new(3);
+	dbusmenu_server_set_root(server, root);
+
+	DbusmenuClient * client = lean_client_new();
+	g_assert(test_wait_for_sync(root, client));
+	test_settle();
+
+	g_bus_unown_name(owner);
+	g_assert(test_wait_for(lean_no_root, client));
+
+	test_calls_reset();
+	owner = transport_own(bus, LEAN_NAME, G_BUS_NAME_OWNER_FLAGS_NONE);
+	g_assert(test_wait_for_sync(root, client));
+	test_settle();
+
+	g_assert(test_calls_count("GetLayout") >= 1);
+
+	/* And it's listening to the server again */
+	DbusmenuMenuitem * four = dbusmenu_menuitem_new_with_id(4);
+	dbusmenu_menuitem_child_append(root, four);
+	g_object_unref(four);
+	g_assert(test_wait_for_sync(root, client));
+
+	g_object_unref(client);
+	g_object_unref(server);
+	g_object_unref(root);
+	g_bus_unown_name(owner);
+	test_settle();
+	g_object_unref(bus);
+
+	return;
+}
+
+/* A server that takes the name over on its own connection */
+static const gchar * v3_xml =
+"<node>"
+"  <interface name='com.canonical.dbusmenu'>"
+"    <property name='Version' type='u' access='read'/>"
+"    <property name='TextDirection' type='s' access='read'/>"
+"    <property name='Status' type='s' access='read'/>"
+"    <property name='IconThemePath' type='as' access='read'/>"
+"    <method name='GetLayout'>"
+"      <arg type='i' name='parentId' direction='in'/>"
+"      <arg type='i' name='recursionDepth' direction='in'/>"
+"      <arg type='as' name='propertyNames' direction='in'/>"
+"      <arg type='u' name='revision' direction='out'/>"
+"      <arg type='(ia{sv}av)' name='layout' direction='out'/>"
+"    </method>"
+"    <signal name='LayoutUpdated'>"
+"      <arg type='u' name='revision'/>"
+"      <arg type='i' name='parent'/>"
+"    </signal>"
+"  </interface>"
+"</node>";
+
+typedef struct _v3_server_t v3_server_t;
+struct _v3_server_t {
+	DbusmenuMenuitem * root;
+	guint revision;
+};
+
+static GVariant *
+v3_layout (DbusmenuMenuitem * mi)
+{
+	GVariantBuilder children;
+	g_variant_builder_init(&children, G_VARIANT_TYPE("av"));
+
+	GList * child;
+	for (child = dbusmenu_menuitem_get_children(mi); child != NULL; child = g_list_next(child)) {
+		g_variant_builder_add(&children, "v", v3_layout(DBUSMENU_MENUITEM(child->data)));
+	}
+
+	return g_variant_new("(i@a{sv}@av)", dbusmenu_menuitem_get_id(mi),
+	                     g_variant_new_array(G_VARIANT_TYPE("{sv}"), NULL, 0),
+	                     g_variant_builder_end(&children));
+}
+
+static void
+v3_method (GDBusConnection * connection, const gchar * sender, const gchar * path, const gchar * interface, const gchar * method, GVariant * params, GDBusMethodInvocation * invocation, gpointer user_data)
+{
+	v3_server_t * v3 = (v3_server_t *)user_data;
+	gint parent;
+	gint depth;
+	GVariant * props;
+
+	g_variant_get(params, "(ii@as)", &parent, &depth, &props);
+	g_variant_unref(props);
+
+	DbusmenuMenuitem * mi = dbusmenu_menuitem_find_id(v3->root, parent);
+	if (mi == NULL) {
+		g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS, "No item %d", parent);
+		return;
+	}
+
+	g_dbus_method_invocation_return_value(invocation,
+		g_variant_new("(u@(ia{sv}av))", v3->revision, v3_layout(mi)));
+
+	return;
+}
+
+static GVariant *
+v3_property (GDBusConnection * connection, const gchar * sender, const gchar * path, const gchar * interface, const gchar * property, GError ** error, gpointer user_data)
+{
+	if (g_strcmp0(property, "Version") == 0) {
+		return g_variant_new_uint32(3);
+	} else if (g_strcmp0(property, "TextDirection") == 0) {
+		return g_variant_new_string("ltr");
+	} else if (g_strcmp0(property, "Status") == 0) {
+		return g_variant_new_string("normal");
+	} else if (g_strcmp0(property, "IconThemePath") == 0) {
+		return g_variant_new_strv(NULL, 0);
+	}
+
+	return NULL;
+}
+
+static const GDBusInterfaceVTable v3_vtable = {
+	v3_method,
+	v3_property,
+	NULL
+};
+
+/* When someone else takes the name the client moves over to
+   them, and stops listening to the one it had */
+static void
+test_lean_owner_change (void)
+{
+	GDBusConnection * bus = test_bus();
+	guint owner = transport_own(bus, LEAN_NAME, G_BUS_NAME_OWNER_FLAGS_ALLOW_REPLACEMENT);
+
+	DbusmenuServer * server = dbusmenu_server_new(LEAN_PATH);
+	DbusmenuMenuitem * root = test_menu_new(3);
+	dbusmenu_server_set_root(server, root);
+
+	DbusmenuClient * client = lean_client_new();
+	g_assert(test_wait_for_sync(root, client));
+	test_settle();
+
+	/* Another connection with a different menu */
+	gchar * address = g_dbus_address_get_for_bus_sync(G_BUS_TYPE_SESSION, NULL, NULL);
+	g_assert(address != NULL);
+	GDBusConnection * other = g_dbus_connection_new_for_address_sync(address,
+	                                                                 G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT | G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+	                                                                 NULL, NULL, NULL);
+	g_assert(other != NULL);
+	g_free(address);
+
+	GDBusNodeInfo * info = g_dbus_node_info_new_for_xml(v3_xml, NULL);
+	g_assert(info != NULL);
+
+	v3_server_t v3;
+	v3.root = test_menu_new(5);
+	v3.revision = 1;
+
+	guint object = g_dbus_connection_register_object(other, LEAN_PATH, info->interfaces[0], &v3_vtable, &v3, NULL, NULL);
+	g_assert(object != 0);
+
+	guint otherowner = transport_own(other, LEAN_NAME, G_BUS_NAME_OWNER_FLAGS_REPLACE);
+	g_assert(test_wait_for_sync(v3.root, client));
+	test_settle();
+
+	/* The old server changing doesn't matter anymore */
+	test_calls_reset();
+	dbusmenu_menuitem_child_delete(root, dbusmenu_menuitem_find_id(root, 1));
+	test_settle();
+
+	g_assert(test_calls_count("LayoutUpdated") >= 1);
+	g_assert(test_calls_count("GetLayout") == 0);
+	g_assert(test_calls_count("GetLayoutDelta") == 0);
+	g_assert(test_tree_matches(v3.root, dbusmenu_client_get_root(client)));
+
+	/* The new one does */
+	DbusmenuMenuitem * six = dbusmenu_menuitem_new_with_id(6);
+	dbusmenu_menuitem_child_append(v3.root, six);
+	g_object_unref(six);
+
+	v3.revision++;
+	g_dbus_connection_emit_signal(other, NULL, LEAN_PATH, "com.canonical.dbusmenu", "LayoutUpdated",
+	                              g_variant_new("(ui)", v3.revision, 0), NULL);
+
+	g_assert(test_wait_for_sync(v3.root, client));
+	g_assert(test_calls_count("GetLayout") >= 1);
+
+	g_object_unref(client);
+	g_bus_unown_name(otherowner);
+	g_dbus_connection_unregister_object(other, object);
+	g_dbus_node_info_unref(info);
+	g_object_unref(v3.root);
+	g_dbus_connection_close_sync(other, NULL, NULL);
+	g_object_unref(other);
+
+	g_object_unref(server);
+	g_object_unref(root);
+	g_bus_unown_name(owner);
+	test_settle();
+	g_object_unref(bus);
+
+	return;
+}
+
+#define RECONNECT_NAME   "org.dbusmenu.test.reconnect"
+#define RECONNECT_GRACE  1000
+
+typedef struct _reconnect_test_t reconnect_test_t;
+struct _reconnect_test_t {
+	test_fixture_t fixture;
+	guint owner;
+	guint roots; /* root-changed signals */
+};
+
+static void
+reconnect_root_changed (DbusmenuClient * client, DbusmenuMenuitem * newroot, gpointer user_data)
+{
+	((reconnect_test_t *)user_data)->roots++;
+	return;
+}
+
+/* The tests are run with the proxy and with the lean transport,
+   which @data says */
+static void
+reconnect_setup (reconnect_test_t * test, const gchar * path, gconstpointer data)
+{
+	test_fixture_setup(&test->fixture, path, test_menu_new(3));
+	test->owner = transport_own(test->fixture.bus, RECONNECT_NAME, G_BUS_NAME_OWNER_FLAGS_NONE);
+
+	test_fixture_connect(&test->fixture, DBUSMENU_CLIENT(g_object_new(DBUSMENU_TYPE_CLIENT,
+	                                                                  DBUSMENU_CLIENT_PROP_DBUS_NAME, RECONNECT_NAME,
+	                                                                  DBUSMENU_CLIENT_PROP_DBUS_OBJECT, path,
+	                                                                  DBUSMENU_CLIENT_PROP_RECONNECT_GRACE, RECONNECT_GRACE,
+	                                                                  DBUSMENU_CLIENT_PROP_LEAN_TRANSPORT, GPOINTER_TO_INT(data),
+	                                                                  NULL)));
+
+	test->roots = 0;
+	g_signal_connect(test->fixture.client, DBUSMENU_CLIENT_SIGNAL_ROOT_CHANGED, G_CALLBACK(reconnect_root_changed), test);
+
+	return;
+}
+
+static void
+reconnect_teardown (reconnect_test_t * test)
+{
+	if (test->owner != 0) {
+		g_bus_unown_name(test->owner);
+	}
+	test_fixture_teardown(&test->fixture);
+
+	return;
+}
+
+static gboolean
+reconnect_root_replaced (gpointer data)
+{
+	return ((reconnect_test_t *)data)->roots > 0;
+}
+
+static gboolean
+reconnect_relabeled (gpointer data)
+{
+	reconnect_test_t * test = (reconnect_test_t *)data;
+	DbusmenuMenuitem * root = dbusmenu_client_get_root(test->fixture.client);
+	DbusmenuMenuitem * two = root != NULL ? dbusmenu_menuitem_find_id(root, 2) : NULL;
+	return two != NULL && g_strcmp0(dbusmenu_menuitem_property_get(two, DBUSMENU_MENUITEM_PROP_LABEL), "Back") == 0;
+}
+
+/* A server that comes back inside the grace period gets matched
+   up with the items the client kept */
+static void
+test_reconnect_within_grace (gconstpointer data)
+{
+	reconnect_test_t test;
+	reconnect_setup(&test, "/org/test/reconnect/within", data);
+
+	DbusmenuMenuitem * clientroot = dbusmenu_client_get_root(test.fixture.client);
+	DbusmenuMenuitem * clienttwo = dbusmenu_menuitem_find_id(clientroot, 2);
+
+	/* Once the client has heard it's gone, it's still there
+	   while we wait */
+	g_bus_unown_name(test.owner);
+	test.owner = 0;
+	test_settle();
+
+	g_assert(dbusmenu_client_get_root(test.fixture.client) == clientroot);
+	g_assert(test.roots == 0);
+
+	/* It comes back a little different */
+	dbusmenu_menuitem_property_set(dbusmenu_menuitem_find_id(test.fixture.root, 2), DBUSMENU_MENUITEM_PROP_LABEL, "Back");
+	dbusmenu_menuitem_child_delete(test.fixture.root, dbusmenu_menuitem_find_id(test.fixture.root, 3));
+	test.owner = transport_own(test.fixture.bus, RECONNECT_NAME, G_BUS_NAME_OWNER_FLAGS_NONE);
+
+	g_assert(test_wait_for(reconnect_relabeled, &test));
+	g_assert(test_wait_for_sync(test.fixture.root, test.fixture.client));
+
+	/* Only what changed was rebuilt */
+	g_assert(dbusmenu_client_get_root(test.fixture.client) == clientroot);
+	g_assert(dbusmenu_menuitem_find_id(clientroot, 2) == clienttwo);
+	g_assert(dbusmenu_menuitem_find_id(clientroot, 3) == NULL);
+
+	/* And the grace timer doesn't go off later */
+	g_assert(!test_wait_for_msec(reconnect_root_replaced, &test, RECONNECT_GRACE + 200));
+	g_assert(dbusmenu_client_get_root(test.fixture.client) == clientroot);
+
+	reconnect_teardown(&test);
+	return;
+}
+
+static gboolean
+reconnect_no_root (gpointer data)
+{
+	return dbusmenu_client_get_root(((reconnect_test_t *)data)->fixture.client) == NULL;
+}
+
+/* A server that stays away has its menu dropped once the grace
+   period is over, and not before */
+static void
+test_reconnect_after_grace (gconstpointer data)
+{
+	reconnect_test_t test;
+	reconnect_setup(&test, "/org/test/reconnect/after", data);
+
+	gint64 start = g_get_monotonic_time();
+	g_bus_unown_name(test.owner);
+	test.owner = 0;
+
+	g_assert(test_wait_for(reconnect_no_root, &test));
+	g_assert(g_get_monotonic_time() - start >= (RECONNECT_GRACE - 100) * 1000);
+	g_assert(test.roots == 1);
+
+	/* Coming back after that is like starting over */
+	test.owner = transport_own(test.fixture.bus, RECONNECT_NAME, G_BUS_NAME_OWNER_FLAGS_NONE);
+	g_assert(test_wait_for_sync(test.fixture.root, test.fixture.client));
+	g_assert(test.roots == 2);
+
+	reconnect_teardown(&test);
+	return;
+}
+
+/* Build the test suites */
+static void
+test_glib_hub_suite (void)
+{
+	g_test_add_func ("/dbusmenu/glib/hub/routing",               test_hub_routing);
+	g_test_add_func ("/dbusmenu/glib/hub/unregister_in_dispatch", test_hub_unregister_in_dispatch);
+	g_test_add_func ("/dbusmenu/glib/hub/clients",               test_hub_clients);
+	return;
+}
+
+static void
+test_glib_lean_suite (void)
+{
+	g_test_add_func ("/dbusmenu/glib/lean/reappear",     test_lean_reappear);
+	g_test_add_func ("/dbusmenu/glib/lean/owner_change", test_lean_owner_change);
+	return;
+}
+
+static void
+test_glib_reconnect_suite (void)
+{
+	g_test_add_data_func ("/dbusmenu/glib/reconnect/proxy/within_grace", GINT_TO_POINTER(FALSE), test_reconnect_within_grace);
+	g_test_add_data_func ("/dbusmenu/glib/reconnect/proxy/after_grace",  GINT_TO_POINTER(FALSE), test_reconnect_after_grace);
+	g_test_add_data_func ("/dbusmenu/glib/reconnect/lean/within_grace",  GINT_TO_POINTER(TRUE),  test_reconnect_within_grace);
+	g_test_add_data_func ("/dbusmenu/glib/reconnect/lean/after_grace",   GINT_TO_POINTER(TRUE),  test_reconnect_after_grace);
+	return;
+}
+
+gint
+main (gint argc, gchar * argv[])
+{
+	g_test_init(&argc, &argv, NULL);
+
+	/* Test suites */
+	test_glib_hub_suite();
+	test_glib_lean_suite();
+	test_glib_reconnect_suite();
+
+	return g_test_run ();
+}